@@ -4,95 +4,96 @@
 
 #include "Advance.h"
 
+#include "ClockTracker.h"
+#include "Playheads.h"
+#include "State.h"
 #include "Utils.h"
 
 /**
- * @brief Change the current preset to the next preset and calculate the expected gate length.
+ * @brief Change the current preset in response to a gate: at the ADV input, or a step from the
+ * leader of linked modules. See Link.h.
  *
- * @param loopStartTime
- * @return State
+ * @param state
+ * @param preset Normally the next preset. See nextPreset().
+ * @param gateMicros micros() when the gate arrived.
  */
-void Advance::advancePreset(unsigned long *loopStartTime, State *state) {
-  // WARNING! ACHTUNG! PELIGRO! We need to prevent infinite recursion.
-  // If all presets have been somehow removed, we need to prevent nextPreset() from recursing.
-  bool allowRecursion = !Advance::allPresetsRemoved(state->removedPresets);
-  state->currentPreset = Advance::nextPreset(
-    state->currentPreset,
-    state->advancePresetAddend,
-    state->removedPresets,
-    allowRecursion
-  );
+void Advance::advanceTo(State *state, uint8_t preset, uint32_t gateMicros) {
+  if (state->config.randomOutputOverwrites) {
+    // Set random output voltages of the preset before advancing to it.
+    State::setRandomVoltagesForPreset(preset, state->randomStep + 1, state);
+  }
+  state->currentPreset = preset;
+  Playheads::advance(state);
+  state->randomStep += 1;
+  ClockTracker::handleGate(state, gateMicros);
+  Advance::updateStateAfterAdvancing(state);
 }
 
 /**
- * @brief Determine whether all presets have been removed. This should never occur, but we check to
- * make sure we will not enter an infinite recursion in Advance::nextPreset().
+ * @brief Flag the table as out of date, after a change to removedPresets.
  *
- * @param removedPresets
- * @return true
- * @return false
+ * @param state
  */
-bool Advance::allPresetsRemoved(bool removedPresets[]) {
-  bool allRemoved = true;
-  for (u_int8_t i = 0; i < 16; i++) {
-    if (!removedPresets[i]) {
-      allRemoved = false;
-      break;
-    }
-  }
-  return allRemoved;
+void Advance::markStale(State *state) {
+  state->advance.isStale = true;
 }
 
 /**
- * @brief Get the index of the next preset. Note that the last argument, allowRecursion, should be
- * provided by the inverse result of Advance::allPresetsRemoved() to prevent infinite recursion.
+ * @brief Get the index of the preset after a preset, in the direction and by the size of
+ * advancePresetAddend.
  *
+ * @param state
  * @param preset
- * @param addend
- * @param removedPresets
- * @param allowRecursion
  * @return uint8_t
  */
-uint8_t Advance::nextPreset(uint8_t preset, uint8_t addend, bool removedPresets[], bool allowRecursion) {
-  uint8_t addendedPreset = preset + addend;
-  uint8_t nextPreset =
-    addendedPreset > 15
-      ? addendedPreset - 16
-      : addendedPreset < 0
-        ? addendedPreset + 16
-        : addendedPreset;
-  if (allowRecursion && removedPresets[nextPreset]) {
-    nextPreset = Advance::nextPreset(nextPreset, addend, removedPresets, allowRecursion);
+uint8_t Advance::nextPreset(State *state, uint8_t preset) {
+  Advance *advance = &state->advance;
+  int8_t addend = state->advancePresetAddend;
+  uint8_t size = addend < 0 ? -addend : addend;
+  if (advance->isStale || advance->tableAddend != size) {
+    Advance::rebuild(state, size);
   }
-  return nextPreset;
+  return addend < 0 ? advance->previousPresets[preset] : advance->nextPresets[preset];
 }
 
 /**
- * @brief This function assumes it is being called when state.isAdvancingPresets is true.
+ * @brief This function assumes it is being called when state->isAdvancingPresets is true.
  * TODO: break this up into multiple functions that do one thing instead of this grab bag.
  *
- * @param loopStartTime
- * @return State
+ * @param state
  */
-State Advance::updateStateAfterAdvancing(unsigned long loopStartTime, State state) {
+void Advance::updateStateAfterAdvancing(State *state) {
   // Press record key while advancing: sample new voltage immediately after advance
-  if (state.screen == SCREEN.RECORD_CHANNEL_SELECT && state.selectedKeyForRecording >= 0) {
-    state = State::recordVoltageOnSelectedChannel(state);
+  if (state->screen == SCREEN.RECORD_CHANNEL_SELECT && state->selectedKeyForRecording >= 0) {
+    State::recordVoltageOnSelectedChannel(state);
   }
+}
 
-  // manage gate length
-  if (state.isClocked) {
-    if (loopStartTime - state.lastAdvReceivedTime[0] > 0) {
-      state.gateMillis = static_cast<unsigned long>((loopStartTime - state.lastAdvReceivedTime[0]) / 2);
-    }
-  } else {
-    state.gateMillis = DEFAULT_TRIGGER_LENGTH;
-  }
+//--------------------------------------- PRIVATE --------------------------------------------------
 
-  // update tracking of last ADV pulse received
-  state.lastAdvReceivedTime[2] = state.lastAdvReceivedTime[1];
-  state.lastAdvReceivedTime[1] = state.lastAdvReceivedTime[0];
-  state.lastAdvReceivedTime[0] = loopStartTime;
+void Advance::rebuild(State *state, uint8_t addend) {
+  Advance *advance = &state->advance;
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    advance->nextPresets[preset] = Advance::presetAfter(state->removedPresets, preset, addend);
+    advance->previousPresets[preset] = Advance::presetAfter(state->removedPresets, preset, -addend);
+  }
+  advance->tableAddend = addend;
+  advance->isStale = false;
+}
 
-  return state;
+/**
+ * @brief The preset after a preset, skipping the removed presets. The walk is bounded, so if every
+ * preset it can reach has been somehow removed, this is the preset after it regardless.
+ */
+uint8_t Advance::presetAfter(bool removedPresets[], uint8_t preset, int8_t addend) {
+  // The addend as a distance forward, so that the walk never goes below 0.
+  uint8_t distance = (addend % 16 + 16) % 16;
+  uint8_t nextPreset = preset;
+  for (uint8_t i = 0; i < 16; i++) {
+    nextPreset = (nextPreset + distance) % 16;
+    if (!removedPresets[nextPreset]) {
+      return nextPreset;
+    }
+  }
+  return (preset + distance) % 16;
 }
@@ -4,16 +4,40 @@
  * Copyright 2022 William Edward Fisher.
  */
 
-#include "State.h"
+#include "typedefs.h"
 
 #ifndef RECOLLECTIONS_ADVANCE_H_
 #define RECOLLECTIONS_ADVANCE_H_
 
+struct State;
+
+/**
+ * The preset that follows each preset, skipping the removed presets, in both directions. Advancing
+ * is then a single lookup rather than a walk past the removed presets. The table is rebuilt on the
+ * next lookup after removedPresets changes, which marks it stale, or after the size of
+ * advancePresetAddend changes.
+ */
 typedef struct Advance {
-  static void advancePreset(unsigned long *loopStartTime, State *state);
-  static bool allPresetsRemoved(bool removedPresets[]);
-  static uint8_t nextPreset(uint8_t preset, uint8_t addend, bool removedPresets[], bool allowRecursion);
-  static State updateStateAfterAdvancing(unsigned long loopStartTime, State state);
+  /** The preset after each preset, forward and in reverse. Indices are [preset]. */
+  uint8_t nextPresets[16];
+  uint8_t previousPresets[16];
+
+  /** The size of the addend the table was built for. */
+  uint8_t tableAddend;
+
+  /** Whether the table is out of date. */
+  bool isStale;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  static void advanceTo(State *state, uint8_t preset, uint32_t gateMicros);
+  static void markStale(State *state);
+  static uint8_t nextPreset(State *state, uint8_t preset);
+  static void updateStateAfterAdvancing(State *state);
+
+  private:
+  static void rebuild(State *state, uint8_t addend);
+  static uint8_t presetAfter(bool removedPresets[], uint8_t preset, int8_t addend);
 } Advance;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "BankRecord.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "State.h"
+#include "Utils.h"
+#include "constants.h"
+
+/**
+ * @brief The size of a record of a version, or 0 for a version we cannot read.
+ */
+static size_t sizeOfVersion(uint16_t version) {
+  switch (version) {
+    case 1:
+      return BANK_RECORD_V1_SIZE;
+    case 2:
+      return BANK_RECORD_V2_SIZE;
+    case BANK_RECORD_VERSION:
+      return sizeof(BankRecord);
+    default:
+      return 0;
+  }
+}
+
+void BankRecord::fromState(State *state, uint8_t bank, BankRecord *record) {
+  record->magic = BANK_RECORD_MAGIC;
+  record->version = BANK_RECORD_VERSION;
+  record->size = sizeof(BankRecord);
+  record->autoRecordChannels = state->autoRecordChannels[bank];
+  record->gateChannels = state->gateChannels[bank];
+  record->randomInputChannels = state->randomInputChannels[bank];
+  record->randomOutputChannels = state->randomOutputChannels[bank];
+  for (uint8_t i = 0; i < 16; i++) {
+    record->activeVoltages[i] = state->activeVoltages[bank][i];
+    record->gateVoltages[i] = state->gateVoltages[bank][i];
+    record->lockedVoltages[i] = state->lockedVoltages[bank][i];
+    record->randomVoltages[i] = state->randomVoltages[bank][i];
+    for (uint8_t j = 0; j < 8; j++) {
+      record->voltages[i][j] = state->voltages[bank][i][j];
+    }
+  }
+  for (uint8_t j = 0; j < 8; j++) {
+    record->randomSeeds[j] = state->randomSeeds[bank][j];
+    record->channelLengths[j] = state->channelLengths[bank][j];
+    record->channelAddends[j] = state->channelAddends[bank][j];
+    record->removedSteps[j] = state->removedSteps[bank][j];
+  }
+  record->crc = BankRecord::checksum(record);
+}
+
+bool BankRecord::toState(BankRecord *record, State *state, uint8_t bank) {
+  if (!BankRecord::isValid(record)) {
+    return false;
+  }
+  state->autoRecordChannels[bank] = record->autoRecordChannels;
+  state->gateChannels[bank] = record->gateChannels;
+  state->randomInputChannels[bank] = record->randomInputChannels;
+  state->randomOutputChannels[bank] = record->randomOutputChannels;
+  for (uint8_t i = 0; i < 16; i++) {
+    state->activeVoltages[bank][i] = record->activeVoltages[i];
+    state->gateVoltages[bank][i] = record->gateVoltages[i];
+    state->lockedVoltages[bank][i] = record->lockedVoltages[i];
+    state->randomVoltages[bank][i] = record->randomVoltages[i];
+    for (uint8_t j = 0; j < 8; j++) {
+      // Guard against out of range values, as these go straight to the DACs.
+      state->voltages[bank][i][j] = record->voltages[i][j] > MAX_UNSIGNED_12_BIT
+        ? MAX_UNSIGNED_12_BIT
+        : record->voltages[i][j];
+    }
+  }
+  bool const hasSeeds = record->version >= 2;
+  bool const hasSequences = record->version >= 3;
+  for (uint8_t j = 0; j < 8; j++) {
+    state->randomSeeds[bank][j] = hasSeeds ? record->randomSeeds[j] : 0;
+    // Without a sequence of its own, a channel plays the current preset.
+    state->channelLengths[bank][j] = hasSequences && record->channelLengths[j] <= 16
+      ? record->channelLengths[j]
+      : 0;
+    state->channelAddends[bank][j] = hasSequences ? record->channelAddends[j] : 1;
+    state->removedSteps[bank][j] = hasSequences ? record->removedSteps[j] : 0;
+  }
+  return true;
+}
+
+bool BankRecord::isValid(BankRecord *record) {
+  if (record->magic != BANK_RECORD_MAGIC) {
+    return false;
+  }
+  size_t const size = sizeOfVersion(record->version);
+  if (size == 0 || record->size != size) {
+    return false;
+  }
+  if (record->version < BANK_RECORD_VERSION) {
+    // The CRC of an older record is in its last four bytes, where the later fields now begin.
+    uint32_t crc;
+    size_t const crcOffset = size - sizeof(uint32_t);
+    memcpy(&crc, reinterpret_cast<uint8_t *>(record) + crcOffset, sizeof(uint32_t));
+    return crc == Utils::crc32(reinterpret_cast<uint8_t *>(record), crcOffset);
+  }
+  return record->crc == BankRecord::checksum(record);
+}
+
+uint32_t BankRecord::checksum(BankRecord *record) {
+  return Utils::crc32(reinterpret_cast<uint8_t *>(record), offsetof(BankRecord, crc));
+}
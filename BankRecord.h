@@ -0,0 +1,118 @@
+/**
+ * Recollections: Bank Record
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <stddef.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_BANK_RECORD_H_
+#define RECOLLECTIONS_BANK_RECORD_H_
+
+// Declared here rather than included, as State holds these records for saving. See SaveJob.h.
+struct State;
+
+/**
+ * The binary form of one bank, as stored in Module.bin (see ModuleImage.h) and in the legacy
+ * Bank_n.bin files on the SD card. The record is read and written as a single block, so the
+ * layout must not change without incrementing BANK_RECORD_VERSION. See constants.h.
+ *
+ * The boolean planes are stored in the same bit-packed form as in State. Voltages are stored as
+ * 16-bit little-endian values so the record can be used in place without unpacking; both of our
+ * target platforms are little-endian.
+ *
+ * Older records, which end with their CRC where the later fields begin, are still read. Version 1
+ * records have every random seed set to 0, and version 1 and 2 records have no channel sequences.
+ * They are written back as the current version.
+ */
+typedef struct BankRecord {
+  /** Always BANK_RECORD_MAGIC. Used to reject files that are not bank records. */
+  uint32_t magic;
+
+  /** The version of this layout, BANK_RECORD_VERSION at the time of writing. */
+  uint16_t version;
+
+  /** The size of the record in bytes at the time of writing. */
+  uint16_t size;
+
+  ChannelFlags_t autoRecordChannels;
+  ChannelFlags_t gateChannels;
+  ChannelFlags_t randomInputChannels;
+  ChannelFlags_t randomOutputChannels;
+
+  /** Indices are [preset], with one bit per channel. */
+  ChannelFlags_t activeVoltages[16];
+  ChannelFlags_t gateVoltages[16];
+  ChannelFlags_t lockedVoltages[16];
+  ChannelFlags_t randomVoltages[16];
+
+  /** Indices are [preset][channel]. */
+  uint16_t voltages[16][8];
+
+  /** Indices are [channel]. Added in version 2. */
+  uint16_t randomSeeds[8];
+
+  /** The sequence of each channel. See State::channelLengths. Indices are [channel]. Version 3. */
+  uint8_t channelLengths[8];
+  int8_t channelAddends[8];
+  uint16_t removedSteps[8];
+
+  /** CRC-32 of every preceding byte in the record. */
+  uint32_t crc;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Copy one bank out of state into a record, including its header and CRC.
+   *
+   * @param state
+   * @param bank
+   * @param record
+   */
+  static void fromState(State *state, uint8_t bank, BankRecord *record);
+
+  /**
+   * @brief Copy a record into one bank of state. The record is validated first, and state is left
+   * untouched if the record is not valid.
+   *
+   * @param record
+   * @param state
+   * @param bank
+   * @return true
+   * @return false
+   */
+  static bool toState(BankRecord *record, State *state, uint8_t bank);
+
+  /**
+   * @brief Check the magic number, version, size and CRC of a record, of any version. Only the
+   * first size bytes of the record are meaningful.
+   *
+   * @param record
+   * @return true
+   * @return false
+   */
+  static bool isValid(BankRecord *record);
+
+  /**
+   * @brief Calculate the CRC of a record, covering every byte prior to the crc member.
+   *
+   * @param record
+   * @return uint32_t
+   */
+  static uint32_t checksum(BankRecord *record);
+} BankRecord;
+
+static_assert(sizeof(BankRecord) == 384, "BankRecord layout changed; increment the version");
+static_assert(
+  offsetof(BankRecord, randomSeeds) == BANK_RECORD_V1_SIZE - sizeof(uint32_t),
+  "A version 1 record must end where the random seeds begin"
+);
+static_assert(
+  offsetof(BankRecord, channelLengths) == BANK_RECORD_V2_SIZE - sizeof(uint32_t),
+  "A version 2 record must end where the channel sequences begin"
+);
+
+#endif
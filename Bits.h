@@ -0,0 +1,58 @@
+/**
+ * Recollections: Bits
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_BITS_H_
+#define RECOLLECTIONS_BITS_H_
+
+/**
+ * Accessors for the packed boolean planes in State. Each ChannelFlags_t holds one flag per output
+ * channel, where bit n is channel n.
+ *
+ * These are defined here in the header rather than in a .cpp file so that the compiler can inline
+ * them, as they are called many times per loop.
+ */
+typedef struct Bits {
+  /**
+   * @brief Read the flag for one channel.
+   *
+   * @param flags
+   * @param channel 0-7
+   * @return true
+   * @return false
+   */
+  static bool get(ChannelFlags_t flags, uint8_t channel) {
+    return (flags >> channel) & 1;
+  }
+
+  /**
+   * @brief Write the flag for one channel.
+   *
+   * @param flags
+   * @param channel 0-7
+   * @param value
+   */
+  static void set(ChannelFlags_t *flags, uint8_t channel, bool value) {
+    if (value) {
+      *flags = *flags | (1 << channel);
+    } else {
+      *flags = *flags & ~(1 << channel);
+    }
+  }
+
+  /**
+   * @brief Invert the flag for one channel.
+   *
+   * @param flags
+   * @param channel 0-7
+   */
+  static void toggle(ChannelFlags_t *flags, uint8_t channel) {
+    *flags = *flags ^ (1 << channel);
+  }
+} Bits;
+
+#endif
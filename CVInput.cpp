@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "CVInput.h"
+
+#ifndef CORE_TEENSY
+  #include <hardware/adc.h>
+  #include <hardware/dma.h>
+#endif
+
+#include "State.h"
+#include "Utils.h"
+
+static_assert(
+  (CV_SAMPLE_RING_SIZE & (CV_SAMPLE_RING_SIZE - 1)) == 0,
+  "CV_SAMPLE_RING_SIZE must be a power of two"
+);
+static_assert(
+  CV_OVERSAMPLING < CV_SAMPLE_RING_SIZE,
+  "CV_OVERSAMPLING must leave room in the ring for the sample being written"
+);
+
+#ifdef CORE_TEENSY
+
+void CVInput::begin(State *state) {
+  analogReadAveraging(CV_OVERSAMPLING);
+}
+
+void CVInput::sample(State *state) {
+  state->cvInput.latest = Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
+}
+
+uint16_t CVInput::read(State *state) {
+  return Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
+}
+
+#else
+
+void CVInput::begin(State *state) {
+  CVInput *input = &state->cvInput;
+  input->isFiltering = false;
+  memset(input->samples, 0, sizeof(input->samples));
+
+  adc_gpio_init(CV_INPUT);
+  adc_init();
+  adc_select_input(CV_INPUT - 26); // the ADC inputs are GPIO 26-29
+  adc_fifo_setup(
+    true, // write each conversion to the FIFO
+    true, // request DMA as soon as a sample is in the FIFO
+    1,
+    false,
+    false // keep all 12 bits
+  );
+  adc_set_clkdiv(48000000 / CV_SAMPLE_RATE - 1);
+
+  input->dmaChannel = dma_claim_unused_channel(true);
+  dma_channel_config config = dma_channel_get_default_config(input->dmaChannel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_ring(&config, true, CV_SAMPLE_RING_BITS);
+  channel_config_set_dreq(&config, DREQ_ADC);
+  dma_channel_configure(
+    input->dmaChannel,
+    &config,
+    input->samples,
+    &adc_hw->fifo,
+    CV_DMA_TRANSFER_COUNT,
+    true
+  );
+  adc_run(true);
+}
+
+void CVInput::sample(State *state) {
+  CVInput *input = &state->cvInput;
+  // The channel stops after CV_DMA_TRANSFER_COUNT samples, hours from now. That count is a
+  // multiple of the ring's size, so the ring position continues from the count remaining.
+  if (!dma_channel_is_busy(input->dmaChannel)) {
+    dma_channel_set_trans_count(input->dmaChannel, CV_DMA_TRANSFER_COUNT, true);
+  }
+  uint32_t written = CV_DMA_TRANSFER_COUNT -
+    dma_channel_hw_addr(input->dmaChannel)->transfer_count;
+  if (!input->isFiltering && written <= CV_OVERSAMPLING) {
+    return;
+  }
+
+  // Average the newest complete samples, which stop short of the one being written.
+  uint32_t sum = 0;
+  for (uint8_t i = 1; i <= CV_OVERSAMPLING; i++) {
+    sum += input->samples[(written - i) & (CV_SAMPLE_RING_SIZE - 1)];
+  }
+  uint32_t average = (sum << 4) / CV_OVERSAMPLING;
+
+  if (!input->isFiltering) {
+    input->filtered = average;
+    input->isFiltering = true;
+  }
+  else {
+    int32_t change = static_cast<int32_t>(average) - static_cast<int32_t>(input->filtered);
+    input->filtered += change / (1 << state->config.cvSmoothing);
+  }
+  input->latest = (input->filtered + 8) >> 4;
+}
+
+uint16_t CVInput::read(State *state) {
+  return state->cvInput.latest;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * Recollections: CVInput
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_CV_INPUT_H_
+#define RECOLLECTIONS_CV_INPUT_H_
+
+struct State;
+
+/**
+ * The voltage at the CV input, as recorded into presets.
+ *
+ * On the RP2040, the ADC runs freely at CV_SAMPLE_RATE, and a DMA channel copies each sample from
+ * the ADC's FIFO into a ring buffer, without the CPU. Every OUTPUT_TIMER_PERIOD_MICROS, the second
+ * core averages the newest CV_OVERSAMPLING samples, which reduces the noise of the ADC, and passes
+ * the average through a one pole low-pass filter set by config.cvSmoothing. Reading the input is
+ * then only a matter of taking the latest filtered value, with no wait for a conversion.
+ *
+ * On Teensy, which has one core, the input is read when it is needed, and the ADC averages
+ * CV_OVERSAMPLING conversions for each reading.
+ */
+typedef struct CVInput {
+  /** The latest filtered 12-bit value. Written only by the second core on the RP2040. */
+  volatile uint16_t latest;
+
+  #ifndef CORE_TEENSY
+    /**
+     * Written by DMA, as a ring. The DMA wraps its writes at a boundary of the ring's size, so the
+     * ring is aligned to its size.
+     */
+    uint16_t samples[CV_SAMPLE_RING_SIZE]
+      __attribute__((aligned(CV_SAMPLE_RING_SIZE * sizeof(uint16_t))));
+
+    /** The DMA channel that writes samples. */
+    int dmaChannel;
+
+    /** The filtered value in 1/16ths of a 12-bit step, so that small changes are not lost. */
+    uint32_t filtered;
+
+    /** Whether filtered holds a value yet. */
+    bool isFiltering;
+  #endif
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Start sampling. Called by the second core on the RP2040 and by setup() on Teensy.
+   *
+   * @param state
+   */
+  static void begin(State *state);
+
+  /**
+   * @brief Update the latest value from the newest samples. Called by the second core on the
+   * RP2040 every OUTPUT_TIMER_PERIOD_MICROS.
+   *
+   * @param state
+   */
+  static void sample(State *state);
+
+  /**
+   * @brief The voltage at the CV input as a 12-bit value.
+   *
+   * @param state
+   * @return uint16_t
+   */
+  static uint16_t read(State *state);
+} CVInput;
+
+#endif
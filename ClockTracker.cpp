@@ -0,0 +1,76 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "ClockTracker.h"
+
+#include "State.h"
+
+void ClockTracker::handleGate(State *state, uint32_t gateMicros) {
+  ClockTracker *clock = &state->clock;
+  uint32_t interval = gateMicros - clock->lastGateMicros;
+  bool hadGate = clock->hasGate;
+  clock->hasGate = true;
+  clock->lastGateMicros = gateMicros;
+
+  if (!hadGate) {
+    clock->beatMicros = gateMicros;
+    clock->periodMicros = 0;
+    clock->lockedGates = 0;
+  }
+  else {
+    int32_t error = static_cast<int32_t>(gateMicros - (clock->beatMicros + clock->periodMicros));
+    uint32_t magnitude = error < 0 ? -error : error;
+    if (clock->periodMicros == 0 || magnitude > clock->toleranceMicros) {
+      // Unlocked. Start again from the interval we just measured.
+      clock->beatMicros = gateMicros;
+      clock->periodMicros = interval;
+      clock->lockedGates = 0;
+    }
+    else {
+      clock->beatMicros += clock->periodMicros + error / CLOCK_BEAT_CORRECTION_DIVISOR;
+      clock->periodMicros += error / CLOCK_PERIOD_CORRECTION_DIVISOR;
+      if (clock->lockedGates < UINT8_MAX) {
+        clock->lockedGates++;
+      }
+    }
+    // The float math happens once per gate rather than once per loop.
+    clock->toleranceMicros = clock->periodMicros * state->config.isClockedTolerance;
+  }
+
+  state->isClocked = clock->lockedGates > 0;
+  state->gateMillis = state->isClocked
+    ? clock->periodMicros / 2000
+    : DEFAULT_TRIGGER_LENGTH;
+}
+
+void ClockTracker::update(State *state, uint32_t nowMicros) {
+  ClockTracker *clock = &state->clock;
+  if (!clock->hasGate) {
+    state->isAdvancingPresets = false;
+    state->isClocked = false;
+    return;
+  }
+
+  uint32_t sinceGate = nowMicros - clock->lastGateMicros;
+  state->isAdvancingPresets =
+    sinceGate < static_cast<uint32_t>(state->config.isAdvancingMaxInterval) * 1000;
+
+  // The clock has stopped, or at least skipped a gate, once the next gate is overdue. The corrected
+  // beat can fall a little after the gate itself, so the difference is signed.
+  int32_t sinceBeat = static_cast<int32_t>(nowMicros - clock->beatMicros);
+  if (
+    clock->lockedGates > 0 &&
+    sinceBeat > static_cast<int32_t>(clock->periodMicros + clock->toleranceMicros)
+  ) {
+    clock->lockedGates = 0;
+    state->isClocked = false;
+  }
+}
+
+bool ClockTracker::isWithinGate(State *state, uint32_t nowMicros) {
+  ClockTracker *clock = &state->clock;
+  return
+    clock->hasGate &&
+    nowMicros - clock->lastGateMicros < static_cast<uint32_t>(state->gateMillis) * 1000;
+}
@@ -0,0 +1,75 @@
+/**
+ * Recollections: ClockTracker
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_CLOCK_TRACKER_H_
+#define RECOLLECTIONS_CLOCK_TRACKER_H_
+
+struct State;
+
+/**
+ * Tracks the clock at the ADV input, and from it sets state.isAdvancingPresets, state.isClocked and
+ * state.gateMillis.
+ *
+ * Gates are timed in microseconds, from the time their edge arrived. See GateEvents.h. The tracker
+ * predicts when the next gate is due, one period after the last beat, and corrects both the beat
+ * and the period by a fraction of how early or late each gate is. This is a simple phase-locked
+ * loop: the jitter of single gates is averaged out, a gradual change of tempo is followed, and a
+ * gate outside of config.isClockedTolerance of its prediction, such as a skipped gate or a sudden
+ * change of tempo, unlocks the tracker, which then measures the period afresh.
+ */
+typedef struct ClockTracker {
+  /** micros() at the last gate. Only meaningful once hasGate is true. */
+  uint32_t lastGateMicros;
+
+  /** The time of the last beat as corrected by the loop, from which the next gate is predicted. */
+  uint32_t beatMicros;
+
+  /** The estimated clock period. Zero until two gates have been received. */
+  uint32_t periodMicros;
+
+  /** How far from its prediction a gate may arrive while the tracker stays locked. */
+  uint32_t toleranceMicros;
+
+  /** Whether a gate has been received since power up. */
+  bool hasGate;
+
+  /** The number of consecutive gates that arrived within tolerance of their prediction. */
+  uint8_t lockedGates;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Update the tracker with a gate at the ADV input.
+   *
+   * @param state
+   * @param gateMicros micros() when the gate arrived.
+   */
+  static void handleGate(State *state, uint32_t gateMicros);
+
+  /**
+   * @brief Update isAdvancingPresets, and isClocked when an expected gate has not arrived. Called
+   * once per loop.
+   *
+   * @param state
+   * @param nowMicros
+   */
+  static void update(State *state, uint32_t nowMicros);
+
+  /**
+   * @brief Whether a gate output is within the gate length that follows the last gate at the ADV
+   * input. See state.gateMillis.
+   *
+   * @param state
+   * @param nowMicros
+   * @return true
+   * @return false
+   */
+  static bool isWithinGate(State *state, uint32_t nowMicros);
+} ClockTracker;
+
+#endif
@@ -46,6 +46,13 @@ typedef struct Config {
   Adafruit_MCP4728 dac2;
   Adafruit_NeoTrellis trellis;
 
+  /**
+   * The minimum number of milliseconds between automatic saves of the banks that have changed since
+   * they were last saved. A value of 0 turns automatic saving off, leaving only the explicit save
+   * in the Section Select screen. Default in setup() is 10000.
+   */
+  uint32_t autosaveInterval;
+
   /**
    * Overall brightness level, up to 255. Brightness above 120 may consume too much power. Default
    * in setup() is 100.
@@ -102,14 +109,43 @@ typedef struct Config {
    */
   float isClockedTolerance;
 
+  /**
+   * The strength of the low-pass filter on the CV input, from 0, which is no filter, to
+   * CV_SMOOTHING_MAX. Each step doubles the time the filter takes to follow a change. Only the
+   * RP2040 filters the CV input. See CVInput.h.
+   */
+  uint8_t cvSmoothing;
+
   /**
    * Flag to determine whether we should overwrite voltages when using randomized output set up in
-   * the Edit Channel Selection or Edit Channel Voltages screens. It can be useful to do this
-   * overwrite, as no external gate or trigger is required here to get random values into memory,
-   * which is the case when using randomized input on the Recording screen.
+   * the Edit Channel Selection or Edit Channel Voltages screens. Random output is always played
+   * from the seed of the channel, so it repeats from each reset either way. With this on, the
+   * values are also written into the voltages as they play, and the next save keeps the run. This
+   * commits a run to memory without the external gate or trigger that randomized input on the
+   * Recording screen needs. Off by default.
    */
   bool randomOutputOverwrites;
 
+  /**
+   * Flag to determine whether saving a bank also writes the human-readable Module.txt and
+   * Bank_n.txt JSON files alongside the binary Module.bin file. Writing the JSON is much slower, so
+   * this is off by default.
+   */
+  bool exportBankJson;
+
+  /**
+   * The number of Recollections modules linked on the follower bus into one longer sequencer, up
+   * to LINK_MAX_MODULES: two make a 32-step sequencer, four a 64-step sequencer. 1, the default,
+   * means this module is not linked. See Link.h.
+   */
+  uint8_t linkModuleCount;
+
+  /**
+   * The place of this module in the chain of linked modules. 0 is the leader, which is clocked and
+   * plays the first 16 steps. Follower n plays steps 16n to 16n + 15. Default in setup() is 0.
+   */
+  uint8_t linkPosition;
+
 } Config;
 
 #endif
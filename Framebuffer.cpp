@@ -0,0 +1,46 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Framebuffer.h"
+
+#include "OutputTimer.h"
+#include "State.h"
+#include "constants.h"
+
+void Framebuffer::setPixel(State *state, uint8_t displayKey, RGBColorArray_t rgbColor) {
+  Framebuffer *framebuffer = &state->framebuffer;
+  uint8_t *pixel = framebuffer->pixels[displayKey];
+  if (
+    (framebuffer->knownPixels & (1 << displayKey)) &&
+    pixel[0] == rgbColor[0] &&
+    pixel[1] == rgbColor[1] &&
+    pixel[2] == rgbColor[2]
+  ) {
+    return;
+  }
+  OutputTimer::claimBus(state);
+  state->config.trellis.pixels.setPixelColor(displayKey, rgbColor[0], rgbColor[1], rgbColor[2]);
+  OutputTimer::releaseBus(state);
+  pixel[0] = rgbColor[0];
+  pixel[1] = rgbColor[1];
+  pixel[2] = rgbColor[2];
+  framebuffer->knownPixels |= 1 << displayKey;
+  framebuffer->isDirty = true;
+}
+
+void Framebuffer::show(State *state) {
+  Framebuffer *framebuffer = &state->framebuffer;
+  if (!framebuffer->isDirty) {
+    return;
+  }
+  unsigned long now = millis();
+  if (now - framebuffer->lastShowTime < MIN_FRAME_INTERVAL) {
+    return;
+  }
+  OutputTimer::claimBus(state);
+  state->config.trellis.pixels.show();
+  OutputTimer::releaseBus(state);
+  framebuffer->isDirty = false;
+  framebuffer->lastShowTime = now;
+}
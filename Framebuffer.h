@@ -0,0 +1,55 @@
+/**
+ * Recollections: Framebuffer
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_FRAMEBUFFER_H_
+#define RECOLLECTIONS_FRAMEBUFFER_H_
+
+struct State;
+
+/**
+ * The colors last sent to the 16 NeoTrellis pixels. The NeoTrellis shares the local I2C bus with
+ * the DACs, and both setting a pixel color and showing the pixels are I2C transactions. The screens
+ * are rendered in full on every loop, so the framebuffer filters out pixels whose color has not
+ * changed, and only shows the pixels when at least one has changed, at most once per
+ * MIN_FRAME_INTERVAL ms.
+ */
+typedef struct Framebuffer {
+  /** The color last sent to each pixel. Indices are [displayKey], not [key]. */
+  RGBColorArray_t pixels[16];
+
+  /** One bit per display key, set once the pixel has been sent a color. */
+  uint16_t knownPixels;
+
+  /** Whether pixels have been sent colors that are not yet shown. */
+  bool isDirty;
+
+  /** The time in ms at which the pixels were last shown. */
+  unsigned long lastShowTime;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Send a color to a pixel, unless the pixel already has that color. Only
+   * Hardware::prepareRenderingOfKey() should call this, as it handles the orientation of the keys.
+   *
+   * @param state
+   * @param displayKey
+   * @param rgbColor
+   */
+  static void setPixel(State *state, uint8_t displayKey, RGBColorArray_t rgbColor);
+
+  /**
+   * @brief Show the pixels if any have changed since they were last shown, and at least
+   * MIN_FRAME_INTERVAL ms have passed. Changes held back are shown on a later call.
+   *
+   * @param state
+   */
+  static void show(State *state);
+} Framebuffer;
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "GateEvents.h"
+
+#include "State.h"
+
+bool GateEvents::capture(State *state, GateInput_t input, uint32_t edgeMicros) {
+  GateEvents *gateEvents = &state->gateEvents;
+  bool isHigh = GateEvents::isHigh(input);
+  uint8_t head = gateEvents->head;
+  if ((uint8_t)(head - gateEvents->tail) >= GATE_EVENT_BUFFER_SIZE) {
+    gateEvents->hasOverflowed = true;
+    return isHigh;
+  }
+  volatile GateEvent *event = &gateEvents->events[head & (GATE_EVENT_BUFFER_SIZE - 1)];
+  event->micros = edgeMicros;
+  event->input = input;
+  event->isHigh = isHigh;
+  // Publish the event only once it is complete.
+  gateEvents->head = head + 1;
+  return isHigh;
+}
+
+bool GateEvents::pop(State *state, GateEvent *event) {
+  GateEvents *gateEvents = &state->gateEvents;
+  uint8_t tail = gateEvents->tail;
+  if (tail == gateEvents->head) {
+    return false;
+  }
+  volatile GateEvent *next = &gateEvents->events[tail & (GATE_EVENT_BUFFER_SIZE - 1)];
+  event->micros = next->micros;
+  event->input = next->input;
+  event->isHigh = next->isHigh;
+  // Release the slot only once it has been read.
+  gateEvents->tail = tail + 1;
+  return true;
+}
+
+bool GateEvents::isHigh(GateInput_t input) {
+  uint8_t level = digitalRead(GateEvents::pin(input));
+  // The input circuits of ADV and REC invert the gate.
+  return input == GATE_INPUT.ADV || input == GATE_INPUT.REC ? !level : level;
+}
+
+uint8_t GateEvents::pin(GateInput_t input) {
+  switch (input) {
+    case GATE_INPUT.RESET:
+      return RESET_INPUT;
+    case GATE_INPUT.BANK_REV:
+      return BANK_REV_INPUT;
+    case GATE_INPUT.BANK_ADV:
+      return BANK_ADV_INPUT;
+    case GATE_INPUT.REV:
+      return REV_INPUT;
+    case GATE_INPUT.ADV:
+      return ADV_INPUT;
+    default:
+      return REC_INPUT;
+  }
+}
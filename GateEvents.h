@@ -0,0 +1,101 @@
+/**
+ * Recollections: GateEvents
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_GATE_EVENTS_H_
+#define RECOLLECTIONS_GATE_EVENTS_H_
+
+struct State;
+
+/**
+ * One edge at a gate input, as seen by its interrupt handler.
+ */
+typedef struct GateEvent {
+  /** micros() when the edge arrived. */
+  uint32_t micros;
+
+  /** See GATE_INPUT in constants.h. */
+  GateInput_t input;
+
+  /** Whether the gate went high, as seen at the jack. The inversion of ADV and REC is undone. */
+  bool isHigh;
+} GateEvent;
+
+/**
+ * Edges at the gate inputs, captured with their time by interrupt handlers and handled by
+ * Input::handleInput() on the next loop. Polling the inputs once per loop made the timing of a
+ * clock as coarse as the loop, and a loop that runs long, such as one that writes to the SD card,
+ * could miss a short trigger entirely.
+ *
+ * This is a single producer, single consumer ring buffer: only the interrupt handlers write head
+ * and only the loop writes tail, so neither needs to disable interrupts. On the RP2040, the
+ * handlers run on the second core, which the buffer also serves, as the RP2040 has no data cache
+ * and its cores see each other's writes in order. The indices run freely
+ * and are masked when used, which requires GATE_EVENT_BUFFER_SIZE to be a power of two.
+ */
+typedef struct GateEvents {
+  volatile GateEvent events[GATE_EVENT_BUFFER_SIZE];
+
+  /** The count of events pushed. Written only by interrupt handlers. */
+  volatile uint8_t head;
+
+  /** The count of events popped. Written only by the loop. */
+  volatile uint8_t tail;
+
+  /** Whether an event was dropped because the buffer was full. Cleared by the loop. */
+  volatile bool hasOverflowed;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Read an input and push its level, with the time, as an event. Called by the interrupt
+   * handlers in Recollections.ino on every change at the input. If the buffer is full, the event
+   * is dropped and hasOverflowed is set.
+   *
+   * @param state
+   * @param input
+   * @param edgeMicros micros() when the edge arrived.
+   * @return true if the input is now high.
+   * @return false
+   */
+  static bool capture(State *state, GateInput_t input, uint32_t edgeMicros);
+
+  /**
+   * @brief Take the oldest event from the buffer.
+   *
+   * @param state
+   * @param event Receives the event.
+   * @return true
+   * @return false if the buffer is empty.
+   */
+  static bool pop(State *state, GateEvent *event);
+
+  /**
+   * @brief Read the level of a gate input, as seen at the jack.
+   *
+   * @param input
+   * @return true
+   * @return false
+   */
+  static bool isHigh(GateInput_t input);
+
+  /**
+   * @brief The pin of a gate input.
+   *
+   * @param input
+   * @return uint8_t
+   */
+  static uint8_t pin(GateInput_t input);
+} GateEvents;
+
+static_assert(
+  (GATE_EVENT_BUFFER_SIZE & (GATE_EVENT_BUFFER_SIZE - 1)) == 0 && GATE_EVENT_BUFFER_SIZE <= 128,
+  "GATE_EVENT_BUFFER_SIZE must be a power of two, no larger than 128"
+);
+
+#endif
@@ -5,153 +5,220 @@
 #include "Input.h"
 
 #include "Advance.h"
+#include "CVInput.h"
+#include "ClockTracker.h"
+#include "GateEvents.h"
+#include "Link.h"
+#include "Log.h"
 #include "Nav.h"
+#include "Playheads.h"
+#include "Journal.h"
+#include "Random.h"
+#include "SDCard.h"
 #include "Utils.h"
 #include "constants.h"
 
 /**
  * @brief Entry point to handling the MOD button and all inputs.
  *
+ * The gate inputs are not read here. Their edges were captured by interrupts as they arrived, and
+ * are handled here with the time they arrived, so that a loop that runs long neither delays a
+ * clock nor misses a short trigger. Within one loop, the edges are handled input by input, in the
+ * order of GATE_INPUT, so that simultaneous gates at RESET and ADV, for example, always have the
+ * same result. The edges of any one input are handled in the order they arrived.
+ *
  * @param loopStartTime
  * @param state
- * @return State
  */
-State Input::handleInput(unsigned long loopStartTime, State state) {
-  // I would prefer to do this with function composition, but it does not seem to be working.
-  // The ordering of these functions is important.
-  state = Input::handleModButton(loopStartTime, state);
-  state = Input::handleResetInput(state);
-  state = Input::handleBankReverseInput(state);
-  state = Input::handleBankAdvanceInput(state);
-  state = Input::handleReverseInput(state);
-  state = Input::handleAdvInput(loopStartTime, state);
-  state = Input::handleRecInput(state);
-  return state;
+void Input::handleInput(unsigned long loopStartTime, State *state) {
+  Input::handleModButton(loopStartTime, state);
+
+  GateEvent events[GATE_EVENT_BUFFER_SIZE];
+  uint8_t eventCount = 0;
+  while (eventCount < GATE_EVENT_BUFFER_SIZE && GateEvents::pop(state, &events[eventCount])) {
+    eventCount++;
+  }
+  if (state->gateEvents.hasOverflowed) {
+    state->gateEvents.hasOverflowed = false;
+    Input::resynchronizeGates(state);
+  }
+
+  // Every event popped above arrived before this reading.
+  uint32_t nowMicros = micros();
+
+  for (GateInput_t input = 0; input < GATE_INPUT_COUNT; input++) {
+    if (input == GATE_INPUT.ADV) {
+      ClockTracker::update(state, nowMicros);
+    }
+    for (uint8_t i = 0; i < eventCount; i++) {
+      if (events[i].input == input) {
+        Input::handleGateEdge(&events[i], state);
+      }
+    }
+  }
+
+  Link::update(state);
+
+  RemoteCommand command;
+  while (Remote::pop(state, &command)) {
+    Input::handleRemoteCommand(&command, state);
+  }
+
+  // A module selected with a key, now that the keys have been read and the bus released.
+  if (state->requestedModule >= 0) {
+    uint8_t module = state->requestedModule;
+    state->requestedModule = -1;
+    if (!SDCard::switchModule(state, module)) {
+      Nav::goForward(state, SCREEN.ERROR);
+    }
+  }
 }
 
 // Private
 
 /**
- * @brief Handle gates on the ADV input, or the lack thereof. Updates isAdvancingPresets and
- * isClocked on every loop.
+ * @brief Handle one edge at a gate input. A rising edge acts only if the input has fallen since the
+ * last rising edge it acted on, which filters out repeated edges from a noisy gate.
  *
- * @param loopStartTime
+ * @param event
  * @param state
- * @return State
  */
-State Input::handleAdvInput(unsigned long loopStartTime, State state) {
-  // Note that the following block, which updates isAdvancingPresets and isClocked, is executed on
-  // every loop, not just when the ADV input is high or low.
-  uint16_t lastInterval = loopStartTime - state.lastAdvReceivedTime[0];
-  state.isAdvancingPresets = lastInterval < state.config.isAdvancingMaxInterval;
-  uint16_t avgInterval =
-    ((state.lastAdvReceivedTime[0] - state.lastAdvReceivedTime[1]) +
-    (state.lastAdvReceivedTime[1] - state.lastAdvReceivedTime[2])) * 0.5;
-  uint16_t toleranceMillis = avgInterval * state.config.isClockedTolerance;
-  signed long signedLastInterval = lastInterval;
-  state.isClocked =
-    !(signedLastInterval > (avgInterval + toleranceMillis) ||
-      signedLastInterval < (avgInterval - toleranceMillis));
-
-  if (state.readyForAdvInput && !digitalRead(ADV_INPUT)) {
-    state.readyForAdvInput = false;
-
-    if ( // protect against overflow
-      !(loopStartTime >= state.lastAdvReceivedTime[0] &&
-      state.lastAdvReceivedTime[0] >= state.lastAdvReceivedTime[1] &&
-      state.lastAdvReceivedTime[1] >= state.lastAdvReceivedTime[2])
-    ) {
-      if (loopStartTime < 3) {
-        loopStartTime = 3;
-      }
-      state.lastAdvReceivedTime[0] = loopStartTime - 1;
-      state.lastAdvReceivedTime[1] = loopStartTime - 2;
-      state.lastAdvReceivedTime[2] = loopStartTime - 3;
-    }
-
-    if (state.config.randomOutputOverwrites) {
-      // Set random output voltages of next preset before advancing. Make sure to prevent infinite
-      // recursion in the case where all presets have been removed.
-      bool allowRecursion = !Advance::allPresetsRemoved(state.removedPresets);
-      uint8_t nextPreset = Advance::nextPreset(
-        state.currentPreset,
-        state.advancePresetAddend,
-        state.removedPresets,
-        allowRecursion
-      );
-      state = State::setRandomVoltagesForPreset(nextPreset, state);
-    }
-
-    Advance::advancePreset(&loopStartTime, &state);
-    state = Advance::updateStateAfterAdvancing(loopStartTime, state);
+void Input::handleGateEdge(GateEvent *event, State *state) {
+  bool *isReady = Input::readiness(event->input, state);
+  if (!event->isHigh) {
+    *isReady = true;
+    return;
+  }
+  if (!*isReady) {
+    return;
   }
-  else if (!state.readyForAdvInput && digitalRead(ADV_INPUT)) {
-    state.readyForAdvInput = true;
+  *isReady = false;
+
+  switch (event->input) {
+    case GATE_INPUT.RESET:
+      Input::handleResetInput(state);
+      break;
+    case GATE_INPUT.BANK_REV:
+      Input::handleBankReverseInput(state);
+      break;
+    case GATE_INPUT.BANK_ADV:
+      Input::handleBankAdvanceInput(state);
+      break;
+    case GATE_INPUT.REV:
+      Input::handleReverseInput(state);
+      break;
+    case GATE_INPUT.ADV:
+      Input::handleAdvInput(event->micros, state);
+      break;
+    case GATE_INPUT.REC:
+      Input::handleRecInput(state);
+      break;
   }
+}
 
-  return state;
+/**
+ * @brief The flag that tracks whether a gate input is ready to respond to a rising edge.
+ *
+ * @param input
+ * @param state
+ * @return bool*
+ */
+bool *Input::readiness(GateInput_t input, State *state) {
+  switch (input) {
+    case GATE_INPUT.RESET:
+      return &state->readyForResetInput;
+    case GATE_INPUT.BANK_REV:
+      return &state->readyForBankReverseInput;
+    case GATE_INPUT.BANK_ADV:
+      return &state->readyForBankAdvanceInput;
+    case GATE_INPUT.REV:
+      return &state->readyForReverseInput;
+    case GATE_INPUT.ADV:
+      return &state->readyForAdvInput;
+    default:
+      return &state->readyForRecInput;
+  }
 }
 
-State Input::handleBankAdvanceInput(State state) {
-  if (state.readyForBankAdvanceInput && digitalRead(BANK_ADV_INPUT)) {
-    Serial.println("BANK ADV input");
-    state.readyForBankAdvanceInput = false;
-    if (-15 > state.advanceBankAddend || state.advanceBankAddend > 15) {
-      Serial.println("advanceBankAddend out of range, resetting it to 1");
-      state.advanceBankAddend = 1;
+/**
+ * @brief After edges were dropped because too many arrived within one loop, make every gate input
+ * that is now low ready for its next rising edge, so that none waits for a falling edge that was
+ * lost.
+ *
+ * @param state
+ */
+void Input::resynchronizeGates(State *state) {
+  LOG_WARN("Gate edges were dropped");
+  for (GateInput_t input = 0; input < GATE_INPUT_COUNT; input++) {
+    if (!GateEvents::isHigh(input)) {
+      *Input::readiness(input, state) = true;
     }
-    int8_t advancedBank = state.currentBank + state.advanceBankAddend;
-    state.currentBank =
-      advancedBank > 15
-        ? advancedBank - 16
-        : advancedBank < 0
-          ? advancedBank + 16
-          : advancedBank;
-  }
-  else if (!state.readyForBankAdvanceInput && !digitalRead(BANK_ADV_INPUT)) {
-    state.readyForBankAdvanceInput = true;
-  }
-  return state;
+  }
 }
 
-State Input::handleBankReverseInput(State state) {
-  if (state.readyForBankReverseInput && digitalRead(BANK_REV_INPUT)) {
-    Serial.println("BANK REV input");
-    state.readyForBankReverseInput = false;
-    state.advanceBankAddend = state.advanceBankAddend * -1;
+/**
+ * @brief Advance the preset in response to a gate at the ADV input.
+ *
+ * @param gateMicros micros() when the gate arrived.
+ * @param state
+ */
+void Input::handleAdvInput(uint32_t gateMicros, State *state) {
+  if (Link::isLinked(state)) {
+    // The leader steps through the pages of every linked module, and the followers step with it.
+    Link::advance(state, gateMicros);
+    return;
   }
-  else if (!state.readyForBankReverseInput && !digitalRead(BANK_REV_INPUT)) {
-    state.readyForBankReverseInput = true;
+  Advance::advanceTo(state, Advance::nextPreset(state, state->currentPreset), gateMicros);
+}
+
+void Input::handleBankAdvanceInput(State *state) {
+  LOG_DEBUG("BANK ADV input");
+  if (-15 > state->advanceBankAddend || state->advanceBankAddend > 15) {
+    LOG_WARN("advanceBankAddend out of range, resetting it to 1");
+    state->advanceBankAddend = 1;
   }
-  return state;
+  int8_t advancedBank = state->currentBank + state->advanceBankAddend;
+  State::selectBank(
+    state,
+    advancedBank > 15
+      ? advancedBank - 16
+      : advancedBank < 0
+        ? advancedBank + 16
+        : advancedBank
+  );
+}
+
+void Input::handleBankReverseInput(State *state) {
+  LOG_DEBUG("BANK REV input");
+  state->advanceBankAddend = state->advanceBankAddend * -1;
 }
 
-State Input::handleModButton(unsigned long loopStartTime, State state) {
+void Input::handleModButton(unsigned long loopStartTime, State *state) {
   // long press handling
   if (
-    !state.readyForModPress &&
-    state.initialModHoldKey < 0 &&
-    loopStartTime - state.lastModPressTime > LONG_PRESS_TIME
+    !state->readyForModPress &&
+    state->initialModHoldKey < 0 &&
+    loopStartTime - state->lastModPressTime > LONG_PRESS_TIME
   ) {
-    state.initialModHoldKey = 69; // faking this to prevent immediate navigation back
-    if (state.screen == SCREEN.PRESET_SELECT) {
-      state = Nav::goForward(state, SCREEN.PRESET_CHANNEL_SELECT);
+    state->initialModHoldKey = 69; // faking this to prevent immediate navigation back
+    if (state->screen == SCREEN.PRESET_SELECT) {
+      Nav::goForward(state, SCREEN.PRESET_CHANNEL_SELECT);
     } else if (
-      state.screen == SCREEN.EDIT_CHANNEL_VOLTAGES ||
-      state.screen == SCREEN.GLOBAL_EDIT
+      state->screen == SCREEN.EDIT_CHANNEL_VOLTAGES ||
+      state->screen == SCREEN.GLOBAL_EDIT
     ) {
-      state.readyForPresetSelection = true;
+      state->readyForPresetSelection = true;
     }
-    return state;
+    return;
   }
 
   // When MOD_INPUT is low, the button is being pressed.
   // We have a debounce scheme here with the readyForModPress flag. Once the button is pressed, we
   // say we are not readyForModPress until the button is released and the debounce time has elapsed.
-  if (state.readyForModPress && !digitalRead(MOD_INPUT)) {
-    state.readyForModPress = false;
-    state.lastModPressTime = loopStartTime;
-    return state;
+  if (state->readyForModPress && !digitalRead(MOD_INPUT)) {
+    state->readyForModPress = false;
+    state->lastModPressTime = loopStartTime;
+    return;
   }
 
   // When MOD_INPUT is high, the button is no longer being pressed.
@@ -161,87 +228,119 @@ State Input::handleModButton(unsigned long loopStartTime, State state) {
   // treated as if the debounce time has elapsed. In theory, this would only happen if the program
   // was running for over 50 days.
   if (
-    !state.readyForModPress && digitalRead(MOD_INPUT) &&
+    !state->readyForModPress && digitalRead(MOD_INPUT) &&
     (
-      (loopStartTime - state.lastModPressTime > MOD_DEBOUNCE_TIME) ||
-      loopStartTime < state.lastModPressTime
+      (loopStartTime - state->lastModPressTime > MOD_DEBOUNCE_TIME) ||
+      loopStartTime < state->lastModPressTime
     )
   ) {
-    if (state.initialModHoldKey >= 0) {
-      state.initialModHoldKey = -1;
-      state.keyPressesSinceModHold = 0;
-      if (state.selectedKeyForCopying >= 0) {
-        state = State::paste(state);
+    if (state->initialModHoldKey >= 0) {
+      state->initialModHoldKey = -1;
+      state->keyPressesSinceModHold = 0;
+      if (state->selectedKeyForCopying >= 0) {
+        State::paste(state);
       }
     }
-    else if (state.screen == SCREEN.SECTION_SELECT && state.readyToSave) {
-      state.readyToSave = false;
+    else if (state->screen == SCREEN.SECTION_SELECT && state->readyToSave) {
+      state->readyToSave = false;
     }
-    else if (state.screen == SCREEN.PRESET_SELECT) {
-      state = Nav::goForward(state, SCREEN.SECTION_SELECT);
+    else if (state->screen == SCREEN.PRESET_SELECT) {
+      Nav::goForward(state, SCREEN.SECTION_SELECT);
     }
-    else if (state.readyForPresetSelection) {
-      state.readyForPresetSelection = false;
+    else if (state->readyForPresetSelection) {
+      state->readyForPresetSelection = false;
     }
     else {
-      state = Nav::goBack(state);
+      Nav::goBack(state);
     }
-    state.readyForModPress = true;
+    state->readyForModPress = true;
   }
-  return state;
 }
 
-State Input::handleRecInput(State state) {
-  if (state.readyForRecInput && !digitalRead(REC_INPUT)) {
-    state.readyForRecInput = false;
-
-    // We perform the initial sample of voltage in response to the REC input, but other recording
-    // may happen while readyForRecInput is false, depending on the context. See autoRecord and
-    // recordContinuously.
-    uint8_t currentBank = state.currentBank;
-    uint8_t currentPreset = state.currentPreset;
-    for (uint8_t i = 0; i < 8; i++) {
-      if (state.autoRecordChannels[currentBank][i]) {
-        if (state.randomInputChannels[currentBank][i]) {
-          state.voltages[currentBank][currentPreset][i] = Utils::random(MAX_UNSIGNED_12_BIT);
-        }
-        else {
-          #ifdef CORE_TEENSY
-            uint16_t reading = analogRead(CV_INPUT);
-            state.voltages[currentBank][currentPreset][i] = Utils::tenBitToTwelveBit(reading);
-          #else
-            state.voltages[currentBank][currentPreset][i] = analogRead(CV_INPUT);
-          #endif
-        }
+void Input::handleRecInput(State *state) {
+  // We perform the initial sample of voltage in response to the REC input, but other recording
+  // may happen while readyForRecInput is false, depending on the context. See autoRecord and
+  // recordContinuously.
+  uint8_t currentBank = state->currentBank;
+  uint16_t randomValues[8];
+  if ((state->autoRecordChannels[currentBank] & state->randomInputChannels[currentBank]) != 0) {
+    Random::voltages(state, randomValues);
+  }
+  for (uint8_t i = 0; i < 8; i++) {
+    if (Bits::get(state->autoRecordChannels[currentBank], i)) {
+      uint8_t currentPreset = Playheads::step(state, i);
+      if (Bits::get(state->randomInputChannels[currentBank], i)) {
+        state->voltages[currentBank][currentPreset][i] = randomValues[i];
+      }
+      else {
+        state->voltages[currentBank][currentPreset][i] = CVInput::read(state);
       }
+      Journal::voltage(state, currentBank, currentPreset, i);
     }
   }
-  else if (!state.readyForRecInput && digitalRead(REC_INPUT)) {
-    state.readyForRecInput = true;
-  }
-  return state;
 }
 
-State Input::handleResetInput(State state) {
-  if (state.readyForResetInput && digitalRead(RESET_INPUT)) {
-    Serial.println("RESET input");
-    state.readyForResetInput = false;
-    state.currentPreset = 0;
-  }
-  else if (!state.readyForResetInput && !digitalRead(RESET_INPUT)) {
-    state.readyForResetInput = true;
+/**
+ * @brief Carry out one command from a controller on the follower bus. See Remote.h. A command
+ * with a channel or value out of range is ignored.
+ *
+ * @param command
+ * @param state
+ */
+void Input::handleRemoteCommand(RemoteCommand *command, State *state) {
+  uint8_t currentBank = state->currentBank;
+  switch (command->type) {
+    case REMOTE_COMMAND.SET_VOLTAGE: {
+      uint8_t channel = command->channel;
+      if (channel > 7 || command->value > MAX_UNSIGNED_12_BIT) {
+        return;
+      }
+      // As recording does, at the channel's step, if it has a sequence of its own.
+      uint8_t preset = Playheads::step(state, channel);
+      if (!Bits::get(state->lockedVoltages[currentBank][preset], channel)) {
+        state->voltages[currentBank][preset][channel] = command->value;
+        Journal::voltage(state, currentBank, preset, channel);
+      }
+      break;
+    }
+    case REMOTE_COMMAND.SELECT_PRESET:
+      if (command->value < 16) {
+        state->currentPreset = command->value;
+        Playheads::moveTo(state, command->value);
+      }
+      break;
+    case REMOTE_COMMAND.SELECT_BANK:
+      if (command->value < 16) {
+        State::selectBank(state, command->value);
+      }
+      break;
+    case REMOTE_COMMAND.SELECT_MODULE:
+      if (command->value < 16 && command->value != state->config.currentModule) {
+        if (!SDCard::switchModule(state, command->value)) {
+          Nav::goForward(state, SCREEN.ERROR);
+        }
+      }
+      break;
+    case REMOTE_COMMAND.RECORD:
+      Input::handleRecInput(state);
+      break;
   }
-  return state;
 }
 
-State Input::handleReverseInput(State state) {
-  if (state.readyForReverseInput && digitalRead(REV_INPUT)) {
-    Serial.println("REV input");
-    state.readyForReverseInput = false;
-    state.advancePresetAddend = state.advancePresetAddend * -1;
-  }
-  else if (!state.readyForReverseInput && !digitalRead(REV_INPUT)) {
-    state.readyForReverseInput = true;
+void Input::handleResetInput(State *state) {
+  LOG_DEBUG("RESET input");
+  if (Link::isFollower(state)) {
+    // The leader resets every linked module.
+    return;
   }
-  return state;
+  state->currentPreset = 0;
+  // Channels with sequences of their own, and random channels and presets, start over too.
+  Playheads::moveTo(state, 0);
+  state->randomStep = 0;
+  Link::reset(state);
+}
+
+void Input::handleReverseInput(State *state) {
+  LOG_DEBUG("REV input");
+  state->advancePresetAddend = state->advancePresetAddend * -1;
 }
\ No newline at end of file
@@ -4,22 +4,28 @@
  * Copyright 2022 William Edward Fisher.
  */
 
+#include "GateEvents.h"
+#include "Remote.h"
 #include "State.h"
 
 #ifndef RECOLLECTIONS_INPUT_H_
 #define RECOLLECTIONS_INPUT_H_
 
 typedef struct Input {
-  static State handleInput(unsigned long loopStartTime, State state);
+  static void handleInput(unsigned long loopStartTime, State *state);
 
   private:
-  static State handleAdvInput(unsigned long loopStartTime, State state);
-  static State handleBankAdvanceInput(State state);
-  static State handleBankReverseInput(State state);
-  static State handleModButton(unsigned long loopStartTime, State state);
-  static State handleRecInput(State state);
-  static State handleResetInput(State state);
-  static State handleReverseInput(State state);
+  static void handleAdvInput(uint32_t gateMicros, State *state);
+  static void handleBankAdvanceInput(State *state);
+  static void handleBankReverseInput(State *state);
+  static void handleGateEdge(GateEvent *event, State *state);
+  static void handleModButton(unsigned long loopStartTime, State *state);
+  static void handleRecInput(State *state);
+  static void handleRemoteCommand(RemoteCommand *command, State *state);
+  static void handleResetInput(State *state);
+  static void handleReverseInput(State *state);
+  static bool *readiness(GateInput_t input, State *state);
+  static void resynchronizeGates(State *state);
 } Input;
 
-#endif
\ No newline at end of file
+#endif
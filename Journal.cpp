@@ -0,0 +1,231 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Journal.h"
+
+#include <stddef.h>
+
+#include "Advance.h"
+#include "Playheads.h"
+#include "ResolvedPresets.h"
+#include "SDCard.h"
+#include "State.h"
+#include "Utils.h"
+
+void Journal::voltage(State *state, uint8_t bank, uint8_t preset, uint8_t channel) {
+  Journal::append(
+    state,
+    JOURNAL_FIELD.VOLTAGE,
+    bank,
+    preset,
+    channel,
+    state->voltages[bank][preset][channel]
+  );
+}
+
+void Journal::presetFlags(State *state, uint8_t bank, uint8_t preset) {
+  Journal::append(
+    state, JOURNAL_FIELD.ACTIVE_VOLTAGES, bank, preset, 0, state->activeVoltages[bank][preset]
+  );
+  Journal::append(
+    state, JOURNAL_FIELD.GATE_VOLTAGES, bank, preset, 0, state->gateVoltages[bank][preset]
+  );
+  Journal::append(
+    state, JOURNAL_FIELD.LOCKED_VOLTAGES, bank, preset, 0, state->lockedVoltages[bank][preset]
+  );
+  Journal::append(
+    state, JOURNAL_FIELD.RANDOM_VOLTAGES, bank, preset, 0, state->randomVoltages[bank][preset]
+  );
+}
+
+void Journal::channelFlags(State *state, uint8_t bank) {
+  Journal::append(
+    state, JOURNAL_FIELD.AUTO_RECORD_CHANNELS, bank, 0, 0, state->autoRecordChannels[bank]
+  );
+  Journal::append(state, JOURNAL_FIELD.GATE_CHANNELS, bank, 0, 0, state->gateChannels[bank]);
+  Journal::append(
+    state, JOURNAL_FIELD.RANDOM_INPUT_CHANNELS, bank, 0, 0, state->randomInputChannels[bank]
+  );
+  Journal::append(
+    state, JOURNAL_FIELD.RANDOM_OUTPUT_CHANNELS, bank, 0, 0, state->randomOutputChannels[bank]
+  );
+}
+
+void Journal::randomSeed(State *state, uint8_t bank, uint8_t channel) {
+  Journal::append(
+    state, JOURNAL_FIELD.RANDOM_SEED, bank, 0, channel, state->randomSeeds[bank][channel]
+  );
+}
+
+void Journal::removedPreset(State *state, uint8_t preset) {
+  Journal::append(
+    state, JOURNAL_FIELD.REMOVED_PRESET, 0, preset, 0, state->removedPresets[preset] ? 1 : 0
+  );
+}
+
+void Journal::sequence(State *state, uint8_t bank, uint8_t channel) {
+  Journal::append(
+    state, JOURNAL_FIELD.CHANNEL_LENGTH, bank, 0, channel, state->channelLengths[bank][channel]
+  );
+  Journal::append(
+    state,
+    JOURNAL_FIELD.CHANNEL_ADDEND,
+    bank,
+    0,
+    channel,
+    static_cast<uint8_t>(state->channelAddends[bank][channel])
+  );
+  Journal::append(
+    state, JOURNAL_FIELD.REMOVED_STEPS, bank, 0, channel, state->removedSteps[bank][channel]
+  );
+}
+
+void Journal::bank(State *state, uint8_t bank) {
+  Journal::channelFlags(state, bank);
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    Journal::presetFlags(state, bank, preset);
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      Journal::voltage(state, bank, preset, channel);
+    }
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    Journal::randomSeed(state, bank, channel);
+    Journal::sequence(state, bank, channel);
+  }
+}
+
+bool Journal::apply(JournalEntry *entry, State *state) {
+  if (
+    entry->check != Journal::checksum(entry) ||
+    entry->bank > 15 ||
+    entry->preset > 15 ||
+    entry->channel > 7
+  ) {
+    return false;
+  }
+
+  uint8_t const bank = entry->bank;
+  uint8_t const preset = entry->preset;
+  switch (entry->field) {
+    case JOURNAL_FIELD.VOLTAGE:
+      // Guard against out of range values, as these go straight to the DACs.
+      state->voltages[bank][preset][entry->channel] = entry->value > MAX_UNSIGNED_12_BIT
+        ? MAX_UNSIGNED_12_BIT
+        : entry->value;
+      break;
+    case JOURNAL_FIELD.ACTIVE_VOLTAGES:
+      state->activeVoltages[bank][preset] = entry->value;
+      ResolvedPresets::markStale(state, bank);
+      break;
+    case JOURNAL_FIELD.GATE_VOLTAGES:
+      state->gateVoltages[bank][preset] = entry->value;
+      break;
+    case JOURNAL_FIELD.LOCKED_VOLTAGES:
+      state->lockedVoltages[bank][preset] = entry->value;
+      break;
+    case JOURNAL_FIELD.RANDOM_VOLTAGES:
+      state->randomVoltages[bank][preset] = entry->value;
+      break;
+    case JOURNAL_FIELD.AUTO_RECORD_CHANNELS:
+      state->autoRecordChannels[bank] = entry->value;
+      break;
+    case JOURNAL_FIELD.GATE_CHANNELS:
+      state->gateChannels[bank] = entry->value;
+      break;
+    case JOURNAL_FIELD.RANDOM_INPUT_CHANNELS:
+      state->randomInputChannels[bank] = entry->value;
+      break;
+    case JOURNAL_FIELD.RANDOM_OUTPUT_CHANNELS:
+      state->randomOutputChannels[bank] = entry->value;
+      break;
+    case JOURNAL_FIELD.RANDOM_SEED:
+      state->randomSeeds[bank][entry->channel] = entry->value;
+      break;
+    case JOURNAL_FIELD.REMOVED_PRESET:
+      state->removedPresets[preset] = entry->value != 0;
+      State::markModuleDirty(state);
+      Advance::markStale(state);
+      return true;
+    case JOURNAL_FIELD.CHANNEL_LENGTH:
+      if (entry->value > 16) {
+        return false;
+      }
+      state->channelLengths[bank][entry->channel] = entry->value;
+      Playheads::markStale(state);
+      break;
+    case JOURNAL_FIELD.CHANNEL_ADDEND:
+      state->channelAddends[bank][entry->channel] = static_cast<int8_t>(entry->value & 0xFF);
+      Playheads::markStale(state);
+      break;
+    case JOURNAL_FIELD.REMOVED_STEPS:
+      state->removedSteps[bank][entry->channel] = entry->value;
+      Playheads::markStale(state);
+      break;
+    default:
+      return false;
+  }
+  State::markBankDirty(state, bank);
+  return true;
+}
+
+void Journal::seal(JournalEntry *entry) {
+  entry->check = Journal::checksum(entry);
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+void Journal::append(
+  State *state,
+  JournalField_t field,
+  uint8_t bank,
+  uint8_t preset,
+  uint8_t channel,
+  uint16_t value
+) {
+  if (field == JOURNAL_FIELD.REMOVED_PRESET) {
+    State::markModuleDirty(state);
+    Advance::markStale(state);
+  } else {
+    State::markBankDirty(state, bank);
+  }
+  if (field == JOURNAL_FIELD.ACTIVE_VOLTAGES) {
+    ResolvedPresets::markStale(state, bank);
+  }
+
+  Journal *journal = &state->journal;
+
+  // Look for a pending entry to update in place. Every entry is an absolute value, so only the
+  // latest value of each field matters.
+  for (int8_t i = journal->pendingCount - 1; i >= 0; i--) {
+    JournalEntry *entry = &journal->pending[i];
+    if (
+      entry->field == field &&
+      entry->bank == bank &&
+      entry->preset == preset &&
+      entry->channel == channel
+    ) {
+      entry->value = value;
+      return;
+    }
+  }
+
+  if (journal->pendingCount == JOURNAL_BUFFER_ENTRIES) {
+    SDCard::flushJournal(state);
+    if (journal->pendingCount == JOURNAL_BUFFER_ENTRIES) {
+      // The card is unavailable. The bank is already marked dirty, so autosave still has the edit.
+      return;
+    }
+  }
+  JournalEntry *entry = &journal->pending[journal->pendingCount];
+  entry->bank = bank;
+  entry->preset = preset;
+  entry->channel = channel;
+  entry->field = field;
+  entry->value = value;
+  journal->pendingCount += 1;
+}
+
+uint16_t Journal::checksum(JournalEntry *entry) {
+  return Utils::crc32(reinterpret_cast<uint8_t *>(entry), offsetof(JournalEntry, check));
+}
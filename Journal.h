@@ -0,0 +1,184 @@
+/**
+ * Recollections: Journal
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+// Included for File
+#ifdef CORE_TEENSY
+  // This needs to be the Teensy-specific version of this. Rename others to disambiguate.
+  #include <SD.h>
+#else
+  #include <SDFS.h>
+#endif
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_JOURNAL_H_
+#define RECOLLECTIONS_JOURNAL_H_
+
+struct State;
+
+/**
+ * One edit as recorded in the Journal.bin file on the SD card. Each entry holds the absolute value
+ * of one field, never a delta or a reference to another field, so replaying an entry that is
+ * already reflected in Module.bin is harmless. See JournalField in constants.h for the meaning of
+ * the coordinates.
+ */
+typedef struct JournalEntry {
+  uint8_t bank;
+  uint8_t preset;
+  uint8_t channel;
+  JournalField_t field;
+  uint16_t value;
+
+  /** The low 16 bits of the CRC-32 of the preceding bytes. Used to detect a torn write. */
+  uint16_t check;
+} JournalEntry;
+
+static_assert(sizeof(JournalEntry) == 8, "JournalEntry layout changed");
+
+/**
+ * Write-ahead journal of edits to the bank data, so that edits survive the power being cut before
+ * the affected banks are saved.
+ *
+ * Every mutation of bank data records the new value here, which is only an append to a small
+ * buffer in RAM. SDCard::maintainJournal() appends the buffer to Journal.bin every
+ * JOURNAL_FLUSH_INTERVAL ms. When a module is read, its journal is replayed on top of Module.bin.
+ * Once autosave has written every dirty bank, the journal holds nothing that is not already in
+ * Module.bin, so it is truncated. Recording an edit also marks its bank dirty.
+ */
+typedef struct Journal {
+  /** Entries not yet appended to Journal.bin, oldest first. */
+  JournalEntry pending[JOURNAL_BUFFER_ENTRIES];
+
+  /** The number of entries in pending. */
+  uint8_t pendingCount;
+
+  /** The size in bytes of the valid entries in Journal.bin. */
+  uint32_t fileSize;
+
+  /** The time in ms at which pending was last appended to Journal.bin. */
+  unsigned long lastFlushTime;
+
+  /** Journal.bin, open for appending between flushes. Closed when the module changes. */
+  File file;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Record the current value of voltages[bank][preset][channel].
+   *
+   * @param state
+   * @param bank
+   * @param preset
+   * @param channel
+   */
+  static void voltage(State *state, uint8_t bank, uint8_t preset, uint8_t channel);
+
+  /**
+   * @brief Record the current values of the four per-preset flag planes of [bank][preset]:
+   * activeVoltages, gateVoltages, lockedVoltages and randomVoltages.
+   *
+   * @param state
+   * @param bank
+   * @param preset
+   */
+  static void presetFlags(State *state, uint8_t bank, uint8_t preset);
+
+  /**
+   * @brief Record the current values of the four per-bank channel flags of [bank]:
+   * autoRecordChannels, gateChannels, randomInputChannels and randomOutputChannels.
+   *
+   * @param state
+   * @param bank
+   */
+  static void channelFlags(State *state, uint8_t bank);
+
+  /**
+   * @brief Record the current value of randomSeeds[bank][channel].
+   *
+   * @param state
+   * @param bank
+   * @param channel
+   */
+  static void randomSeed(State *state, uint8_t bank, uint8_t channel);
+
+  /**
+   * @brief Record the current value of removedPresets[preset].
+   *
+   * @param state
+   * @param preset
+   */
+  static void removedPreset(State *state, uint8_t preset);
+
+  /**
+   * @brief Record the current values of channelLengths, channelAddends and removedSteps of
+   * [bank][channel].
+   *
+   * @param state
+   * @param bank
+   * @param channel
+   */
+  static void sequence(State *state, uint8_t bank, uint8_t channel);
+
+  /**
+   * @brief Record the current value of every field of [bank], as after pasting another bank over
+   * it. This is some 230 entries, so it may flush the pending buffer to the SD card a few times.
+   *
+   * @param state
+   * @param bank
+   */
+  static void bank(State *state, uint8_t bank);
+
+  /**
+   * @brief Apply one entry from Journal.bin to state. Returns false if the entry is torn or out of
+   * range, in which case state is unchanged.
+   *
+   * @param entry
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool apply(JournalEntry *entry, State *state);
+
+  /**
+   * @brief Set the check value of an entry, just before it is written to the SD card.
+   *
+   * @param entry
+   */
+  static void seal(JournalEntry *entry);
+
+  private:
+  /**
+   * @brief Add an entry to the pending buffer, marking its bank dirty. If an entry for the same
+   * field and coordinates is already pending, its value is updated in place instead, so continuous
+   * recording does not fill the buffer. A full buffer is flushed to the SD card first.
+   *
+   * @param state
+   * @param field
+   * @param bank
+   * @param preset
+   * @param channel
+   * @param value
+   */
+  static void append(
+    State *state,
+    JournalField_t field,
+    uint8_t bank,
+    uint8_t preset,
+    uint8_t channel,
+    uint16_t value
+  );
+
+  /**
+   * @brief Calculate the check value of an entry.
+   *
+   * @param entry
+   * @return uint16_t
+   */
+  static uint16_t checksum(JournalEntry *entry);
+} Journal;
+
+#endif
@@ -8,27 +8,31 @@
 
 #include <Adafruit_NeoTrellis.h>
 
+#include "CVInput.h"
 #include "Hardware.h"
+#include "Log.h"
 #include "Nav.h"
+#include "Playheads.h"
+#include "Random.h"
 #include "SDCard.h"
 #include "Utils.h"
 #include "constants.h"
 
-State Keys::handleKeyEvent(keyEvent evt, State state) {
-  if (evt.bit.EDGE == SEESAW_KEYPAD_EDGE_RISING && state.readyForKeyPress) {
-    uint8_t key = state.config.controllerOrientation
+void Keys::handleKeyEvent(keyEvent evt, State *state) {
+  if (evt.bit.EDGE == SEESAW_KEYPAD_EDGE_RISING && state->readyForKeyPress) {
+    uint8_t key = state->config.controllerOrientation
       ? evt.bit.NUM
       : 15 - evt.bit.NUM;
-    state.readyForKeyPress = false;
-    switch (state.screen) {
+    state->readyForKeyPress = false;
+    switch (state->screen) {
       case SCREEN.BANK_SELECT:
-        state = Keys::handleBankSelectKeyEvent(key, state);
+        Keys::handleBankSelectKeyEvent(key, state);
         break;
       case SCREEN.EDIT_CHANNEL_SELECT:
-        state = Keys::handleEditChannelSelectKeyEvent(key, state);
+        Keys::handleEditChannelSelectKeyEvent(key, state);
         break;
       case SCREEN.EDIT_CHANNEL_VOLTAGES:
-        state = Keys::handleEditChannelVoltagesKeyEvent(key, state);
+        Keys::handleEditChannelVoltagesKeyEvent(key, state);
         break;
       case SCREEN.ERROR:
         #ifdef CORE_TEENSY
@@ -38,524 +42,514 @@ State Keys::handleKeyEvent(keyEvent evt, State state) {
         #endif
         break;
       case SCREEN.GLOBAL_EDIT:
-        state = Keys::handleGlobalEditKeyEvent(key, state);
+        Keys::handleGlobalEditKeyEvent(key, state);
         break;
       case SCREEN.MODULE_SELECT:
-        state = Keys::handleModuleSelectKeyEvent(key, state);
+        Keys::handleModuleSelectKeyEvent(key, state);
         break;
       case SCREEN.PRESET_CHANNEL_SELECT:
-        state = Keys::handlePresetChannelSelectKeyEvent(key, state);
+        Keys::handlePresetChannelSelectKeyEvent(key, state);
         break;
       case SCREEN.PRESET_SELECT:
-        state = Keys::handlePresetSelectKeyEvent(key, state);
+        Keys::handlePresetSelectKeyEvent(key, state);
         break;
       case SCREEN.RECORD_CHANNEL_SELECT:
-        state = Keys::handleRecordChannelSelectKeyEvent(key, state);
+        Keys::handleRecordChannelSelectKeyEvent(key, state);
         break;
       case SCREEN.SECTION_SELECT:
-        state = Keys::handleSectionSelectKeyEvent(key, state);
+        Keys::handleSectionSelectKeyEvent(key, state);
         break;
     }
   }
-  else if (evt.bit.EDGE == SEESAW_KEYPAD_EDGE_FALLING && !state.readyForKeyPress) {
-    state.readyForKeyPress = true;
-    state.selectedKeyForRecording = -1;
+  else if (evt.bit.EDGE == SEESAW_KEYPAD_EDGE_FALLING && !state->readyForKeyPress) {
+    state->readyForKeyPress = true;
+    state->selectedKeyForRecording = -1;
   }
-
-  return state;
 }
 
 //--------------------------------------- PRIVATE --------------------------------------------------
 
-State Keys::addKeyToCopyPasteData(uint8_t key, State state) {
-  if (state.selectedKeyForCopying == key) {
-    Serial.println("Somehow began copy/paste incorrectly. This should never happen.");
-    return state;
+void Keys::addKeyToCopyPasteData(uint8_t key, State *state) {
+  if (state->selectedKeyForCopying == key) {
+    LOG_ERROR("Somehow began copy/paste incorrectly. This should never happen.");
+    return;
   }
-  if (state.selectedKeyForCopying < 0) { // No key selected yet, initiate copy of the pressed key.
-    state.selectedKeyForCopying = key;
-    state.pasteTargetKeys[key] = true;
+  if (state->selectedKeyForCopying < 0) { // No key selected yet, initiate copy of the pressed key.
+    state->selectedKeyForCopying = key;
+    state->pasteTargetKeys[key] = true;
   }
   else { // Pressed key should be added or removed from the set of paste target keys.
-    state.pasteTargetKeys[key] = !state.pasteTargetKeys[key];
+    state->pasteTargetKeys[key] = !state->pasteTargetKeys[key];
   }
-  return state;
 }
 
-State Keys::carryRestsToInactiveVoltages(uint8_t key, State state) {
+void Keys::carryRestsToInactiveVoltages(uint8_t key, State *state) {
   for (uint8_t i = 0; i < 15; i++) {
-    if (!state.gateVoltages[state.currentBank][i][key]) {
-      state.activeVoltages[state.currentBank][i][key] = false;
+    if (!Bits::get(state->gateVoltages[state->currentBank][i], key)) {
+      Bits::set(&state->activeVoltages[state->currentBank][i], key, false);
+      Journal::presetFlags(state, state->currentBank, i);
     }
   }
-  return state;
 }
 
-State Keys::handleBankSelectKeyEvent(uint8_t key, State state) {
-  if (!state.readyForModPress) { // MOD button is being held
-    state = Keys::updateModKeyCombinationTracking(key, state);
-    if (state.selectedKeyForCopying != key) {
-      state = Keys::addKeyToCopyPasteData(key, state);
+void Keys::handleBankSelectKeyEvent(uint8_t key, State *state) {
+  if (!state->readyForModPress) { // MOD button is being held
+    Keys::updateModKeyCombinationTracking(key, state);
+    if (state->selectedKeyForCopying != key) {
+      Keys::addKeyToCopyPasteData(key, state);
     }
     else { // Pressed the original bank again, quit copy-paste and clear the paste banks.
-      state = State::quitCopyPasteFlowPriorToPaste(state);
+      State::quitCopyPasteFlowPriorToPaste(state);
     }
   }
-  else if (key != state.currentBank) {
-    state.currentBank = key;
+  else {
+    State::selectBank(state, key);
   }
-  return state;
 }
 
-State Keys::handleEditChannelSelectKeyEvent(uint8_t key, State state) {
+void Keys::handleEditChannelSelectKeyEvent(uint8_t key, State *state) {
   // Invalid key
   if (key > 7) {
-    return state;
+    return;
   }
 
-  state.currentChannel = key;
+  state->currentChannel = key;
 
   // MOD button is not being held, select channel and navigate
-  if (state.readyForModPress) {
-    state = Nav::goForward(state, SCREEN.EDIT_CHANNEL_VOLTAGES);
-    return state;
+  if (state->readyForModPress) {
+    Nav::goForward(state, SCREEN.EDIT_CHANNEL_VOLTAGES);
+    return;
   }
 
   // MOD button is being held
-  uint8_t currentBank = state.currentBank;
-  if (state.initialModHoldKey < 0) {
-    state.initialModHoldKey = key;
+  uint8_t currentBank = state->currentBank;
+  if (state->initialModHoldKey < 0) {
+    state->initialModHoldKey = key;
   }
 
   // If we changed this key previously, reset the state.
   // Otherwise, update the mod + key tracking to enter the cycle of functionality.
   if (
-    state.keyPressesSinceModHold == 0 &&
-    (state.randomOutputChannels[currentBank][key] || state.gateChannels[currentBank][key])
+    state->keyPressesSinceModHold == 0 &&
+    (
+      Bits::get(state->randomOutputChannels[currentBank], key) ||
+      Bits::get(state->gateChannels[currentBank], key)
+    )
   ) {
-    state.randomOutputChannels[currentBank][key] = false;
-    if (state.gateChannels[currentBank][key]) {
-      state = Keys::carryRestsToInactiveVoltages(key, state);
-      state.gateChannels[currentBank][key] = false;
+    Bits::set(&state->randomOutputChannels[currentBank], key, false);
+    if (Bits::get(state->gateChannels[currentBank], key)) {
+      Keys::carryRestsToInactiveVoltages(key, state);
+      Bits::set(&state->gateChannels[currentBank], key, false);
     }
+    Journal::channelFlags(state, currentBank);
   } else {
-    state = Keys::updateModKeyCombinationTracking(key, state);
+    Keys::updateModKeyCombinationTracking(key, state);
   }
 
   // copy-paste
-  if (state.keyPressesSinceModHold == 1) {
-    state = Keys::addKeyToCopyPasteData(key, state);
+  if (state->keyPressesSinceModHold == 1) {
+    Keys::addKeyToCopyPasteData(key, state);
   }
 
   // set as gate channel
-  else if (state.keyPressesSinceModHold == 2) {
-    state = State::quitCopyPasteFlowPriorToPaste(state);
-    state.gateChannels[currentBank][key] = true;
+  else if (state->keyPressesSinceModHold == 2) {
+    State::quitCopyPasteFlowPriorToPaste(state);
+    Bits::set(&state->gateChannels[currentBank], key, true);
+    Journal::channelFlags(state, currentBank);
   }
 
-  // set as random CV channel
-  else if (state.keyPressesSinceModHold == 3) {
-    state.gateChannels[currentBank][key] = false;
-    state.randomOutputChannels[currentBank][key] = true;
+  // set as random CV channel, with a new random sequence
+  else if (state->keyPressesSinceModHold == 3) {
+    Bits::set(&state->gateChannels[currentBank], key, false);
+    Bits::set(&state->randomOutputChannels[currentBank], key, true);
+    state->randomSeeds[currentBank][key] = Random::next(state);
+    Journal::channelFlags(state, currentBank);
+    Journal::randomSeed(state, currentBank, key);
   }
 
   // Return to beginning
-  else if (state.keyPressesSinceModHold == 4) {
-    state.randomOutputChannels[currentBank][key] = false;
-    state.keyPressesSinceModHold = 0;
+  else if (state->keyPressesSinceModHold == 4) {
+    Bits::set(&state->randomOutputChannels[currentBank], key, false);
+    state->keyPressesSinceModHold = 0;
+    Journal::channelFlags(state, currentBank);
   }
-
-  return state;
 }
 
-State Keys::handleEditChannelVoltagesKeyEvent(uint8_t key, State state) {
-  uint8_t currentBank = state.currentBank;
-  uint8_t currentChannel = state.currentChannel;
+void Keys::handleEditChannelVoltagesKeyEvent(uint8_t key, State *state) {
+  uint8_t currentBank = state->currentBank;
+  uint8_t currentChannel = state->currentChannel;
 
   // Alternate preset selection flow
-  if (state.readyForModPress && state.readyForPresetSelection) {
-    state.currentPreset = key;
-    state.readyForPresetSelection = false;
-    return state;
+  if (state->readyForModPress && state->readyForPresetSelection) {
+    state->currentPreset = key;
+    Playheads::moveTo(state, key);
+    state->readyForPresetSelection = false;
+    return;
   }
 
   // Gate channel
-  if (state.gateChannels[currentBank][state.currentChannel]) {
+  if (Bits::get(state->gateChannels[currentBank], state->currentChannel)) {
     // MOD button is not being held, so toggle gate on or off
-    if (state.readyForModPress) {
-      state.gateVoltages[currentBank][key][currentChannel] =
-        !state.gateVoltages[currentBank][key][currentChannel];
+    if (state->readyForModPress) {
+      Bits::toggle(&state->gateVoltages[currentBank][key], currentChannel);
     }
     // MOD button is being held
     else {
-      if (state.initialModHoldKey < 0) {
-        state.initialModHoldKey = key;
+      if (state->initialModHoldKey < 0) {
+        state->initialModHoldKey = key;
       }
 
       // If we changed this key previously, reset the state.
       // Otherwise, update the mod + key tracking to enter the cycle of functionality.
       if (
-        state.keyPressesSinceModHold == 0 &&
-        state.randomVoltages[currentBank][key][currentChannel]
+        state->keyPressesSinceModHold == 0 &&
+        Bits::get(state->randomVoltages[currentBank][key], currentChannel)
       ) {
-        state.randomVoltages[currentBank][key][currentChannel] = false;
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, false);
       } else {
-        state = Keys::updateModKeyCombinationTracking(key, state);
+        Keys::updateModKeyCombinationTracking(key, state);
       }
 
       // Voltage is a random coin-flip between gate on or gate off
-      if (state.keyPressesSinceModHold == 1) {
-        state.randomVoltages[currentBank][key][currentChannel] = true;
+      if (state->keyPressesSinceModHold == 1) {
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, true);
       }
       // Return to beginning
-      else if (state.keyPressesSinceModHold == 2) {
-        state.randomVoltages[currentBank][key][currentChannel] = false;
-        state.keyPressesSinceModHold = 0;
+      else if (state->keyPressesSinceModHold == 2) {
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, false);
+        state->keyPressesSinceModHold = 0;
       }
     }
+    Journal::presetFlags(state, currentBank, key);
   }
 
   // CV channel
   else {
     // MOD button is not being held, so edit voltage
-    if (state.readyForModPress) {
-      state.selectedKeyForRecording = key;
+    if (state->readyForModPress) {
+      state->selectedKeyForRecording = key;
       // See also continual recording in loop().
-      #ifdef CORE_TEENSY
-        state.voltages[currentBank][key][currentChannel] =
-          Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-      #else
-        state.voltages[currentBank][key][currentChannel] = analogRead(CV_INPUT);
-      #endif
+      state->voltages[currentBank][key][currentChannel] = CVInput::read(state);
+      Journal::voltage(state, currentBank, key, currentChannel);
     }
     // MOD button is being held
     else {
-      if (state.initialModHoldKey < 0) {
-        state.initialModHoldKey = key;
+      if (state->initialModHoldKey < 0) {
+        state->initialModHoldKey = key;
       }
 
       // If we changed this key previously, reset the state.
       // Otherwise, update the mod + key tracking to enter the cycle of functionality.
       if (
-        state.keyPressesSinceModHold == 0 &&
+        state->keyPressesSinceModHold == 0 &&
         (
-          state.lockedVoltages[currentBank][key][currentChannel] ||
-          !state.activeVoltages[currentBank][key][currentChannel] ||
-          state.randomVoltages[currentBank][key][currentChannel]
+          Bits::get(state->lockedVoltages[currentBank][key], currentChannel) ||
+          !Bits::get(state->activeVoltages[currentBank][key], currentChannel) ||
+          Bits::get(state->randomVoltages[currentBank][key], currentChannel)
         )
       ) {
-        state.lockedVoltages[currentBank][key][currentChannel] = false;
-        state.activeVoltages[currentBank][key][currentChannel] = true;
-        state.randomVoltages[currentBank][key][currentChannel] = false;
+        Bits::set(&state->lockedVoltages[currentBank][key], currentChannel, false);
+        Bits::set(&state->activeVoltages[currentBank][key], currentChannel, true);
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, false);
       } else {
-        state = Keys::updateModKeyCombinationTracking(key, state);
+        Keys::updateModKeyCombinationTracking(key, state);
       }
 
       // Copy-paste voltage value
-      if (state.keyPressesSinceModHold == 1) {
-        state = Keys::addKeyToCopyPasteData(key, state);
+      if (state->keyPressesSinceModHold == 1) {
+        Keys::addKeyToCopyPasteData(key, state);
       }
       // Voltage is locked
-      else if (state.keyPressesSinceModHold == 2) {
-        state = State::quitCopyPasteFlowPriorToPaste(state);
-        state.lockedVoltages[currentBank][key][currentChannel] = true;
+      else if (state->keyPressesSinceModHold == 2) {
+        State::quitCopyPasteFlowPriorToPaste(state);
+        Bits::set(&state->lockedVoltages[currentBank][key], currentChannel, true);
       }
       // Voltage is inactive
-      else if (state.keyPressesSinceModHold == 3) {
-        state.lockedVoltages[currentBank][key][currentChannel] = false;
-        state.activeVoltages[currentBank][key][currentChannel] = false;
+      else if (state->keyPressesSinceModHold == 3) {
+        Bits::set(&state->lockedVoltages[currentBank][key], currentChannel, false);
+        Bits::set(&state->activeVoltages[currentBank][key], currentChannel, false);
       }
       // Voltage is random
-      else if (state.keyPressesSinceModHold == 4) {
-        state.activeVoltages[currentBank][key][currentChannel] = true;
-        state.randomVoltages[currentBank][key][currentChannel] = true;
+      else if (state->keyPressesSinceModHold == 4) {
+        Bits::set(&state->activeVoltages[currentBank][key], currentChannel, true);
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, true);
       }
       // Return to beginning
-      else if (state.keyPressesSinceModHold == 5) {
-        state.randomVoltages[currentBank][key][currentChannel] = false;
-        state.keyPressesSinceModHold = 0;
+      else if (state->keyPressesSinceModHold == 5) {
+        Bits::set(&state->randomVoltages[currentBank][key], currentChannel, false);
+        state->keyPressesSinceModHold = 0;
       }
+      Journal::presetFlags(state, currentBank, key);
     }
   }
-
-  return state;
 }
 
-State Keys::handleGlobalEditKeyEvent(uint8_t key, State state) {
-  uint8_t currentBank = state.currentBank;
+void Keys::handleGlobalEditKeyEvent(uint8_t key, State *state) {
+  uint8_t currentBank = state->currentBank;
 
-  if (state.readyForModPress) { // MOD button is not being held
+  if (state->readyForModPress) { // MOD button is not being held
     // Alternate preset selection flow
-    if (state.readyForPresetSelection) {
-      state.currentPreset = key;
-      state.readyForPresetSelection = false;
-      return state;
+    if (state->readyForPresetSelection) {
+      state->currentPreset = key;
+      Playheads::moveTo(state, key);
+      state->readyForPresetSelection = false;
+      return;
     }
 
     // Toggle removed presets
-    if (state.removedPresets[key]) {
-      state.removedPresets[key] = false;
+    if (state->removedPresets[key]) {
+      state->removedPresets[key] = false;
     }
     else {
       uint8_t totalRemovedPresets = 0;
       for (uint8_t i = 0; i < 16; i++) {
-        if (state.removedPresets[i]) {
+        if (state->removedPresets[i]) {
           totalRemovedPresets = totalRemovedPresets + 1;
         }
       }
       // NOTE: it is important to always have at least one preset, so we need to prevent the removal
       // if it would be the 16th removed preset.
-      state.removedPresets[key] = totalRemovedPresets < 15 ? true : false;
+      state->removedPresets[key] = totalRemovedPresets < 15 ? true : false;
     }
+    Journal::removedPreset(state, key);
   }
 
   // MOD button is being held
   else {
-    if (state.initialModHoldKey < 0) {
-      state.initialModHoldKey = key;
+    if (state->initialModHoldKey < 0) {
+      state->initialModHoldKey = key;
     }
 
     // If we changed this key previously, reset the state.
     // Otherwise, update the mod + key tracking to enter the cycle of functionality.
-    if (state.keyPressesSinceModHold == 0) {
+    if (state->keyPressesSinceModHold == 0) {
       bool allChannelVoltagesLocked = true;
       bool allChannelVoltagesInactive = true;
       for (uint8_t i = 0; i < 8; i++) {
-        if (!state.lockedVoltages[state.currentBank][key][i]) {
+        if (!Bits::get(state->lockedVoltages[state->currentBank][key], i)) {
           allChannelVoltagesLocked = false;
         }
-        if (state.activeVoltages[state.currentBank][key][i]) {
+        if (Bits::get(state->activeVoltages[state->currentBank][key], i)) {
           allChannelVoltagesInactive = false;
         }
       }
       if (allChannelVoltagesLocked || allChannelVoltagesInactive) {
         for (uint8_t i = 0; i < 8; i++) {
-          state.lockedVoltages[currentBank][key][i] = false;
-          state.activeVoltages[currentBank][key][i] = true;
+          Bits::set(&state->lockedVoltages[currentBank][key], i, false);
+          Bits::set(&state->activeVoltages[currentBank][key], i, true);
         }
-        return state;
+        Journal::presetFlags(state, currentBank, key);
+        return;
       }
     }
 
-    state = Keys::updateModKeyCombinationTracking(key, state);
+    Keys::updateModKeyCombinationTracking(key, state);
 
     // Copy-paste
-    if (state.keyPressesSinceModHold == 1) {
-      state = Keys::addKeyToCopyPasteData(key, state);
+    if (state->keyPressesSinceModHold == 1) {
+      Keys::addKeyToCopyPasteData(key, state);
     }
     // Toggle locked voltages
-    else if (state.keyPressesSinceModHold == 2) {
-      state = State::quitCopyPasteFlowPriorToPaste(state);
+    else if (state->keyPressesSinceModHold == 2) {
+      State::quitCopyPasteFlowPriorToPaste(state);
       for (uint8_t i = 0; i < 8; i++) {
-        state.lockedVoltages[currentBank][key][i] = true;
+        Bits::set(&state->lockedVoltages[currentBank][key], i, true);
       }
     }
     // Toggle active/inactive voltages
-    else if (state.keyPressesSinceModHold == 3) {
+    else if (state->keyPressesSinceModHold == 3) {
       for (uint8_t i = 0; i < 8; i++) {
-        state.lockedVoltages[currentBank][key][i] = false;
-        state.activeVoltages[currentBank][key][i] = false;
+        Bits::set(&state->lockedVoltages[currentBank][key], i, false);
+        Bits::set(&state->activeVoltages[currentBank][key], i, false);
       }
     }
     // Return to beginning
-    else if (state.keyPressesSinceModHold == 4) {
+    else if (state->keyPressesSinceModHold == 4) {
       for (uint8_t i = 0; i < 8; i++) {
-        state.activeVoltages[currentBank][key][i] = true;
+        Bits::set(&state->activeVoltages[currentBank][key], i, true);
       }
-      state.keyPressesSinceModHold = 0;
+      state->keyPressesSinceModHold = 0;
     }
+    Journal::presetFlags(state, currentBank, key);
   }
-  return state;
 }
 
-State Keys::handleModuleSelectKeyEvent(uint8_t key, State state) {
-  state.config.currentModule = key;
-  state = SDCard::readModuleDirectory(state);
-  return state;
+void Keys::handleModuleSelectKeyEvent(uint8_t key, State *state) {
+  // Switching reads the SD card for a long time, which must not happen while the bus is claimed.
+  state->requestedModule = key;
 }
 
-State Keys::handlePresetChannelSelectKeyEvent(uint8_t key, State state) {
+void Keys::handlePresetChannelSelectKeyEvent(uint8_t key, State *state) {
   if (key > 7) {
-    return state;
+    return;
   }
-  state.currentChannel = key;
-  state = Nav::goBack(state);
-  return state;
+  state->currentChannel = key;
+  Nav::goBack(state);
 }
 
-State Keys::handlePresetSelectKeyEvent(uint8_t key, State state) {
-  uint8_t currentBank = state.currentBank;
-  uint8_t currentChannel = state.currentChannel;
+void Keys::handlePresetSelectKeyEvent(uint8_t key, State *state) {
+  uint8_t currentBank = state->currentBank;
+  uint8_t currentChannel = state->currentChannel;
 
-  if (!state.readyForModPress) { // MOD button is being held
-    state.initialModHoldKey = key;
-    state.selectedKeyForRecording = key;
+  if (!state->readyForModPress) { // MOD button is being held
+    state->initialModHoldKey = key;
+    state->selectedKeyForRecording = key;
     if (
-      state.randomInputChannels[currentBank][currentChannel] ||
-      (state.randomVoltages[currentBank][state.currentPreset][currentBank] &&
-        state.config.randomOutputOverwrites)
+      Bits::get(state->randomInputChannels[currentBank], currentChannel) ||
+      (Bits::get(state->randomVoltages[currentBank][state->currentPreset], currentChannel) &&
+        state->config.randomOutputOverwrites)
     ) {
-      state.voltages[currentBank][key][currentChannel] = Utils::random(MAX_UNSIGNED_12_BIT);
+      state->voltages[currentBank][key][currentChannel] = Random::voltage(state);
     }
     else {
-      #ifdef CORE_TEENSY
-        state.voltages[currentBank][key][currentChannel] =
-          Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-      #else
-        state.voltages[currentBank][key][currentChannel] = analogRead(CV_INPUT);
-      #endif
+      state->voltages[currentBank][key][currentChannel] = CVInput::read(state);
     }
+    Journal::voltage(state, currentBank, key, currentChannel);
   }
   else {
-    state.currentPreset = key;
-    if (
-      state.randomVoltages[currentBank][key][currentChannel] ||
-      state.randomOutputChannels[currentBank][currentChannel]
-    ) {
-      state.voltages[currentBank][key][currentChannel] = Utils::random(MAX_UNSIGNED_12_BIT);
-    }
+    // Random voltages play from the seed, so the preset keeps its recorded value.
+    state->currentPreset = key;
+    Playheads::moveTo(state, key);
   }
-  return state;
 }
 
-State Keys::handleRecordChannelSelectKeyEvent(uint8_t key, State state) {
+void Keys::handleRecordChannelSelectKeyEvent(uint8_t key, State *state) {
   if (key > 7) {
-    return state;
+    return;
   }
 
-  state.currentChannel = key;
-  uint8_t currentBank = state.currentBank;
-  uint8_t currentPreset = state.currentPreset;
+  state->currentChannel = key;
+  uint8_t currentBank = state->currentBank;
+  // The step of the channel, if it has a sequence of its own.
+  uint8_t currentPreset = Playheads::step(state, key);
 
   // MOD button is not being held
-  if (state.readyForModPress) {
-    state.selectedKeyForRecording = key;
-    if (!state.isAdvancingPresets) {
+  if (state->readyForModPress) {
+    state->selectedKeyForRecording = key;
+    if (!state->isAdvancingPresets) {
       // This is only the initial sample when pressing the key. When isAdvancingPresets is true, we
       // do not record immediately upon pressing the key here, but rather when the preset changes.
       // See Advance::updateStateAfterAdvancing().
-      #ifdef CORE_TEENSY
-        state.voltages[currentBank][currentPreset][key] =
-          Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-      #else
-        state.voltages[currentBank][currentPreset][key] = analogRead(CV_INPUT);
-      #endif
+      state->voltages[currentBank][currentPreset][key] = CVInput::read(state);
+      Journal::voltage(state, currentBank, currentPreset, key);
     }
-    return state;
+    return;
   }
 
   // MOD button is being held
-  if (state.initialModHoldKey < 0) {
-    state.initialModHoldKey = key;
+  if (state->initialModHoldKey < 0) {
+    state->initialModHoldKey = key;
   }
 
   // Allow auto recording only on one channel at a time
-  if (state.initialModHoldKey != key) {
-    return state;
+  if (state->initialModHoldKey != key) {
+    return;
   }
 
   // If we changed this key previously, reset the state.
   // Otherwise, update the mod + key tracking to enter the cycle of functionality.
   if (
-    state.keyPressesSinceModHold == 0 &&
-    (state.autoRecordChannels[currentBank][key] || state.randomInputChannels[currentBank][key])
+    state->keyPressesSinceModHold == 0 &&
+    (
+      Bits::get(state->autoRecordChannels[currentBank], key) ||
+      Bits::get(state->randomInputChannels[currentBank], key)
+    )
   ) {
-    state.autoRecordChannels[currentBank][key] = false;
-    state.randomInputChannels[currentBank][key] = false;
+    Bits::set(&state->autoRecordChannels[currentBank], key, false);
+    Bits::set(&state->randomInputChannels[currentBank], key, false);
+    Journal::channelFlags(state, currentBank);
   }
   else {
-    state = Keys::updateModKeyCombinationTracking(key, state);
+    Keys::updateModKeyCombinationTracking(key, state);
   }
 
   // Automatic recording
-  if (state.keyPressesSinceModHold == 1) {
-    state.autoRecordChannels[currentBank][key] = true;
+  if (state->keyPressesSinceModHold == 1) {
+    Bits::set(&state->autoRecordChannels[currentBank], key, true);
+    Journal::channelFlags(state, currentBank);
   }
 
   // Randomly generated input.
   // Note: this does not turn off automatic recording, as we want to use random voltage as part of
   // automatic recording in this case.
-  else if (state.keyPressesSinceModHold == 2) {
-    state.randomInputChannels[currentBank][key] = true;
+  else if (state->keyPressesSinceModHold == 2) {
+    Bits::set(&state->randomInputChannels[currentBank], key, true);
+    Journal::channelFlags(state, currentBank);
     // if not advancing, sample random voltage immediately
-    if (!state.isAdvancingPresets) {
-      state.cachedVoltage = state.voltages[currentBank][currentPreset][key];
-      state.voltages[currentBank][currentPreset][key] =
-        Utils::random(MAX_UNSIGNED_12_BIT);
+    if (!state->isAdvancingPresets) {
+      state->cachedVoltage = state->voltages[currentBank][currentPreset][key];
+      state->voltages[currentBank][currentPreset][key] = Random::voltage(state);
+      Journal::voltage(state, currentBank, currentPreset, key);
     }
   }
 
   // Return to beginning
-  else if (state.keyPressesSinceModHold == 3) {
-    state.autoRecordChannels[currentBank][key] = false;
-    state.randomInputChannels[currentBank][key] = false;
-    if (!state.isAdvancingPresets) {
-      state.voltages[currentBank][currentPreset][key] = state.cachedVoltage;
+  else if (state->keyPressesSinceModHold == 3) {
+    Bits::set(&state->autoRecordChannels[currentBank], key, false);
+    Bits::set(&state->randomInputChannels[currentBank], key, false);
+    Journal::channelFlags(state, currentBank);
+    if (!state->isAdvancingPresets) {
+      state->voltages[currentBank][currentPreset][key] = state->cachedVoltage;
+      Journal::voltage(state, currentBank, currentPreset, key);
     }
-    state.keyPressesSinceModHold = 0;
+    state->keyPressesSinceModHold = 0;
   }
-
-  return state;
 }
 
-State Keys::handleSectionSelectKeyEvent(uint8_t key, State state) {
-  bool const modButtonIsBeingHeld = !state.readyForModPress;
+void Keys::handleSectionSelectKeyEvent(uint8_t key, State *state) {
+  bool const modButtonIsBeingHeld = !state->readyForModPress;
   Quadrant_t quadrant = Utils::keyQuadrant(key);
 
   // Cancel save by pressing any other quadrant
-  if (state.readyToSave && quadrant != QUADRANT.SE) {
-    state.readyToSave = false;
-    return state;
+  if (state->readyToSave && quadrant != QUADRANT.SE) {
+    state->readyToSave = false;
+    return;
   }
 
   switch (quadrant) {
     case QUADRANT.INVALID:
-      state.screen = SCREEN.ERROR;
+      state->screen = SCREEN.ERROR;
       break;
     case QUADRANT.NW: // yellow: navigate to channel editing
       if (modButtonIsBeingHeld) {
         // TODO: configure output voltage?
       } else {
-        state = Nav::goForward(state, SCREEN.EDIT_CHANNEL_SELECT);
+        Nav::goForward(state, SCREEN.EDIT_CHANNEL_SELECT);
       }
       break;
     case QUADRANT.NE: // red: navigate to recording
       if (modButtonIsBeingHeld) {
         // TODO: configure input voltage?
       } else {
-        state = Nav::goForward(state, SCREEN.RECORD_CHANNEL_SELECT);
+        Nav::goForward(state, SCREEN.RECORD_CHANNEL_SELECT);
       }
       break;
     case QUADRANT.SW: // green: navigate to global edit or load module
       if (modButtonIsBeingHeld) {
-        state.initialModHoldKey = key;
-        state = Nav::goForward(state, SCREEN.MODULE_SELECT);
+        state->initialModHoldKey = key;
+        Nav::goForward(state, SCREEN.MODULE_SELECT);
       } else {
-        state = Nav::goForward(state, SCREEN.GLOBAL_EDIT);
+        Nav::goForward(state, SCREEN.GLOBAL_EDIT);
       }
       break;
     case QUADRANT.SE: // blue: navigate to bank select or save bank to SD
-      if (modButtonIsBeingHeld || state.readyToSave) {
-        if (!state.readyToSave) {
-          state.initialModHoldKey = key;
-          state.readyToSave = true;
+      if (modButtonIsBeingHeld || state->readyToSave) {
+        if (!state->readyToSave) {
+          state->initialModHoldKey = key;
+          state->readyToSave = true;
         }
         else {
-          bool const writeSuccess = SDCard::writeCurrentModuleAndBank(state);
-          if (writeSuccess) {
-            state.readyToSave = false;
-            state.confirmingSave = true;
-            state.flashesSinceSave = 0;
-          } else {
-            state = Nav::goForward(state, SCREEN.ERROR);
+          // The save continues across loop iterations and confirms itself once it completes.
+          state->readyToSave = false;
+          if (!SDCard::beginSave(state, state->currentBank, false)) {
+            Nav::goForward(state, SCREEN.ERROR);
           }
         }
       } else {
-        state = Nav::goForward(state, SCREEN.BANK_SELECT);
+        Nav::goForward(state, SCREEN.BANK_SELECT);
       }
       break;
   }
-  return state;
 }
 
 /**
@@ -565,20 +559,18 @@ State Keys::handleSectionSelectKeyEvent(uint8_t key, State state) {
  *
  * @param key
  * @param state
- * @return State
  */
-State Keys::updateModKeyCombinationTracking(uint8_t key, State state) {
+void Keys::updateModKeyCombinationTracking(uint8_t key, State *state) {
   // MOD button is being held
-  if (!state.readyForModPress) {
+  if (!state->readyForModPress) {
     // this is the first key to be pressed
-    if (state.initialModHoldKey < 0) {
-      state.initialModHoldKey = key;
-      state.keyPressesSinceModHold = 1;
+    if (state->initialModHoldKey < 0) {
+      state->initialModHoldKey = key;
+      state->keyPressesSinceModHold = 1;
     }
     // initial key is pressed repeatedly
-    else if (state.initialModHoldKey == key) {
-      state.keyPressesSinceModHold = state.keyPressesSinceModHold + 1;
+    else if (state->initialModHoldKey == key) {
+      state->keyPressesSinceModHold = state->keyPressesSinceModHold + 1;
     }
   }
-  return state;
 }
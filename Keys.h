@@ -11,20 +11,20 @@
 #define RECOLLECTIONS_KEYS_H_
 
 typedef struct Keys {
-  static State handleKeyEvent(keyEvent evt, State state);
+  static void handleKeyEvent(keyEvent evt, State *state);
   private:
-  static State addKeyToCopyPasteData(uint8_t key, State state);
-  static State carryRestsToInactiveVoltages(uint8_t key, State state);
-  static State handleBankSelectKeyEvent(uint8_t key, State state);
-  static State handleEditChannelSelectKeyEvent(uint8_t key, State state);
-  static State handleEditChannelVoltagesKeyEvent(uint8_t key, State state);
-  static State handleGlobalEditKeyEvent(uint8_t key, State state);
-  static State handleModuleSelectKeyEvent(uint8_t key, State state);
-  static State handleRecordChannelSelectKeyEvent(uint8_t key, State state);
-  static State handleSectionSelectKeyEvent(uint8_t key, State state);
-  static State handlePresetChannelSelectKeyEvent(uint8_t key, State state);
-  static State handlePresetSelectKeyEvent(uint8_t key, State state);
-  static State updateModKeyCombinationTracking(uint8_t key, State state);
+  static void addKeyToCopyPasteData(uint8_t key, State *state);
+  static void carryRestsToInactiveVoltages(uint8_t key, State *state);
+  static void handleBankSelectKeyEvent(uint8_t key, State *state);
+  static void handleEditChannelSelectKeyEvent(uint8_t key, State *state);
+  static void handleEditChannelVoltagesKeyEvent(uint8_t key, State *state);
+  static void handleGlobalEditKeyEvent(uint8_t key, State *state);
+  static void handleModuleSelectKeyEvent(uint8_t key, State *state);
+  static void handleRecordChannelSelectKeyEvent(uint8_t key, State *state);
+  static void handleSectionSelectKeyEvent(uint8_t key, State *state);
+  static void handlePresetChannelSelectKeyEvent(uint8_t key, State *state);
+  static void handlePresetSelectKeyEvent(uint8_t key, State *state);
+  static void updateModKeyCombinationTracking(uint8_t key, State *state);
 } Keys;
 
 #endif
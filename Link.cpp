@@ -0,0 +1,223 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Link.h"
+
+#if defined(ARDUINO_TEENSY36)
+  #include <i2c_t3.h>
+#else
+  #include <Wire.h>
+#endif
+
+#include "Advance.h"
+#include "Log.h"
+#include "OutputTimer.h"
+#include "Playheads.h"
+#include "State.h"
+
+void Link::advance(State *state, uint32_t gateMicros) {
+  if (Link::isFollower(state)) {
+    return;
+  }
+  Link *link = &state->link;
+  link->step = Link::stepAfter(state, link->step);
+  // The followers hear of the step first, as the outputs of the leader were latched at the edge.
+  uint32_t ageMicros = micros() - gateMicros;
+  Link::send(state, LINK_MESSAGE.STEP, link->step, ageMicros > 0xFFFF ? 0xFFFF : ageMicros);
+  if (Link::page(link->step) == state->config.linkPosition) {
+    Advance::advanceTo(state, link->step % 16, gateMicros);
+  }
+}
+
+bool Link::isLinked(State *state) {
+  return state->config.linkModuleCount > 1;
+}
+
+bool Link::isFollower(State *state) {
+  return Link::isLinked(state) && state->config.linkPosition > 0;
+}
+
+bool Link::nextPreset(State *state, uint8_t *preset) {
+  if (!Link::isLinked(state)) {
+    *preset = Advance::nextPreset(state, state->currentPreset);
+    return true;
+  }
+  uint16_t nextStep = Link::isFollower(state)
+    ? state->link.nextStep
+    : Link::stepAfter(state, state->link.step);
+  if (nextStep == 0xFFFF || Link::page(nextStep) != state->config.linkPosition) {
+    return false;
+  }
+  *preset = nextStep % 16;
+  return true;
+}
+
+void Link::receive(State *state, int byteCount, uint32_t receivedMicros) {
+  Link *link = &state->link;
+  LinkMessage message;
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(&message);
+  int length = 0;
+  while (Wire1.available() > 0) {
+    uint8_t byte = Wire1.read();
+    if (length < static_cast<int>(sizeof(LinkMessage))) {
+      bytes[length] = byte;
+    }
+    length++;
+  }
+  if (byteCount != sizeof(LinkMessage) || length != sizeof(LinkMessage)) {
+    return;
+  }
+
+  // Dated back to the edge at the leader, by the time it took to send and the time before sending.
+  uint32_t edgeMicros = receivedMicros - LINK_MESSAGE_TRANSFER_MICROS - message.ageMicros;
+  if (
+    message.type == LINK_MESSAGE.STEP &&
+    message.value == link->nextStep &&
+    Link::page(message.value) == state->config.linkPosition
+  ) {
+    // The step is already in the DACs, and is produced without waiting for the loop.
+    OutputTimer::requestLatch(state, edgeMicros);
+  }
+
+  uint8_t head = link->head;
+  if ((uint8_t)(head - link->tail) >= LINK_MESSAGE_BUFFER_SIZE) {
+    link->hasOverflowed = true;
+    return;
+  }
+  uint8_t slot = head & (LINK_MESSAGE_BUFFER_SIZE - 1);
+  link->messages[slot].type = message.type;
+  link->messages[slot].sequence = message.sequence;
+  link->messages[slot].value = message.value;
+  link->messages[slot].nextValue = message.nextValue;
+  link->messages[slot].ageMicros = message.ageMicros;
+  link->edgeMicros[slot] = edgeMicros;
+  // Publish the message only once it is complete.
+  link->head = head + 1;
+}
+
+void Link::reset(State *state) {
+  if (!Link::isLinked(state) || Link::isFollower(state)) {
+    return;
+  }
+  state->link.step = 0;
+  Link::send(state, LINK_MESSAGE.RESET, 0, 0);
+}
+
+void Link::update(State *state) {
+  if (!Link::isLinked(state)) {
+    return;
+  }
+  Link *link = &state->link;
+  if (!Link::isFollower(state)) {
+    if (state->currentBank != link->sentBank) {
+      link->sentBank = state->currentBank;
+      Link::send(state, LINK_MESSAGE.BANK, state->currentBank, 0);
+    }
+    return;
+  }
+
+  LinkMessage message;
+  uint32_t edgeMicros;
+  while (Link::pop(state, &message, &edgeMicros)) {
+    Link::apply(state, &message, edgeMicros);
+  }
+  if (link->hasOverflowed) {
+    // The dropped messages are counted by the gap in the sequence numbers.
+    link->hasOverflowed = false;
+    LOG_WARN("Messages from the leader were dropped");
+  }
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+uint8_t Link::page(uint16_t step) {
+  return step / 16;
+}
+
+void Link::apply(State *state, LinkMessage *message, uint32_t edgeMicros) {
+  Link *link = &state->link;
+  link->missedMessages += (uint8_t)(message->sequence - link->sequence);
+  link->sequence = message->sequence + 1;
+  link->messageCount += 1;
+  uint32_t latencyMicros = micros() - edgeMicros;
+  if (latencyMicros > link->maxLatencyMicros) {
+    link->maxLatencyMicros = latencyMicros;
+  }
+
+  if (message->type == LINK_MESSAGE.BANK) {
+    if (message->value < 16) {
+      State::selectBank(state, message->value);
+    }
+    return;
+  }
+  uint16_t stepCount = 16 * state->config.linkModuleCount;
+  if (message->value >= stepCount || message->nextValue >= stepCount) {
+    LOG_WARN("Step %u from the leader is outside the chain of linked modules", message->value);
+    return;
+  }
+  link->step = message->value;
+  link->nextStep = message->nextValue;
+  if (message->type == LINK_MESSAGE.RESET) {
+    // As Input::handleResetInput().
+    state->currentPreset = 0;
+    Playheads::moveTo(state, 0);
+    state->randomStep = 0;
+  }
+  else if (Link::page(link->step) == state->config.linkPosition) {
+    Advance::advanceTo(state, link->step % 16, edgeMicros);
+  }
+}
+
+bool Link::pop(State *state, LinkMessage *message, uint32_t *edgeMicros) {
+  Link *link = &state->link;
+  uint8_t tail = link->tail;
+  if (tail == link->head) {
+    return false;
+  }
+  uint8_t slot = tail & (LINK_MESSAGE_BUFFER_SIZE - 1);
+  message->type = link->messages[slot].type;
+  message->sequence = link->messages[slot].sequence;
+  message->value = link->messages[slot].value;
+  message->nextValue = link->messages[slot].nextValue;
+  message->ageMicros = link->messages[slot].ageMicros;
+  *edgeMicros = link->edgeMicros[slot];
+  // Release the slot only once it has been read.
+  link->tail = tail + 1;
+  return true;
+}
+
+/**
+ * @brief Send a message to every follower in turn. Each is sent as soon as the one before it, so
+ * the age of the edge grows by the time it takes to send one.
+ */
+void Link::send(State *state, LinkMessageType_t type, uint16_t value, uint16_t ageMicros) {
+  Link *link = &state->link;
+  LinkMessage message;
+  message.type = type;
+  message.sequence = link->sequence;
+  message.value = value;
+  message.nextValue = type == LINK_MESSAGE.BANK ? 0 : Link::stepAfter(state, value);
+  link->sequence += 1;
+  uint32_t age = ageMicros;
+  for (uint8_t follower = 1; follower < state->config.linkModuleCount; follower++) {
+    message.ageMicros = age > 0xFFFF ? 0xFFFF : age;
+    Wire1.beginTransmission(LINK_FOLLOWER_ADDRESS + follower - 1);
+    Wire1.write(reinterpret_cast<uint8_t *>(&message), sizeof(LinkMessage));
+    if (Wire1.endTransmission() != 0) {
+      link->missedMessages += 1;
+    }
+    age += LINK_MESSAGE_TRANSFER_MICROS;
+  }
+  link->messageCount += 1;
+}
+
+/**
+ * @brief The linked step after a step, in the direction and by the size of advancePresetAddend,
+ * wrapping around the pages of every linked module.
+ */
+uint16_t Link::stepAfter(State *state, uint16_t step) {
+  int16_t stepCount = 16 * state->config.linkModuleCount;
+  int16_t next = (static_cast<int16_t>(step) + state->advancePresetAddend) % stepCount;
+  return next < 0 ? next + stepCount : next;
+}
@@ -0,0 +1,174 @@
+/**
+ * Recollections: Link
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_LINK_H_
+#define RECOLLECTIONS_LINK_H_
+
+struct State;
+
+/**
+ * One message from the leader to its followers, sent over the bus as it is laid out here. Both of
+ * our target platforms are little-endian.
+ */
+typedef struct LinkMessage {
+  /** See LINK_MESSAGE in constants.h. */
+  LinkMessageType_t type;
+
+  /** One more than that of the message before, so that a follower can count missed messages. */
+  uint8_t sequence;
+
+  /** The linked step or the bank, and for a step, the linked step after it. */
+  uint16_t value;
+  uint16_t nextValue;
+
+  /** The microseconds from the edge at the leader to the start of sending, at most 0xFFFF. */
+  uint16_t ageMicros;
+} LinkMessage;
+
+static_assert(
+  sizeof(LinkMessage) == LINK_MESSAGE_BUS_BYTES - 1,
+  "LinkMessage must fill the bytes of a message on the bus, after the address byte"
+);
+
+/**
+ * Recollections modules linked over the follower bus into one longer sequencer: two modules make a
+ * 32-step sequencer, and four a 64-step sequencer. See Config::linkModuleCount.
+ *
+ * The leader is clocked at its ADV input and counts the linked steps. On every step it sends the
+ * step, with the time since its edge, to each follower, and on a change of bank or a RESET it sends
+ * those. Each module plays only the 16 steps of its own page of the linked sequence, and holds its
+ * last step while the other modules play theirs. The followers ignore their own ADV and RESET
+ * inputs. Removed presets are not skipped while linked.
+ *
+ * A follower receives messages in an interrupt handler, which only pushes them to a ring buffer
+ * like that of GateEvents for the loop to apply. The step of each message is dated back to the
+ * edge at the leader, so the clock and the gate lengths of the follower line up with the leader's.
+ * If the follower has already loaded the step into its DACs, as it will have from the next step in
+ * the message before, the handler also requests the latch, so the outputs change without waiting
+ * for the loop. See OutputTimer.h.
+ */
+typedef struct Link {
+  /** Messages received by a follower. Indices run freely, as in GateEvents. */
+  volatile LinkMessage messages[LINK_MESSAGE_BUFFER_SIZE];
+
+  /** micros() of the edge at the leader, on the follower's clock. Indices are as messages. */
+  volatile uint32_t edgeMicros[LINK_MESSAGE_BUFFER_SIZE];
+
+  /** The count of messages pushed, written only by the interrupt handler. */
+  volatile uint8_t head;
+
+  /** The count of messages popped, written only by the loop. */
+  volatile uint8_t tail;
+
+  /** Whether a message was dropped because the buffer was full. Cleared by the loop. */
+  volatile bool hasOverflowed;
+
+  /** The linked step, from 0 to 16 * linkModuleCount - 1. */
+  uint16_t step;
+
+  /**
+   * On a follower, the linked step the leader will advance to next, as of its last message, or
+   * 0xFFFF before the first. Read by the interrupt handler.
+   */
+  volatile uint16_t nextStep;
+
+  /** The sequence number of the next message to send, or on a follower, of the next expected. */
+  uint8_t sequence;
+
+  /** On the leader, the bank last sent, or 0xFF if none has been. */
+  uint8_t sentBank;
+
+  /** Messages sent or applied, messages missed, and the most time from an edge to applying it. */
+  uint32_t messageCount;
+  uint32_t missedMessages;
+  uint32_t maxLatencyMicros;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Advance the linked sequence on the leader's ADV input, and send the step to the
+   * followers. Does nothing on a follower, which takes its steps from the leader.
+   *
+   * @param state
+   * @param gateMicros micros() when the gate arrived.
+   */
+  static void advance(State *state, uint32_t gateMicros);
+
+  /**
+   * @brief Whether this module is linked to others.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool isLinked(State *state);
+
+  /**
+   * @brief Whether this module follows the leader of linked modules.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool isFollower(State *state);
+
+  /**
+   * @brief The preset this module will play at the next step: that of the next linked step, if it
+   * is on this module's page, or otherwise the next preset. See Advance::nextPreset().
+   *
+   * @param state
+   * @param preset Receives the preset.
+   * @return true
+   * @return false if another module plays the next linked step, or a follower does not know it yet.
+   */
+  static bool nextPreset(State *state, uint8_t *preset);
+
+  /**
+   * @brief Read a message from the follower bus and push it for the loop. Called by the interrupt
+   * handler of the follower bus in Recollections.ino. A message of any other size is dropped.
+   *
+   * @param state
+   * @param byteCount The bytes received.
+   * @param receivedMicros micros() when the message arrived.
+   */
+  static void receive(State *state, int byteCount, uint32_t receivedMicros);
+
+  /**
+   * @brief Start the linked sequence over on the leader's RESET input, and send it to the
+   * followers.
+   *
+   * @param state
+   */
+  static void reset(State *state);
+
+  /**
+   * @brief Called once per loop. A follower applies the messages received since the last loop. The
+   * leader sends its bank to the followers if it has changed.
+   *
+   * @param state
+   */
+  static void update(State *state);
+
+  private:
+  static uint8_t page(uint16_t step);
+  static void apply(State *state, LinkMessage *message, uint32_t edgeMicros);
+  static bool pop(State *state, LinkMessage *message, uint32_t *edgeMicros);
+  static void send(State *state, LinkMessageType_t type, uint16_t value, uint16_t ageMicros);
+  static uint16_t stepAfter(State *state, uint16_t step);
+} Link;
+
+static_assert(
+  (LINK_MESSAGE_BUFFER_SIZE & (LINK_MESSAGE_BUFFER_SIZE - 1)) == 0 &&
+    LINK_MESSAGE_BUFFER_SIZE <= 128,
+  "LINK_MESSAGE_BUFFER_SIZE must be a power of two, no larger than 128"
+);
+
+#endif
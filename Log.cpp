@@ -0,0 +1,63 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(
+  (LOG_BUFFER_LINES & (LOG_BUFFER_LINES - 1)) == 0,
+  "LOG_BUFFER_LINES must be a power of two"
+);
+
+/** The held messages. Like GateEvents, the indices run freely and are masked when used. */
+static char lines[LOG_BUFFER_LINES][LOG_LINE_LENGTH];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+
+/** Messages that arrived while the buffer was full. */
+static uint32_t droppedLines = 0;
+
+/** Whether messages are held until the next drain. See Log::hold(). */
+static bool isHolding = false;
+
+void Log::drain() {
+  while (tail != head) {
+    char *line = lines[tail & (LOG_BUFFER_LINES - 1)];
+    if (Serial.availableForWrite() < static_cast<int>(strlen(line) + 2)) {
+      return;
+    }
+    Serial.println(line);
+    tail++;
+  }
+  if (droppedLines > 0 && Serial.availableForWrite() >= LOG_LINE_LENGTH) {
+    Serial.printf("%lu log messages were dropped\n", static_cast<unsigned long>(droppedLines));
+    droppedLines = 0;
+  }
+}
+
+void Log::hold() {
+  isHolding = LOG_BUFFERED;
+}
+
+void Log::write(const char *format, ...) {
+  if (isHolding && head - tail == LOG_BUFFER_LINES) {
+    droppedLines++;
+    return;
+  }
+  char line[LOG_LINE_LENGTH];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, LOG_LINE_LENGTH, format, args);
+  va_end(args);
+
+  if (!isHolding) {
+    Serial.println(line);
+    return;
+  }
+  memcpy(lines[head & (LOG_BUFFER_LINES - 1)], line, LOG_LINE_LENGTH);
+  head++;
+}
@@ -0,0 +1,65 @@
+/**
+ * Recollections: Log
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+
+#ifndef RECOLLECTIONS_LOG_H_
+#define RECOLLECTIONS_LOG_H_
+
+/**
+ * Log a message at a level from LOG_LEVEL in constants.h. A message above LOG_LEVEL is compiled
+ * out, along with its arguments, so that a message in a time critical path costs nothing unless it
+ * has been asked for. Each message is a printf() format and its arguments, without a newline.
+ */
+#define LOG_AT(level, ...)                                                                         \
+  do {                                                                                             \
+    if (LOG_LEVEL >= (level)) {                                                                    \
+      Log::write(__VA_ARGS__);                                                                     \
+    }                                                                                              \
+  } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * Messages over Serial. Printing over Serial takes a while, and blocks once its buffer is full, so
+ * with LOG_BUFFERED the messages of the loop are held in a ring buffer and printed by drain() at
+ * the start of the next loop, as far as Serial can take them without blocking. Messages are
+ * printed where they occur until hold() is called at the end of setup(), which is not time
+ * critical and logs more than the buffer holds.
+ *
+ * The log belongs to the loop: to setup() and loop() and everything they call. It is not for the
+ * interrupt handlers or the second core of the RP2040, which report to the loop instead. Unlike
+ * most modules, it keeps its buffer to itself rather than in State, as it is used by functions that
+ * are not given the state.
+ */
+typedef struct Log {
+  // ---- static methods ----
+
+  /**
+   * @brief Print the messages held since the last drain, oldest first, until Serial would block.
+   */
+  static void drain();
+
+  /**
+   * @brief From now on, hold messages until the next drain, if LOG_BUFFERED.
+   */
+  static void hold();
+
+  /**
+   * @brief Print a message, or hold it until the next drain with LOG_BUFFERED. Call this through
+   * the LOG_ macros above rather than directly.
+   *
+   * @param format A printf() format, without a newline.
+   */
+  static void write(const char *format, ...) __attribute__((format(printf, 1, 2)));
+} Log;
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "LoopProfiler.h"
+
+#include "Log.h"
+
+static_assert(
+  PROFILE_BUCKETS == 4 * 31,
+  "PROFILE_BUCKETS must hold four buckets for each power of two of a 32-bit count"
+);
+
+/** Indices are [LoopPhase_t]. */
+static const char *const PHASE_NAMES[LOOP_PHASE_COUNT] = {
+  "flashTiming",
+  "trellisRead",
+  "handleInput",
+  "record",
+  "reflectState",
+  "save",
+  "loop",
+};
+
+void LoopProfiler::begin(LoopProfiler *profiler) {
+  #ifdef CORE_TEENSY
+    // Already running on Teensy 4.x, but not on Teensy 3.x.
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  #endif
+  LoopProfiler::reset(profiler);
+}
+
+uint32_t LoopProfiler::percentile(PhaseProfile *profile, uint8_t percent) {
+  if (profile->count == 0) {
+    return 0;
+  }
+  uint64_t target = (static_cast<uint64_t>(profile->count) * percent + 99) / 100;
+  if (target == 0) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (uint8_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+    seen += profile->buckets[bucket];
+    if (seen >= target) {
+      uint32_t upperBound = LoopProfiler::bucketUpperBound(bucket);
+      return upperBound < profile->maxCycles ? upperBound : profile->maxCycles;
+    }
+  }
+  return profile->maxCycles;
+}
+
+void LoopProfiler::record(PhaseProfile *profile, uint32_t cycles) {
+  profile->buckets[LoopProfiler::bucket(cycles)] += 1;
+  if (profile->count == 0 || cycles < profile->minCycles) {
+    profile->minCycles = cycles;
+  }
+  if (cycles > profile->maxCycles) {
+    profile->maxCycles = cycles;
+  }
+  profile->count += 1;
+}
+
+void LoopProfiler::reportOnRequest(LoopProfiler *profiler) {
+  if (!PROFILE_LOOP || Serial.available() <= 0) {
+    return;
+  }
+  bool isRequested = false;
+  while (Serial.available() > 0) {
+    isRequested = Serial.read() == PROFILE_REPORT_COMMAND || isRequested;
+  }
+  if (!isRequested) {
+    return;
+  }
+
+  double const perMicrosecond = LoopProfiler::cyclesPerMicrosecond();
+  LOG_INFO(
+    "loop profile over %lu loops, in us",
+    static_cast<unsigned long>(profiler->phases[LOOP_PHASE.LOOP].count)
+  );
+  LOG_INFO("%-12s %9s %9s %9s %9s %9s", "phase", "min", "p50", "p90", "p99", "max");
+  for (LoopPhase_t phase = 0; phase < LOOP_PHASE_COUNT; phase++) {
+    PhaseProfile *profile = &profiler->phases[phase];
+    LOG_INFO(
+      "%-12s %9.1f %9.1f %9.1f %9.1f %9.1f",
+      PHASE_NAMES[phase],
+      profile->minCycles / perMicrosecond,
+      LoopProfiler::percentile(profile, 50) / perMicrosecond,
+      LoopProfiler::percentile(profile, 90) / perMicrosecond,
+      LoopProfiler::percentile(profile, 99) / perMicrosecond,
+      profile->maxCycles / perMicrosecond
+    );
+  }
+  LoopProfiler::reset(profiler);
+}
+
+void LoopProfiler::reset(LoopProfiler *profiler) {
+  memset(profiler->phases, 0, sizeof(profiler->phases));
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+/**
+ * @brief Counts below 4 have a bucket each. Above that, each power of two 2^e is split into four
+ * buckets by the two bits below its highest bit.
+ */
+uint8_t LoopProfiler::bucket(uint32_t cycles) {
+  if (cycles < 4) {
+    return cycles;
+  }
+  uint8_t exponent = 31 - __builtin_clz(cycles);
+  return 4 * (exponent - 1) + ((cycles >> (exponent - 2)) & 3);
+}
+
+uint32_t LoopProfiler::bucketUpperBound(uint8_t bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  uint8_t exponent = bucket / 4 + 1;
+  uint32_t lowerBound = static_cast<uint32_t>(4 + bucket % 4) << (exponent - 2);
+  return lowerBound + ((static_cast<uint32_t>(1) << (exponent - 2)) - 1);
+}
+
+uint32_t LoopProfiler::cyclesPerMicrosecond() {
+  #if defined(__IMXRT1062__)
+    return F_CPU_ACTUAL / 1000000;
+  #elif defined(CORE_TEENSY)
+    return F_CPU / 1000000;
+  #else
+    return rp2040.f_cpu() / 1000000;
+  #endif
+}
@@ -0,0 +1,148 @@
+/**
+ * Recollections: LoopProfiler
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_LOOP_PROFILER_H_
+#define RECOLLECTIONS_LOOP_PROFILER_H_
+
+/**
+ * A histogram of the cycles taken by one phase of the loop. Buckets are log-linear: four per power
+ * of two, so a percentile read from them is within 25% of the true value, while min and max are
+ * exact.
+ */
+typedef struct PhaseProfile {
+  uint32_t buckets[PROFILE_BUCKETS];
+  uint32_t count;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+} PhaseProfile;
+
+/**
+ * The time taken by each phase of loop(), counted in CPU cycles, so that a change in the latency of
+ * the loop can be measured rather than guessed at. A no-op unless PROFILE_LOOP is true.
+ *
+ * The cycles come from the DWT cycle counter on Teensy and from the SysTick based cycle count of
+ * the RP2040 core. On the host, a cycle is a nanosecond of host time. A report of every phase is
+ * logged when PROFILE_REPORT_COMMAND arrives over Serial, after which the histograms start over.
+ *
+ * The methods called around each phase are defined here in the header rather than in a .cpp file
+ * so that the compiler can inline them, and drop them entirely when PROFILE_LOOP is false.
+ */
+typedef struct LoopProfiler {
+  /** Indices are [LoopPhase_t]. */
+  PhaseProfile phases[LOOP_PHASE_COUNT];
+
+  /** The cycle count at the start of the loop, and at the end of the last phase. */
+  uint32_t loopStartCycles;
+  uint32_t phaseStartCycles;
+
+  // ---- static methods ----
+
+  /**
+   * @brief The current value of the cycle counter, which wraps.
+   *
+   * @return uint32_t
+   */
+  static uint32_t cycles() {
+    #ifdef CORE_TEENSY
+      return ARM_DWT_CYCCNT;
+    #else
+      return rp2040.getCycleCount();
+    #endif
+  }
+
+  /**
+   * @brief Mark the start of the loop and of its first phase.
+   *
+   * @param profiler
+   */
+  static void startLoop(LoopProfiler *profiler) {
+    if (!PROFILE_LOOP) {
+      return;
+    }
+    profiler->loopStartCycles = LoopProfiler::cycles();
+    profiler->phaseStartCycles = profiler->loopStartCycles;
+  }
+
+  /**
+   * @brief Record the cycles since the end of the previous phase as those of this phase.
+   *
+   * @param profiler
+   * @param phase See LOOP_PHASE in constants.h.
+   */
+  static void endPhase(LoopProfiler *profiler, LoopPhase_t phase) {
+    if (!PROFILE_LOOP) {
+      return;
+    }
+    uint32_t now = LoopProfiler::cycles();
+    LoopProfiler::record(&profiler->phases[phase], now - profiler->phaseStartCycles);
+    profiler->phaseStartCycles = now;
+  }
+
+  /**
+   * @brief Record the cycles since startLoop() as those of the whole loop.
+   *
+   * @param profiler
+   */
+  static void endLoop(LoopProfiler *profiler) {
+    if (!PROFILE_LOOP) {
+      return;
+    }
+    uint32_t now = LoopProfiler::cycles();
+    LoopProfiler::record(&profiler->phases[LOOP_PHASE.LOOP], now - profiler->loopStartCycles);
+  }
+
+  /**
+   * @brief Start the cycle counter where it does not run by default, and clear the histograms.
+   *
+   * @param profiler
+   */
+  static void begin(LoopProfiler *profiler);
+
+  /**
+   * @brief The cycles within which the given percentage of the recorded samples completed, to the
+   * upper edge of its bucket, but never above the slowest sample.
+   *
+   * @param profile
+   * @param percent 0-100
+   * @return uint32_t 0 if nothing has been recorded.
+   */
+  static uint32_t percentile(PhaseProfile *profile, uint8_t percent);
+
+  /**
+   * @brief Add one sample to a histogram.
+   *
+   * @param profile
+   * @param cycles
+   */
+  static void record(PhaseProfile *profile, uint32_t cycles);
+
+  /**
+   * @brief Log a report of every phase and start over, if PROFILE_REPORT_COMMAND has arrived over
+   * Serial. A no-op unless PROFILE_LOOP is true.
+   *
+   * @param profiler
+   */
+  static void reportOnRequest(LoopProfiler *profiler);
+
+  /**
+   * @brief Clear the histograms.
+   *
+   * @param profiler
+   */
+  static void reset(LoopProfiler *profiler);
+
+  private:
+  static uint8_t bucket(uint32_t cycles);
+  static uint32_t bucketUpperBound(uint8_t bucket);
+  static uint32_t cyclesPerMicrosecond();
+} LoopProfiler;
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "ModuleImage.h"
+
+#include <stddef.h>
+
+#include "State.h"
+#include "Utils.h"
+#include "constants.h"
+
+void ModuleImage::fromState(State *state, ModuleImage *image) {
+  image->magic = MODULE_IMAGE_MAGIC;
+  image->version = MODULE_IMAGE_VERSION;
+  image->size = sizeof(ModuleImage);
+  image->currentBank = state->currentBank;
+  image->currentPreset = state->currentPreset;
+  image->currentChannel = state->currentChannel;
+  image->reserved = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    image->removedPresets[i] = state->removedPresets[i] ? 1 : 0;
+    image->bankOffsets[i] = sizeof(ModuleImage) + i * sizeof(BankRecord);
+  }
+  image->crc = ModuleImage::checksum(image);
+}
+
+bool ModuleImage::toState(ModuleImage *image, State *state) {
+  if (!ModuleImage::isValid(image)) {
+    return false;
+  }
+  state->currentBank = image->currentBank;
+  state->currentPreset = image->currentPreset;
+  state->currentChannel = image->currentChannel;
+  for (uint8_t i = 0; i < 16; i++) {
+    state->removedPresets[i] = image->removedPresets[i] != 0;
+  }
+  return true;
+}
+
+bool ModuleImage::isValid(ModuleImage *image) {
+  if (
+    image->magic != MODULE_IMAGE_MAGIC ||
+    image->version != MODULE_IMAGE_VERSION ||
+    image->size != sizeof(ModuleImage) ||
+    image->crc != ModuleImage::checksum(image)
+  ) {
+    return false;
+  }
+  // These index directly into state, so they must be in range even when the CRC matches.
+  if (image->currentBank > 15 || image->currentPreset > 15 || image->currentChannel > 7) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 16; i++) {
+    if (image->bankOffsets[i] < sizeof(ModuleImage)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t ModuleImage::checksum(ModuleImage *image) {
+  return Utils::crc32(reinterpret_cast<uint8_t *>(image), offsetof(ModuleImage, crc));
+}
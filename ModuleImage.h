@@ -0,0 +1,90 @@
+/**
+ * Recollections: Module Image
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "BankRecord.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_MODULE_IMAGE_H_
+#define RECOLLECTIONS_MODULE_IMAGE_H_
+
+/**
+ * The header of a Module.bin file, which holds an entire module in one file on the SD card:
+ *
+ *   [ModuleImage header][BankRecord 0][BankRecord 1] ... [BankRecord 15]
+ *
+ * The header holds the data otherwise found in Module.txt, plus a table of the byte offsets of the
+ * 16 bank records. Each bank record carries its own CRC, so a damaged record costs only that one
+ * bank. Every save writes a whole new image to Module.tmp, which then replaces Module.bin. See
+ * SDCard::continueSave(). The layout must not change without incrementing MODULE_IMAGE_VERSION.
+ * See constants.h.
+ */
+typedef struct ModuleImage {
+  /** Always MODULE_IMAGE_MAGIC. Used to reject files that are not module images. */
+  uint32_t magic;
+
+  /** The version of this layout, MODULE_IMAGE_VERSION at the time of writing. */
+  uint16_t version;
+
+  /** The size of the header in bytes at the time of writing. */
+  uint16_t size;
+
+  uint8_t currentBank;
+  uint8_t currentPreset;
+  uint8_t currentChannel;
+  uint8_t reserved;
+
+  /** Zero or one per preset. Stored as bytes rather than bool to keep the layout explicit. */
+  uint8_t removedPresets[16];
+
+  /** Byte offset of each bank's BankRecord from the start of the file. Indices are [bank]. */
+  uint32_t bankOffsets[16];
+
+  /** CRC-32 of every preceding byte in the header. */
+  uint32_t crc;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Copy the module-level values out of state into a header, including the offset table and
+   * CRC. Bank records are laid out contiguously, immediately after the header.
+   *
+   * @param state
+   * @param image
+   */
+  static void fromState(State *state, ModuleImage *image);
+
+  /**
+   * @brief Copy the module-level values of a header into state. The header is validated first, and
+   * state is left untouched if the header is not valid.
+   *
+   * @param image
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool toState(ModuleImage *image, State *state);
+
+  /**
+   * @brief Check the magic number, version, size, offset table and CRC of a header.
+   *
+   * @param image
+   * @return true
+   * @return false
+   */
+  static bool isValid(ModuleImage *image);
+
+  /**
+   * @brief Calculate the CRC of a header, covering every byte prior to the crc member.
+   *
+   * @param image
+   * @return uint32_t
+   */
+  static uint32_t checksum(ModuleImage *image);
+} ModuleImage;
+
+static_assert(sizeof(ModuleImage) == 96, "ModuleImage layout changed; increment the version");
+
+#endif
@@ -11,8 +11,8 @@
 #define RECOLLECTIONS_NAV_H_
 
 typedef struct Nav {
-  static State goBack(State state);
-  static State goForward(State state, Screen_t screen);
+  static void goBack(State *state);
+  static void goForward(State *state, Screen_t screen);
 } Nav;
 
 #endif
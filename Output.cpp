@@ -0,0 +1,238 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Output.h"
+
+#include "Link.h"
+#include "Log.h"
+#include "OutputTimer.h"
+#include "Playheads.h"
+#include "State.h"
+#include "Utils.h"
+#include "constants.h"
+
+bool Output::setOutputsAll(State *state) {
+  Output *output = &state->output;
+  output->loops += 1;
+
+  // In hardware before version 0.4.0, the USB is only accessible by removing dac1. Thus, we will
+  // not send voltage to the outputs while doing development or debugging on these hardware versions.
+  if (USB_POWERED && (HARDWARE_SEMVER.compare("0.4.0") < 0)) {
+    return true;
+  }
+
+  OutputFrame frame;
+  frame.gateMicros = state->clock.lastGateMicros;
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    frame.values[channel] = Utils::voltageValue(state, Playheads::step(state, channel), channel);
+    if (frame.values[channel] > MAX_UNSIGNED_12_BIT) {
+      LOG_ERROR("invalid 12-bit voltage value %u", frame.values[channel]);
+      return false;
+    }
+  }
+  Output::setGateEnd(state, &frame);
+  Output::setNextValues(state, &frame);
+  return OutputTimer::write(state, &frame);
+}
+
+bool Output::isPreloaded(State *state, uint16_t values[]) {
+  Output *output = &state->output;
+  if (!output->isCacheValid) {
+    return false;
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    if (values[channel] != output->inputValues[channel]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Output::isWritten(State *state, uint16_t values[]) {
+  Output *output = &state->output;
+  if (!output->isCacheValid) {
+    return false;
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    if (values[channel] != output->values[channel]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Output::latch(State *state) {
+  Output *output = &state->output;
+  if (!output->isCacheValid || Output::isWritten(state, output->inputValues)) {
+    return false;
+  }
+  if (!Output::softwareUpdate(state)) {
+    output->isCacheValid = false;
+    return false;
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    output->values[channel] = output->inputValues[channel];
+  }
+  return true;
+}
+
+bool Output::preloadValues(State *state, uint16_t values[]) {
+  Output *output = &state->output;
+  if (!output->isCacheValid) {
+    return true;
+  }
+  // A multi-write per channel, as the library has no write of several channels that leaves the
+  // outputs alone. Most steps change only a few channels.
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    if (values[channel] == output->inputValues[channel]) {
+      continue;
+    }
+    Adafruit_MCP4728 *dac = channel < 4 ? &state->config.dac1 : &state->config.dac2;
+    unsigned long startTime = micros();
+    bool writeSuccess = dac->setChannelValue(
+      DAC_CHANNELS[channel % 4],
+      values[channel],
+      MCP4728_VREF_VDD,
+      MCP4728_GAIN_1X,
+      MCP4728_PD_MODE_NORMAL,
+      true // udac: leave the output alone until the next latch
+    );
+    output->i2cMicros += micros() - startTime;
+    output->i2cBytes += DAC_MULTI_WRITE_BYTES;
+    if (!writeSuccess) {
+      output->isCacheValid = false;
+      return false;
+    }
+    output->inputValues[channel] = values[channel];
+  }
+  return true;
+}
+
+bool Output::writeValues(State *state, uint16_t values[]) {
+  Output *output = &state->output;
+  bool isChanged = !Output::isWritten(state, values) || !Output::isPreloaded(state, values);
+  if (
+    !Output::writeDac(state, &state->config.dac1, 0, values) ||
+    !Output::writeDac(state, &state->config.dac2, 4, values) ||
+    (PRELOAD_DAC_OUTPUTS && isChanged && !Output::softwareUpdate(state))
+  ) {
+    output->isCacheValid = false;
+    return false;
+  }
+  output->isCacheValid = true;
+  return true;
+}
+
+void Output::reportStats(unsigned long loopStartTime, State *state) {
+  if (!REPORT_OUTPUT_STATS) {
+    return;
+  }
+  Output *output = &state->output;
+  if (loopStartTime - output->lastReportTime < OUTPUT_STATS_INTERVAL || output->loops == 0) {
+    return;
+  }
+  LOG_INFO(
+    "outputs: %lu loops, %lu I2C bytes/loop, %lu us/loop",
+    static_cast<unsigned long>(output->loops),
+    static_cast<unsigned long>(output->i2cBytes / output->loops),
+    static_cast<unsigned long>(output->i2cMicros / output->loops)
+  );
+  output->loops = 0;
+  output->i2cBytes = 0;
+  output->i2cMicros = 0;
+  output->lastReportTime = loopStartTime;
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+void Output::setGateEnd(State *state, OutputFrame *frame) {
+  ChannelFlags_t gateChannels = state->gateChannels[state->currentBank];
+  frame->hasGateEnd = false;
+  if (!state->clock.hasGate || gateChannels == CHANNEL_FLAGS_NONE) {
+    return;
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    frame->gateEndValues[channel] = Bits::get(gateChannels, channel) ? 0 : frame->values[channel];
+    frame->hasGateEnd =
+      frame->hasGateEnd || frame->gateEndValues[channel] != frame->values[channel];
+  }
+  // The same time at which ClockTracker::isWithinGate() turns false, so the loop agrees with the
+  // timer once the gate is over.
+  frame->gateEndMicros =
+    state->clock.lastGateMicros + static_cast<uint32_t>(state->gateMillis) * 1000;
+}
+
+void Output::setNextValues(State *state, OutputFrame *frame) {
+  // As Input::handleAdvInput() will advance. A linked module may not play the next step at all.
+  uint8_t nextPreset;
+  frame->hasNextValues = PRELOAD_DAC_OUTPUTS && Link::nextPreset(state, &nextPreset);
+  if (!frame->hasNextValues) {
+    return;
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    // The gate starts with the step.
+    frame->nextValues[channel] = Utils::voltageValueAtStep(
+      state,
+      Playheads::nextStep(state, channel, nextPreset),
+      channel,
+      state->randomStep + 1,
+      true
+    );
+  }
+}
+
+bool Output::softwareUpdate(State *state) {
+  Output *output = &state->output;
+  unsigned long startTime = micros();
+  Wire.beginTransmission(I2C_GENERAL_CALL_ADDRESS);
+  Wire.write(DAC_SOFTWARE_UPDATE_COMMAND);
+  bool writeSuccess = Wire.endTransmission() == 0;
+  output->i2cMicros += micros() - startTime;
+  output->i2cBytes += DAC_GENERAL_CALL_BYTES;
+  return writeSuccess;
+}
+
+bool Output::writeDac(
+  State *state,
+  Adafruit_MCP4728 *dac,
+  uint8_t firstChannel,
+  uint16_t values[]
+) {
+  Output *output = &state->output;
+  if (output->isCacheValid) {
+    bool isChanged = false;
+    for (uint8_t channel = firstChannel; channel < firstChannel + 4; channel++) {
+      if (
+        values[channel] != output->values[channel] ||
+        values[channel] != output->inputValues[channel]
+      ) {
+        isChanged = true;
+        break;
+      }
+    }
+    if (!isChanged) {
+      return true;
+    }
+  }
+
+  unsigned long startTime = micros();
+  bool writeSuccess = dac->fastWrite(
+    values[firstChannel],
+    values[firstChannel + 1],
+    values[firstChannel + 2],
+    values[firstChannel + 3]
+  );
+  output->i2cMicros += micros() - startTime;
+  output->i2cBytes += DAC_FAST_WRITE_BYTES;
+  if (!writeSuccess) {
+    // Not logged here, as this also runs in the output timer. The loop logs the failure.
+    return false;
+  }
+
+  for (uint8_t channel = firstChannel; channel < firstChannel + 4; channel++) {
+    output->values[channel] = values[channel];
+    output->inputValues[channel] = values[channel];
+  }
+  return true;
+}
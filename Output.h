@@ -0,0 +1,177 @@
+/**
+ * Recollections: Output
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Adafruit_MCP4728.h>
+
+#include "OutputTimer.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_OUTPUT_H_
+#define RECOLLECTIONS_OUTPUT_H_
+
+struct State;
+
+/**
+ * The production of voltage on the eight outputs, through the two MCP4728 DACs on the local I2C
+ * bus. Outputs 0-3 are on dac1 and outputs 4-7 are on dac2.
+ *
+ * The last values written to each DAC are cached, and a DAC is only written when one of its four
+ * values has changed. A DAC is always written in one fast write transaction covering all four of
+ * its channels, rather than in one transaction per channel.
+ *
+ * The values are produced through OutputTimer, which also ends each gate without waiting for the
+ * next loop, and which on the RP2040 writes the DACs from the second core.
+ *
+ * When PRELOAD_DAC_OUTPUTS is true, the values of the preset that the next ADV gate will advance to
+ * are loaded into the input registers of the DACs ahead of the gate, without changing the outputs,
+ * and a single general call on the rising edge moves them to all eight outputs at once. Writing
+ * the outputs only after the loop had handled the gate left them a loop behind the clock, with the
+ * second DAC a write behind the first. Every write to the outputs is then latched by a general call
+ * as well, so that both DACs change together.
+ */
+typedef struct Output {
+  /** The last values successfully written to the DACs. Indices are [channel]. */
+  uint16_t values[8];
+
+  /**
+   * The values in the input registers of the DACs, which the outputs take when latched. These
+   * differ from values only while the next preset is loaded. Indices are [channel].
+   */
+  uint16_t inputValues[8];
+
+  /** Whether values reflects what the DACs are producing. False until the first write. */
+  bool isCacheValid;
+
+  /**
+   * Instrumentation, accumulated since the last report. See REPORT_OUTPUT_STATS. On the RP2040,
+   * the I2C figures are counted by the second core, so a report can be off by a write.
+   */
+  uint32_t loops;
+  uint32_t i2cBytes;
+  uint32_t i2cMicros;
+  unsigned long lastReportTime;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Set the output of all channels to the voltages of the current preset, writing only the
+   * DACs whose values have changed.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool setOutputsAll(State *state);
+
+  /**
+   * @brief Print the I2C bytes and microseconds spent on the outputs per loop, averaged over the
+   * last OUTPUT_STATS_INTERVAL ms. A no-op unless REPORT_OUTPUT_STATS is true.
+   *
+   * @param loopStartTime
+   * @param state
+   */
+  static void reportStats(unsigned long loopStartTime, State *state);
+
+  /**
+   * @brief Whether the values are those in the input registers of the DACs, ready to be latched.
+   *
+   * @param state
+   * @param values Indices are [channel].
+   * @return true
+   * @return false
+   */
+  static bool isPreloaded(State *state, uint16_t values[]);
+
+  /**
+   * @brief Whether the values are those last written to the DACs.
+   *
+   * @param state
+   * @param values Indices are [channel].
+   * @return true
+   * @return false
+   */
+  static bool isWritten(State *state, uint16_t values[]);
+
+  /**
+   * @brief Move the values in the input registers of both DACs to their outputs, with one general
+   * call. The caller must hold the I2C bus.
+   *
+   * @param state
+   * @return true if the outputs changed.
+   * @return false if nothing was loaded, or the general call failed.
+   */
+  static bool latch(State *state);
+
+  /**
+   * @brief Load the values into the input registers of the DACs without changing the outputs,
+   * writing only the channels whose input registers hold something else. Nothing is loaded until
+   * the outputs have been written once. The caller must hold the I2C bus.
+   *
+   * @param state
+   * @param values Indices are [channel].
+   * @return true
+   * @return false
+   */
+  static bool preloadValues(State *state, uint16_t values[]);
+
+  /**
+   * @brief Write the values to both DACs, writing only the DACs whose values have changed. The
+   * caller must hold the I2C bus. See OutputTimer.h.
+   *
+   * @param state
+   * @param values Indices are [channel].
+   * @return true
+   * @return false
+   */
+  static bool writeValues(State *state, uint16_t values[]);
+
+  private:
+  /**
+   * @brief Set the outputs of a frame as they will be once the current gate is over: the same
+   * values, but with every gate channel low.
+   *
+   * @param state
+   * @param frame A frame with its values set.
+   */
+  static void setGateEnd(State *state, OutputFrame *frame);
+
+  /**
+   * @brief Set the values of a frame for the step that the next ADV gate will advance to.
+   *
+   * @param state
+   * @param frame
+   */
+  static void setNextValues(State *state, OutputFrame *frame);
+
+  /**
+   * @brief Send the general call that moves the input registers of both DACs to their outputs.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool softwareUpdate(State *state);
+
+  /**
+   * @brief Write four consecutive channels to one DAC in a single fast write, if any of them
+   * differ from the cache, either at the outputs or in the input registers.
+   *
+   * @param state
+   * @param dac
+   * @param firstChannel 0 for dac1, 4 for dac2.
+   * @param values The values for all eight channels. Indices are [channel].
+   * @return true
+   * @return false
+   */
+  static bool writeDac(
+    State *state,
+    Adafruit_MCP4728 *dac,
+    uint8_t firstChannel,
+    uint16_t values[]
+  );
+} Output;
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "OutputTimer.h"
+
+#include "Output.h"
+#include "State.h"
+
+#ifdef CORE_TEENSY
+
+bool OutputTimer::write(State *state, OutputFrame *frame) {
+  OutputTimer *timer = &state->outputTimer;
+  OutputTimer::claimBus(state);
+  timer->frameCount += 1;
+  if (OutputTimer::isHoldingLatch(state, timer->frameCount, frame->gateMicros)) {
+    OutputTimer::releaseBus(state);
+    return true;
+  }
+  bool writeSuccess = Output::writeValues(state, frame->values);
+  timer->isPending = writeSuccess && frame->hasGateEnd;
+  if (timer->isPending) {
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      timer->values[channel] = frame->gateEndValues[channel];
+    }
+    timer->dueMicros = frame->gateEndMicros;
+  }
+  timer->hasNextValues = frame->hasNextValues;
+  if (timer->hasNextValues) {
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      timer->nextValues[channel] = frame->nextValues[channel];
+    }
+  }
+  // Otherwise the next step is loaded once the gate is over, so that ending it does not overwrite
+  // the next step.
+  if (writeSuccess && timer->hasNextValues && !timer->isPending) {
+    writeSuccess = Output::preloadValues(state, timer->nextValues);
+  }
+  OutputTimer::releaseBus(state);
+  return writeSuccess;
+}
+
+void OutputTimer::claimBus(State *state) {
+  // The interrupt handlers only hold the bus until they return, so it is always free here.
+  noInterrupts();
+  state->outputTimer.isBusClaimed = true;
+  interrupts();
+}
+
+void OutputTimer::latch(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  if (!timer->isLatchRequested || !OutputTimer::tryClaimBus(state)) {
+    return;
+  }
+  OutputTimer::latchNow(state);
+  timer->isBusClaimed = false;
+}
+
+void OutputTimer::releaseBus(State *state) {
+  // A latch or a write that fell due while the bus was claimed is made now, before the timer can
+  // get to it.
+  if (state->outputTimer.isLatchRequested) {
+    OutputTimer::latchNow(state);
+  }
+  OutputTimer::writeIfDue(state, micros());
+  state->outputTimer.isBusClaimed = false;
+}
+
+void OutputTimer::requestLatch(State *state, uint32_t edgeMicros) {
+  state->outputTimer.requestMicros = edgeMicros;
+  state->outputTimer.isLatchRequested = true;
+  OutputTimer::latch(state);
+}
+
+void OutputTimer::tick(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  OutputTimer::latch(state);
+  if (!timer->isPending || !OutputTimer::tryClaimBus(state)) {
+    return;
+  }
+  OutputTimer::writeIfDue(state, micros());
+  timer->isBusClaimed = false;
+}
+
+#else
+
+bool OutputTimer::write(State *state, OutputFrame *frame) {
+  OutputTimer *timer = &state->outputTimer;
+  uint32_t frameCount = timer->frameCount + 1;
+  timer->frames[frameCount & 1] = *frame;
+  // The frame must be complete before it is counted.
+  __sync_synchronize();
+  timer->frameCount = frameCount;
+
+  if (timer->hasWriteFailed) {
+    timer->hasWriteFailed = false;
+    return false;
+  }
+  return true;
+}
+
+void OutputTimer::claimBus(State *state) {
+  mutex_enter_blocking(&state->outputTimer.bus);
+}
+
+void OutputTimer::latch(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  if (!timer->isLatchRequested || !mutex_try_enter(&timer->bus, NULL)) {
+    return;
+  }
+  OutputTimer::latchNow(state);
+  mutex_exit(&timer->bus);
+}
+
+void OutputTimer::releaseBus(State *state) {
+  mutex_exit(&state->outputTimer.bus);
+}
+
+void OutputTimer::tick(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  if (timer->frameCount == 0) {
+    return;
+  }
+  OutputFrame frame;
+  uint32_t frameCount = OutputTimer::readFrame(state, &frame);
+  if (OutputTimer::isHoldingLatch(state, frameCount, frame.gateMicros)) {
+    return;
+  }
+
+  // Once the gate is over, the gate end values replace the values, even those of a frame that was
+  // published just before the gate ended, so that no gate is written high again after it ends.
+  bool isGateOver =
+    frame.hasGateEnd && static_cast<int32_t>(micros() - frame.gateEndMicros) >= 0;
+  uint16_t *values = isGateOver ? frame.gateEndValues : frame.values;
+  bool isWriteDue = !Output::isWritten(state, values);
+  // The next step is loaded once the gate is over, so that ending it does not overwrite the next
+  // step.
+  bool isPreloadDue =
+    frame.hasNextValues &&
+    (!frame.hasGateEnd || isGateOver) &&
+    !Output::isPreloaded(state, frame.nextValues);
+  if ((!isWriteDue && !isPreloadDue) || !mutex_try_enter(&timer->bus, NULL)) {
+    return;
+  }
+  bool writeSuccess =
+    (!isWriteDue || Output::writeValues(state, values)) &&
+    (!isPreloadDue || Output::preloadValues(state, frame.nextValues));
+  if (!writeSuccess) {
+    timer->hasWriteFailed = true;
+  }
+  mutex_exit(&timer->bus);
+}
+
+void OutputTimer::requestLatch(State *state, uint32_t edgeMicros) {
+  // The interrupt handler runs on the second core, which latches on its next pass.
+  state->outputTimer.requestMicros = edgeMicros;
+  state->outputTimer.isLatchRequested = true;
+}
+
+#endif
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+/**
+ * @brief Whether a frame was computed before the loop handled the edge that was latched. Only the
+ * frame of the loop in progress at the latch can have been, and that of the loop after it, so the
+ * hold also ends after two frames, in case the loop did not take the edge as a gate. Ends the hold
+ * at the first frame that is not held.
+ */
+bool OutputTimer::isHoldingLatch(State *state, uint32_t frameCount, uint32_t gateMicros) {
+  OutputTimer *timer = &state->outputTimer;
+  if (
+    timer->isLatchHeld &&
+    static_cast<int32_t>(gateMicros - timer->latchMicros) < 0 &&
+    frameCount - timer->latchFrameCount < 2
+  ) {
+    return true;
+  }
+  timer->isLatchHeld = false;
+  return false;
+}
+
+/**
+ * @brief Latch the values loaded into the DACs. The caller must hold the bus.
+ */
+void OutputTimer::latchNow(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  timer->isLatchRequested = false;
+  if (!Output::latch(state)) {
+    return;
+  }
+  timer->isLatchHeld = true;
+  timer->latchFrameCount = timer->frameCount;
+  timer->latchMicros = timer->requestMicros;
+  #ifdef CORE_TEENSY
+    // The end of the gate before would write the step before.
+    timer->isPending = false;
+  #endif
+}
+
+#ifdef CORE_TEENSY
+
+/**
+ * @brief Claim the I2C bus from an interrupt handler, unless the loop or another handler already
+ * holds it. The check and the claim are made with interrupts masked, so that no other handler can
+ * claim the bus in between.
+ */
+bool OutputTimer::tryClaimBus(State *state) {
+  OutputTimer *timer = &state->outputTimer;
+  noInterrupts();
+  bool isFree = !timer->isBusClaimed;
+  if (isFree) {
+    timer->isBusClaimed = true;
+  }
+  interrupts();
+  return isFree;
+}
+
+void OutputTimer::writeIfDue(State *state, uint32_t nowMicros) {
+  OutputTimer *timer = &state->outputTimer;
+  if (!timer->isPending || static_cast<int32_t>(nowMicros - timer->dueMicros) < 0) {
+    return;
+  }
+  timer->isPending = false;
+  if (Output::writeValues(state, timer->values) && timer->hasNextValues) {
+    Output::preloadValues(state, timer->nextValues);
+  }
+}
+
+#else
+
+uint32_t OutputTimer::readFrame(State *state, OutputFrame *frame) {
+  OutputTimer *timer = &state->outputTimer;
+  uint32_t frameCount;
+  do {
+    frameCount = timer->frameCount;
+    __sync_synchronize();
+    *frame = timer->frames[frameCount & 1];
+    __sync_synchronize();
+  } while (timer->frameCount != frameCount);
+  return frameCount;
+}
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * Recollections: OutputTimer
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#ifndef CORE_TEENSY
+  #include <pico/mutex.h>
+#endif
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_OUTPUT_TIMER_H_
+#define RECOLLECTIONS_OUTPUT_TIMER_H_
+
+struct State;
+
+/**
+ * The outputs for the current step: the values to produce now, and the values to produce once the
+ * current gate is over, which are the same values with every gate channel low. Also the values of
+ * the next step, to be loaded into the DACs ahead of it.
+ */
+typedef struct OutputFrame {
+  /** Indices are [channel]. */
+  uint16_t values[8];
+
+  /** Indices are [channel]. Only meaningful when hasGateEnd is true. */
+  uint16_t gateEndValues[8];
+
+  /** micros() at which the gate is over. */
+  uint32_t gateEndMicros;
+
+  /** Whether any output changes when the gate is over. */
+  bool hasGateEnd;
+
+  /** micros() of the last ADV gate handled by the loop. */
+  uint32_t gateMicros;
+
+  /**
+   * The values of the step that the next ADV gate will advance to. Indices are [channel]. Only
+   * meaningful when hasNextValues is true.
+   */
+  uint16_t nextValues[8];
+
+  /** Whether the next values are to be loaded into the DACs. See PRELOAD_DAC_OUTPUTS. */
+  bool hasNextValues;
+} OutputFrame;
+
+/**
+ * Writes the outputs at the time they are due, rather than on whichever loop happens to run next.
+ * Gate lengths were otherwise as coarse as the loop, and a loop that ran long, such as one that
+ * wrote to the SD card, held gates high until it finished.
+ *
+ * On Teensy, the loop writes the values for the current step itself, and a hardware timer, which
+ * checks every OUTPUT_TIMER_PERIOD_MICROS, writes the end of the gate.
+ *
+ * On the RP2040, the second core owns the DACs. The loop publishes each frame, and the second core
+ * writes the frame's values, or its gate end values once they are due, every
+ * OUTPUT_TIMER_PERIOD_MICROS. Frames are double buffered: the loop writes the buffer the second
+ * core is not reading and then publishes it by counting it, and the second core reads again if the
+ * count changed while it was reading.
+ *
+ * The DACs share the I2C bus with the NeoTrellis, and a transaction cannot be interrupted by
+ * another. The loop claims the bus for each of its own transactions, and the writes of the timer
+ * or the second core wait for the bus to be free. On Teensy, the interrupt handlers of the timer
+ * and the ADV input claim the bus too, checking and setting the claim with interrupts masked, so
+ * that no two of them can take it at once. A handler that finds the bus claimed leaves its write
+ * to releaseBus(), if the loop holds the bus, or else to the next tick of the timer.
+ *
+ * The next step is loaded into the DACs once the values of the current step are final, after its
+ * gate is over, and the rising edge at the ADV input latches it: at once on Teensy, unless the
+ * loop holds the bus, and on the next pass of the second core on the RP2040. See Output.h. Until
+ * the loop has handled the edge, the frames it publishes still hold the step before, so these are
+ * not written.
+ */
+typedef struct OutputTimer {
+  /** Whether a rising edge at the ADV input is waiting for the latch, and micros() of the edge. */
+  volatile bool isLatchRequested;
+  volatile uint32_t requestMicros;
+
+  /**
+   * Whether frames are held back after a latch, with the count of frames and micros() of the edge
+   * at the latch.
+   */
+  bool isLatchHeld;
+  uint32_t latchFrameCount;
+  uint32_t latchMicros;
+
+  #ifdef CORE_TEENSY
+    /** The count of frames written by the loop. */
+    uint32_t frameCount;
+
+    /** The values to write when dueMicros arrives. Written only while the bus is claimed. */
+    uint16_t values[8];
+
+    /** The values to load into the DACs once the gate is over. */
+    uint16_t nextValues[8];
+    bool hasNextValues;
+
+    /** micros() at which values are due. */
+    volatile uint32_t dueMicros;
+
+    /** Whether values are waiting to be written. */
+    volatile bool isPending;
+
+    /** Whether the loop or an interrupt handler is using the I2C bus. */
+    volatile bool isBusClaimed;
+  #else
+    /** The last two frames published by the loop. */
+    OutputFrame frames[2];
+
+    /** The count of frames published. The latest is frames[frameCount & 1]. */
+    volatile uint32_t frameCount;
+
+    /** Whether the second core has failed to write the DACs. Cleared by the loop. */
+    volatile bool hasWriteFailed;
+
+    /** Held by whichever core is using the I2C bus. */
+    mutex_t bus;
+  #endif
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Produce a frame on the outputs: write its values now, and its gate end values when due.
+   * Called by the loop.
+   *
+   * @param state
+   * @param frame
+   * @return true
+   * @return false
+   */
+  static bool write(State *state, OutputFrame *frame);
+
+  /**
+   * @brief Claim the I2C bus for a transaction by the loop, keeping the timer or the second core
+   * off of it.
+   *
+   * @param state
+   */
+  static void claimBus(State *state);
+
+  /**
+   * @brief Latch the values loaded into the DACs onto the outputs, if a rising edge at the ADV
+   * input asked for it and the bus is free. Called on every pass of the second core on the
+   * RP2040, and by requestLatch() and the timer on Teensy.
+   *
+   * @param state
+   */
+  static void latch(State *state);
+
+  /**
+   * @brief Release the I2C bus.
+   *
+   * @param state
+   */
+  static void releaseBus(State *state);
+
+  /**
+   * @brief Ask for the latch of the values loaded into the DACs. Called by the interrupt handler
+   * of the ADV input on a rising edge.
+   *
+   * @param state
+   * @param edgeMicros micros() when the edge arrived.
+   */
+  static void requestLatch(State *state, uint32_t edgeMicros);
+
+  /**
+   * @brief Write whatever is due on the outputs, if the bus is free. Called every
+   * OUTPUT_TIMER_PERIOD_MICROS, by the timer's interrupt handler on Teensy and by the second core
+   * on the RP2040.
+   *
+   * @param state
+   */
+  static void tick(State *state);
+
+  private:
+  static bool isHoldingLatch(State *state, uint32_t frameCount, uint32_t gateMicros);
+  static void latchNow(State *state);
+  #ifdef CORE_TEENSY
+    static bool tryClaimBus(State *state);
+    static void writeIfDue(State *state, uint32_t nowMicros);
+  #else
+    static uint32_t readFrame(State *state, OutputFrame *frame);
+  #endif
+} OutputTimer;
+
+#endif
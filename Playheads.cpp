@@ -0,0 +1,102 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Playheads.h"
+
+#include "State.h"
+
+void Playheads::advance(State *state) {
+  Playheads *playheads = &state->playheads;
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    if (Playheads::hasSequence(state, channel)) {
+      playheads->steps[channel] = Playheads::table(state, channel)[playheads->steps[channel]];
+    }
+  }
+}
+
+bool Playheads::hasSequence(State *state, uint8_t channel) {
+  return state->channelLengths[state->currentBank][channel] > 0;
+}
+
+void Playheads::markStale(State *state) {
+  state->playheads.isStale = true;
+}
+
+void Playheads::moveTo(State *state, uint8_t preset) {
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    state->playheads.steps[channel] = preset;
+  }
+}
+
+uint8_t Playheads::nextStep(State *state, uint8_t channel, uint8_t nextPreset) {
+  if (!Playheads::hasSequence(state, channel)) {
+    return nextPreset;
+  }
+  return Playheads::table(state, channel)[state->playheads.steps[channel]];
+}
+
+uint8_t Playheads::step(State *state, uint8_t channel) {
+  if (!Playheads::hasSequence(state, channel)) {
+    return state->currentPreset;
+  }
+  // A step beyond the end of the sequence, after moveTo() or a change of bank, wraps around it.
+  uint8_t length = state->channelLengths[state->currentBank][channel];
+  uint8_t step = state->playheads.steps[channel];
+  return length < 16 ? step % length : step;
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+void Playheads::rebuild(State *state) {
+  Playheads *playheads = &state->playheads;
+  uint8_t bank = state->currentBank;
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    int8_t addend = state->channelAddends[bank][channel];
+    for (uint8_t step = 0; step < 16; step++) {
+      playheads->forwardSteps[channel][step] = Playheads::stepAfter(state, channel, step, addend);
+      playheads->reverseSteps[channel][step] = Playheads::stepAfter(state, channel, step, -addend);
+    }
+  }
+  playheads->tableBank = bank;
+  playheads->isStale = false;
+}
+
+/**
+ * @brief The step after a step, skipping the removed steps. The walk is bounded by the length of
+ * the sequence, so a sequence whose every reachable step is removed stays where it is rather than
+ * looping forever. An addend of 0 is taken as 1.
+ */
+uint8_t Playheads::stepAfter(State *state, uint8_t channel, uint8_t step, int8_t addend) {
+  uint8_t bank = state->currentBank;
+  uint8_t length = state->channelLengths[bank][channel];
+  if (length == 0 || length > 16) {
+    length = 16;
+  }
+  // The addend as a distance forward within the sequence, so that the walk never goes below 0.
+  int16_t distance = (addend == 0 ? 1 : addend) % length;
+  if (distance < 0) {
+    distance += length;
+  }
+  uint8_t next = step % length;
+  for (uint8_t i = 0; i < length; i++) {
+    next = (next + distance) % length;
+    if (!((state->removedSteps[bank][channel] >> next) & 1)) {
+      return next;
+    }
+  }
+  return step % length;
+}
+
+/**
+ * @brief The table of the direction the sequence is going, rebuilt first if it is out of date.
+ */
+uint8_t *Playheads::table(State *state, uint8_t channel) {
+  Playheads *playheads = &state->playheads;
+  if (playheads->isStale || playheads->tableBank != state->currentBank) {
+    Playheads::rebuild(state);
+  }
+  return state->advancePresetAddend < 0
+    ? playheads->reverseSteps[channel]
+    : playheads->forwardSteps[channel];
+}
@@ -0,0 +1,104 @@
+/**
+ * Recollections: Playheads
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_PLAYHEADS_H_
+#define RECOLLECTIONS_PLAYHEADS_H_
+
+struct State;
+
+/**
+ * The step of each channel that has a sequence of its own, so that the channels can play
+ * polychronic sequences: 16 steps on one channel, 8 on another and 5 on a third, all advanced by
+ * the same clock. The sequence of a channel is set per bank by State::channelLengths,
+ * State::channelAddends and State::removedSteps. A channel with a length of 0, the default, has no
+ * sequence of its own and plays the current preset.
+ *
+ * The step that follows each step of a channel, in either direction, is kept in a table rather
+ * than found by walking past the removed steps, so advancing all eight playheads costs eight
+ * lookups. The tables cover the current bank, and are rebuilt on the next lookup after the bank
+ * changes or after a sequence changes, which marks them stale.
+ */
+typedef struct Playheads {
+  /** The step of each channel with a sequence of its own. Indices are [channel]. */
+  uint8_t steps[8];
+
+  /** The step after each step, going forward and in reverse. Indices are [channel][step]. */
+  uint8_t forwardSteps[8][16];
+  uint8_t reverseSteps[8][16];
+
+  /** The bank the tables were built for. */
+  uint8_t tableBank;
+
+  /** Whether the tables are out of date, even for the same bank. */
+  bool isStale;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Advance each channel with a sequence of its own by its addend, in the direction of
+   * State::advancePresetAddend. Called whenever the current preset advances.
+   *
+   * @param state
+   */
+  static void advance(State *state);
+
+  /**
+   * @brief Whether a channel has a sequence of its own in the current bank.
+   *
+   * @param state
+   * @param channel
+   * @return true
+   * @return false
+   */
+  static bool hasSequence(State *state, uint8_t channel);
+
+  /**
+   * @brief Flag the tables as out of date, after a change to the sequences of any bank.
+   *
+   * @param state
+   */
+  static void markStale(State *state);
+
+  /**
+   * @brief Move each channel with a sequence of its own to a step, as when a preset is selected or
+   * at RESET. A channel whose sequence is shorter wraps around it.
+   *
+   * @param state
+   * @param preset
+   */
+  static void moveTo(State *state, uint8_t preset);
+
+  /**
+   * @brief The step a channel will play after the next advance, without advancing.
+   *
+   * @param state
+   * @param channel
+   * @param nextPreset The current preset after the next advance, which a channel without a
+   * sequence of its own will play.
+   * @return uint8_t
+   */
+  static uint8_t nextStep(State *state, uint8_t channel, uint8_t nextPreset);
+
+  /**
+   * @brief The step a channel is playing: its own step, or the current preset.
+   *
+   * @param state
+   * @param channel
+   * @return uint8_t
+   */
+  static uint8_t step(State *state, uint8_t channel);
+
+  private:
+  static void rebuild(State *state);
+  static uint8_t stepAfter(State *state, uint8_t channel, uint8_t step, int8_t addend);
+  static uint8_t *table(State *state, uint8_t channel);
+} Playheads;
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Random.h"
+
+#ifdef CORE_TEENSY
+  // Entropy is included with Teensyduino and is found in
+  // /Applications/Teensyduino.app/Contents/Java/hardware/teensy/avr/libraries/
+  #include <Entropy.h>
+#else
+  #include <pico/rand.h>
+#endif
+
+#include "State.h"
+
+/**
+ * @brief The next number of a Weyl sequence, through the MurmurHash3 finalizer, which spreads
+ * every bit of the seed across the four words of the generator.
+ */
+static uint32_t splitMix(uint32_t *x) {
+  *x += 0x9E3779B9;
+  uint32_t z = *x;
+  z = (z ^ (z >> 16)) * 0x85EBCA6B;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35;
+  return z ^ (z >> 16);
+}
+
+/**
+ * @brief A 32-bit integer hash with strong avalanche (Chris Wellons' lowbias32), used as a counter
+ * based generator: the hash of a counter is as random as the output of a generator, with no state.
+ */
+static uint32_t hash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352D;
+  x ^= x >> 15;
+  x *= 0x846CA68B;
+  x ^= x >> 16;
+  return x;
+}
+
+static uint32_t rotateLeft(uint32_t x, uint8_t bits) {
+  return (x << bits) | (x >> (32 - bits));
+}
+
+void Random::begin(State *state) {
+  #ifdef CORE_TEENSY
+    Entropy.Initialize();
+  #endif
+  Random::seed(state, Random::entropy());
+  Random::mix(state, Random::entropy());
+  state->random.lastReseedTime = millis();
+}
+
+void Random::allAtStep(State *state, uint8_t bank, uint32_t step, uint32_t values[8]) {
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    values[channel] = Random::atStep(state, bank, channel, step);
+  }
+}
+
+uint32_t Random::atStep(State *state, uint8_t bank, uint8_t channel, uint32_t step) {
+  // The channel is part of the key, so that channels with the same seed still differ.
+  uint32_t key = (static_cast<uint32_t>(state->randomSeeds[bank][channel]) << 3) | channel;
+  return hash(hash(key + 0x9E3779B9) ^ step);
+}
+
+uint32_t Random::below(State *state, uint32_t max) {
+  // Lemire's multiply and shift, which rejects the few products that would favor some numbers.
+  uint64_t product = static_cast<uint64_t>(Random::next(state)) * max;
+  uint32_t low = static_cast<uint32_t>(product);
+  if (low < max) {
+    uint32_t threshold = (0 - max) % max;
+    while (low < threshold) {
+      product = static_cast<uint64_t>(Random::next(state)) * max;
+      low = static_cast<uint32_t>(product);
+    }
+  }
+  return product >> 32;
+}
+
+uint32_t Random::next(State *state) {
+  uint32_t *words = state->random.words;
+  uint32_t result = rotateLeft(words[1] * 5, 7) * 9;
+  uint32_t t = words[1] << 9;
+  words[2] ^= words[0];
+  words[3] ^= words[1];
+  words[1] ^= words[2];
+  words[0] ^= words[3];
+  words[2] ^= t;
+  words[3] = rotateLeft(words[3], 11);
+  return result;
+}
+
+void Random::reseed(unsigned long loopStartTime, State *state) {
+  if (loopStartTime - state->random.lastReseedTime < RANDOM_RESEED_INTERVAL) {
+    return;
+  }
+  #ifdef CORE_TEENSY
+    if (Entropy.available() == 0) {
+      return;
+    }
+  #endif
+  Random::mix(state, Random::entropy());
+  state->random.lastReseedTime = loopStartTime;
+}
+
+void Random::seed(State *state, uint32_t seed) {
+  memset(state->random.words, 0, sizeof(state->random.words));
+  Random::mix(state, seed);
+}
+
+uint16_t Random::voltage(State *state) {
+  return Random::next(state) >> 20;
+}
+
+void Random::voltages(State *state, uint16_t values[8]) {
+  uint32_t a = Random::next(state);
+  uint32_t b = Random::next(state);
+  uint32_t c = Random::next(state);
+  values[0] = a & MAX_UNSIGNED_12_BIT;
+  values[1] = (a >> 12) & MAX_UNSIGNED_12_BIT;
+  values[2] = ((a >> 24) | (b << 8)) & MAX_UNSIGNED_12_BIT;
+  values[3] = (b >> 4) & MAX_UNSIGNED_12_BIT;
+  values[4] = (b >> 16) & MAX_UNSIGNED_12_BIT;
+  values[5] = ((b >> 28) | (c << 4)) & MAX_UNSIGNED_12_BIT;
+  values[6] = (c >> 8) & MAX_UNSIGNED_12_BIT;
+  values[7] = c >> 20;
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+uint32_t Random::entropy() {
+  #ifdef CORE_TEENSY
+    return Entropy.random();
+  #else
+    return get_rand_32();
+  #endif
+}
+
+/**
+ * @brief Fold 32 bits of entropy into every word, then draw once so that the words mix with one
+ * another.
+ */
+void Random::mix(State *state, uint32_t entropy) {
+  uint32_t seed = entropy;
+  uint32_t *words = state->random.words;
+  for (uint8_t i = 0; i < 4; i++) {
+    words[i] ^= splitMix(&seed);
+  }
+  // The only state that xoshiro128** cannot leave.
+  if ((words[0] | words[1] | words[2] | words[3]) == 0) {
+    words[0] = 1;
+  }
+  Random::next(state);
+}
@@ -0,0 +1,124 @@
+/**
+ * Recollections: Random
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_RANDOM_H_
+#define RECOLLECTIONS_RANDOM_H_
+
+struct State;
+
+/**
+ * Random numbers for random voltages, gates and colors, from xoshiro128**: four words of state and
+ * a handful of shifts, rotations and xors per 32-bit number. Both rand() % max, on the RP2040, and
+ * the Entropy library, on Teensy, were far slower per number, and rand() % max was biased towards
+ * the low values.
+ *
+ * The generator is seeded from a true random source in begin(), and more entropy is mixed into it
+ * every RANDOM_RESEED_INTERVAL ms: the ring oscillator of the RP2040, through the SDK's
+ * get_rand_32(), or the Entropy library on Teensy. The RP2040's ADC is not used, as it belongs to
+ * the CV input. See CVInput.h.
+ *
+ * The random channels and presets do not use the generator. Their values come from atStep(), a
+ * hash of the channel's seed in State::randomSeeds and the step, so that a sequence can be recalled
+ * without writing it into the voltages.
+ */
+typedef struct Random {
+  /** The state of xoshiro128**. Never all zero. */
+  uint32_t words[4];
+
+  unsigned long lastReseedTime;
+
+  // ---- static methods ----
+
+  /**
+   * @brief Seed the generator from the true random source.
+   *
+   * @param state
+   */
+  static void begin(State *state);
+
+  /**
+   * @brief The random bits of every channel of a bank at one step. See atStep().
+   *
+   * @param state
+   * @param bank
+   * @param step
+   * @param values Indices are [channel].
+   */
+  static void allAtStep(State *state, uint8_t bank, uint32_t step, uint32_t values[8]);
+
+  /**
+   * @brief The random bits of one channel at one step: a pure function of the channel, its seed in
+   * the bank and the step, so a sequence repeats whenever the step starts over, and any step costs
+   * the same to compute. The top 12 bits make a voltage, and the top bit makes a gate.
+   *
+   * @param state
+   * @param bank
+   * @param channel
+   * @param step
+   * @return uint32_t
+   */
+  static uint32_t atStep(State *state, uint8_t bank, uint8_t channel, uint32_t step);
+
+  /**
+   * @brief A number from 0 up to but not including max, with every number equally likely.
+   *
+   * @param state
+   * @param max
+   * @return uint32_t 0 if max is 0.
+   */
+  static uint32_t below(State *state, uint32_t max);
+
+  /**
+   * @brief The next 32 random bits.
+   *
+   * @param state
+   * @return uint32_t
+   */
+  static uint32_t next(State *state);
+
+  /**
+   * @brief Mix more entropy into the generator, if RANDOM_RESEED_INTERVAL has elapsed.
+   *
+   * @param loopStartTime
+   * @param state
+   */
+  static void reseed(unsigned long loopStartTime, State *state);
+
+  /**
+   * @brief Restart the generator from a known seed, which repeats the same numbers every time.
+   *
+   * @param state
+   * @param seed
+   */
+  static void seed(State *state, uint32_t seed);
+
+  /**
+   * @brief A random 12-bit voltage value, from 0 to MAX_UNSIGNED_12_BIT.
+   *
+   * @param state
+   * @return uint16_t
+   */
+  static uint16_t voltage(State *state);
+
+  /**
+   * @brief Eight random 12-bit voltage values, one per channel, from three 32-bit numbers.
+   *
+   * @param state
+   * @param values Indices are [channel].
+   */
+  static void voltages(State *state, uint16_t values[8]);
+
+  private:
+  static uint32_t entropy();
+  static void mix(State *state, uint32_t entropy);
+} Random;
+
+#endif
@@ -34,24 +34,20 @@
 // https://arduinojson.org/
 #include <ArduinoJson.h>
 
-#ifdef CORE_TEENSY
-  // Random number generation:
-  // On Teensy (or any AVR processor), we will use the Entropy library. On RP2040, we will need to
-  // settle for the pseudorandomness of stdlib's srand() seeded from a noisy unconnected pin
-  // and rand().
-  // Entropy is included with Teenyduino and is found in
-  // /Applications/Teensyduino.app/Contents/Java/hardware/teensy/avr/libraries/
-  // Entropy source code: https://code.google.com/archive/p/avr-hardware-random-number-generation/
-  #include <Entropy.h>
-#else
-  #include <stdlib.h> // for srand()
-#endif
-
+#include "CVInput.h"
 #include "Config.h"
+#include "GateEvents.h"
 #include "Keys.h"
 #include "Hardware.h"
 #include "Input.h"
+#include "Link.h"
+#include "Log.h"
+#include "LoopProfiler.h"
 #include "Nav.h"
+#include "Output.h"
+#include "OutputTimer.h"
+#include "Random.h"
+#include "Remote.h"
 #include "SDCard.h"
 #include "State.h"
 #include "Utils.h"
@@ -61,6 +57,14 @@
 // State instance. Initial values provided in setup().
 State state;
 
+#ifdef CORE_TEENSY
+  // The hardware timer that drives OutputTimer. On the RP2040, the second core drives it instead.
+  IntervalTimer outputTimer;
+#else
+  // The time of the last OutputTimer tick on the second core.
+  uint32_t lastCore1TickMicros;
+#endif
+
 ////////////////////////////////////////// KEY EVENTS //////////////////////////////////////////////
 
 /**
@@ -69,10 +73,70 @@ State state;
  * @param evt The key event, a struct.
  */
 TrellisCallback handleKeyEvent(keyEvent evt) {
-  state = Keys::handleKeyEvent(evt, state);
+  Keys::handleKeyEvent(evt, &state);
   return 0;
 }
 
+////////////////////////////////////////// GATE EDGES //////////////////////////////////////////////
+
+// Interrupt handlers for the gate inputs, which capture each edge with its time. See GateEvents.h.
+
+void handleResetEdge() {
+  GateEvents::capture(&state, GATE_INPUT.RESET, micros());
+}
+
+void handleBankReverseEdge() {
+  GateEvents::capture(&state, GATE_INPUT.BANK_REV, micros());
+}
+
+void handleBankAdvanceEdge() {
+  GateEvents::capture(&state, GATE_INPUT.BANK_ADV, micros());
+}
+
+void handleReverseEdge() {
+  GateEvents::capture(&state, GATE_INPUT.REV, micros());
+}
+
+void handleAdvEdge() {
+  uint32_t edgeMicros = micros();
+  // A follower of linked modules takes its steps from the leader rather than its ADV input.
+  if (GateEvents::capture(&state, GATE_INPUT.ADV, edgeMicros) && !Link::isFollower(&state)) {
+    // The next preset is already in the DACs, and is produced without waiting for the loop.
+    OutputTimer::requestLatch(&state, edgeMicros);
+  }
+}
+
+void handleRecEdge() {
+  GateEvents::capture(&state, GATE_INPUT.REC, micros());
+}
+
+////////////////////////////////////////// FOLLOWER BUS //////////////////////////////////////////
+
+/**
+ * @brief Interrupt handler for a message on the follower bus: from the leader of linked modules,
+ * which is told apart by its size, or a command from a controller. See Link.h and Remote.h.
+ *
+ * @param byteCount
+ */
+#if defined(ARDUINO_TEENSY36)
+  void handleBusReceive(size_t byteCount) {
+#else
+  void handleBusReceive(int byteCount) {
+#endif
+  if (Link::isFollower(&state) && byteCount == sizeof(LinkMessage)) {
+    Link::receive(&state, byteCount, micros());
+  } else {
+    Remote::receive(&state, byteCount);
+  }
+}
+
+/**
+ * @brief Interrupt handler for a read by a controller on the follower bus. See Remote.h.
+ */
+void handleBusRequest() {
+  Remote::request(&state);
+}
+
 ////////////////////////////////////// SETUP AND LOOP  /////////////////////////////////////////////
 
 /**
@@ -84,7 +148,7 @@ TrellisCallback handleKeyEvent(keyEvent evt) {
 bool setupSDCard() {
   delay(200); // Seems to work better on Teensy, not sure why
 
-  Serial.println("Attempting to open SD card");
+  LOG_INFO("Attempting to open SD card");
   bool success = false;
 
   #ifdef CORE_TEENSY
@@ -94,10 +158,10 @@ bool setupSDCard() {
   #endif
 
   if (!success) {
-    Serial.println("SD card failed, or is not present");
+    LOG_ERROR("SD card failed, or is not present");
     return false;
   } else {
-    Serial.println("SD card is working.");
+    LOG_INFO("SD card is working.");
   }
   return true;
 }
@@ -122,15 +186,20 @@ bool setupConfig() {
     .magenta = {119,0,119},
     .black = {0,0,0},
   };
+  state.config.autosaveInterval = 10000;
   state.config.controllerOrientation = 1;
   state.config.currentModule = 0;
   state.config.isAdvancingMaxInterval = 10000;
   state.config.isClockedTolerance = 0.1;
-  state.config.randomOutputOverwrites = 1;
+  state.config.cvSmoothing = 2;
+  state.config.randomOutputOverwrites = 0;
+  state.config.exportBankJson = 0;
+  state.config.linkModuleCount = 1;
+  state.config.linkPosition = 0;
 
   // overwrite defaults if anything is in the Config.txt file
   if (REQUIRE_SD_CARD) {
-    state.config = SDCard::readConfigFile(state.config);
+    SDCard::readConfigFile(&state.config);
   }
 
   return true;
@@ -150,24 +219,24 @@ bool setupPeripheralHardware() {
   // In hardware before version 0.4.0, the USB port is only accessible by removing dac1.
   if (!(USB_POWERED && (HARDWARE_SEMVER.compare("0.4.0") < 0))) {
     if (state.config.dac1.begin(DAC_1_I2C_ADDRESS, &Wire)) {
-      Serial.println("dac1 began successfully");
+      LOG_INFO("dac1 began successfully");
     } else {
-      Serial.println("dac1 did not begin successfully");
+      LOG_ERROR("dac1 did not begin successfully");
       return false;
     }
   }
   if (state.config.dac2.begin(DAC_2_I2C_ADDRESS, &Wire)) {
-    Serial.println("dac2 began successfully");
+    LOG_INFO("dac2 began successfully");
   } else {
-    Serial.println("dac2 did not begin successfully");
+    LOG_ERROR("dac2 did not begin successfully");
     return false;
   }
 
   // NeoTrellis elastomer keys
   if (state.config.trellis.begin(0x2E)) {
-    Serial.println("NeoTrellis began successfully");
+    LOG_INFO("NeoTrellis began successfully");
   } else {
-    Serial.println("NeoTrellis did not begin successfully");
+    LOG_ERROR("NeoTrellis did not begin successfully");
     return false;
   }
 
@@ -179,7 +248,7 @@ bool setupPeripheralHardware() {
     state.config.trellis.activateKey(i, SEESAW_KEYPAD_EDGE_FALLING);
     state.config.trellis.registerCallback(i, handleKeyEvent);
   }
-  Serial.println("NeoTrellis fully activated");
+  LOG_INFO("NeoTrellis fully activated");
 
   return true;
 }
@@ -198,13 +267,65 @@ bool setupState() {
   }
   state.advanceBankAddend = 1;
   state.advancePresetAddend = 1;
+  state.randomStep = 0;
+  state.clock.hasGate = false;
+  state.clock.lockedGates = 0;
+  state.clock.periodMicros = 0;
+  state.cvInput.latest = 0;
+  state.dirtyBanks = 0;
   state.flash = true;
   state.flashesSinceRandomColorChange = 0;
+  state.framebuffer.isDirty = false;
+  state.framebuffer.knownPixels = 0;
+  state.framebuffer.lastShowTime = 0;
+  state.gateMillis = DEFAULT_TRIGGER_LENGTH;
+  state.gateEvents.hasOverflowed = false;
+  state.gateEvents.head = 0;
+  state.gateEvents.tail = 0;
+  state.link.hasOverflowed = false;
+  state.link.head = 0;
+  state.link.maxLatencyMicros = 0;
+  state.link.messageCount = 0;
+  state.link.missedMessages = 0;
+  state.link.nextStep = 0xFFFF;
+  state.link.sentBank = 0xFF;
+  state.link.sequence = 0;
+  state.link.step = 0;
+  state.link.tail = 0;
+  state.remote.commandCount = 0;
+  state.remote.droppedCommands = 0;
+  state.remote.head = 0;
+  state.remote.readChannel = 0;
+  state.remote.tail = 0;
+  state.requestedModule = -1;
   state.initialLoopCompleted = false;
   state.initialModHoldKey = -1;
+  state.isModuleDirty = false;
+  state.journal.lastFlushTime = 0;
+  state.journal.pendingCount = 0;
   state.keyPressesSinceModHold = 0;
+  state.lastAutosaveTime = 0;
   state.lastFlashToggle = 0;
   state.navHistoryIndex = 0;
+  state.output.i2cBytes = 0;
+  state.output.i2cMicros = 0;
+  state.output.isCacheValid = false;
+  state.output.lastReportTime = 0;
+  state.output.loops = 0;
+  state.outputTimer.isLatchHeld = false;
+  state.outputTimer.isLatchRequested = false;
+  state.outputTimer.latchFrameCount = 0;
+  state.outputTimer.latchMicros = 0;
+  #ifdef CORE_TEENSY
+    state.outputTimer.frameCount = 0;
+    state.outputTimer.hasNextValues = false;
+    state.outputTimer.isBusClaimed = false;
+    state.outputTimer.isPending = false;
+  #else
+    mutex_init(&state.outputTimer.bus);
+    state.outputTimer.frameCount = 0;
+    state.outputTimer.hasWriteFailed = false;
+  #endif
   state.randomColorShouldChange = true;
   state.readyForAdvInput = true;
   state.readyForBankAdvanceInput = true;
@@ -215,6 +336,12 @@ bool setupState() {
   state.readyForResetInput = true;
   state.readyForReverseInput = true;
   state.readyForPresetSelection = false;
+  state.advance.isStale = true;
+  state.playheads.isStale = true;
+  state.resolvedPresets.isStale = true;
+  state.resolvedPresets.tableBank = 0;
+  state.saveJob.step = SAVE_STEP.IDLE;
+  state.saveJob.hasFailed = false;
   state.selectedKeyForCopying = -1;
   state.selectedKeyForRecording = -1;
   for (uint8_t i = 0; i < 16; i++) {
@@ -223,12 +350,12 @@ bool setupState() {
     }
     state.pasteTargetKeys[i] = false;
   }
-  Serial.println("Successfully set up transient state");
+  LOG_INFO("Successfully set up transient state");
 
   // default state
 
-  // Core data -- preserved in Module.txt
-  // Keep this in sync with SDCard::readModuleFile().
+  // Core data -- preserved in Module.bin, or Module.txt for legacy files
+  // Keep this in sync with SDCard::readModuleFile() and ModuleImage.
   // If adding or removing anything here, please recalculate the size constants for the JSON
   // documents required for storing the data on the SD card. See constants.h.
   state.currentPreset = 0;
@@ -238,42 +365,117 @@ bool setupState() {
     state.removedPresets[i] = false;
   }
 
-  // Bank data -- preserved in Bank_<bank-index>.txt
+  // Bank data -- preserved in Module.bin, or Bank_<bank-index>.bin and Bank_<bank-index>.txt for
+  // legacy files
   //
-  // Keep this in sync with State::readBankFromSDCard().
+  // Keep this in sync with SDCard::readBankFile() and BankRecord.
   // If adding or removing anything here, please recalculate the size constants for the JSON
-  // documents required for storing the data on the SD card. See constants.h.
+  // documents required for storing the data on the SD card and increment BANK_RECORD_VERSION.
+  // See constants.h.
   //
-  // Also keep this in sync with State::pasteBanks().
+  // Also keep this in sync with State::copyBank(), which copies each of these fields.
   //
-  // Indices are bank, preset, channel.
+  // Indices are bank, preset, channel. The boolean planes pack the channel axis into bits.
   for (uint8_t i = 0; i < 16; i++) {
+    state.autoRecordChannels[i] = CHANNEL_FLAGS_NONE;
+    state.gateChannels[i] = CHANNEL_FLAGS_NONE;
+    state.randomInputChannels[i] = CHANNEL_FLAGS_NONE;
+    state.randomOutputChannels[i] = CHANNEL_FLAGS_NONE;
     for (uint8_t j = 0; j < 16; j++) {
+      state.activeVoltages[i][j] = CHANNEL_FLAGS_ALL;
+      state.gateVoltages[i][j] = CHANNEL_FLAGS_NONE;
+      state.lockedVoltages[i][j] = CHANNEL_FLAGS_NONE;
+      state.randomVoltages[i][j] = CHANNEL_FLAGS_NONE;
       for (uint8_t k = 0; k < 8; k++) {
-        state.activeVoltages[i][j][k] = true;
-        state.autoRecordChannels[i][k] = false;
-        state.gateChannels[i][k] = false;
-        state.gateVoltages[i][j][k] = false;
-        state.lockedVoltages[i][j][k] = false;
-        state.randomInputChannels[i][k] = false;
-        state.randomOutputChannels[i][k] = false;
-        state.randomVoltages[i][j][k] = false;
         state.voltages[i][j][k] = VOLTAGE_VALUE_MID;
       }
     }
+    for (uint8_t k = 0; k < 8; k++) {
+      state.randomSeeds[i][k] = 0;
+      state.channelLengths[i][k] = 0;
+      state.channelAddends[i][k] = 1;
+      state.removedSteps[i][k] = 0;
+    }
   }
-  Serial.println("Successfully set up default state");
+  LOG_INFO("Successfully set up default state");
 
   // persisted state
 
   if (REQUIRE_SD_CARD) {
-    state = SDCard::readModuleDirectory(state);
-    Serial.println("Successfully set up persisted state");
+    SDCard::readModuleDirectory(&state);
+    LOG_INFO("Successfully set up persisted state");
   }
 
   return true;
 }
 
+/**
+ * @brief Attaches the interrupt handlers for the gate inputs. This must follow setupState(), which
+ * empties the buffer the handlers write to.
+ */
+void setupGateInputs() {
+  void (*const handlers[GATE_INPUT_COUNT])() = {
+    handleResetEdge,
+    handleBankReverseEdge,
+    handleBankAdvanceEdge,
+    handleReverseEdge,
+    handleAdvEdge,
+    handleRecEdge,
+  };
+  for (GateInput_t input = 0; input < GATE_INPUT_COUNT; input++) {
+    uint8_t pin = GateEvents::pin(input);
+    attachInterrupt(digitalPinToInterrupt(pin), handlers[input], CHANGE);
+  }
+  LOG_INFO("Gate inputs attached");
+}
+
+/**
+ * @brief Joins the follower bus: as the leader of linked modules, as a follower at its address, or
+ * when unlinked, at REMOTE_ADDRESS for controllers. This must follow setupState(), which empties
+ * the buffers the handlers write to.
+ */
+void setupFollowerBus() {
+  #ifndef CORE_TEENSY
+    Wire1.setSDA(RECOLLECTIONS_SDA1);
+    Wire1.setSCL(RECOLLECTIONS_SCL1);
+  #endif
+  if (!Remote::isListening(&state)) {
+    Wire1.begin();
+    Wire1.setClock(LINK_BUS_FREQUENCY);
+  } else {
+    Wire1.begin(
+      Link::isFollower(&state)
+        ? LINK_FOLLOWER_ADDRESS + state.config.linkPosition - 1
+        : REMOTE_ADDRESS
+    );
+    Wire1.onReceive(handleBusReceive);
+    Wire1.onRequest(handleBusRequest);
+  }
+  if (Link::isLinked(&state)) {
+    LOG_INFO(
+      "Linked as module %u of %u", state.config.linkPosition + 1, state.config.linkModuleCount
+    );
+  }
+}
+
+#ifdef CORE_TEENSY
+  /**
+   * @brief Interrupt handler for the output timer.
+   */
+  void handleOutputTimer() {
+    OutputTimer::tick(&state);
+  }
+
+  /**
+   * @brief Starts the hardware timer that writes scheduled outputs. This must follow setupState(),
+   * which empties the schedule.
+   */
+  void setupOutputTimer() {
+    outputTimer.begin(handleOutputTimer, OUTPUT_TIMER_PERIOD_MICROS);
+    LOG_INFO("Output timer started");
+  }
+#endif
+
 /**
  * @brief Runs on power up and prior to loop()
  */
@@ -281,7 +483,7 @@ void setup() {
   Serial.begin(9600);
   while (!Serial);
 
-  Serial.println("Starting set up");
+  LOG_INFO("Starting set up");
 
   // Set up the local I2C bus where the MCU is the controller/leader.
   // This communicats with the NeoTrellis elastomer keys and the MCP4728 DACs.
@@ -320,15 +522,27 @@ void setup() {
     state.screen = SCREEN.ERROR;
   }
 
+  setupFollowerBus();
+
   #ifdef CORE_TEENSY
-    Entropy.Initialize();
-  #else
-    srand(analogRead(UNCONNECTED_ANALOG_PIN));
+    CVInput::begin(&state);
+    setupGateInputs();
+    setupOutputTimer();
   #endif
 
+  Random::begin(&state);
+
   digitalWrite(BOARD_LED, 1); // to indicate that the microcontroller is alive and well
 
-  Serial.println("Completed set up");
+  #ifndef CORE_TEENSY
+    // The second core has been waiting for the state it works on to be set up.
+    rp2040.fifo.push(CORE1_START);
+  #endif
+
+  LoopProfiler::begin(&state.profiler);
+
+  LOG_INFO("Completed set up");
+  Log::hold();
 }
 
 /**
@@ -338,30 +552,91 @@ void setup() {
  */
 void loop() {
   unsigned long loopStartTime = millis();
+  LoopProfiler::startLoop(&state.profiler);
+
+  // Print what was logged since the last loop, before anything else can log.
+  Log::drain();
 
-  state = Hardware::updateFlashTiming(loopStartTime, state);
+  Hardware::updateFlashTiming(loopStartTime, &state);
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.FLASH_TIMING);
 
   // error screen returns early
   if (state.screen == SCREEN.ERROR) {
-    Hardware::reflectState(state);
+    Hardware::reflectState(&state);
     return;
   }
 
   // Handle key events, inputs and recording.
   // These drive all of the state changes other than flash timing.
   if (!digitalRead(TRELLIS_INTERRUPT_INPUT)) {
+    OutputTimer::claimBus(&state);
     state.config.trellis.read(false);
+    OutputTimer::releaseBus(&state);
   }
-  state = State::recordContinuously(Input::handleInput(loopStartTime, state));
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.TRELLIS_READ);
+  Input::handleInput(loopStartTime, &state);
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.HANDLE_INPUT);
+  State::recordContinuously(&state);
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.RECORD);
 
   // reflect state
-  if (!Hardware::reflectState(state)) {
+  if (!Hardware::reflectState(&state)) {
+    state.screen = SCREEN.ERROR;
+  }
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.REFLECT_STATE);
+
+  // Advance any save in progress by one small step, once the outputs are up to date.
+  SDCard::autosave(loopStartTime, &state);
+  if (!SDCard::continueSave(&state)) {
     state.screen = SCREEN.ERROR;
   }
+  SDCard::maintainJournal(loopStartTime, &state);
+  LoopProfiler::endPhase(&state.profiler, LOOP_PHASE.SAVE);
+
+  Random::reseed(loopStartTime, &state);
+  Output::reportStats(loopStartTime, &state);
+  LoopProfiler::reportOnRequest(&state.profiler);
 
   // initial loop completed -- this is for debugging only. TODO: remove.
   if (!state.initialLoopCompleted) {
-    Serial.println("--- Initial loop completed ---");
+    LOG_DEBUG("--- Initial loop completed ---");
     state.initialLoopCompleted = true;
   }
+  LoopProfiler::endLoop(&state.profiler);
 }
+
+////////////////////////////////////////// SECOND CORE /////////////////////////////////////////////
+
+// On the RP2040, the second core runs the time critical input and output: it filters the CV input,
+// takes the interrupts of the gate inputs, and writes the DACs at a fixed rate. The first core runs
+// everything else, including the keys, the display and the SD card, so none of those can delay the
+// inputs or the outputs.
+
+#ifndef CORE_TEENSY
+
+  /**
+   * @brief Runs on the second core, once the first core has completed setup().
+   */
+  void setup1() {
+    rp2040.fifo.pop();
+    CVInput::begin(&state);
+    // Interrupts are taken by the core that attaches them.
+    setupGateInputs();
+    lastCore1TickMicros = micros();
+  }
+
+  /**
+   * @brief Runs repeatedly on the second core.
+   */
+  void loop1() {
+    // An ADV edge is answered on every pass rather than every OUTPUT_TIMER_PERIOD_MICROS.
+    OutputTimer::latch(&state);
+    uint32_t now = micros();
+    if (now - lastCore1TickMicros < OUTPUT_TIMER_PERIOD_MICROS) {
+      return;
+    }
+    lastCore1TickMicros = now;
+    CVInput::sample(&state);
+    OutputTimer::tick(&state);
+  }
+#endif
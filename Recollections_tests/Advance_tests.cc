@@ -0,0 +1,67 @@
+#include "../Advance.h"
+#include "../State.h"
+
+#include <gtest/gtest.h>
+
+class AdvanceTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      state = new State();
+      state->advancePresetAddend = 1;
+      Advance::markStale(state);
+    }
+
+    void TearDown() override {
+      delete state;
+    }
+
+    State *state;
+};
+
+TEST_F(AdvanceTests, WrapsAroundInEitherDirection) {
+  EXPECT_EQ(Advance::nextPreset(state, 15), 0);
+  state->advancePresetAddend = -1;
+  EXPECT_EQ(Advance::nextPreset(state, 0), 15);
+  EXPECT_EQ(Advance::nextPreset(state, 7), 6);
+}
+
+TEST_F(AdvanceTests, SkipsRemovedPresets) {
+  state->removedPresets[1] = true;
+  state->removedPresets[2] = true;
+  state->removedPresets[15] = true;
+  Advance::markStale(state);
+  EXPECT_EQ(Advance::nextPreset(state, 0), 3);
+  EXPECT_EQ(Advance::nextPreset(state, 14), 0);
+  state->advancePresetAddend = -1;
+  EXPECT_EQ(Advance::nextPreset(state, 3), 0);
+  EXPECT_EQ(Advance::nextPreset(state, 0), 14);
+}
+
+TEST_F(AdvanceTests, MovesByAnyAddend) {
+  state->advancePresetAddend = 5;
+  EXPECT_EQ(Advance::nextPreset(state, 13), 2);
+  state->advancePresetAddend = -15;
+  EXPECT_EQ(Advance::nextPreset(state, 4), 5);
+  state->removedPresets[5] = true;
+  Advance::markStale(state);
+  EXPECT_EQ(Advance::nextPreset(state, 4), 6);
+}
+
+TEST_F(AdvanceTests, StaysInBoundsWhenEveryPresetIsRemoved) {
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    state->removedPresets[preset] = true;
+  }
+  Advance::markStale(state);
+  EXPECT_EQ(Advance::nextPreset(state, 15), 0);
+  state->advancePresetAddend = -2;
+  EXPECT_EQ(Advance::nextPreset(state, 1), 15);
+}
+
+TEST_F(AdvanceTests, AdvancesTheCurrentPreset) {
+  state->currentPreset = 15;
+  state->removedPresets[0] = true;
+  Advance::markStale(state);
+  Advance::advanceTo(state, Advance::nextPreset(state, state->currentPreset), 0);
+  EXPECT_EQ(state->currentPreset, 1);
+  EXPECT_EQ(state->randomStep, 1u);
+}
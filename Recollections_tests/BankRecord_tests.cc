@@ -0,0 +1,94 @@
+#include "../BankRecord.h"
+#include "../State.h"
+#include "../Utils.h"
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <string.h>
+
+class BankRecordTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      state = new State();
+      for (uint8_t preset = 0; preset < 16; preset++) {
+        for (uint8_t channel = 0; channel < 8; channel++) {
+          state->voltages[2][preset][channel] = preset * 100 + channel;
+        }
+      }
+      for (uint8_t channel = 0; channel < 8; channel++) {
+        state->randomSeeds[2][channel] = 1000 + channel;
+        state->channelLengths[2][channel] = 9 + channel;
+        state->channelAddends[2][channel] = -1;
+        state->removedSteps[2][channel] = 1 << channel;
+      }
+    }
+
+    void TearDown() override {
+      delete state;
+    }
+
+    State *state;
+};
+
+TEST_F(BankRecordTests, KeepsTheRandomSeeds) {
+  BankRecord record;
+  BankRecord::fromState(state, 2, &record);
+  State *copy = new State();
+  ASSERT_TRUE(BankRecord::toState(&record, copy, 5));
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(copy->randomSeeds[5][channel], 1000 + channel);
+  }
+  delete copy;
+}
+
+TEST_F(BankRecordTests, KeepsTheChannelSequences) {
+  BankRecord record;
+  BankRecord::fromState(state, 2, &record);
+  State *copy = new State();
+  ASSERT_TRUE(BankRecord::toState(&record, copy, 5));
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(copy->channelLengths[5][channel], 9 + channel);
+    EXPECT_EQ(copy->channelAddends[5][channel], -1);
+    EXPECT_EQ(copy->removedSteps[5][channel], 1 << channel);
+  }
+  delete copy;
+}
+
+TEST_F(BankRecordTests, ReadsAVersion2RecordWithoutSequences) {
+  BankRecord record;
+  BankRecord::fromState(state, 2, &record);
+  record.version = 2;
+  record.size = BANK_RECORD_V2_SIZE;
+  size_t const crcOffset = BANK_RECORD_V2_SIZE - sizeof(uint32_t);
+  uint32_t crc = Utils::crc32(reinterpret_cast<uint8_t *>(&record), crcOffset);
+  memcpy(reinterpret_cast<uint8_t *>(&record) + crcOffset, &crc, sizeof(uint32_t));
+
+  ASSERT_TRUE(BankRecord::toState(&record, state, 2));
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(state->randomSeeds[2][channel], 1000 + channel);
+    EXPECT_EQ(state->channelLengths[2][channel], 0);
+    EXPECT_EQ(state->channelAddends[2][channel], 1);
+    EXPECT_EQ(state->removedSteps[2][channel], 0);
+  }
+}
+
+TEST_F(BankRecordTests, ReadsAVersion1RecordWithoutSeeds) {
+  BankRecord record;
+  BankRecord::fromState(state, 2, &record);
+  // A version 1 record ends with the CRC of what precedes it, where the seeds now begin.
+  record.version = 1;
+  record.size = BANK_RECORD_V1_SIZE;
+  size_t const crcOffset = BANK_RECORD_V1_SIZE - sizeof(uint32_t);
+  uint32_t crc = Utils::crc32(reinterpret_cast<uint8_t *>(&record), crcOffset);
+  memcpy(reinterpret_cast<uint8_t *>(&record) + crcOffset, &crc, sizeof(uint32_t));
+
+  ASSERT_TRUE(BankRecord::toState(&record, state, 2));
+  EXPECT_EQ(state->voltages[2][15][7], 1507);
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(state->randomSeeds[2][channel], 0);
+  }
+
+  reinterpret_cast<uint8_t *>(&record)[100] ^= 1;
+  EXPECT_FALSE(BankRecord::isValid(&record));
+}
@@ -0,0 +1,117 @@
+#include "../ClockTracker.h"
+#include "../State.h"
+
+#include <gtest/gtest.h>
+
+// Synthetic clocks at the ADV input, fed straight to the tracker.
+class ClockTrackerTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      state = new State();
+      state->config.isAdvancingMaxInterval = 10000;
+      state->config.isClockedTolerance = 0.1;
+      state->clock.hasGate = false;
+      state->clock.lockedGates = 0;
+      state->clock.periodMicros = 0;
+      state->gateMillis = DEFAULT_TRIGGER_LENGTH;
+      now = 1000;
+      beat = now;
+    }
+
+    void TearDown() override {
+      delete state;
+    }
+
+    /** Send gates every periodMicros, early or late by up to jitterMicros, updating every ms. */
+    void clock(uint8_t gates, uint32_t periodMicros, int32_t jitterMicros = 0) {
+      static const int8_t pattern[] = {0, 1, -1, 1, 0, -1, -1, 1};
+      for (uint8_t i = 0; i < gates; i++) {
+        beat += periodMicros;
+        uint32_t gate = beat + pattern[i % 8] * jitterMicros;
+        while (static_cast<int32_t>(gate - now) > 1000) {
+          now += 1000;
+          ClockTracker::update(state, now);
+        }
+        now = gate;
+        ClockTracker::handleGate(state, now);
+        ClockTracker::update(state, now);
+      }
+    }
+
+    State *state;
+    uint32_t beat;
+    uint32_t now;
+};
+
+TEST_F(ClockTrackerTests, IsNotAdvancingBeforeTheFirstGate) {
+  ClockTracker::update(state, now);
+  EXPECT_FALSE(state->isAdvancingPresets);
+  EXPECT_FALSE(state->isClocked);
+  EXPECT_FALSE(ClockTracker::isWithinGate(state, now));
+}
+
+TEST_F(ClockTrackerTests, LocksToAJitteryClock) {
+  clock(32, 125000, 2000);
+  EXPECT_TRUE(state->isAdvancingPresets);
+  EXPECT_TRUE(state->isClocked);
+  EXPECT_NEAR(state->clock.periodMicros, 125000, 1000);
+  EXPECT_NEAR(state->gateMillis, 62, 1);
+}
+
+TEST_F(ClockTrackerTests, UsesTheDefaultTriggerLengthUntilLocked) {
+  clock(1, 125000);
+  EXPECT_TRUE(state->isAdvancingPresets);
+  EXPECT_FALSE(state->isClocked);
+  EXPECT_EQ(state->gateMillis, DEFAULT_TRIGGER_LENGTH);
+  EXPECT_TRUE(ClockTracker::isWithinGate(state, now + DEFAULT_TRIGGER_LENGTH * 1000 - 1));
+  EXPECT_FALSE(ClockTracker::isWithinGate(state, now + DEFAULT_TRIGGER_LENGTH * 1000));
+}
+
+TEST_F(ClockTrackerTests, FollowsAGradualChangeOfTempo) {
+  clock(8, 125000);
+  for (uint32_t period = 125000; period > 100000; period -= 500) {
+    clock(1, period);
+    EXPECT_TRUE(state->isClocked);
+  }
+  EXPECT_NEAR(state->clock.periodMicros, 100000, 2500);
+}
+
+TEST_F(ClockTrackerTests, RelocksAfterASuddenChangeOfTempo) {
+  clock(8, 125000);
+  clock(1, 90000);
+  EXPECT_FALSE(state->isClocked);
+  clock(2, 90000);
+  EXPECT_TRUE(state->isClocked);
+  EXPECT_EQ(state->clock.periodMicros, 90000u);
+  EXPECT_EQ(state->gateMillis, 45u);
+}
+
+TEST_F(ClockTrackerTests, UnlocksWhenTheClockStops) {
+  clock(8, 125000);
+  for (uint8_t i = 0; i < 150; i++) {
+    now += 1000;
+    ClockTracker::update(state, now);
+  }
+  EXPECT_FALSE(state->isClocked);
+  EXPECT_TRUE(state->isAdvancingPresets);
+
+  now += state->config.isAdvancingMaxInterval * 1000;
+  ClockTracker::update(state, now);
+  EXPECT_FALSE(state->isAdvancingPresets);
+}
+
+TEST_F(ClockTrackerTests, MeasuresLongPeriods) {
+  // Longer than the 65.5 s a uint16_t of ms can hold.
+  state->config.isAdvancingMaxInterval = 65535;
+  clock(3, 70000000);
+  EXPECT_TRUE(state->isClocked);
+  EXPECT_EQ(state->clock.periodMicros, 70000000u);
+}
+
+TEST_F(ClockTrackerTests, SurvivesTheWrapOfMicros) {
+  now = UINT32_MAX - 300000;
+  beat = now;
+  clock(8, 125000, 2000);
+  EXPECT_TRUE(state->isClocked);
+  EXPECT_NEAR(state->clock.periodMicros, 125000, 1000);
+}
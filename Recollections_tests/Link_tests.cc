@@ -0,0 +1,177 @@
+#include "../Link.h"
+#include "../OutputTimer.h"
+#include "../State.h"
+#include "../constants.h"
+#include "host/Simulator.h"
+#include "host/TempDir.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+// In Recollections.ino.
+void setupFollowerBus();
+
+// A follower on the other end of the bus, for the tests of the leader.
+static TwoWire follower;
+static std::vector<LinkMessage> receivedMessages;
+
+static void handleFollowerReceive(int byteCount) {
+  LinkMessage message;
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(&message);
+  for (int i = 0; i < byteCount && follower.available() > 0; i++) {
+    bytes[i] = follower.read();
+  }
+  receivedMessages.push_back(message);
+}
+
+// The whole firmware, linked as one module of two.
+class LinkTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      sdRoot = TempDir::create("recollections_link_tests_");
+      ASSERT_FALSE(sdRoot.empty());
+      Serial.setEcho(false);
+      receivedMessages.clear();
+    }
+
+    void TearDown() override {
+      follower.end();
+      TempDir::remove(sdRoot.c_str());
+    }
+
+    /** As setup() would with linkModuleCount and linkPosition in Config.txt. */
+    void setupModule(uint8_t linkPosition) {
+      Simulator::begin(sdRoot.c_str());
+      Simulator::setup();
+      Simulator::state()->config.linkModuleCount = 2;
+      Simulator::state()->config.linkPosition = linkPosition;
+      setupFollowerBus();
+      Simulator::run(10);
+    }
+
+    /** Send a message to the simulated follower, as the leader would. */
+    uint8_t send(LinkMessageType_t type, uint16_t value, uint16_t nextValue) {
+      LinkMessage message;
+      message.type = type;
+      message.sequence = sequence++;
+      message.value = value;
+      message.nextValue = nextValue;
+      message.ageMicros = 0;
+      leader.beginTransmission(LINK_FOLLOWER_ADDRESS);
+      leader.write(reinterpret_cast<uint8_t *>(&message), sizeof(LinkMessage));
+      return leader.endTransmission();
+    }
+
+    void pulseAdv() {
+      Simulator::setGate(ADV_INPUT, true);
+      Simulator::run(5);
+      Simulator::setGate(ADV_INPUT, false);
+      Simulator::run(5);
+    }
+
+    TwoWire leader;
+    uint8_t sequence = 0;
+    std::string sdRoot;
+};
+
+TEST_F(LinkTests, FollowerPlaysOnlyItsOwnPage) {
+  setupModule(1);
+  State *state = Simulator::state();
+  ASSERT_TRUE(Link::isFollower(state));
+
+  for (uint16_t step = 16; step <= 18; step++) {
+    ASSERT_EQ(send(LINK_MESSAGE.STEP, step, step + 1), 0);
+  }
+  Simulator::run(5);
+  EXPECT_EQ(state->currentPreset, 2);
+
+  // The leader's page: the follower holds its last step.
+  send(LINK_MESSAGE.STEP, 0, 1);
+  Simulator::run(5);
+  EXPECT_EQ(state->currentPreset, 2);
+
+  // Its own ADV input is ignored.
+  pulseAdv();
+  EXPECT_EQ(state->currentPreset, 2);
+
+  send(LINK_MESSAGE.RESET, 0, 1);
+  Simulator::run(5);
+  EXPECT_EQ(state->currentPreset, 0);
+  EXPECT_EQ(state->link.missedMessages, 0u);
+}
+
+TEST_F(LinkTests, FollowerLatchesAPreloadedStepAtTheMessage) {
+  setupModule(1);
+  State *state = Simulator::state();
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    state->voltages[0][1][channel] = 1000 + channel;
+    state->voltages[0][2][channel] = 2000 + channel;
+  }
+  send(LINK_MESSAGE.STEP, 17, 18);
+  Simulator::run(10);
+  EXPECT_EQ(Simulator::output(0), 1000);
+
+  // The second core latches on its next pass, before the loop has seen the message.
+  send(LINK_MESSAGE.STEP, 18, 19);
+  OutputTimer::latch(state);
+  EXPECT_EQ(state->currentPreset, 1);
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(Simulator::output(channel), 2000 + channel);
+  }
+  Simulator::run(5);
+  EXPECT_EQ(state->currentPreset, 2);
+}
+
+TEST_F(LinkTests, FollowerTakesTheBankOfTheLeader) {
+  setupModule(1);
+  send(LINK_MESSAGE.BANK, 3, 0);
+  Simulator::run(5);
+  EXPECT_EQ(Simulator::state()->currentBank, 3);
+}
+
+TEST_F(LinkTests, FollowerCountsMissedMessages) {
+  setupModule(1);
+  State *state = Simulator::state();
+  send(LINK_MESSAGE.STEP, 16, 17);
+  sequence += 2;
+  send(LINK_MESSAGE.STEP, 17, 18);
+  // Outside the chain of two modules.
+  send(LINK_MESSAGE.STEP, 40, 41);
+  Simulator::run(5);
+  EXPECT_EQ(state->link.missedMessages, 2u);
+  EXPECT_EQ(state->link.messageCount, 3u);
+  EXPECT_EQ(state->currentPreset, 1);
+}
+
+TEST_F(LinkTests, LeaderSendsEachStepAndHoldsOffItsPage) {
+  follower.begin(LINK_FOLLOWER_ADDRESS);
+  follower.onReceive(handleFollowerReceive);
+  setupModule(0);
+  State *state = Simulator::state();
+  ASSERT_FALSE(receivedMessages.empty());
+  EXPECT_EQ(receivedMessages.back().type, LINK_MESSAGE.BANK);
+
+  pulseAdv();
+  EXPECT_EQ(state->currentPreset, 1);
+  EXPECT_EQ(receivedMessages.back().type, LINK_MESSAGE.STEP);
+  EXPECT_EQ(receivedMessages.back().value, 1);
+  EXPECT_EQ(receivedMessages.back().nextValue, 2);
+
+  for (uint8_t i = 0; i < 16; i++) {
+    pulseAdv();
+  }
+  EXPECT_EQ(receivedMessages.back().value, 17);
+  EXPECT_EQ(state->currentPreset, 15);
+  EXPECT_EQ(state->link.missedMessages, 0u);
+
+  Simulator::setGate(RESET_INPUT, true);
+  Simulator::run(5);
+  Simulator::setGate(RESET_INPUT, false);
+  Simulator::run(5);
+  EXPECT_EQ(receivedMessages.back().type, LINK_MESSAGE.RESET);
+  EXPECT_EQ(state->currentPreset, 0);
+}
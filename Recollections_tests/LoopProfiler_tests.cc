@@ -0,0 +1,56 @@
+#include "../LoopProfiler.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+class LoopProfilerTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      memset(&profile, 0, sizeof(PhaseProfile));
+    }
+
+    PhaseProfile profile;
+};
+
+TEST_F(LoopProfilerTests, ReportsNothingBeforeASample) {
+  EXPECT_EQ(LoopProfiler::percentile(&profile, 50), 0u);
+}
+
+TEST_F(LoopProfilerTests, KeepsTheExactMinimumAndMaximum) {
+  for (uint32_t cycles : {700u, 12u, 90000u, 3u}) {
+    LoopProfiler::record(&profile, cycles);
+  }
+  EXPECT_EQ(profile.count, 4u);
+  EXPECT_EQ(profile.minCycles, 3u);
+  EXPECT_EQ(profile.maxCycles, 90000u);
+  EXPECT_EQ(LoopProfiler::percentile(&profile, 100), 90000u);
+}
+
+TEST_F(LoopProfilerTests, ReadsPercentilesWithinABucket) {
+  // 1000 samples of 1 to 1000 cycles.
+  for (uint32_t cycles = 1; cycles <= 1000; cycles++) {
+    LoopProfiler::record(&profile, cycles);
+  }
+  for (uint8_t percent : {10, 50, 90, 99}) {
+    uint32_t expected = percent * 10;
+    uint32_t actual = LoopProfiler::percentile(&profile, percent);
+    EXPECT_GE(actual, expected);
+    EXPECT_LE(actual, expected + expected / 4);
+  }
+}
+
+TEST_F(LoopProfilerTests, ReadsASlowOutlierOnlyAtTheTail) {
+  for (uint8_t i = 0; i < 99; i++) {
+    LoopProfiler::record(&profile, 100);
+  }
+  LoopProfiler::record(&profile, 1000000);
+  EXPECT_LE(LoopProfiler::percentile(&profile, 99), 125u);
+  EXPECT_EQ(LoopProfiler::percentile(&profile, 100), 1000000u);
+}
+
+TEST_F(LoopProfilerTests, CountsTheLargestCycleCounts) {
+  LoopProfiler::record(&profile, 0xFFFFFFFF);
+  EXPECT_EQ(profile.buckets[PROFILE_BUCKETS - 1], 1u);
+  EXPECT_EQ(LoopProfiler::percentile(&profile, 50), 0xFFFFFFFFu);
+}
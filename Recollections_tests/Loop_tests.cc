@@ -0,0 +1,394 @@
+#include "../Journal.h"
+#include "../OutputTimer.h"
+#include "../Playheads.h"
+#include "../Random.h"
+#include "../SDCard.h"
+#include "../State.h"
+#include "../constants.h"
+#include "host/Simulator.h"
+#include "host/TempDir.h"
+
+#include <Arduino.h>
+#include <SDFS.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+// The whole firmware, setup() and loop(), against a blank SD card.
+class LoopTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      sdRoot = TempDir::create("recollections_loop_tests_");
+      ASSERT_FALSE(sdRoot.empty());
+      Serial.setEcho(false);
+      Simulator::begin(sdRoot.c_str());
+      Simulator::setup();
+    }
+
+    void TearDown() override {
+      TempDir::remove(sdRoot.c_str());
+    }
+
+    /** Record the CV into a preset on the current channel, with MOD + key on PRESET_SELECT. */
+    void recordPreset(uint8_t key, uint16_t cv) {
+      Simulator::setCV(cv);
+      Simulator::setGate(MOD_INPUT, true);
+      Simulator::run(20);
+      Simulator::pressKey(key);
+      Simulator::run(20);
+      Simulator::releaseKey(key);
+      Simulator::setGate(MOD_INPUT, false);
+      Simulator::run(MOD_DEBOUNCE_TIME + 20);
+    }
+
+    std::string sdRoot;
+};
+
+TEST_F(LoopTests, WritesEveryOutputOnTheFirstLoop) {
+  Simulator::loop();
+  EXPECT_EQ(Simulator::state()->screen, SCREEN.PRESET_SELECT);
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(Simulator::output(channel), VOLTAGE_VALUE_MID);
+  }
+}
+
+TEST_F(LoopTests, AdvancesOnAGateAtADV) {
+  Simulator::run(10);
+  EXPECT_EQ(Simulator::state()->currentPreset, 0);
+  Simulator::setGate(ADV_INPUT, true);
+  Simulator::run(10);
+  Simulator::setGate(ADV_INPUT, false);
+  Simulator::run(10);
+  EXPECT_EQ(Simulator::state()->currentPreset, 1);
+}
+
+TEST_F(LoopTests, CatchesATriggerShorterThanTheLoop) {
+  Simulator::run(10);
+  Simulator::setGate(ADV_INPUT, true);
+  HostBoard::advanceMicros(500);
+  Simulator::setGate(ADV_INPUT, false);
+  Simulator::loop();
+  EXPECT_EQ(Simulator::state()->currentPreset, 1);
+}
+
+TEST_F(LoopTests, TimesAGateFromItsEdgeRatherThanTheLoop) {
+  Simulator::run(10);
+  uint32_t edgeTime = micros();
+  Simulator::setGate(ADV_INPUT, true);
+  // A loop that runs long, as when writing to the SD card.
+  HostBoard::advanceMicros(15000);
+  Simulator::loop();
+  EXPECT_EQ(Simulator::state()->currentPreset, 1);
+  EXPECT_EQ(Simulator::state()->clock.lastGateMicros, edgeTime);
+}
+
+TEST_F(LoopTests, EndsAGateOnTimeWithoutWaitingForTheLoop) {
+  State *state = Simulator::state();
+  state->gateChannels[0] = 1;
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    state->gateVoltages[0][preset] = 1;
+  }
+  // Lock to a 100 ms clock, for 50 ms gates.
+  Simulator::run(10);
+  for (uint8_t i = 0; i < 4; i++) {
+    Simulator::setGate(ADV_INPUT, true);
+    Simulator::run(10);
+    Simulator::setGate(ADV_INPUT, false);
+    Simulator::run(90);
+  }
+  Simulator::setGate(ADV_INPUT, true);
+  uint32_t edgeTime = micros();
+  Simulator::loop();
+  ASSERT_TRUE(state->isClocked);
+  ASSERT_EQ(state->gateMillis, 50u);
+  EXPECT_EQ(Simulator::output(0), VOLTAGE_VALUE_MAX);
+
+  // No loop runs for the rest of the gate, as when writing to the SD card.
+  HostBoard::advanceMicros(edgeTime + 49000 - micros());
+  EXPECT_EQ(Simulator::output(0), VOLTAGE_VALUE_MAX);
+  HostBoard::advanceMicros(1000 + OUTPUT_TIMER_PERIOD_MICROS);
+  EXPECT_EQ(Simulator::output(0), 0);
+}
+
+TEST_F(LoopTests, LatchesTheNextPresetOnAllOutputsAtTheEdge) {
+  State *state = Simulator::state();
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    state->voltages[0][0][channel] = 1000 + channel;
+    state->voltages[0][1][channel] = 2000 + channel;
+  }
+  Simulator::run(10);
+  EXPECT_EQ(Simulator::output(0), 1000);
+  EXPECT_EQ(Simulator::output(7), 1007);
+
+  // The second core latches on its next pass, before the loop has seen the edge.
+  Simulator::setGate(ADV_INPUT, true);
+  OutputTimer::latch(state);
+  EXPECT_EQ(state->currentPreset, 0);
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(Simulator::output(channel), 2000 + channel);
+  }
+
+  // The frame of the step before is not written over the latched values.
+  OutputTimer::tick(state);
+  EXPECT_EQ(Simulator::output(0), 2000);
+  Simulator::run(10);
+  EXPECT_EQ(state->currentPreset, 1);
+  EXPECT_EQ(Simulator::output(0), 2000);
+  EXPECT_EQ(Simulator::output(7), 2007);
+}
+
+TEST_F(LoopTests, RepeatsARandomChannelFromEachReset) {
+  State *state = Simulator::state();
+  // Overwriting writes each value into the voltages as it plays, which must not change the run.
+  state->config.randomOutputOverwrites = 1;
+  Bits::set(&state->randomOutputChannels[0], 2, true);
+  state->randomSeeds[0][2] = 1234;
+  // A random preset on a CV channel.
+  Bits::set(&state->randomVoltages[0][5], 3, true);
+  state->randomSeeds[0][3] = 5678;
+  Simulator::run(10);
+
+  // The whole sequence, then the same again after each of two resets.
+  uint16_t firstRun[16][2];
+  for (uint8_t run = 0; run < 3; run++) {
+    for (uint8_t step = 0; step < 16; step++) {
+      for (uint8_t i = 0; i < 2; i++) {
+        uint16_t value = Simulator::output(2 + i);
+        if (run == 0) {
+          firstRun[step][i] = value;
+        }
+        EXPECT_EQ(value, firstRun[step][i]) << "run " << +run << ", step " << +step;
+      }
+      // The value holds for the whole step.
+      Simulator::run(5);
+      EXPECT_EQ(Simulator::output(2), firstRun[step][0]);
+      Simulator::setGate(ADV_INPUT, true);
+      Simulator::run(10);
+      Simulator::setGate(ADV_INPUT, false);
+      Simulator::run(10);
+    }
+    Simulator::setGate(RESET_INPUT, true);
+    Simulator::run(10);
+    Simulator::setGate(RESET_INPUT, false);
+    Simulator::run(10);
+  }
+  EXPECT_NE(firstRun[0][0], firstRun[1][0]);
+  EXPECT_NE(firstRun[5][1], firstRun[4][1]);
+}
+
+TEST_F(LoopTests, LeavesABankCleanWhileOverwritingRandomVoltages) {
+  State *state = Simulator::state();
+  state->config.randomOutputOverwrites = 1;
+  Bits::set(&state->randomOutputChannels[0], 2, true);
+  state->randomSeeds[0][2] = 1234;
+  Simulator::run(10);
+
+  for (uint8_t step = 0; step < 4; step++) {
+    Simulator::setGate(ADV_INPUT, true);
+    Simulator::run(10);
+    Simulator::setGate(ADV_INPUT, false);
+    Simulator::run(10);
+  }
+  EXPECT_EQ(state->voltages[0][4][2], Random::atStep(state, 0, 2, state->randomStep) >> 20);
+  EXPECT_EQ(state->dirtyBanks, 0);
+  EXPECT_EQ(state->journal.pendingCount, 0);
+}
+
+TEST_F(LoopTests, PlaysASequenceOfItsOwnOnAChannel) {
+  State *state = Simulator::state();
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    state->voltages[0][preset][0] = 100 + preset;
+    state->voltages[0][preset][5] = 500 + preset;
+  }
+  state->channelLengths[0][5] = 3;
+  Playheads::markStale(state);
+  Simulator::run(10);
+
+  uint16_t const expected[5] = {501, 502, 500, 501, 502};
+  for (uint8_t step = 0; step < 5; step++) {
+    Simulator::setGate(ADV_INPUT, true);
+    Simulator::run(10);
+    Simulator::setGate(ADV_INPUT, false);
+    Simulator::run(10);
+    EXPECT_EQ(Simulator::output(0), 101 + step);
+    EXPECT_EQ(Simulator::output(5), expected[step]);
+  }
+
+  Simulator::setGate(RESET_INPUT, true);
+  Simulator::run(10);
+  Simulator::setGate(RESET_INPUT, false);
+  Simulator::run(10);
+  EXPECT_EQ(Simulator::output(0), 100);
+  EXPECT_EQ(Simulator::output(5), 500);
+}
+
+TEST_F(LoopTests, RecordsTheCVWithModAndAKey) {
+  Simulator::run(10);
+  recordPreset(3, 3000);
+  EXPECT_EQ(Simulator::state()->voltages[0][3][0], 3000);
+  EXPECT_EQ(Simulator::state()->screen, SCREEN.PRESET_SELECT);
+}
+
+TEST_F(LoopTests, SmoothsAStepAtTheCVInput) {
+  CVInput *input = &Simulator::state()->cvInput;
+  Simulator::setCV(1000);
+  Simulator::run(20);
+  EXPECT_EQ(input->latest, 1000);
+
+  Simulator::setCV(3000);
+  HostBoard::advanceMicros(OUTPUT_TIMER_PERIOD_MICROS * 2);
+  EXPECT_GT(input->latest, 1000);
+  EXPECT_LT(input->latest, 3000);
+  Simulator::run(20);
+  EXPECT_EQ(input->latest, 3000);
+}
+
+TEST_F(LoopTests, SwitchesModuleOnceTheKeysHaveBeenRead) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  state->screen = SCREEN.MODULE_SELECT;
+  Simulator::pressKey(3);
+  Simulator::run(20);
+  Simulator::releaseKey(3);
+  Simulator::run(20);
+  EXPECT_EQ(state->config.currentModule, 3);
+  EXPECT_EQ(state->requestedModule, -1);
+}
+
+TEST_F(LoopTests, RestoresAnEditFromTheJournalAfterAPowerCut) {
+  Simulator::run(10);
+  recordPreset(3, 3000);
+  // Well within the autosave interval, so the edit is only in Journal.bin.
+  Simulator::run(JOURNAL_FLUSH_INTERVAL * 2);
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[0][3][0], 3000);
+  EXPECT_EQ(Simulator::state()->voltages[0][4][0], VOLTAGE_VALUE_MID);
+}
+
+TEST_F(LoopTests, AutosavesAndEmptiesTheJournal) {
+  Simulator::run(10);
+  recordPreset(3, 3000);
+  Simulator::run(Simulator::state()->config.autosaveInterval + 1000);
+
+  std::string modulePath = std::string(MODULE_SD_PATH_PREFIX) + "0/";
+  EXPECT_TRUE(SDFS.exists((modulePath + "Module.bin").c_str()));
+  File journal = SDFS.open((modulePath + "Journal.bin").c_str(), "r");
+  if (journal) {
+    EXPECT_EQ(journal.size(), 0u);
+    journal.close();
+  }
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[0][3][0], 3000);
+}
+
+TEST_F(LoopTests, AutosavesEveryDirtyBankInOneSave) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  state->voltages[1][0][0] = 1000;
+  state->screen = SCREEN.BANK_SELECT;
+  state->selectedKeyForCopying = 1;
+  for (uint8_t bank = 2; bank < 6; bank++) {
+    state->pasteTargetKeys[bank] = true;
+  }
+  State::paste(state);
+  ASSERT_EQ(state->dirtyBanks, 0b111100);
+
+  uint8_t savesBegun = 0;
+  unsigned long const endTime = millis() + state->config.autosaveInterval + 1000;
+  while (millis() < endTime) {
+    SaveStep_t const lastStep = state->saveJob.step;
+    Simulator::loop();
+    if (lastStep == SAVE_STEP.IDLE && state->saveJob.step != SAVE_STEP.IDLE) {
+      savesBegun += 1;
+    }
+  }
+  EXPECT_EQ(savesBegun, 1);
+  EXPECT_EQ(state->saveJob.step, SAVE_STEP.IDLE);
+  EXPECT_EQ(state->dirtyBanks, 0);
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[5][0][0], 1000);
+}
+
+TEST_F(LoopTests, LeavesABankDirtyWhenAnEarlierSaveFails) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  // A directory where Module.tmp should be, so that no save can open it.
+  std::string tempPath = sdRoot + "/" + MODULE_SD_PATH_PREFIX + "0/Module.tmp";
+  std::filesystem::create_directories(tempPath);
+
+  State::markBankDirty(state, 5);
+  ASSERT_TRUE(SDCard::beginSave(state, 2, false));
+  EXPECT_FALSE(SDCard::beginSave(state, 5, true));
+  EXPECT_EQ(state->saveJob.step, SAVE_STEP.IDLE);
+  EXPECT_EQ(state->dirtyBanks, (1 << 2) | (1 << 5));
+}
+
+TEST_F(LoopTests, RestoresAPastedBankAfterItsSourceIsSaved) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  state->voltages[1][0][0] = 1000;
+  ASSERT_TRUE(SDCard::beginSave(state, 1, false));
+  ASSERT_TRUE(SDCard::finishSave(state));
+
+  state->screen = SCREEN.BANK_SELECT;
+  state->selectedKeyForCopying = 1;
+  state->pasteTargetKeys[2] = true;
+  State::paste(state);
+  state->voltages[1][0][0] = 2000;
+  Journal::voltage(state, 1, 0, 0);
+  SDCard::flushJournal(state);
+  // Only the source reaches Module.bin before the power is cut.
+  ASSERT_TRUE(SDCard::beginSave(state, 1, false));
+  ASSERT_TRUE(SDCard::finishSave(state));
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[1][0][0], 2000);
+  EXPECT_EQ(Simulator::state()->voltages[2][0][0], 1000);
+}
+
+TEST_F(LoopTests, KeepsModuleBinWhenASaveIsCutShort) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  state->voltages[0][1][0] = 1111;
+  ASSERT_TRUE(SDCard::beginSave(state, 0, false));
+  ASSERT_TRUE(SDCard::finishSave(state));
+
+  state->voltages[0][2][0] = 2222;
+  Journal::voltage(state, 0, 2, 0);
+  SDCard::flushJournal(state);
+  ASSERT_TRUE(SDCard::beginSave(state, 0, false));
+  // Open, then the first chunk of bank 0, before the power is cut.
+  SDCard::continueSave(state);
+  SDCard::continueSave(state);
+  ASSERT_EQ(state->saveJob.step, SAVE_STEP.WRITE);
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[0][1][0], 1111);
+  EXPECT_EQ(Simulator::state()->voltages[0][2][0], 2222);
+}
+
+TEST_F(LoopTests, RestoresModuleBinFromAVerifiedSave) {
+  Simulator::run(10);
+  State *state = Simulator::state();
+  state->voltages[3][0][0] = 3333;
+  ASSERT_TRUE(SDCard::beginSave(state, 3, false));
+  while (state->saveJob.step != SAVE_STEP.COMMIT) {
+    ASSERT_TRUE(SDCard::continueSave(state));
+    ASSERT_NE(state->saveJob.step, SAVE_STEP.IDLE);
+  }
+  // The power is cut just after Module.bin is removed.
+  SDFS.remove((std::string(MODULE_SD_PATH_PREFIX) + "0/Module.bin").c_str());
+
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  EXPECT_EQ(Simulator::state()->voltages[3][0][0], 3333);
+}
@@ -0,0 +1,118 @@
+#include "../Playheads.h"
+#include "../State.h"
+
+#include <gtest/gtest.h>
+
+class PlayheadsTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      state = new State();
+      state->currentBank = 3;
+      state->advancePresetAddend = 1;
+      for (uint8_t channel = 0; channel < 8; channel++) {
+        state->channelAddends[3][channel] = 1;
+      }
+      Playheads::markStale(state);
+    }
+
+    void TearDown() override {
+      delete state;
+    }
+
+    /** Advance n times, keeping the step of a channel after each advance. */
+    void play(uint8_t channel, uint8_t n, uint8_t steps[]) {
+      for (uint8_t i = 0; i < n; i++) {
+        Playheads::advance(state);
+        steps[i] = Playheads::step(state, channel);
+      }
+    }
+
+    State *state;
+};
+
+TEST_F(PlayheadsTests, FollowsTheCurrentPresetWithoutASequence) {
+  state->currentPreset = 9;
+  Playheads::advance(state);
+  EXPECT_FALSE(Playheads::hasSequence(state, 0));
+  EXPECT_EQ(Playheads::step(state, 0), 9);
+  EXPECT_EQ(Playheads::nextStep(state, 0, 10), 10);
+}
+
+TEST_F(PlayheadsTests, WrapsChannelsOfDifferentLengthsIndependently) {
+  state->channelLengths[3][1] = 3;
+  state->channelLengths[3][2] = 5;
+  uint8_t three[7];
+  uint8_t five[7];
+  for (uint8_t i = 0; i < 7; i++) {
+    Playheads::advance(state);
+    three[i] = Playheads::step(state, 1);
+    five[i] = Playheads::step(state, 2);
+  }
+  uint8_t const expectedThree[7] = {1, 2, 0, 1, 2, 0, 1};
+  uint8_t const expectedFive[7] = {1, 2, 3, 4, 0, 1, 2};
+  for (uint8_t i = 0; i < 7; i++) {
+    EXPECT_EQ(three[i], expectedThree[i]);
+    EXPECT_EQ(five[i], expectedFive[i]);
+  }
+}
+
+TEST_F(PlayheadsTests, SkipsRemovedStepsInEitherDirection) {
+  state->channelLengths[3][4] = 6;
+  state->removedSteps[3][4] = (1 << 1) | (1 << 2) | (1 << 5);
+  uint8_t steps[4];
+  play(4, 4, steps);
+  uint8_t const forward[4] = {3, 4, 0, 3};
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_EQ(steps[i], forward[i]);
+  }
+
+  state->advancePresetAddend = -1;
+  play(4, 4, steps);
+  uint8_t const reverse[4] = {0, 4, 3, 0};
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_EQ(steps[i], reverse[i]);
+  }
+}
+
+TEST_F(PlayheadsTests, MovesByTheAddendOfTheChannel) {
+  state->channelLengths[3][0] = 7;
+  state->channelAddends[3][0] = 3;
+  uint8_t steps[4];
+  play(0, 4, steps);
+  uint8_t const expected[4] = {3, 6, 2, 5};
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_EQ(steps[i], expected[i]);
+  }
+  EXPECT_EQ(Playheads::nextStep(state, 0, 0), 1);
+}
+
+TEST_F(PlayheadsTests, StaysPutWhenEveryOtherStepIsRemoved) {
+  state->channelLengths[3][0] = 4;
+  state->removedSteps[3][0] = 0xFFFF;
+  uint8_t steps[2];
+  play(0, 2, steps);
+  EXPECT_EQ(steps[0], 0);
+  EXPECT_EQ(steps[1], 0);
+}
+
+TEST_F(PlayheadsTests, StartsEveryChannelOverFromAPreset) {
+  state->channelLengths[3][1] = 3;
+  state->channelLengths[3][2] = 5;
+  Playheads::advance(state);
+  Playheads::moveTo(state, 7);
+  EXPECT_EQ(Playheads::step(state, 1), 1);
+  EXPECT_EQ(Playheads::step(state, 2), 2);
+  Playheads::moveTo(state, 0);
+  EXPECT_EQ(Playheads::step(state, 1), 0);
+  EXPECT_EQ(Playheads::step(state, 2), 0);
+}
+
+TEST_F(PlayheadsTests, RebuildsTheTablesAfterASequenceChanges) {
+  state->channelLengths[3][0] = 4;
+  Playheads::advance(state);
+  EXPECT_EQ(Playheads::step(state, 0), 1);
+  state->removedSteps[3][0] = 1 << 2;
+  Playheads::markStale(state);
+  Playheads::advance(state);
+  EXPECT_EQ(Playheads::step(state, 0), 3);
+}
@@ -0,0 +1,100 @@
+#include "../Random.h"
+#include "../State.h"
+
+#include <gtest/gtest.h>
+
+class RandomTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      state = new State();
+      Random::seed(state, 12345);
+    }
+
+    void TearDown() override {
+      delete state;
+    }
+
+    State *state;
+};
+
+TEST_F(RandomTests, RepeatsTheSameNumbersFromTheSameSeed) {
+  uint32_t first[8];
+  for (uint8_t i = 0; i < 8; i++) {
+    first[i] = Random::next(state);
+  }
+  Random::seed(state, 12345);
+  for (uint8_t i = 0; i < 8; i++) {
+    EXPECT_EQ(Random::next(state), first[i]);
+  }
+}
+
+TEST_F(RandomTests, StaysBelowTheBound) {
+  for (uint32_t max : {1u, 2u, 3u, 255u, 4095u, 0x80000001u}) {
+    for (uint16_t i = 0; i < 1000; i++) {
+      EXPECT_LT(Random::below(state, max), max);
+    }
+  }
+  EXPECT_EQ(Random::below(state, 0), 0u);
+}
+
+TEST_F(RandomTests, ChoosesEveryNumberAsOftenAsAnyOther) {
+  // A bound of a third of 2^32, where taking the remainder would favor the low third twice over.
+  uint32_t const max = 0xAAAAAAAA;
+  uint32_t counts[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < 30000; i++) {
+    counts[Random::below(state, max) / (max / 3 + 1)] += 1;
+  }
+  for (uint32_t count : counts) {
+    EXPECT_GT(count, 9500u);
+    EXPECT_LT(count, 10500u);
+  }
+}
+
+TEST_F(RandomTests, FillsEveryChannelWithTheFullRangeOfVoltages) {
+  uint16_t lowest[8];
+  uint16_t highest[8];
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    lowest[channel] = MAX_UNSIGNED_12_BIT;
+    highest[channel] = 0;
+  }
+  for (uint32_t i = 0; i < 100000; i++) {
+    uint16_t values[8];
+    Random::voltages(state, values);
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      ASSERT_LE(values[channel], MAX_UNSIGNED_12_BIT);
+      lowest[channel] = std::min(lowest[channel], values[channel]);
+      highest[channel] = std::max(highest[channel], values[channel]);
+    }
+  }
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_LT(lowest[channel], 8);
+    EXPECT_GT(highest[channel], MAX_UNSIGNED_12_BIT - 8);
+  }
+}
+
+TEST_F(RandomTests, ComputesAnyStepFromTheSeedAlone) {
+  state->randomSeeds[3][5] = 777;
+  uint32_t atStep1000 = Random::atStep(state, 3, 5, 1000);
+  // Neither the generator nor the steps before it change a step's value.
+  Random::next(state);
+  Random::atStep(state, 3, 5, 999);
+  EXPECT_EQ(Random::atStep(state, 3, 5, 1000), atStep1000);
+  EXPECT_NE(Random::atStep(state, 3, 5, 1001), atStep1000);
+
+  state->randomSeeds[3][5] = 778;
+  EXPECT_NE(Random::atStep(state, 3, 5, 1000), atStep1000);
+}
+
+TEST_F(RandomTests, GivesChannelsWithTheSameSeedDifferentValues) {
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    state->randomSeeds[0][channel] = 42;
+  }
+  uint32_t values[8];
+  Random::allAtStep(state, 0, 7, values);
+  for (uint8_t channel = 0; channel < 8; channel++) {
+    EXPECT_EQ(values[channel], Random::atStep(state, 0, channel, 7));
+    for (uint8_t other = 0; other < channel; other++) {
+      EXPECT_NE(values[channel], values[other]);
+    }
+  }
+}
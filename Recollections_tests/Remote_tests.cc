@@ -0,0 +1,118 @@
+#include "../Remote.h"
+#include "../State.h"
+#include "../constants.h"
+#include "host/Simulator.h"
+#include "host/TempDir.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <gtest/gtest.h>
+
+#include <string>
+
+// In Recollections.ino.
+void setupFollowerBus();
+
+// The whole firmware, driven by a controller on the follower bus.
+class RemoteTests : public testing::Test {
+  protected:
+    void SetUp() override {
+      sdRoot = TempDir::create("recollections_remote_tests_");
+      ASSERT_FALSE(sdRoot.empty());
+      Serial.setEcho(false);
+      Simulator::begin(sdRoot.c_str());
+      Simulator::setup();
+      Simulator::run(10);
+    }
+
+    void TearDown() override {
+      TempDir::remove(sdRoot.c_str());
+    }
+
+    uint8_t send(RemoteCommandType_t type, uint8_t channel, uint16_t value) {
+      return sendTo(REMOTE_ADDRESS, type, channel, value);
+    }
+
+    uint8_t sendTo(uint8_t address, RemoteCommandType_t type, uint8_t channel, uint16_t value) {
+      controller.beginTransmission(address);
+      controller.write(type);
+      controller.write(channel);
+      controller.write(value >> 8);
+      controller.write(value & 0xFF);
+      return controller.endTransmission();
+    }
+
+    uint16_t readOutput(uint8_t channel) {
+      send(REMOTE_COMMAND.READ_OUTPUT, channel, 0);
+      if (controller.requestFrom(REMOTE_ADDRESS, 2) != 2) {
+        return 0xFFFF;
+      }
+      uint16_t value = controller.read() << 8;
+      return value | controller.read();
+    }
+
+    TwoWire controller;
+    std::string sdRoot;
+};
+
+TEST_F(RemoteTests, SetsAVoltageAndReadsBackTheOutput) {
+  ASSERT_EQ(send(REMOTE_COMMAND.SET_VOLTAGE, 2, 3000), 0);
+  EXPECT_EQ(Simulator::state()->voltages[0][0][2], VOLTAGE_VALUE_MID);
+  Simulator::run(5);
+  EXPECT_EQ(Simulator::state()->voltages[0][0][2], 3000);
+  EXPECT_EQ(Simulator::output(2), 3000);
+  EXPECT_EQ(readOutput(2), 3000);
+  EXPECT_EQ(readOutput(0), VOLTAGE_VALUE_MID);
+}
+
+TEST_F(RemoteTests, SelectsAPresetAndABank) {
+  State *state = Simulator::state();
+  state->voltages[4][7][0] = 1234;
+  send(REMOTE_COMMAND.SELECT_BANK, 0, 4);
+  send(REMOTE_COMMAND.SELECT_PRESET, 0, 7);
+  // Out of range.
+  send(REMOTE_COMMAND.SELECT_PRESET, 0, 16);
+  Simulator::run(5);
+  EXPECT_EQ(state->currentBank, 4);
+  EXPECT_EQ(state->currentPreset, 7);
+  EXPECT_EQ(readOutput(0), 1234);
+}
+
+TEST_F(RemoteTests, RecordsAsTheRecInputDoes) {
+  State *state = Simulator::state();
+  Bits::set(&state->autoRecordChannels[0], 1, true);
+  Simulator::setCV(2500);
+  Simulator::run(20);
+  send(REMOTE_COMMAND.RECORD, 0, 0);
+  Simulator::run(5);
+  EXPECT_EQ(state->voltages[0][0][1], 2500);
+  EXPECT_EQ(state->voltages[0][0][0], VOLTAGE_VALUE_MID);
+}
+
+TEST_F(RemoteTests, DropsCommandsBeyondTheBufferWithoutWaiting) {
+  State *state = Simulator::state();
+  for (uint8_t i = 0; i < REMOTE_COMMAND_BUFFER_SIZE + 6; i++) {
+    send(REMOTE_COMMAND.SELECT_PRESET, 0, i % 16);
+  }
+  // Not a whole command.
+  controller.beginTransmission(REMOTE_ADDRESS);
+  controller.write(REMOTE_COMMAND.SELECT_BANK);
+  controller.endTransmission();
+  EXPECT_EQ(state->remote.droppedCommands, 7u);
+
+  Simulator::run(5);
+  EXPECT_EQ(state->currentPreset, (REMOTE_COMMAND_BUFFER_SIZE - 1) % 16);
+  EXPECT_EQ(state->remote.commandCount, REMOTE_COMMAND_BUFFER_SIZE + 7u);
+}
+
+TEST_F(RemoteTests, LinkedFollowerTakesCommandsAtItsOwnAddress) {
+  State *state = Simulator::state();
+  state->config.linkModuleCount = 2;
+  state->config.linkPosition = 1;
+  setupFollowerBus();
+  EXPECT_NE(send(REMOTE_COMMAND.SELECT_BANK, 0, 2), 0);
+  EXPECT_EQ(sendTo(LINK_FOLLOWER_ADDRESS, REMOTE_COMMAND.SELECT_BANK, 0, 2), 0);
+  Simulator::run(5);
+  EXPECT_EQ(state->currentBank, 2);
+  EXPECT_EQ(state->remote.droppedCommands, 0u);
+}
@@ -17,4 +17,70 @@ TEST(UtilsTests, BasicAssertions) {
   EXPECT_EQ(Utils::keyQuadrant(15), QUADRANT.SE);
 
   EXPECT_EQ(Utils::keyQuadrant(16), QUADRANT.INVALID);
-}
\ No newline at end of file
+}
+
+// Utils::voltageValue(), for inactive voltages on a CV channel
+TEST(UtilsTests, VoltageValueOfInactivePresets) {
+  static State state;
+  state.currentBank = 2;
+  state.config.randomOutputOverwrites = 1;
+  state.gateChannels[2] = CHANNEL_FLAGS_NONE;
+  state.randomOutputChannels[2] = CHANNEL_FLAGS_NONE;
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    state.activeVoltages[2][preset] = CHANNEL_FLAGS_ALL;
+    state.randomVoltages[2][preset] = CHANNEL_FLAGS_NONE;
+    state.voltages[2][preset][4] = preset * 100;
+    state.voltages[2][preset][5] = preset * 100;
+  }
+  ResolvedPresets::markAllStale(&state);
+  EXPECT_EQ(Utils::voltageValue(&state, 4, 5), 400);
+
+  // Presets 5 to 7 rest on the value of preset 4, and presets 0 and 1 wrap around to preset 15.
+  for (uint8_t preset : {0, 1, 5, 6, 7}) {
+    Bits::set(&state.activeVoltages[2][preset], 5, false);
+  }
+  ResolvedPresets::markStale(&state, 2);
+  EXPECT_EQ(Utils::voltageValue(&state, 5, 5), 400);
+  EXPECT_EQ(Utils::voltageValue(&state, 7, 5), 400);
+  EXPECT_EQ(Utils::voltageValue(&state, 8, 5), 800);
+  EXPECT_EQ(Utils::voltageValue(&state, 1, 5), 1500);
+  EXPECT_EQ(Utils::voltageValue(&state, 7, 4), 700);
+
+  // With only the next preset active, the search of the 14 earlier presets finds nothing, and the
+  // voltage outputs its own value.
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    Bits::set(&state.activeVoltages[2][preset], 5, preset == 9);
+  }
+  ResolvedPresets::markStale(&state, 2);
+  EXPECT_EQ(Utils::voltageValue(&state, 8, 5), 800);
+  EXPECT_EQ(Utils::voltageValue(&state, 12, 5), 900);
+}
+
+// Utils::voltageValue(), after a change of bank, which the resolved presets are rebuilt for
+TEST(UtilsTests, VoltageValueAfterChangingBanks) {
+  static State state;
+  state.config.randomOutputOverwrites = 1;
+  for (uint8_t bank : {2, 3}) {
+    state.gateChannels[bank] = CHANNEL_FLAGS_NONE;
+    state.randomOutputChannels[bank] = CHANNEL_FLAGS_NONE;
+    for (uint8_t preset = 0; preset < 16; preset++) {
+      state.activeVoltages[bank][preset] = CHANNEL_FLAGS_ALL;
+      state.randomVoltages[bank][preset] = CHANNEL_FLAGS_NONE;
+      state.voltages[bank][preset][0] = bank * 1000 + preset;
+    }
+  }
+  Bits::set(&state.activeVoltages[3][6], 0, false);
+  ResolvedPresets::markAllStale(&state);
+
+  state.currentBank = 2;
+  EXPECT_EQ(Utils::voltageValue(&state, 6, 0), 2006);
+  state.currentBank = 3;
+  EXPECT_EQ(Utils::voltageValue(&state, 6, 0), 3005);
+
+  // A change to a bank other than the one in the table leaves the table as it is.
+  Bits::set(&state.activeVoltages[2][6], 0, false);
+  ResolvedPresets::markStale(&state, 2);
+  EXPECT_EQ(Utils::voltageValue(&state, 6, 0), 3005);
+  state.currentBank = 2;
+  EXPECT_EQ(Utils::voltageValue(&state, 6, 0), 2005);
+}
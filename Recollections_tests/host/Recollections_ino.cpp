@@ -0,0 +1,7 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ *
+ * Compiles the sketch as C++ on the host, where the Arduino IDE is not around to do it.
+ */
+
+#include "../../Recollections.ino"
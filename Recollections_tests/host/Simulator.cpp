@@ -0,0 +1,263 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Simulator.h"
+
+#include <Arduino.h>
+#include <SDFS.h>
+#include <Wire.h>
+#include <pico/time.h>
+
+#include <deque>
+#include <new>
+
+#include "constants.h"
+
+// Defined in Recollections.ino.
+extern State state;
+void setup();
+void loop();
+void setup1();
+void loop1();
+
+namespace {
+  typedef enum TraceInput {
+    TRACE_GATE,
+    TRACE_CV,
+    TRACE_PRESS,
+    TRACE_RELEASE,
+  } TraceInput;
+
+  typedef struct TraceEvent {
+    uint64_t atMicros;
+    TraceInput input;
+    uint8_t pin;
+    uint16_t value;
+  } TraceEvent;
+
+  std::deque<TraceEvent> trace;
+  repeating_timer_t core1Timer;
+  unsigned long loopPeriod = 1000;
+  unsigned long loopCount = 0;
+
+  /** The inputs whose circuits invert the gate, so that a high gate reads as LOW. */
+  bool isInverted(uint8_t pin) {
+    return pin == ADV_INPUT || pin == MOD_INPUT || pin == REC_INPUT;
+  }
+
+  /** The key number that the NeoTrellis reports for a key, given the controller orientation. */
+  uint8_t trellisKey(uint8_t key) {
+    return state.config.controllerOrientation ? key : 15 - key;
+  }
+
+  bool parseGate(const char *name, uint8_t *pin) {
+    struct {
+      const char *name;
+      uint8_t pin;
+    } const gates[] = {
+      {"adv", ADV_INPUT},
+      {"mod", MOD_INPUT},
+      {"rec", REC_INPUT},
+      {"rev", REV_INPUT},
+      {"reset", RESET_INPUT},
+      {"bank_adv", BANK_ADV_INPUT},
+      {"bank_rev", BANK_REV_INPUT},
+    };
+    for (auto const &gate : gates) {
+      if (strcmp(name, gate.name) == 0) {
+        *pin = gate.pin;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool runCore1(repeating_timer_t * /* timer */) {
+    ::loop1();
+    return true;
+  }
+
+  void applyTraceEvent(TraceEvent const &event) {
+    switch (event.input) {
+      case TRACE_GATE:
+        Simulator::setGate(event.pin, event.value != 0);
+        break;
+      case TRACE_CV:
+        Simulator::setCV(event.value);
+        break;
+      case TRACE_PRESS:
+        Simulator::pressKey(event.pin);
+        break;
+      case TRACE_RELEASE:
+        Simulator::releaseKey(event.pin);
+        break;
+    }
+  }
+}
+
+void Simulator::begin(const char *sdRoot) {
+  // A power cut loses everything in RAM, including open files.
+  ::state.~State();
+  new (&::state) State();
+
+  HostBoard::reset();
+  // The module leaves any bus it had joined as a target.
+  Wire1.end();
+  SDFS.setRoot(sdRoot);
+  SDFS.resetStats();
+  trace.clear();
+  loopCount = 0;
+
+  // Nothing is patched into the jacks and no key is pressed.
+  uint8_t const gates[] = {
+    ADV_INPUT, MOD_INPUT, REC_INPUT, REV_INPUT, RESET_INPUT, BANK_ADV_INPUT, BANK_REV_INPUT
+  };
+  for (uint8_t pin : gates) {
+    Simulator::setGate(pin, false);
+  }
+  HostBoard::setDigital(TRELLIS_INTERRUPT_INPUT, HIGH);
+}
+
+void Simulator::setup() {
+  ::setup();
+  ::setup1();
+  // The second core spins in loop1(), which only does any work every OUTPUT_TIMER_PERIOD_MICROS.
+  // On the host, loop1() runs at those times only, as the clock passes them.
+  add_repeating_timer_us(-OUTPUT_TIMER_PERIOD_MICROS, runCore1, nullptr, &core1Timer);
+}
+
+void Simulator::loop() {
+  uint64_t now = HostBoard::nowMicros();
+  while (!trace.empty() && trace.front().atMicros <= now) {
+    applyTraceEvent(trace.front());
+    trace.pop_front();
+  }
+  HostBoard::setDigital(
+    TRELLIS_INTERRUPT_INPUT,
+    ::state.config.trellis.hasKeyEvents() ? LOW : HIGH
+  );
+
+  ::loop();
+
+  loopCount += 1;
+  HostBoard::advanceMicros(loopPeriod);
+}
+
+void Simulator::run(unsigned long ms) {
+  uint64_t end = HostBoard::nowMicros() + static_cast<uint64_t>(ms) * 1000;
+  while (HostBoard::nowMicros() < end) {
+    Simulator::loop();
+  }
+}
+
+void Simulator::setLoopPeriod(unsigned long us) {
+  loopPeriod = us;
+}
+
+void Simulator::setGate(uint8_t pin, bool isHigh) {
+  HostBoard::setDigital(pin, isHigh != isInverted(pin) ? HIGH : LOW);
+}
+
+void Simulator::setCV(uint16_t value) {
+  HostBoard::setAnalog(CV_INPUT, value);
+}
+
+void Simulator::pressKey(uint8_t key) {
+  ::state.config.trellis.pushKeyEvent(trellisKey(key), SEESAW_KEYPAD_EDGE_RISING);
+}
+
+void Simulator::releaseKey(uint8_t key) {
+  ::state.config.trellis.pushKeyEvent(trellisKey(key), SEESAW_KEYPAD_EDGE_FALLING);
+}
+
+bool Simulator::loadTrace(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Could not open trace %s\n", path);
+    return false;
+  }
+
+  uint64_t start = HostBoard::nowMicros();
+  std::deque<TraceEvent> events;
+  char line[128];
+  unsigned int lineNumber = 0;
+  bool success = true;
+  while (fgets(line, sizeof(line), file)) {
+    lineNumber += 1;
+    char *cursor = line;
+    while (*cursor == ' ' || *cursor == '\t') {
+      cursor++;
+    }
+    if (*cursor == '#' || *cursor == '\n' || *cursor == '\r' || *cursor == '\0') {
+      continue;
+    }
+
+    unsigned long ms;
+    char name[16];
+    long value;
+    if (sscanf(cursor, "%lu %15s %ld", &ms, name, &value) != 3 || value < 0) {
+      fprintf(stderr, "%s:%u: expected <ms> <input> <value>\n", path, lineNumber);
+      success = false;
+      break;
+    }
+
+    TraceEvent event = {start + static_cast<uint64_t>(ms) * 1000, TRACE_GATE, 0, 0};
+    if (parseGate(name, &event.pin)) {
+      event.value = value != 0;
+    } else if (strcmp(name, "cv") == 0 && value <= MAX_UNSIGNED_12_BIT) {
+      event.input = TRACE_CV;
+      event.value = value;
+    } else if (strcmp(name, "press") == 0 && value < 16) {
+      event.input = TRACE_PRESS;
+      event.pin = value;
+    } else if (strcmp(name, "release") == 0 && value < 16) {
+      event.input = TRACE_RELEASE;
+      event.pin = value;
+    } else {
+      fprintf(stderr, "%s:%u: unknown input or value out of range\n", path, lineNumber);
+      success = false;
+      break;
+    }
+    events.push_back(event);
+  }
+  fclose(file);
+
+  if (!success) {
+    return false;
+  }
+  // Events are applied in time order, and in file order when they share a time.
+  for (TraceEvent const &event : events) {
+    auto position = trace.end();
+    while (position != trace.begin() && (position - 1)->atMicros > event.atMicros) {
+      position--;
+    }
+    trace.insert(position, event);
+  }
+  return true;
+}
+
+bool Simulator::isTracePending() {
+  return !trace.empty();
+}
+
+uint16_t Simulator::output(uint8_t channel) {
+  if (channel > 7) {
+    return 0;
+  }
+  return channel < 4
+    ? ::state.config.dac1.getValue(channel)
+    : ::state.config.dac2.getValue(channel - 4);
+}
+
+uint32_t Simulator::keyColor(uint8_t key) {
+  return ::state.config.trellis.pixels.getShownColor(trellisKey(key));
+}
+
+unsigned long Simulator::loops() {
+  return loopCount;
+}
+
+State *Simulator::state() {
+  return &::state;
+}
@@ -0,0 +1,147 @@
+/**
+ * Recollections: Simulator
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "State.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_SIMULATOR_H_
+#define RECOLLECTIONS_SIMULATOR_H_
+
+/**
+ * Runs the firmware's setup() and loop() on the host, so the real loop can be profiled and
+ * regression tested on a workstation.
+ *
+ * The hardware abstraction is the set of Arduino core and library headers the firmware already
+ * includes: Arduino.h for the clock, GPIO and the ADC, Adafruit_MCP4728.h for the DACs,
+ * Adafruit_NeoTrellis.h for the keys and their LEDs, and SD.h and SDFS.h for the file system. On
+ * the device these are provided by arduino-pico or Teensyduino and the Adafruit libraries. On the
+ * host they are provided by the files in host/hal, so the firmware compiles unchanged.
+ *
+ * The firmware's second core, which on the RP2040 runs setup1() and loop1(), runs on the same
+ * thread as the first. setup1() runs after setup(), and loop1() runs between loops, as the clock
+ * passes each time it has work to do.
+ *
+ * The simulated SD card is a directory. The clock only moves when the simulator moves it, by a
+ * fixed period per loop plus any delay() in the firmware, so runs are deterministic. Inputs are
+ * set directly or replayed from a trace file, one event per line:
+ *
+ *   <ms> <input> <value>
+ *
+ * where ms is the time since the trace was loaded, and input is one of:
+ *
+ *   adv, mod, rec, rev, reset, bank_adv, bank_rev   gate or button, 1 for high and 0 for low
+ *   cv                                              12-bit value on the CV input
+ *   press, release                                  key number, 0-15
+ *
+ * Blank lines and lines starting with # are ignored.
+ */
+typedef struct Simulator {
+  /**
+   * @brief Power up the board: reset the clock, the inputs and the global state, and insert an SD
+   * card backed by a directory. Call setup() next, as the device would.
+   *
+   * @param sdRoot An existing directory.
+   */
+  static void begin(const char *sdRoot);
+
+  /**
+   * @brief Run the firmware's setup(), then the second core's setup1(), and start running loop1().
+   */
+  static void setup();
+
+  /**
+   * @brief Run one iteration of the firmware's loop(), after applying any trace events that are
+   * due, then advance the clock by the loop period.
+   */
+  static void loop();
+
+  /**
+   * @brief Run loop() until the clock has advanced by at least ms.
+   *
+   * @param ms
+   */
+  static void run(unsigned long ms);
+
+  /**
+   * @brief Set the time the clock advances after each loop. Defaults to 1000 us.
+   *
+   * @param us
+   */
+  static void setLoopPeriod(unsigned long us);
+
+  /**
+   * @brief Set a gate input or the MOD button, as seen at the jack or the button. The inversion of
+   * the ADV, MOD and REC inputs by their input circuits is handled here.
+   *
+   * @param pin One of the *_INPUT pins. See constants.h.
+   * @param isHigh
+   */
+  static void setGate(uint8_t pin, bool isHigh);
+
+  /**
+   * @brief Set the voltage at the CV input.
+   *
+   * @param value A 12-bit value.
+   */
+  static void setCV(uint16_t value);
+
+  /**
+   * @brief Press or release a key. The event is read on the next loop.
+   *
+   * @param key 0-15, in the orientation of the screens rather than of the NeoTrellis.
+   */
+  static void pressKey(uint8_t key);
+  static void releaseKey(uint8_t key);
+
+  /**
+   * @brief Read a trace file. Its events are replayed by loop(), relative to the time of loading.
+   *
+   * @param path
+   * @return true
+   * @return false if the file cannot be read or has a malformed line, which is reported on stderr.
+   */
+  static bool loadTrace(const char *path);
+
+  /**
+   * @brief Whether events remain in the trace.
+   *
+   * @return true
+   * @return false
+   */
+  static bool isTracePending();
+
+  /**
+   * @brief The value on an output, as last written to the DACs.
+   *
+   * @param channel 0-7.
+   * @return uint16_t
+   */
+  static uint16_t output(uint8_t channel);
+
+  /**
+   * @brief The color visible on a key, as 0xRRGGBB.
+   *
+   * @param key 0-15, in the orientation of the screens rather than of the NeoTrellis.
+   * @return uint32_t
+   */
+  static uint32_t keyColor(uint8_t key);
+
+  /**
+   * @brief The number of loops run since begin().
+   *
+   * @return unsigned long
+   */
+  static unsigned long loops();
+
+  /**
+   * @brief The firmware's global state.
+   *
+   * @return State*
+   */
+  static State *state();
+} Simulator;
+
+#endif
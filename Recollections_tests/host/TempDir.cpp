@@ -0,0 +1,33 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "TempDir.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace {
+  int removeEntry(
+    const char *path,
+    const struct stat * /* info */,
+    int /* type */,
+    struct FTW * /* ftw */
+  ) {
+    return ::remove(path);
+  }
+}
+
+std::string TempDir::create(const char *prefix) {
+  const char *base = getenv("TMPDIR");
+  std::string pattern = std::string(base && *base ? base : "/tmp") + "/" + prefix + "XXXXXX";
+  std::vector<char> path(pattern.begin(), pattern.end());
+  path.push_back('\0');
+  return mkdtemp(path.data()) ? std::string(path.data()) : std::string();
+}
+
+void TempDir::remove(const char *path) {
+  nftw(path, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -0,0 +1,32 @@
+/**
+ * Recollections: TempDir
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <string>
+
+#ifndef RECOLLECTIONS_TEMP_DIR_H_
+#define RECOLLECTIONS_TEMP_DIR_H_
+
+/**
+ * Scratch directories on the host, used as blank SD cards by the tests and benchmarks.
+ */
+typedef struct TempDir {
+  /**
+   * @brief Create a new, empty directory under the system's temporary directory.
+   *
+   * @param prefix
+   * @return std::string The path, or an empty string on failure.
+   */
+  static std::string create(const char *prefix);
+
+  /**
+   * @brief Delete a directory and everything in it.
+   *
+   * @param path
+   */
+  static void remove(const char *path);
+} TempDir;
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ *
+ * link_benchmark: a follower of two linked modules, stepped by a simulated leader on the follower
+ * bus. See Link.h. The first table is the latency from the edge at the leader's ADV input to the
+ * follower's outputs and to its state, in simulated time, for two kinds of step:
+ *
+ *   expected    the step the follower was told would come next, already loaded into its DACs
+ *   unexpected  any other step, as after a change of direction, which waits for the loop
+ *
+ * Each edge falls at a different point of the follower's 1 ms loop. Only the steps on the
+ * follower's own page are measured, as it holds its outputs through the leader's.
+ *
+ * The second table sends bursts of messages with no loop in between, as a follower would receive
+ * them while writing to the SD card, and counts the messages applied and dropped, and the host
+ * time to receive and apply each. Bursts are shorter than the 256 messages it takes for the
+ * sequence numbers to wrap. The bus carries a message every LINK_MESSAGE_TRANSFER_MICROS.
+ *
+ *   link_benchmark [steps per kind]
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include <chrono>
+
+#include "Link.h"
+#include "Simulator.h"
+#include "TempDir.h"
+#include "constants.h"
+
+// In Recollections.ino.
+void setupFollowerBus();
+
+namespace {
+  /** The time between polls of the outputs, and the follower's loop period. */
+  uint32_t const POLL_MICROS = 10;
+  uint32_t const LOOP_MICROS = 1000;
+
+  TwoWire leader;
+  uint8_t sequence = 0;
+  uint64_t nextLoopMicros = 0;
+
+  void send(LinkMessageType_t type, uint16_t value, uint16_t nextValue) {
+    LinkMessage message;
+    message.type = type;
+    message.sequence = sequence++;
+    message.value = value;
+    message.nextValue = nextValue;
+    message.ageMicros = 0;
+    leader.beginTransmission(LINK_FOLLOWER_ADDRESS);
+    leader.write(reinterpret_cast<uint8_t *>(&message), sizeof(LinkMessage));
+    leader.endTransmission();
+  }
+
+  /** Advance the clock by one poll, and run the loop if it is due. */
+  void poll() {
+    HostBoard::advanceMicros(POLL_MICROS);
+    if (HostBoard::nowMicros() >= nextLoopMicros) {
+      Simulator::loop();
+      nextLoopMicros += LOOP_MICROS;
+    }
+  }
+
+  typedef struct Latencies {
+    uint64_t totalMicros = 0;
+    uint32_t maxMicros = 0;
+    uint32_t count = 0;
+
+    void add(uint32_t micros) {
+      totalMicros += micros;
+      maxMicros = micros > maxMicros ? micros : maxMicros;
+      count++;
+    }
+  } Latencies;
+
+  void runSteps(const char *name, bool isExpected, uint32_t steps) {
+    State *state = Simulator::state();
+    Latencies outputs;
+    Latencies presets;
+    uint16_t step = 0;
+    for (uint32_t i = 0; i < steps; i++) {
+      step = (step + 1) % 32;
+      uint16_t nextStep = (step + (isExpected ? 1 : 2)) % 32;
+      uint8_t preset = step % 16;
+      // Spread the edges across the loop, by a period prime to it.
+      uint32_t waitMicros = 2 * LOOP_MICROS + (i * 170) % LOOP_MICROS;
+      uint64_t edgeMicros = HostBoard::nowMicros() + waitMicros;
+      while (HostBoard::nowMicros() + LINK_MESSAGE_TRANSFER_MICROS < edgeMicros) {
+        poll();
+      }
+      HostBoard::advanceMicros(edgeMicros + LINK_MESSAGE_TRANSFER_MICROS - HostBoard::nowMicros());
+      send(LINK_MESSAGE.STEP, step, nextStep);
+      if (step < 16) {
+        continue;
+      }
+
+      uint16_t const expectedValue = 100 * (preset + 1);
+      bool hasOutput = false;
+      bool hasPreset = false;
+      while (!hasOutput || !hasPreset) {
+        if (!hasOutput && Simulator::output(0) == expectedValue) {
+          outputs.add(HostBoard::nowMicros() - edgeMicros);
+          hasOutput = true;
+        }
+        if (!hasPreset && state->currentPreset == preset) {
+          presets.add(HostBoard::nowMicros() - edgeMicros);
+          hasPreset = true;
+        }
+        poll();
+      }
+    }
+    printf(
+      "%-12s %8u %14.0f %14u %14.0f %14u\n",
+      name,
+      outputs.count,
+      static_cast<double>(outputs.totalMicros) / outputs.count,
+      outputs.maxMicros,
+      static_cast<double>(presets.totalMicros) / presets.count,
+      presets.maxMicros
+    );
+  }
+
+  void runBurst(uint32_t messages) {
+    State *state = Simulator::state();
+    uint32_t const applied = state->link.messageCount;
+    uint32_t const missed = state->link.missedMessages;
+    auto const wallStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < messages; i++) {
+      uint16_t step = 16 + i % 16;
+      send(LINK_MESSAGE.STEP, step, 16 + (step + 1) % 16);
+    }
+    Simulator::loop();
+    double const seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wallStart
+    ).count();
+    // The dropped messages are counted by the gap before the next message that arrives.
+    send(LINK_MESSAGE.STEP, 16, 17);
+    Simulator::loop();
+    printf(
+      "%-8u %10u %10u %14.3f\n",
+      messages,
+      state->link.messageCount - applied - 1,
+      state->link.missedMessages - missed,
+      seconds * 1e6 / messages
+    );
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t steps = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+  if (steps == 0) {
+    fprintf(stderr, "usage: link_benchmark [steps per kind]\n");
+    return 2;
+  }
+
+  std::string sdRoot = TempDir::create("recollections_link_benchmark_");
+  if (sdRoot.empty()) {
+    fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+
+  Serial.setEcho(false);
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  State *state = Simulator::state();
+  state->config.linkModuleCount = 2;
+  state->config.linkPosition = 1;
+  setupFollowerBus();
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    state->voltages[0][preset][0] = 100 * (preset + 1);
+  }
+  // Let setup settle, then run the loop on the benchmark's own schedule.
+  Simulator::run(100);
+  Simulator::setLoopPeriod(0);
+  nextLoopMicros = HostBoard::nowMicros();
+
+  printf("%u steps per kind, a %u us loop, latencies in simulated us\n", steps, LOOP_MICROS);
+  printf(
+    "%-12s %8s %14s %14s %14s %14s\n",
+    "step", "count", "outputs avg", "outputs max", "preset avg", "preset max"
+  );
+  runSteps("expected", true, steps);
+  runSteps("unexpected", false, steps);
+  printf("Latencies are from the edge at the leader, to within %u us.\n\n", POLL_MICROS);
+
+  printf("%-8s %10s %10s %14s\n", "burst", "applied", "dropped", "host us/msg");
+  for (uint32_t messages : {4u, 16u, 17u, 64u, 128u}) {
+    runBurst(messages);
+  }
+  printf(
+    "The buffer holds %u messages. The bus carries at most %.0f messages/s to one follower.\n",
+    LINK_MESSAGE_BUFFER_SIZE,
+    1e6 / LINK_MESSAGE_TRANSFER_MICROS
+  );
+
+  TempDir::remove(sdRoot.c_str());
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ *
+ * loop_benchmark: how many iterations of the firmware's loop() run per second on the host, and the
+ * I2C and SD card traffic per iteration, in four scenarios:
+ *
+ *   idle       nothing patched, nothing pressed
+ *   clocked    a 16th note clock on ADV at 120 BPM
+ *   recording  the same clock, with REC held high and a moving CV recorded on every channel
+ *   remote     the same clock, with a controller setting voltages on the follower bus as fast as
+ *              the bus carries commands, REMOTE_COMMANDS_PER_LOOP per loop. See Remote.h.
+ *
+ * Host speed says little about the speed on the device, but the ratio between two builds of the
+ * firmware does, as does the traffic, which is the same on both. A second table breaks each
+ * scenario down by the phases of the loop, from LoopProfiler.
+ *
+ *   loop_benchmark [loops per scenario]
+ */
+
+#include <Arduino.h>
+#include <SDFS.h>
+#include <Wire.h>
+
+#include <chrono>
+
+#include "LoopProfiler.h"
+#include "Simulator.h"
+#include "TempDir.h"
+#include "constants.h"
+
+namespace {
+  typedef enum Scenario {
+    SCENARIO_IDLE,
+    SCENARIO_CLOCKED,
+    SCENARIO_RECORDING,
+    SCENARIO_REMOTE,
+    SCENARIO_COUNT,
+  } Scenario;
+
+  const char *const PHASE_NAMES[LOOP_PHASE_COUNT] = {
+    "flashTiming", "trellisRead", "handleInput", "record", "reflectState", "save", "loop",
+  };
+
+  /**
+   * A command is the address byte and REMOTE_COMMAND_BYTES, 9 bits each on the bus, so a 1 ms loop
+   * is as long as 8 commands at 400 kHz.
+   */
+  uint8_t const REMOTE_COMMANDS_PER_LOOP = 8;
+
+  TwoWire controller;
+
+  /** Indices are [Scenario]. */
+  const char *scenarioNames[SCENARIO_COUNT];
+  LoopProfiler profiles[SCENARIO_COUNT];
+
+  void runScenario(const char *name, Scenario scenario, unsigned long loops) {
+    State *state = Simulator::state();
+    if (scenario == SCENARIO_RECORDING) {
+      state->autoRecordChannels[state->currentBank] = CHANNEL_FLAGS_ALL;
+      Simulator::setGate(REC_INPUT, true);
+    }
+
+    state->config.dac1.resetStats();
+    state->config.dac2.resetStats();
+    state->config.trellis.pixels.resetStats();
+    SDFS.resetStats();
+    LoopProfiler::reset(&state->profiler);
+    auto const wallStart = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < loops; i++) {
+      if (scenario != SCENARIO_IDLE) {
+        // One loop per ms: a 10 ms gate every 125 ms.
+        unsigned long phase = i % 125;
+        if (phase == 0) {
+          Simulator::setGate(ADV_INPUT, true);
+        } else if (phase == 10) {
+          Simulator::setGate(ADV_INPUT, false);
+        }
+        Simulator::setCV(static_cast<uint16_t>((i * 7) & MAX_UNSIGNED_12_BIT));
+      }
+      if (scenario == SCENARIO_REMOTE) {
+        for (uint8_t j = 0; j < REMOTE_COMMANDS_PER_LOOP; j++) {
+          uint16_t value = (i * 13 + j * 501) & MAX_UNSIGNED_12_BIT;
+          controller.beginTransmission(REMOTE_ADDRESS);
+          controller.write(REMOTE_COMMAND.SET_VOLTAGE);
+          controller.write(j);
+          controller.write(value >> 8);
+          controller.write(value & 0xFF);
+          controller.endTransmission();
+        }
+      }
+      Simulator::loop();
+    }
+    double const seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wallStart
+    ).count();
+    scenarioNames[scenario] = name;
+    profiles[scenario] = state->profiler;
+
+    Simulator::setGate(ADV_INPUT, false);
+    Simulator::setGate(REC_INPUT, false);
+    state->autoRecordChannels[state->currentBank] = CHANNEL_FLAGS_NONE;
+
+    double const perLoop = 1.0 / loops;
+    printf(
+      "%-10s %12.0f %10.3f %10.2f %10.2f %10.3f %10.2f\n",
+      name,
+      loops / seconds,
+      seconds * 1e6 * perLoop,
+      (state->config.dac1.getBytes() + state->config.dac2.getBytes()) * perLoop,
+      state->config.trellis.pixels.getPixelWrites() * perLoop,
+      state->config.trellis.pixels.getShows() * perLoop,
+      (SDFS.stats.bytesRead + SDFS.stats.bytesWritten) * perLoop
+    );
+  }
+
+  void printPhases(Scenario scenario) {
+    for (LoopPhase_t phase = 0; phase < LOOP_PHASE_COUNT; phase++) {
+      PhaseProfile *profile = &profiles[scenario].phases[phase];
+      // The host cycle counter counts nanoseconds.
+      printf(
+        "%-10s %-12s %10.3f %10.3f %10.3f %10.3f\n",
+        phase == 0 ? scenarioNames[scenario] : "",
+        PHASE_NAMES[phase],
+        LoopProfiler::percentile(profile, 50) / 1e3,
+        LoopProfiler::percentile(profile, 90) / 1e3,
+        LoopProfiler::percentile(profile, 99) / 1e3,
+        profile->maxCycles / 1e3
+      );
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long loops = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+  if (loops == 0) {
+    fprintf(stderr, "usage: loop_benchmark [loops per scenario]\n");
+    return 2;
+  }
+
+  std::string sdRoot = TempDir::create("recollections_loop_benchmark_");
+  if (sdRoot.empty()) {
+    fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+
+  Serial.setEcho(false);
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+  // Let setup settle, including the first frame and the first write of every output.
+  Simulator::run(100);
+
+  printf("%lu loops per scenario, 1 ms per loop of simulated time\n", loops);
+  printf(
+    "%-10s %12s %10s %10s %10s %10s %10s\n",
+    "scenario", "loops/s", "us/loop", "DAC B", "pixels", "shows", "SD B"
+  );
+  runScenario("idle", SCENARIO_IDLE, loops);
+  runScenario("clocked", SCENARIO_CLOCKED, loops);
+  runScenario("recording", SCENARIO_RECORDING, loops);
+  runScenario("remote", SCENARIO_REMOTE, loops);
+  printf("DAC B, pixels, shows and SD B are per loop.\n\n");
+
+  printf("%-10s %-12s %10s %10s %10s %10s\n", "scenario", "phase", "p50 us", "p90 us", "p99 us",
+    "max us");
+  for (uint8_t scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+    printPhases(static_cast<Scenario>(scenario));
+  }
+  printf("Percentiles are to within 25%%.\n");
+
+  TempDir::remove(sdRoot.c_str());
+  return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ *
+ * module_switch_benchmark: the cost of SDCard::readModuleDirectory(), which runs on every module
+ * switch, for each layout a module directory can have on the card:
+ *
+ *   Module.bin   the single module image
+ *   Bank_n.bin   Module.txt plus 16 binary bank files, the layout before the module image
+ *   Bank_n.txt   Module.txt plus 16 JSON bank files, the original layout
+ *
+ * Each layout holds the same data, and each read is checked against it. The file opens and the
+ * bytes read are the same on the device. The time is host time, so only the ratios carry over.
+ *
+ *   module_switch_benchmark [switches per layout]
+ */
+
+#include <Arduino.h>
+#include <SDFS.h>
+
+#include <chrono>
+#include <string>
+
+#include "ModuleImage.h"
+#include "SDCard.h"
+#include "Simulator.h"
+#include "TempDir.h"
+#include "constants.h"
+
+namespace {
+  State expected;
+
+  void fillState(State *state) {
+    for (uint8_t bank = 0; bank < 16; bank++) {
+      state->autoRecordChannels[bank] = bank;
+      state->gateChannels[bank] = bank * 3;
+      state->randomInputChannels[bank] = 0;
+      state->randomOutputChannels[bank] = 0;
+      for (uint8_t preset = 0; preset < 16; preset++) {
+        state->activeVoltages[bank][preset] = ~(bank ^ preset);
+        state->gateVoltages[bank][preset] = bank ^ preset;
+        state->lockedVoltages[bank][preset] = preset;
+        state->randomVoltages[bank][preset] = 0;
+        for (uint8_t channel = 0; channel < 8; channel++) {
+          state->voltages[bank][preset][channel] =
+            (bank * 256 + preset * 16 + channel * 2) & MAX_UNSIGNED_12_BIT;
+        }
+      }
+    }
+    state->currentBank = 3;
+    state->currentPreset = 5;
+    state->currentChannel = 7;
+    for (uint8_t preset = 0; preset < 16; preset++) {
+      state->removedPresets[preset] = preset == 15;
+    }
+  }
+
+  /** Zero everything matchesExpected() compares, so a layout that reads nothing fails the check. */
+  void clearState(State *state) {
+    memset(state->voltages, 0, sizeof(state->voltages));
+    memset(state->activeVoltages, 0, sizeof(state->activeVoltages));
+    memset(state->gateVoltages, 0, sizeof(state->gateVoltages));
+    memset(state->lockedVoltages, 0, sizeof(state->lockedVoltages));
+    memset(state->gateChannels, 0, sizeof(state->gateChannels));
+    memset(state->removedPresets, 0, sizeof(state->removedPresets));
+    state->currentBank = 0;
+    state->currentPreset = 0;
+  }
+
+  template <typename T>
+  bool isSame(T const &actual, T const &expected) {
+    return memcmp(&actual, &expected, sizeof(T)) == 0;
+  }
+
+  bool matchesExpected(State *state) {
+    return
+      isSame(state->voltages, expected.voltages) &&
+      isSame(state->activeVoltages, expected.activeVoltages) &&
+      isSame(state->gateVoltages, expected.gateVoltages) &&
+      isSame(state->lockedVoltages, expected.lockedVoltages) &&
+      isSame(state->gateChannels, expected.gateChannels) &&
+      isSame(state->removedPresets, expected.removedPresets) &&
+      state->currentBank == expected.currentBank &&
+      state->currentPreset == expected.currentPreset;
+  }
+
+  std::string modulePath(uint8_t module, const char *filename) {
+    return std::string(MODULE_SD_PATH_PREFIX) + std::to_string(module) + "/" + filename;
+  }
+
+  /** Write all three layouts into one module directory, from the data in state. */
+  bool writeModule(State *state, uint8_t module) {
+    state->config.currentModule = module;
+    if (
+      !SDCard::beginSave(state, 0, false) ||
+      !SDCard::finishSave(state) ||
+      !SDCard::exportModuleFile(state)
+    ) {
+      return false;
+    }
+    for (uint8_t bank = 0; bank < 16; bank++) {
+      if (!SDCard::exportBankFile(state, bank)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Split Module.bin into the legacy Bank_n.bin files. */
+  bool splitModuleImage(uint8_t module) {
+    File image = SDFS.open(modulePath(module, "Module.bin").c_str(), "r");
+    if (!image) {
+      return false;
+    }
+    ModuleImage header;
+    image.read(reinterpret_cast<uint8_t *>(&header), sizeof(ModuleImage));
+    for (uint8_t bank = 0; bank < 16; bank++) {
+      BankRecord record;
+      image.seek(header.bankOffsets[bank]);
+      image.read(reinterpret_cast<uint8_t *>(&record), sizeof(BankRecord));
+      std::string name = "Bank_" + std::to_string(bank) + ".bin";
+      File bankFile = SDFS.open(modulePath(module, name.c_str()).c_str(), "w");
+      bankFile.write(reinterpret_cast<uint8_t *>(&record), sizeof(BankRecord));
+      bankFile.close();
+    }
+    image.close();
+    return true;
+  }
+
+  void removeFiles(uint8_t module, const char *prefix, const char *extension) {
+    for (uint8_t bank = 0; bank < 16; bank++) {
+      std::string name = prefix + std::to_string(bank) + extension;
+      SDFS.remove(modulePath(module, name.c_str()).c_str());
+    }
+  }
+
+  void benchmark(const char *name, uint8_t module, unsigned long switches) {
+    State *state = Simulator::state();
+    state->config.currentModule = module;
+    clearState(state);
+
+    SDFS.resetStats();
+    auto const wallStart = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < switches; i++) {
+      SDCard::readModuleDirectory(state);
+    }
+    double const seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wallStart
+    ).count();
+
+    printf(
+      "%-12s %12.1f %10.1f %12.1f %10s\n",
+      name,
+      seconds * 1e6 / switches,
+      static_cast<double>(SDFS.stats.opens) / switches,
+      static_cast<double>(SDFS.stats.bytesRead) / switches,
+      matchesExpected(state) ? "yes" : "NO"
+    );
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long switches = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+  if (switches == 0) {
+    fprintf(stderr, "usage: module_switch_benchmark [switches per layout]\n");
+    return 2;
+  }
+
+  std::string sdRoot = TempDir::create("recollections_module_switch_benchmark_");
+  if (sdRoot.empty()) {
+    fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+
+  Serial.setEcho(false);
+  Simulator::begin(sdRoot.c_str());
+  Simulator::setup();
+
+  State *state = Simulator::state();
+  fillState(state);
+  fillState(&expected);
+  for (uint8_t module = 0; module < 3; module++) {
+    if (!writeModule(state, module)) {
+      fprintf(stderr, "Could not write module %u\n", module);
+      TempDir::remove(sdRoot.c_str());
+      return 1;
+    }
+  }
+  // Module 0 keeps only Module.bin, module 1 only the binary bank files and module 2 only the JSON.
+  removeFiles(0, "Bank_", ".txt");
+  SDFS.remove(modulePath(0, "Module.txt").c_str());
+  splitModuleImage(1);
+  removeFiles(1, "Bank_", ".txt");
+  SDFS.remove(modulePath(1, "Module.bin").c_str());
+  SDFS.remove(modulePath(2, "Module.bin").c_str());
+
+  printf("%lu switches per layout\n", switches);
+  printf("%-12s %12s %10s %12s %10s\n", "layout", "us/switch", "opens", "bytes read", "correct");
+  benchmark("Module.bin", 0, switches);
+  benchmark("Bank_n.bin", 1, switches);
+  benchmark("Bank_n.txt", 2, switches);
+
+  TempDir::remove(sdRoot.c_str());
+  return 0;
+}
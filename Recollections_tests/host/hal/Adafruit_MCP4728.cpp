@@ -0,0 +1,109 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Adafruit_MCP4728.h"
+
+namespace {
+  /**
+   * The DACs that have begun, to which a general call is sent. These are the DACs of the global
+   * state, which is rebuilt in place by Simulator::begin() and so stays at the same address.
+   */
+  Adafruit_MCP4728 *devices[8];
+  uint8_t deviceCount = 0;
+
+  /** The general call command that moves the input registers to the outputs. */
+  uint8_t const SOFTWARE_UPDATE = 0x08;
+}
+
+bool Adafruit_MCP4728::begin(uint8_t /* i2cAddress */, TwoWire *wire) {
+  bool isKnown = false;
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    isKnown = isKnown || devices[i] == this;
+  }
+  if (!isKnown && deviceCount < sizeof(devices) / sizeof(devices[0])) {
+    devices[deviceCount++] = this;
+  }
+  isBegun_ = true;
+  wire_ = wire;
+  return true;
+}
+
+bool Adafruit_MCP4728::setChannelValue(
+  MCP4728_channel_t channel,
+  uint16_t newValue,
+  MCP4728_vref_t /* newVref */,
+  MCP4728_gain_t /* newGain */,
+  MCP4728_pd_mode_t /* newPdMode */,
+  bool udac
+) {
+  if (!isBegun_) {
+    return false;
+  }
+  // Multi-write: the address byte, then three bytes for the one channel.
+  transactions_ += 1;
+  bytes_ += 4;
+  inputValues_[channel] = newValue & 0x0FFF;
+  if (!udac) {
+    values_[channel] = inputValues_[channel];
+  }
+  return true;
+}
+
+bool Adafruit_MCP4728::fastWrite(
+  uint16_t channelAValue,
+  uint16_t channelBValue,
+  uint16_t channelCValue,
+  uint16_t channelDValue
+) {
+  if (!isBegun_) {
+    return false;
+  }
+  // Fast write: the address byte, then two bytes for each of the four channels.
+  transactions_ += 1;
+  bytes_ += 9;
+  inputValues_[0] = channelAValue & 0x0FFF;
+  inputValues_[1] = channelBValue & 0x0FFF;
+  inputValues_[2] = channelCValue & 0x0FFF;
+  inputValues_[3] = channelDValue & 0x0FFF;
+  for (uint8_t channel = 0; channel < 4; channel++) {
+    values_[channel] = inputValues_[channel];
+  }
+  return true;
+}
+
+bool Adafruit_MCP4728::saveToEEPROM() {
+  return isBegun_;
+}
+
+void Adafruit_MCP4728::generalCall(TwoWire *wire, uint8_t command) {
+  if (command != SOFTWARE_UPDATE) {
+    return;
+  }
+  for (uint8_t i = 0; i < deviceCount; i++) {
+    Adafruit_MCP4728 *dac = devices[i];
+    if (!dac->isBegun_ || dac->wire_ != wire) {
+      continue;
+    }
+    for (uint8_t channel = 0; channel < 4; channel++) {
+      dac->values_[channel] = dac->inputValues_[channel];
+    }
+  }
+}
+
+uint16_t Adafruit_MCP4728::getValue(uint8_t channel) const {
+  return channel < 4 ? values_[channel] : 0;
+}
+
+uint32_t Adafruit_MCP4728::getTransactions() const {
+  return transactions_;
+}
+
+uint32_t Adafruit_MCP4728::getBytes() const {
+  return bytes_;
+}
+
+void Adafruit_MCP4728::resetStats() {
+  transactions_ = 0;
+  bytes_ = 0;
+}
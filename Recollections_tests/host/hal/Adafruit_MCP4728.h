@@ -0,0 +1,80 @@
+/**
+ * Recollections: host implementation of Adafruit_MCP4728
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * A simulated MCP4728 4-channel DAC. It holds the value of each channel and counts its I2C traffic.
+ *
+ * A fast write, or a write without udac, changes the outputs at once, as with the LDAC pin low. A
+ * write with udac changes only the input register, until a general call software update on the bus
+ * moves the input registers of every DAC on it to their outputs.
+ */
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#ifndef RECOLLECTIONS_HOST_ADAFRUIT_MCP4728_H_
+#define RECOLLECTIONS_HOST_ADAFRUIT_MCP4728_H_
+
+#define MCP4728_I2CADDR_DEFAULT 0x60
+
+typedef enum {
+  MCP4728_CHANNEL_A,
+  MCP4728_CHANNEL_B,
+  MCP4728_CHANNEL_C,
+  MCP4728_CHANNEL_D,
+} MCP4728_channel_t;
+
+typedef enum {
+  MCP4728_VREF_VDD,
+  MCP4728_VREF_INTERNAL,
+} MCP4728_vref_t;
+
+typedef enum {
+  MCP4728_GAIN_1X,
+  MCP4728_GAIN_2X,
+} MCP4728_gain_t;
+
+typedef enum {
+  MCP4728_PD_MODE_NORMAL,
+  MCP4728_PD_MODE_GND_1K,
+  MCP4728_PD_MODE_GND_100K,
+  MCP4728_PD_MODE_GND_500K,
+} MCP4728_pd_mode_t;
+
+class Adafruit_MCP4728 {
+  public:
+  bool begin(uint8_t i2cAddress = MCP4728_I2CADDR_DEFAULT, TwoWire *wire = &Wire);
+  bool setChannelValue(
+    MCP4728_channel_t channel,
+    uint16_t newValue,
+    MCP4728_vref_t newVref = MCP4728_VREF_VDD,
+    MCP4728_gain_t newGain = MCP4728_GAIN_1X,
+    MCP4728_pd_mode_t newPdMode = MCP4728_PD_MODE_NORMAL,
+    bool udac = false
+  );
+  bool fastWrite(
+    uint16_t channelAValue,
+    uint16_t channelBValue,
+    uint16_t channelCValue,
+    uint16_t channelDValue
+  );
+  bool saveToEEPROM();
+
+  // Host only.
+  static void generalCall(TwoWire *wire, uint8_t command);
+  uint16_t getValue(uint8_t channel) const;
+  uint32_t getTransactions() const;
+  uint32_t getBytes() const;
+  void resetStats();
+
+  private:
+  bool isBegun_ = false;
+  TwoWire *wire_ = nullptr;
+  uint16_t values_[4] = {0, 0, 0, 0};
+  uint16_t inputValues_[4] = {0, 0, 0, 0};
+  uint32_t transactions_ = 0;
+  uint32_t bytes_ = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Adafruit_NeoTrellis.h"
+
+// --------------------------------- seesaw_NeoPixel -----------------------------------------------
+
+void seesaw_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+  setPixelColor(n, Color(r, g, b));
+}
+
+void seesaw_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  if (n >= NEO_TRELLIS_NUM_KEYS) {
+    return;
+  }
+  // Each call writes the pixel to the seesaw's buffer over I2C.
+  pixelWrites_ += 1;
+  pixels_[n] = c;
+}
+
+uint32_t seesaw_NeoPixel::getPixelColor(uint16_t n) const {
+  return n < NEO_TRELLIS_NUM_KEYS ? pixels_[n] : 0;
+}
+
+void seesaw_NeoPixel::show() {
+  shows_ += 1;
+  for (uint8_t i = 0; i < NEO_TRELLIS_NUM_KEYS; i++) {
+    shown_[i] = pixels_[i];
+  }
+}
+
+void seesaw_NeoPixel::setBrightness(uint8_t brightness) {
+  brightness_ = brightness;
+}
+
+uint32_t seesaw_NeoPixel::Color(uint8_t r, uint8_t g, uint8_t b) {
+  return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+}
+
+uint32_t seesaw_NeoPixel::getShownColor(uint16_t n) const {
+  return n < NEO_TRELLIS_NUM_KEYS ? shown_[n] : 0;
+}
+
+uint32_t seesaw_NeoPixel::getPixelWrites() const {
+  return pixelWrites_;
+}
+
+uint32_t seesaw_NeoPixel::getShows() const {
+  return shows_;
+}
+
+void seesaw_NeoPixel::resetStats() {
+  pixelWrites_ = 0;
+  shows_ = 0;
+}
+
+// ------------------------------- Adafruit_NeoTrellis ---------------------------------------------
+
+bool Adafruit_NeoTrellis::begin(uint8_t /* address */, int8_t /* flow */) {
+  return true;
+}
+
+void Adafruit_NeoTrellis::registerCallback(uint8_t key, TrellisCallback (*callback)(keyEvent)) {
+  if (key < NEO_TRELLIS_NUM_KEYS) {
+    callbacks_[key] = callback;
+  }
+}
+
+void Adafruit_NeoTrellis::unregisterCallback(uint8_t key) {
+  if (key < NEO_TRELLIS_NUM_KEYS) {
+    callbacks_[key] = nullptr;
+  }
+}
+
+void Adafruit_NeoTrellis::activateKey(uint8_t key, uint8_t edge, bool enable) {
+  if (key >= NEO_TRELLIS_NUM_KEYS || edge > SEESAW_KEYPAD_EDGE_RISING) {
+    return;
+  }
+  if (enable) {
+    activeEdges_[key] |= 1 << edge;
+  } else {
+    activeEdges_[key] &= ~(1 << edge);
+  }
+}
+
+void Adafruit_NeoTrellis::read(bool /* polling */) {
+  while (!events_.empty()) {
+    keyEvent event = events_.front();
+    events_.pop_front();
+    if (callbacks_[event.bit.NUM]) {
+      callbacks_[event.bit.NUM](event);
+    }
+  }
+}
+
+void Adafruit_NeoTrellis::pushKeyEvent(uint8_t key, uint8_t edge) {
+  if (key >= NEO_TRELLIS_NUM_KEYS || !(activeEdges_[key] & (1 << edge))) {
+    return;
+  }
+  keyEvent event;
+  event.reg = 0;
+  event.bit.NUM = key;
+  event.bit.EDGE = edge;
+  events_.push_back(event);
+}
+
+bool Adafruit_NeoTrellis::hasKeyEvents() const {
+  return !events_.empty();
+}
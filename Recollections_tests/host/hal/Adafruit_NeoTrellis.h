@@ -0,0 +1,85 @@
+/**
+ * Recollections: host implementation of Adafruit_NeoTrellis
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * A simulated NeoTrellis: 16 keys whose events are queued by the Simulator, and 16 pixels whose
+ * colors are held for inspection. Both count their I2C traffic.
+ */
+
+#include <deque>
+
+#include "Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_ADAFRUIT_NEOTRELLIS_H_
+#define RECOLLECTIONS_HOST_ADAFRUIT_NEOTRELLIS_H_
+
+#define NEO_TRELLIS_ADDR 0x2E
+#define NEO_TRELLIS_NUM_KEYS 16
+
+#define SEESAW_KEYPAD_EDGE_HIGH 0
+#define SEESAW_KEYPAD_EDGE_LOW 1
+#define SEESAW_KEYPAD_EDGE_FALLING 2
+#define SEESAW_KEYPAD_EDGE_RISING 3
+
+union keyEvent {
+  struct {
+    uint8_t EDGE : 2;
+    uint16_t NUM : 14;
+  } bit;
+  uint16_t reg;
+};
+
+typedef void *TrellisCallback;
+
+class seesaw_NeoPixel {
+  public:
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  void setPixelColor(uint16_t n, uint32_t c);
+  uint32_t getPixelColor(uint16_t n) const;
+  void show();
+  void setBrightness(uint8_t brightness);
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b);
+
+  // Host only.
+  /** The color of a pixel as of the last show(), which is what is visible on the key. */
+  uint32_t getShownColor(uint16_t n) const;
+  uint32_t getPixelWrites() const;
+  uint32_t getShows() const;
+  void resetStats();
+
+  private:
+  uint32_t pixels_[NEO_TRELLIS_NUM_KEYS] = {};
+  uint32_t shown_[NEO_TRELLIS_NUM_KEYS] = {};
+  uint8_t brightness_ = 255;
+  uint32_t pixelWrites_ = 0;
+  uint32_t shows_ = 0;
+};
+
+class Adafruit_NeoTrellis {
+  public:
+  bool begin(uint8_t address = NEO_TRELLIS_ADDR, int8_t flow = -1);
+  void registerCallback(uint8_t key, TrellisCallback (*callback)(keyEvent));
+  void unregisterCallback(uint8_t key);
+  void activateKey(uint8_t key, uint8_t edge, bool enable = true);
+
+  /** Deliver the queued key events to the registered callbacks. */
+  void read(bool polling = true);
+
+  seesaw_NeoPixel pixels;
+
+  // Host only.
+  /**
+   * Queue a key event, as if the key had been pressed or released. Events on edges that were not
+   * activated with activateKey() are dropped, as the seesaw would not report them.
+   */
+  void pushKeyEvent(uint8_t key, uint8_t edge);
+  bool hasKeyEvents() const;
+
+  private:
+  TrellisCallback (*callbacks_[NEO_TRELLIS_NUM_KEYS])(keyEvent) = {};
+  uint8_t activeEdges_[NEO_TRELLIS_NUM_KEYS] = {};
+  std::deque<keyEvent> events_;
+};
+
+#endif
@@ -0,0 +1,783 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Arduino.h"
+
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+
+#include <chrono>
+#include <climits>
+
+HardwareSerial Serial;
+RP2040 rp2040;
+
+namespace {
+  uint64_t clockMicros = 0;
+  int digitalLevels[HOST_PIN_COUNT];
+  uint16_t analogValues[HOST_PIN_COUNT];
+  int analogBits = 10;
+  bool rebootRequested = false;
+
+  typedef struct InterruptHandler {
+    void (*handler)();
+    int mode;
+  } InterruptHandler;
+
+  InterruptHandler interruptHandlers[HOST_PIN_COUNT];
+
+  /** The repeating timers, with the next time each is due. */
+  typedef struct HostTimer {
+    repeating_timer_t *timer;
+    uint64_t dueMicros;
+  } HostTimer;
+
+  constexpr uint8_t HOST_TIMER_COUNT = 4;
+  HostTimer timers[HOST_TIMER_COUNT];
+
+  /** The ADC in free-running mode, and the DMA channels that may drain its FIFO. */
+  adc_hw_t adcRegisters;
+  unsigned int adcInput = 0;
+  uint32_t adcCyclesPerSample = 96;
+  bool isAdcRunning = false;
+  uint64_t adcStartMicros = 0;
+  uint64_t adcSamples = 0;
+
+  typedef struct HostDmaChannel {
+    bool isClaimed;
+    dma_channel_config config;
+    volatile void *writeAddress;
+    const volatile void *readAddress;
+    uint64_t writeIndex;
+    dma_channel_hw_t registers;
+  } HostDmaChannel;
+
+  HostDmaChannel dmaChannels[NUM_DMA_CHANNELS];
+
+  void writeTransfer(HostDmaChannel *channel, uint64_t index, uint32_t value) {
+    uint8_t size = 1 << channel->config.size;
+    if (channel->config.ringOnWrite) {
+      index %= (1u << channel->config.ringBits) / size;
+    }
+    uint8_t *address = static_cast<uint8_t *>(const_cast<void *>(channel->writeAddress));
+    memcpy(address + index * size, &value, size);
+  }
+
+  /** Take the samples the ADC has taken up to now, and let the DMA channels transfer them. */
+  void catchUpAdc() {
+    if (!isAdcRunning) {
+      return;
+    }
+    uint64_t samples = (clockMicros - adcStartMicros) * 48 / adcCyclesPerSample;
+    uint64_t newSamples = samples - adcSamples;
+    adcSamples = samples;
+    if (newSamples == 0) {
+      return;
+    }
+    // The input is constant between calls, so every new sample has the same value.
+    uint16_t value = analogValues[26 + adcInput];
+    adcRegisters.fifo = value;
+    for (HostDmaChannel &channel : dmaChannels) {
+      if (
+        !channel.isClaimed ||
+        channel.config.dreq != DREQ_ADC ||
+        channel.readAddress != &adcRegisters.fifo ||
+        channel.registers.transfer_count == 0
+      ) {
+        continue;
+      }
+      uint64_t transfers = newSamples < channel.registers.transfer_count
+        ? newSamples
+        : channel.registers.transfer_count;
+      // Only the last lap of a ring is left to see.
+      uint64_t first = channel.writeIndex;
+      if (channel.config.ringOnWrite) {
+        uint64_t entries = (1u << channel.config.ringBits) >> channel.config.size;
+        if (transfers > entries) {
+          first = channel.writeIndex + transfers - entries;
+        }
+      }
+      for (uint64_t index = first; index < channel.writeIndex + transfers; index++) {
+        writeTransfer(&channel, index, value);
+      }
+      channel.writeIndex += transfers;
+      channel.registers.transfer_count -= static_cast<uint32_t>(transfers);
+    }
+  }
+
+  /** Move the clock to the given time, running each timer that falls due on the way, in order. */
+  void advanceClockTo(uint64_t endMicros) {
+    while (true) {
+      HostTimer *next = nullptr;
+      for (uint8_t i = 0; i < HOST_TIMER_COUNT; i++) {
+        if (timers[i].timer && timers[i].dueMicros <= endMicros) {
+          if (!next || timers[i].dueMicros < next->dueMicros) {
+            next = &timers[i];
+          }
+        }
+      }
+      if (!next) {
+        break;
+      }
+      clockMicros = next->dueMicros;
+      catchUpAdc();
+      repeating_timer_t *timer = next->timer;
+      uint64_t period = timer->delay_us < 0 ? -timer->delay_us : timer->delay_us;
+      next->dueMicros += period;
+      if (!timer->callback(timer)) {
+        next->timer = nullptr;
+      }
+    }
+    clockMicros = endMicros;
+    catchUpAdc();
+  }
+}
+
+// ------------------------------------- Clock -----------------------------------------------------
+
+unsigned long millis() {
+  return static_cast<unsigned long>(clockMicros / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(clockMicros);
+}
+
+void delay(unsigned long ms) {
+  advanceClockTo(clockMicros + static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  advanceClockTo(clockMicros + us);
+}
+
+void yield() {}
+
+// ---------------------------------- GPIO and ADC -------------------------------------------------
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < HOST_PIN_COUNT && mode == INPUT_PULLUP) {
+    digitalLevels[pin] = HIGH;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? digitalLevels[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < HOST_PIN_COUNT) {
+    digitalLevels[pin] = value ? HIGH : LOW;
+  }
+}
+
+int analogRead(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? analogValues[pin] >> (12 - analogBits) : 0;
+}
+
+void analogReadResolution(int bits) {
+  analogBits = bits < 1 ? 1 : bits > 12 ? 12 : bits;
+}
+
+// ----------------------------------- Interrupts --------------------------------------------------
+
+uint8_t digitalPinToInterrupt(uint8_t pin) {
+  return pin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+  if (interrupt < HOST_PIN_COUNT) {
+    interruptHandlers[interrupt] = {handler, mode};
+  }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  if (interrupt < HOST_PIN_COUNT) {
+    interruptHandlers[interrupt] = {nullptr, 0};
+  }
+}
+
+void noInterrupts() {}
+
+void interrupts() {}
+
+// ------------------------------------- Timers ----------------------------------------------------
+
+bool add_repeating_timer_us(
+  int64_t delay_us,
+  repeating_timer_callback_t callback,
+  void *user_data,
+  repeating_timer_t *out
+) {
+  if (delay_us == 0 || !callback || !out) {
+    return false;
+  }
+  for (uint8_t i = 0; i < HOST_TIMER_COUNT; i++) {
+    if (!timers[i].timer) {
+      *out = {delay_us, callback, user_data};
+      uint64_t period = delay_us < 0 ? -delay_us : delay_us;
+      timers[i] = {out, clockMicros + period};
+      return true;
+    }
+  }
+  return false;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+  for (uint8_t i = 0; i < HOST_TIMER_COUNT; i++) {
+    if (timers[i].timer == timer) {
+      timers[i].timer = nullptr;
+      return true;
+    }
+  }
+  return false;
+}
+
+// --------------------------------------- ADC -----------------------------------------------------
+
+adc_hw_t *const adc_hw = &adcRegisters;
+
+void adc_init() {
+  isAdcRunning = false;
+}
+
+void adc_gpio_init(unsigned int /* gpio */) {}
+
+void adc_select_input(unsigned int input) {
+  catchUpAdc();
+  adcInput = input < 4 ? input : 0;
+}
+
+void adc_fifo_setup(
+  bool /* en */,
+  bool /* dreq_en */,
+  uint16_t /* dreq_thresh */,
+  bool /* err_in_fifo */,
+  bool /* byte_shift */
+) {}
+
+void adc_set_clkdiv(float clkdiv) {
+  catchUpAdc();
+  // A conversion takes 96 cycles of the 48 MHz ADC clock, however short the divider.
+  uint32_t cycles = static_cast<uint32_t>(clkdiv) + 1;
+  adcCyclesPerSample = cycles < 96 ? 96 : cycles;
+  adcStartMicros = clockMicros;
+  adcSamples = 0;
+}
+
+void adc_run(bool run) {
+  catchUpAdc();
+  if (run && !isAdcRunning) {
+    adcStartMicros = clockMicros;
+    adcSamples = 0;
+  }
+  isAdcRunning = run;
+}
+
+// --------------------------------------- DMA -----------------------------------------------------
+
+int dma_claim_unused_channel(bool required) {
+  for (int i = 0; i < NUM_DMA_CHANNELS; i++) {
+    if (!dmaChannels[i].isClaimed) {
+      dmaChannels[i].isClaimed = true;
+      return i;
+    }
+  }
+  if (required) {
+    fprintf(stderr, "No DMA channel is free\n");
+    abort();
+  }
+  return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int /* channel */) {
+  return {DMA_SIZE_32, true, false, false, 0, 0x3f};
+}
+
+void channel_config_set_transfer_data_size(
+  dma_channel_config *config,
+  dma_channel_transfer_size size
+) {
+  config->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *config, bool increment) {
+  config->readIncrement = increment;
+}
+
+void channel_config_set_write_increment(dma_channel_config *config, bool increment) {
+  config->writeIncrement = increment;
+}
+
+void channel_config_set_ring(dma_channel_config *config, bool write, unsigned int size_bits) {
+  config->ringOnWrite = write && size_bits > 0;
+  config->ringBits = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config *config, unsigned int dreq) {
+  config->dreq = dreq;
+}
+
+void dma_channel_configure(
+  unsigned int channel,
+  const dma_channel_config *config,
+  volatile void *write_addr,
+  const volatile void *read_addr,
+  unsigned int transfer_count,
+  bool trigger
+) {
+  if (channel >= NUM_DMA_CHANNELS) {
+    return;
+  }
+  catchUpAdc();
+  HostDmaChannel *hostChannel = &dmaChannels[channel];
+  hostChannel->config = *config;
+  hostChannel->writeAddress = write_addr;
+  hostChannel->readAddress = read_addr;
+  hostChannel->writeIndex = 0;
+  hostChannel->registers.transfer_count = trigger ? transfer_count : 0;
+}
+
+void dma_channel_set_trans_count(unsigned int channel, uint32_t trans_count, bool trigger) {
+  if (channel < NUM_DMA_CHANNELS && trigger) {
+    catchUpAdc();
+    dmaChannels[channel].registers.transfer_count = trans_count;
+  }
+}
+
+bool dma_channel_is_busy(unsigned int channel) {
+  catchUpAdc();
+  return channel < NUM_DMA_CHANNELS && dmaChannels[channel].registers.transfer_count > 0;
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(unsigned int channel) {
+  catchUpAdc();
+  return &dmaChannels[channel < NUM_DMA_CHANNELS ? channel : 0].registers;
+}
+
+// ------------------------------------- String ----------------------------------------------------
+
+String::String(const char *value) : value_(value ? value : "") {}
+
+String::String(const std::string &value) : value_(value) {}
+
+String::String(char value) : value_(1, value) {}
+
+String::String(long value, unsigned char base) {
+  char buffer[34];
+  if (base == HEX) {
+    snprintf(buffer, sizeof(buffer), "%lx", value);
+  } else if (base == OCT) {
+    snprintf(buffer, sizeof(buffer), "%lo", value);
+  } else {
+    snprintf(buffer, sizeof(buffer), "%ld", value);
+  }
+  value_ = buffer;
+}
+
+const char *String::c_str() const {
+  return value_.c_str();
+}
+
+unsigned int String::length() const {
+  return static_cast<unsigned int>(value_.length());
+}
+
+bool String::reserve(unsigned int size) {
+  value_.reserve(size);
+  return true;
+}
+
+bool String::concat(const String &value) {
+  value_ += value.value_;
+  return true;
+}
+
+bool String::concat(const char *value) {
+  if (!value) {
+    return false;
+  }
+  value_ += value;
+  return true;
+}
+
+bool String::concat(const char *value, unsigned int length) {
+  if (!value) {
+    return false;
+  }
+  value_.append(value, length);
+  return true;
+}
+
+bool String::concat(char value) {
+  value_ += value;
+  return true;
+}
+
+String &String::operator+=(const String &value) {
+  concat(value);
+  return *this;
+}
+
+String &String::operator+=(const char *value) {
+  concat(value);
+  return *this;
+}
+
+String &String::operator+=(char value) {
+  concat(value);
+  return *this;
+}
+
+char String::operator[](unsigned int index) const {
+  return index < value_.length() ? value_[index] : 0;
+}
+
+char &String::operator[](unsigned int index) {
+  return value_[index];
+}
+
+bool String::operator==(const String &other) const {
+  return value_ == other.value_;
+}
+
+bool String::operator==(const char *other) const {
+  return value_ == (other ? other : "");
+}
+
+bool String::operator!=(const String &other) const {
+  return !(*this == other);
+}
+
+bool String::operator!=(const char *other) const {
+  return !(*this == other);
+}
+
+// ------------------------------------- Print -----------------------------------------------------
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  for (size_t i = 0; i < size; i++) {
+    written += write(buffer[i]);
+  }
+  return written;
+}
+
+size_t Print::write(const char *value) {
+  return value ? write(reinterpret_cast<const uint8_t *>(value), strlen(value)) : 0;
+}
+
+size_t Print::write(const char *buffer, size_t size) {
+  return write(reinterpret_cast<const uint8_t *>(buffer), size);
+}
+
+int Print::availableForWrite() {
+  return 0;
+}
+
+void Print::flush() {}
+
+size_t Print::print(const char value[]) {
+  return write(value);
+}
+
+size_t Print::print(char value) {
+  return write(static_cast<uint8_t>(value));
+}
+
+size_t Print::print(const String &value) {
+  return write(value.c_str(), value.length());
+}
+
+size_t Print::print(int value, int base) {
+  return print(static_cast<long>(value), base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print(static_cast<unsigned long>(value), base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC && value < 0) {
+    return printNumber(-static_cast<unsigned long>(value), base, true);
+  }
+  return printNumber(static_cast<unsigned long>(value), base, false);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return printNumber(value, base, false);
+}
+
+size_t Print::print(double value, int digits) {
+  char buffer[64];
+  int length = snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return write(buffer, static_cast<size_t>(length));
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::println(const char value[]) {
+  return print(value) + println();
+}
+
+size_t Print::println(char value) {
+  return print(value) + println();
+}
+
+size_t Print::println(const String &value) {
+  return print(value) + println();
+}
+
+size_t Print::println(int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(double value, int digits) {
+  return print(value, digits) + println();
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  return write(buffer, static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+size_t Print::printNumber(unsigned long value, int base, bool isNegative) {
+  if (base < 2) {
+    base = DEC;
+  }
+  char buffer[8 * sizeof(unsigned long) + 2];
+  char *cursor = &buffer[sizeof(buffer) - 1];
+  *cursor = '\0';
+  do {
+    unsigned long digit = value % base;
+    value /= base;
+    *--cursor = static_cast<char>(digit < 10 ? '0' + digit : 'A' + digit - 10);
+  } while (value);
+  if (isNegative) {
+    *--cursor = '-';
+  }
+  return write(cursor);
+}
+
+// ------------------------------------- Stream ----------------------------------------------------
+
+void Stream::setTimeout(unsigned long timeout) {
+  timeout_ = timeout;
+}
+
+unsigned long Stream::getTimeout() {
+  return timeout_;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = static_cast<char>(c);
+  }
+  return count;
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+  return readBytes(reinterpret_cast<char *>(buffer), length);
+}
+
+int Stream::timedRead() {
+  return read();
+}
+
+int Stream::timedPeek() {
+  return peek();
+}
+
+// ------------------------------------- Serial ----------------------------------------------------
+
+void HardwareSerial::begin(unsigned long /* baud */) {}
+
+void HardwareSerial::end() {}
+
+HardwareSerial::operator bool() {
+  return true;
+}
+
+int HardwareSerial::available() {
+  return 0;
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+int HardwareSerial::peek() {
+  return -1;
+}
+
+size_t HardwareSerial::write(uint8_t value) {
+  if (isEchoing_) {
+    fputc(value, stdout);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (isEchoing_) {
+    fwrite(buffer, 1, size, stdout);
+  }
+  return size;
+}
+
+int HardwareSerial::availableForWrite() {
+  // Standard output never keeps the firmware waiting.
+  return INT_MAX;
+}
+
+void HardwareSerial::setEcho(bool isEchoing) {
+  isEchoing_ = isEchoing;
+}
+
+// -------------------------------------- RP2040 ---------------------------------------------------
+
+void RP2040::reboot() {
+  rebootRequested = true;
+}
+
+uint32_t RP2040::getCycleCount() {
+  return static_cast<uint32_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()
+    ).count()
+  );
+}
+
+int RP2040::f_cpu() {
+  return 1000000000;
+}
+
+void RP2040Fifo::push(uint32_t value) {
+  push_nb(value);
+}
+
+bool RP2040Fifo::push_nb(uint32_t value) {
+  if (count_ == DEPTH) {
+    return false;
+  }
+  values_[(head_ + count_) % DEPTH] = value;
+  count_ += 1;
+  return true;
+}
+
+uint32_t RP2040Fifo::pop() {
+  uint32_t value = 0;
+  pop_nb(&value);
+  return value;
+}
+
+bool RP2040Fifo::pop_nb(uint32_t *value) {
+  if (count_ == 0) {
+    return false;
+  }
+  *value = values_[head_];
+  head_ = (head_ + 1) % DEPTH;
+  count_ -= 1;
+  return true;
+}
+
+int RP2040Fifo::available() {
+  return count_;
+}
+
+void RP2040Fifo::clear() {
+  head_ = 0;
+  count_ = 0;
+}
+
+// ------------------------------------- Host only -------------------------------------------------
+
+void HostBoard::reset() {
+  clockMicros = 0;
+  for (uint8_t pin = 0; pin < HOST_PIN_COUNT; pin++) {
+    digitalLevels[pin] = LOW;
+    analogValues[pin] = 0;
+    interruptHandlers[pin] = {nullptr, 0};
+  }
+  for (uint8_t i = 0; i < HOST_TIMER_COUNT; i++) {
+    timers[i].timer = nullptr;
+  }
+  isAdcRunning = false;
+  for (HostDmaChannel &channel : dmaChannels) {
+    channel = {};
+  }
+  analogBits = 10;
+  rebootRequested = false;
+  rp2040.fifo.clear();
+}
+
+void HostBoard::advanceMicros(uint64_t us) {
+  advanceClockTo(clockMicros + us);
+}
+
+uint64_t HostBoard::nowMicros() {
+  return clockMicros;
+}
+
+void HostBoard::setDigital(uint8_t pin, int level) {
+  if (pin >= HOST_PIN_COUNT) {
+    return;
+  }
+  int previous = digitalLevels[pin];
+  digitalLevels[pin] = level ? HIGH : LOW;
+
+  InterruptHandler const &interrupt = interruptHandlers[pin];
+  if (!interrupt.handler || digitalLevels[pin] == previous) {
+    return;
+  }
+  if (
+    interrupt.mode == CHANGE ||
+    (interrupt.mode == RISING && digitalLevels[pin] == HIGH) ||
+    (interrupt.mode == FALLING && digitalLevels[pin] == LOW)
+  ) {
+    interrupt.handler();
+  }
+}
+
+int HostBoard::getDigital(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? digitalLevels[pin] : LOW;
+}
+
+void HostBoard::setAnalog(uint8_t pin, uint16_t value) {
+  // The samples taken before now saw the value being replaced.
+  catchUpAdc();
+  if (pin < HOST_PIN_COUNT) {
+    analogValues[pin] = value > 4095 ? 4095 : value;
+  }
+}
+
+bool HostBoard::isRebootRequested() {
+  return rebootRequested;
+}
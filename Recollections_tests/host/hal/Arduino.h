@@ -0,0 +1,308 @@
+/**
+ * Recollections: host implementation of the Arduino core
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The subset of the Arduino core that the firmware uses: the clock, GPIO, the ADC, Serial, and the
+ * Print, Stream and String classes that the Arduino libraries build on. On the device these come
+ * from arduino-pico or Teensyduino. On the host, the clock and the pins are driven by HostBoard,
+ * which is in turn driven by the Simulator. See Simulator.h.
+ *
+ * The host presents itself as a Pico, so the firmware compiles its non-Teensy branches.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifndef RECOLLECTIONS_HOST_ARDUINO_H_
+#define RECOLLECTIONS_HOST_ARDUINO_H_
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/** The number of GPIO pins on the Pico. */
+#define HOST_PIN_COUNT 30
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// ------------------------------------- Clock -----------------------------------------------------
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// ---------------------------------- GPIO and ADC -------------------------------------------------
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+void analogReadResolution(int bits);
+
+// ----------------------------------- Interrupts --------------------------------------------------
+
+/**
+ * Pin change interrupts. On the host, an interrupt handler runs within HostBoard::setDigital(), at
+ * the simulated time of the change. The loop and the handlers never run at the same time, so
+ * noInterrupts() and interrupts() have nothing to do.
+ */
+uint8_t digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+// ------------------------------------- String ----------------------------------------------------
+
+/**
+ * Arduino's String, backed by std::string. Only what the Arduino libraries need is implemented.
+ */
+class String {
+  public:
+  String(const char *value = "");
+  String(const std::string &value);
+  explicit String(char value);
+  explicit String(long value, unsigned char base = DEC);
+
+  const char *c_str() const;
+  unsigned int length() const;
+  bool reserve(unsigned int size);
+  bool concat(const String &value);
+  bool concat(const char *value);
+  bool concat(const char *value, unsigned int length);
+  bool concat(char value);
+  String &operator+=(const String &value);
+  String &operator+=(const char *value);
+  String &operator+=(char value);
+  char operator[](unsigned int index) const;
+  char &operator[](unsigned int index);
+  bool operator==(const String &other) const;
+  bool operator==(const char *other) const;
+  bool operator!=(const String &other) const;
+  bool operator!=(const char *other) const;
+
+  private:
+  std::string value_;
+};
+
+// --------------------------------- Print and Stream ----------------------------------------------
+
+class Print {
+  public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t value) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *value);
+  size_t write(const char *buffer, size_t size);
+  virtual int availableForWrite();
+  virtual void flush();
+
+  size_t print(const char value[]);
+  size_t print(char value);
+  size_t print(const String &value);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println();
+  size_t println(const char value[]);
+  size_t println(char value);
+  size_t println(const String &value);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  private:
+  size_t printNumber(unsigned long value, int base, bool isNegative);
+};
+
+class Stream : public Print {
+  public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout);
+  unsigned long getTimeout();
+
+  /**
+   * Reads up to length bytes. Host streams never block, so unlike on the device this does not wait
+   * for the timeout when the stream runs dry.
+   */
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length);
+
+  protected:
+  int timedRead();
+  int timedPeek();
+
+  unsigned long timeout_ = 1000;
+};
+
+// ------------------------------------- Serial ----------------------------------------------------
+
+/**
+ * The USB serial port. Output goes to stdout unless echo is turned off, and there is never any
+ * input.
+ */
+class HardwareSerial : public Stream {
+  public:
+  void begin(unsigned long baud);
+  void end();
+  operator bool();
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int availableForWrite() override;
+
+  // Host only.
+  void setEcho(bool isEchoing);
+
+  private:
+  bool isEchoing_ = true;
+};
+
+extern HardwareSerial Serial;
+
+// -------------------------------------- RP2040 ---------------------------------------------------
+
+/**
+ * One direction of the FIFO between the two cores. On the device, pop() waits for a value. On the
+ * host, where the second core runs only after the first core's setup(), the value is always there,
+ * and popping an empty FIFO returns 0.
+ */
+class RP2040Fifo {
+  public:
+  void push(uint32_t value);
+  bool push_nb(uint32_t value);
+  uint32_t pop();
+  bool pop_nb(uint32_t *value);
+  int available();
+
+  // Host only.
+  void clear();
+
+  private:
+  static const uint8_t DEPTH = 8;
+  uint32_t values_[DEPTH];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+};
+
+/**
+ * The arduino-pico global for RP2040 specific functionality.
+ */
+class RP2040 {
+  public:
+  void reboot();
+
+  // On the host, the cycles are nanoseconds of host time, and so the clock is 1 GHz.
+  uint32_t getCycleCount();
+  int f_cpu();
+
+  RP2040Fifo fifo;
+};
+
+extern RP2040 rp2040;
+
+// ------------------------------------- Host only -------------------------------------------------
+
+/**
+ * The simulated board behind the functions above: a microsecond clock, the level of each pin, and
+ * the 12-bit value presented to each analog pin. The firmware never sees this. The Simulator uses
+ * it to drive the inputs and to read back the board LED.
+ */
+typedef struct HostBoard {
+  /**
+   * @brief Return the board to its power up state: the clock at zero, every pin low, every analog
+   * value zero, a 10-bit ADC, no interrupt handlers or timers, and an empty inter-core FIFO.
+   */
+  static void reset();
+
+  /**
+   * @brief Move the clock forward, running each repeating timer that falls due on the way at the
+   * time it is due. See pico/time.h.
+   *
+   * @param us
+   */
+  static void advanceMicros(uint64_t us);
+
+  /**
+   * @brief The clock, in microseconds since reset.
+   *
+   * @return uint64_t
+   */
+  static uint64_t nowMicros();
+
+  /**
+   * @brief Set the level that digitalRead() returns for a pin, running its interrupt handler if
+   * the change matches the handler's mode.
+   *
+   * @param pin
+   * @param level HIGH or LOW.
+   */
+  static void setDigital(uint8_t pin, int level);
+
+  /**
+   * @brief Get the level of a pin, as last set by digitalWrite() or setDigital().
+   *
+   * @param pin
+   * @return int
+   */
+  static int getDigital(uint8_t pin);
+
+  /**
+   * @brief Set the value presented to an analog pin. analogRead() scales it down to the resolution
+   * set with analogReadResolution(). The free-running ADC samples it at 12 bits. See
+   * hardware/adc.h.
+   *
+   * @param pin
+   * @param value A 12-bit value.
+   */
+  static void setAnalog(uint8_t pin, uint16_t value);
+
+  /**
+   * @brief Whether rp2040.reboot() has been called since reset.
+   *
+   * @return true
+   * @return false
+   */
+  static bool isRebootRequested();
+} HostBoard;
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Recollections: host implementation of Client.h
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The network client interface from the Arduino core, which StreamUtils wraps. The firmware has no
+ * network, so this only needs to compile.
+ */
+
+#include "Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_CLIENT_H_
+#define RECOLLECTIONS_HOST_CLIENT_H_
+
+class IPAddress {
+  public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets_{a, b, c, d} {}
+
+  private:
+  uint8_t octets_[4] = {};
+};
+
+class Client : public Stream {
+  public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual size_t write(uint8_t value) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t *buffer, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * Recollections: host implementation of SD
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The SD card reader, as arduino-pico presents it. The files themselves are accessed through SDFS.
+ */
+
+#include "SDFS.h"
+
+#ifndef RECOLLECTIONS_HOST_SD_H_
+#define RECOLLECTIONS_HOST_SD_H_
+
+class SDClass {
+  public:
+  /** Succeeds when SDFS has been given a root directory. */
+  bool begin(uint8_t csPin, uint32_t speed = 0);
+};
+
+extern SDClass SD;
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+// The system headers come first, so that SDFS.h keeps the system's O_* flags.
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SDFS.h"
+#include "SD.h"
+
+FS SDFS;
+SDClass SD;
+
+struct File::Handle {
+  int descriptor;
+  std::string path;
+
+  Handle(int descriptor, const char *path) : descriptor(descriptor), path(path) {}
+
+  ~Handle() {
+    if (descriptor >= 0) {
+      ::close(descriptor);
+    }
+  }
+};
+
+// -------------------------------------- File -----------------------------------------------------
+
+File::File() {}
+
+File::File(int descriptor, const char *path)
+  : handle_(std::make_shared<Handle>(descriptor, path)) {}
+
+File::operator bool() const {
+  return handle_ && handle_->descriptor >= 0;
+}
+
+int File::available() {
+  if (!*this) {
+    return 0;
+  }
+  size_t current = position();
+  size_t total = size();
+  return total > current ? static_cast<int>(total - current) : 0;
+}
+
+int File::read() {
+  uint8_t value;
+  return read(&value, 1) == 1 ? value : -1;
+}
+
+int File::peek() {
+  if (!*this) {
+    return -1;
+  }
+  uint8_t value;
+  ssize_t count = ::pread(handle_->descriptor, &value, 1, lseek(handle_->descriptor, 0, SEEK_CUR));
+  return count == 1 ? value : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  if (!*this) {
+    return 0;
+  }
+  ssize_t count = ::read(handle_->descriptor, buffer, size);
+  if (count < 0) {
+    return 0;
+  }
+  SDFS.stats.reads += 1;
+  SDFS.stats.bytesRead += count;
+  return static_cast<size_t>(count);
+}
+
+size_t File::write(uint8_t value) {
+  return write(&value, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!*this) {
+    return 0;
+  }
+  ssize_t count = ::write(handle_->descriptor, buffer, size);
+  if (count < 0) {
+    return 0;
+  }
+  SDFS.stats.writes += 1;
+  SDFS.stats.bytesWritten += count;
+  return static_cast<size_t>(count);
+}
+
+void File::flush() {}
+
+bool File::seek(uint32_t position) {
+  return *this && lseek(handle_->descriptor, position, SEEK_SET) == static_cast<off_t>(position);
+}
+
+size_t File::position() const {
+  if (!*this) {
+    return 0;
+  }
+  off_t current = lseek(handle_->descriptor, 0, SEEK_CUR);
+  return current < 0 ? 0 : static_cast<size_t>(current);
+}
+
+size_t File::size() const {
+  struct stat info;
+  if (!*this || fstat(handle_->descriptor, &info) != 0) {
+    return 0;
+  }
+  return static_cast<size_t>(info.st_size);
+}
+
+bool File::truncate(uint32_t size) {
+  return *this && ftruncate(handle_->descriptor, size) == 0;
+}
+
+void File::close() {
+  if (handle_ && handle_->descriptor >= 0) {
+    ::close(handle_->descriptor);
+    handle_->descriptor = -1;
+  }
+  handle_.reset();
+}
+
+const char *File::name() const {
+  if (!handle_) {
+    return "";
+  }
+  size_t slash = handle_->path.find_last_of('/');
+  return handle_->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// --------------------------------------- FS ------------------------------------------------------
+
+File FS::open(const char *path, const char *mode) {
+  int flags;
+  if (strcmp(mode, "r") == 0) {
+    flags = O_RDONLY;
+  } else if (strcmp(mode, "r+") == 0) {
+    flags = O_RDWR;
+  } else if (strcmp(mode, "w") == 0) {
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+  } else if (strcmp(mode, "w+") == 0) {
+    flags = O_RDWR | O_CREAT | O_TRUNC;
+  } else if (strcmp(mode, "a") == 0) {
+    flags = O_WRONLY | O_CREAT | O_APPEND;
+  } else if (strcmp(mode, "a+") == 0) {
+    flags = O_RDWR | O_CREAT | O_APPEND;
+  } else {
+    return File();
+  }
+
+  std::string resolved = resolve(path);
+  stats.opens += 1;
+  int descriptor = ::open(resolved.c_str(), flags, 0644);
+  if (descriptor < 0) {
+    return File();
+  }
+  // As on the card, a directory is not a file.
+  struct stat info;
+  if (fstat(descriptor, &info) != 0 || S_ISDIR(info.st_mode)) {
+    ::close(descriptor);
+    return File();
+  }
+  return File(descriptor, path);
+}
+
+bool FS::exists(const char *path) {
+  struct stat info;
+  return stat(resolve(path).c_str(), &info) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+  return ::mkdir(resolve(path).c_str(), 0755) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return unlink(resolve(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *pathFrom, const char *pathTo) {
+  return ::rename(resolve(pathFrom).c_str(), resolve(pathTo).c_str()) == 0;
+}
+
+void FS::setRoot(const char *root) {
+  root_ = root ? root : "";
+}
+
+const char *FS::getRoot() const {
+  return root_.c_str();
+}
+
+void FS::resetStats() {
+  stats = FSStats();
+}
+
+std::string FS::resolve(const char *path) const {
+  while (*path == '/') {
+    path++;
+  }
+  return root_ + "/" + path;
+}
+
+// --------------------------------------- SD ------------------------------------------------------
+
+bool SDClass::begin(uint8_t /* csPin */, uint32_t /* speed */) {
+  return SDFS.getRoot()[0] != '\0';
+}
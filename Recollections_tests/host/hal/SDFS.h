@@ -0,0 +1,122 @@
+/**
+ * Recollections: host implementation of SDFS
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The SD card file system, as arduino-pico presents it. On the host, the card is a directory, and
+ * paths are resolved relative to it. The file system also counts its traffic, so benchmarks can
+ * report how many files were opened and how many bytes were moved.
+ */
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_SDFS_H_
+#define RECOLLECTIONS_HOST_SDFS_H_
+
+// SdFat's open flags. Only their distinctness matters on the host, as SDFS opens files by mode
+// string, so the platform's own values are kept if it has already defined them.
+#ifndef O_RDONLY
+  #define O_RDONLY 0x00
+#endif
+#ifndef O_WRONLY
+  #define O_WRONLY 0x01
+#endif
+#ifndef O_RDWR
+  #define O_RDWR 0x02
+#endif
+#ifndef O_APPEND
+  #define O_APPEND 0x08
+#endif
+#ifndef O_CREAT
+  #define O_CREAT 0x10
+#endif
+#ifndef O_TRUNC
+  #define O_TRUNC 0x20
+#endif
+#ifndef O_READ
+  #define O_READ O_RDONLY
+#endif
+#ifndef O_WRITE
+  #define O_WRITE O_WRONLY
+#endif
+
+#define FILE_READ O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT)
+
+/**
+ * An open file. Copies share the same open file, which is closed by close() or when the last copy
+ * is destroyed.
+ */
+class File : public Stream {
+  public:
+  File();
+
+  operator bool() const;
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buffer, size_t size);
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+  bool seek(uint32_t position);
+  size_t position() const;
+  size_t size() const;
+  bool truncate(uint32_t size);
+  void close();
+  const char *name() const;
+
+  // Host only.
+  File(int descriptor, const char *path);
+
+  private:
+  struct Handle;
+  std::shared_ptr<Handle> handle_;
+};
+
+/**
+ * Traffic through the file system since the last call to FS::resetStats(). Failed opens are
+ * counted too, as each one still costs a directory lookup on the card.
+ */
+typedef struct FSStats {
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t bytesRead;
+  uint32_t writes;
+  uint32_t bytesWritten;
+} FSStats;
+
+class FS {
+  public:
+  /**
+   * Open a file with an fopen() style mode: "r", "w", "a", "r+", "w+" or "a+". Returns a false
+   * File if the file cannot be opened, for example when reading a file that does not exist.
+   */
+  File open(const char *path, const char *mode = "r");
+  bool exists(const char *path);
+  bool mkdir(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *pathFrom, const char *pathTo);
+
+  // Host only.
+  void setRoot(const char *root);
+  const char *getRoot() const;
+  void resetStats();
+
+  FSStats stats;
+
+  private:
+  std::string resolve(const char *path) const;
+
+  std::string root_;
+};
+
+extern FS SDFS;
+
+#endif
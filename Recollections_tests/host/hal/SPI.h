@@ -0,0 +1,14 @@
+/**
+ * Recollections: host implementation of SPI
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The SD card is the only SPI device, and on the host it is a directory. See SDFS.h.
+ */
+
+#include "Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_SPI_H_
+#define RECOLLECTIONS_HOST_SPI_H_
+
+#endif
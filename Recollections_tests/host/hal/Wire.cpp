@@ -0,0 +1,128 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Wire.h"
+
+#include <string.h>
+
+#include "Adafruit_MCP4728.h"
+
+TwoWire Wire;
+TwoWire Wire1;
+
+/** The TwoWire that has begun as a target at each 7-bit address, if any. */
+static TwoWire *targets[128];
+
+/** A bus answers at one address at most, and at none as a controller. */
+static void release(TwoWire *wire) {
+  for (TwoWire *&target : targets) {
+    if (target == wire) {
+      target = nullptr;
+    }
+  }
+}
+
+void TwoWire::begin() {
+  release(this);
+}
+
+void TwoWire::begin(uint8_t address) {
+  release(this);
+  targets[address & 0x7F] = this;
+}
+
+void TwoWire::end() {
+  release(this);
+  onReceive_ = nullptr;
+  onRequest_ = nullptr;
+  receivedLength_ = 0;
+  receivedIndex_ = 0;
+}
+
+void TwoWire::setSDA(uint8_t /* pin */) {}
+
+void TwoWire::setSCL(uint8_t /* pin */) {}
+
+void TwoWire::setClock(uint32_t /* frequency */) {}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  address_ = address;
+  length_ = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (length_ >= sizeof(buffer_)) {
+    return 0;
+  }
+  buffer_[length_++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t length) {
+  size_t written = 0;
+  while (written < length && write(data[written]) == 1) {
+    written++;
+  }
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool /* sendStop */) {
+  size_t length = length_;
+  length_ = 0;
+  // The general call is addressed to the bus rather than to a simulated device.
+  if (address_ == 0x00) {
+    if (length == 1) {
+      Adafruit_MCP4728::generalCall(this, buffer_[0]);
+    }
+    return 0;
+  }
+  TwoWire *target = targets[address_ & 0x7F];
+  if (target == nullptr || target == this) {
+    // NACK on the address.
+    return 2;
+  }
+  memcpy(target->received_, buffer_, length);
+  target->receivedLength_ = length;
+  target->receivedIndex_ = 0;
+  if (target->onReceive_ != nullptr) {
+    target->onReceive_(static_cast<int>(length));
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  receivedLength_ = 0;
+  receivedIndex_ = 0;
+  TwoWire *target = targets[address & 0x7F];
+  if (target == nullptr || target == this || target->onRequest_ == nullptr) {
+    return 0;
+  }
+  // The target's handler writes its answer as it would a transmission.
+  target->length_ = 0;
+  target->onRequest_();
+  size_t length = target->length_ < quantity ? target->length_ : quantity;
+  memcpy(received_, target->buffer_, length);
+  receivedLength_ = length;
+  target->length_ = 0;
+  return static_cast<uint8_t>(length);
+}
+
+void TwoWire::onReceive(void (*handler)(int)) {
+  onReceive_ = handler;
+}
+
+void TwoWire::onRequest(void (*handler)()) {
+  onRequest_ = handler;
+}
+
+int TwoWire::available() {
+  return static_cast<int>(receivedLength_ - receivedIndex_);
+}
+
+int TwoWire::read() {
+  if (receivedIndex_ >= receivedLength_) {
+    return -1;
+  }
+  return received_[receivedIndex_++];
+}
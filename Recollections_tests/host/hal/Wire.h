@@ -0,0 +1,52 @@
+/**
+ * Recollections: host implementation of Wire
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The I2C buses. On the host, the devices on the local bus are simulated directly in their driver
+ * classes, so the bus passes a general call on to the DACs. Otherwise, a transmission is delivered
+ * to whichever TwoWire has begun as a target at its address, which calls its onReceive handler
+ * at once, as an interrupt would, and requestFrom() calls the target's onRequest handler for the
+ * bytes it writes. Linked modules and controllers are simulated this way. See Link.h and Remote.h.
+ */
+
+#include "Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_WIRE_H_
+#define RECOLLECTIONS_HOST_WIRE_H_
+
+class TwoWire {
+  public:
+  void begin();
+  void begin(uint8_t address);
+  void end();
+  void setSDA(uint8_t pin);
+  void setSCL(uint8_t pin);
+  void setClock(uint32_t frequency);
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t length);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  void onReceive(void (*handler)(int));
+  void onRequest(void (*handler)());
+  int available();
+  int read();
+
+  private:
+  uint8_t address_ = 0;
+  uint8_t buffer_[32];
+  size_t length_ = 0;
+
+  /** The bytes last received as a target, and how many have been read. */
+  uint8_t received_[32];
+  size_t receivedLength_ = 0;
+  size_t receivedIndex_ = 0;
+  void (*onReceive_)(int) = nullptr;
+  void (*onRequest_)() = nullptr;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
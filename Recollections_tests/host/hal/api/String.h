@@ -0,0 +1,15 @@
+/**
+ * Recollections: host implementation of api/String.h
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * Libraries such as StreamUtils include the core's headers one by one. On the host, String is in
+ * Arduino.h.
+ */
+
+#include "../Arduino.h"
+
+#ifndef RECOLLECTIONS_HOST_API_STRING_H_
+#define RECOLLECTIONS_HOST_API_STRING_H_
+
+#endif
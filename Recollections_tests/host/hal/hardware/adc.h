@@ -0,0 +1,39 @@
+/**
+ * Recollections: host implementation of the Pico SDK's ADC
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * Only free-running capture into the FIFO, to be drained by DMA, is implemented. Samples are taken
+ * at the rate set by adc_set_clkdiv(), from the value HostBoard::setAnalog() presents to the
+ * selected input's pin, as the clock moves. See dma.h.
+ */
+
+#include <stdint.h>
+
+#ifndef RECOLLECTIONS_HOST_HARDWARE_ADC_H_
+#define RECOLLECTIONS_HOST_HARDWARE_ADC_H_
+
+/** The DMA request of the ADC's FIFO. */
+#define DREQ_ADC 36
+
+/** The registers of the ADC. Only the FIFO, which DMA reads from, is present. */
+typedef struct adc_hw {
+  volatile uint32_t fifo;
+} adc_hw_t;
+
+extern adc_hw_t *const adc_hw;
+
+void adc_init();
+void adc_gpio_init(unsigned int gpio);
+void adc_select_input(unsigned int input);
+void adc_fifo_setup(
+  bool en,
+  bool dreq_en,
+  uint16_t dreq_thresh,
+  bool err_in_fifo,
+  bool byte_shift
+);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+
+#endif
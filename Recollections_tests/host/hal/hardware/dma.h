@@ -0,0 +1,60 @@
+/**
+ * Recollections: host implementation of the Pico SDK's DMA
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * Only what a channel needs to drain the ADC's FIFO into a ring buffer is implemented: transfers
+ * paced by DREQ_ADC, from adc_hw->fifo, without read increment and with write increment, wrapping
+ * at the ring size. Transfers are made as the clock moves, at the ADC's sample rate. See adc.h.
+ */
+
+#include <stdint.h>
+
+#ifndef RECOLLECTIONS_HOST_HARDWARE_DMA_H_
+#define RECOLLECTIONS_HOST_HARDWARE_DMA_H_
+
+#define NUM_DMA_CHANNELS 12
+
+enum dma_channel_transfer_size {
+  DMA_SIZE_8 = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2,
+};
+
+typedef struct dma_channel_config {
+  dma_channel_transfer_size size;
+  bool readIncrement;
+  bool writeIncrement;
+  bool ringOnWrite;
+  unsigned int ringBits;
+  unsigned int dreq;
+} dma_channel_config;
+
+/** The registers of a channel. Only the count of transfers remaining is present. */
+typedef struct dma_channel_hw {
+  volatile uint32_t transfer_count;
+} dma_channel_hw_t;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+void channel_config_set_transfer_data_size(
+  dma_channel_config *config,
+  dma_channel_transfer_size size
+);
+void channel_config_set_read_increment(dma_channel_config *config, bool increment);
+void channel_config_set_write_increment(dma_channel_config *config, bool increment);
+void channel_config_set_ring(dma_channel_config *config, bool write, unsigned int size_bits);
+void channel_config_set_dreq(dma_channel_config *config, unsigned int dreq);
+void dma_channel_configure(
+  unsigned int channel,
+  const dma_channel_config *config,
+  volatile void *write_addr,
+  const volatile void *read_addr,
+  unsigned int transfer_count,
+  bool trigger
+);
+void dma_channel_set_trans_count(unsigned int channel, uint32_t trans_count, bool trigger);
+bool dma_channel_is_busy(unsigned int channel);
+dma_channel_hw_t *dma_channel_hw_addr(unsigned int channel);
+
+#endif
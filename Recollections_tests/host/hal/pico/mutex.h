@@ -0,0 +1,38 @@
+/**
+ * Recollections: host implementation of the Pico SDK's mutexes
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * The host runs both cores on one thread, so a mutex only records whether it is held.
+ */
+
+#include <stdint.h>
+
+#ifndef RECOLLECTIONS_HOST_PICO_MUTEX_H_
+#define RECOLLECTIONS_HOST_PICO_MUTEX_H_
+
+typedef struct mutex {
+  bool isOwned;
+} mutex_t;
+
+inline void mutex_init(mutex_t *mutex) {
+  mutex->isOwned = false;
+}
+
+inline void mutex_enter_blocking(mutex_t *mutex) {
+  mutex->isOwned = true;
+}
+
+inline bool mutex_try_enter(mutex_t *mutex, uint32_t * /* owner_out */) {
+  if (mutex->isOwned) {
+    return false;
+  }
+  mutex->isOwned = true;
+  return true;
+}
+
+inline void mutex_exit(mutex_t *mutex) {
+  mutex->isOwned = false;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/**
+ * Recollections: host implementation of the Pico SDK's random numbers
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * On the device, get_rand_32() gathers entropy from the ring oscillator. On the host, the numbers
+ * are the same on every run, so that a simulation can be repeated.
+ */
+
+#include <stdint.h>
+
+#ifndef RECOLLECTIONS_HOST_PICO_RAND_H_
+#define RECOLLECTIONS_HOST_PICO_RAND_H_
+
+inline uint32_t get_rand_32() {
+  static uint32_t x = 0;
+  x = x * 1664525 + 1013904223;
+  return x;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * Recollections: host implementation of the Pico SDK's repeating timers
+ *
+ * Copyright 2022 William Edward Fisher.
+ *
+ * On the device, the callback runs in an interrupt. On the host, it runs within
+ * HostBoard::advanceMicros(), delay() and delayMicroseconds(), at each simulated time it is due.
+ */
+
+#include <stdint.h>
+
+#ifndef RECOLLECTIONS_HOST_PICO_TIME_H_
+#define RECOLLECTIONS_HOST_PICO_TIME_H_
+
+struct repeating_timer;
+
+/** Return false to stop the timer. */
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *timer);
+
+typedef struct repeating_timer {
+  int64_t delay_us;
+  repeating_timer_callback_t callback;
+  void *user_data;
+} repeating_timer_t;
+
+/**
+ * @brief Call the callback every |delay_us| microseconds until it returns false or the timer is
+ * cancelled. The host does not model the time the callback takes, so the sign of delay_us, which
+ * on the device chooses whether the delay runs from the start or the end of the last call, does
+ * not matter.
+ *
+ * @param delay_us
+ * @param callback
+ * @param user_data
+ * @param out
+ * @return true
+ * @return false
+ */
+bool add_repeating_timer_us(
+  int64_t delay_us,
+  repeating_timer_callback_t callback,
+  void *user_data,
+  repeating_timer_t *out
+);
+
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#endif
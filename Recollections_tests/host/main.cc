@@ -0,0 +1,140 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ *
+ * recollections_sim: runs the firmware on the host against a directory standing in for the SD card,
+ * optionally replaying a trace of inputs. See Simulator.h for the trace format.
+ *
+ *   recollections_sim --sd <dir> [--trace <file>] [--ms <duration>] [--loop-us <period>]
+ *                     [--outputs] [--quiet]
+ *
+ * --outputs prints the eight outputs whenever they change. --quiet hides the firmware's Serial
+ * output. Without --ms, the simulation runs until one second after the last trace event.
+ */
+
+#include <Arduino.h>
+#include <SDFS.h>
+
+#include <chrono>
+
+#include "Simulator.h"
+#include "constants.h"
+
+namespace {
+  void usage() {
+    fprintf(
+      stderr,
+      "usage: recollections_sim --sd <dir> [--trace <file>] [--ms <duration>] "
+      "[--loop-us <period>] [--outputs] [--quiet]\n"
+    );
+  }
+
+  void printOutputs() {
+    printf("%10lu ms  outputs:", millis());
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      printf(" %4u", Simulator::output(channel));
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *sdRoot = nullptr;
+  const char *tracePath = nullptr;
+  unsigned long duration = 0;
+  unsigned long loopPeriod = 1000;
+  bool isPrintingOutputs = false;
+  bool isQuiet = false;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--sd") == 0 && hasValue) {
+      sdRoot = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+      tracePath = argv[++i];
+    } else if (strcmp(argv[i], "--ms") == 0 && hasValue) {
+      duration = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && hasValue) {
+      loopPeriod = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--outputs") == 0) {
+      isPrintingOutputs = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      isQuiet = true;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (!sdRoot || loopPeriod == 0) {
+    usage();
+    return 2;
+  }
+
+  Serial.setEcho(!isQuiet);
+  Simulator::begin(sdRoot);
+  Simulator::setLoopPeriod(loopPeriod);
+  Simulator::setup();
+  if (tracePath && !Simulator::loadTrace(tracePath)) {
+    return 1;
+  }
+
+  uint16_t lastOutputs[8] = {};
+  bool hasPrintedOutputs = false;
+  unsigned long const startTime = millis();
+  bool hasEndTime = duration > 0;
+  unsigned long endTime = startTime + duration;
+  auto const wallStart = std::chrono::steady_clock::now();
+  while (true) {
+    if (!hasEndTime && !Simulator::isTracePending()) {
+      hasEndTime = true;
+      endTime = millis() + 1000;
+    }
+    if (hasEndTime && millis() >= endTime) {
+      break;
+    }
+    Simulator::loop();
+    if (isPrintingOutputs) {
+      bool isChanged = !hasPrintedOutputs;
+      for (uint8_t channel = 0; channel < 8; channel++) {
+        isChanged = isChanged || Simulator::output(channel) != lastOutputs[channel];
+        lastOutputs[channel] = Simulator::output(channel);
+      }
+      if (isChanged) {
+        printOutputs();
+        hasPrintedOutputs = true;
+      }
+    }
+    if (HostBoard::isRebootRequested()) {
+      printf("reboot requested at %lu ms\n", millis());
+      break;
+    }
+  }
+  double const wallSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wallStart
+  ).count();
+
+  State *state = Simulator::state();
+  unsigned long const loops = Simulator::loops();
+  printf("simulated %lu ms in %lu loops\n", millis() - startTime, loops);
+  printf("host time %.3f s, %.0f loops per second\n", wallSeconds, loops / wallSeconds);
+  printf(
+    "module %u, bank %u, preset %u, screen %u\n",
+    state->config.currentModule,
+    state->currentBank,
+    state->currentPreset,
+    state->screen
+  );
+  printf(
+    "DAC I2C: %u transactions, %u bytes; NeoTrellis: %u pixel writes, %u shows\n",
+    state->config.dac1.getTransactions() + state->config.dac2.getTransactions(),
+    state->config.dac1.getBytes() + state->config.dac2.getBytes(),
+    state->config.trellis.pixels.getPixelWrites(),
+    state->config.trellis.pixels.getShows()
+  );
+  printf(
+    "SD: %u opens, %u bytes read, %u bytes written\n",
+    SDFS.stats.opens,
+    SDFS.stats.bytesRead,
+    SDFS.stats.bytesWritten
+  );
+  printOutputs();
+  return state->screen == SCREEN.ERROR ? 1 : 0;
+}
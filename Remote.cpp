@@ -0,0 +1,78 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "Remote.h"
+
+#if defined(ARDUINO_TEENSY36)
+  #include <i2c_t3.h>
+#else
+  #include <Wire.h>
+#endif
+
+#include "Link.h"
+#include "State.h"
+
+bool Remote::isListening(State *state) {
+  return !Link::isLinked(state) || Link::isFollower(state);
+}
+
+bool Remote::pop(State *state, RemoteCommand *command) {
+  Remote *remote = &state->remote;
+  uint8_t tail = remote->tail;
+  if (tail == remote->head) {
+    return false;
+  }
+  uint8_t slot = tail & (REMOTE_COMMAND_BUFFER_SIZE - 1);
+  command->type = remote->commands[slot].type;
+  command->channel = remote->commands[slot].channel;
+  command->value = remote->commands[slot].value;
+  // Release the slot only once it has been read.
+  remote->tail = tail + 1;
+  return true;
+}
+
+void Remote::receive(State *state, int byteCount) {
+  Remote *remote = &state->remote;
+  uint8_t bytes[REMOTE_COMMAND_BYTES];
+  int length = 0;
+  while (Wire1.available() > 0) {
+    uint8_t byte = Wire1.read();
+    if (length < REMOTE_COMMAND_BYTES) {
+      bytes[length] = byte;
+    }
+    length++;
+  }
+  remote->commandCount += 1;
+  if (byteCount != REMOTE_COMMAND_BYTES || length != REMOTE_COMMAND_BYTES) {
+    remote->droppedCommands += 1;
+    return;
+  }
+
+  if (bytes[0] == REMOTE_COMMAND.READ_OUTPUT) {
+    // The read follows at once, before the loop could carry out the command.
+    if (bytes[1] < 8) {
+      remote->readChannel = bytes[1];
+    }
+    return;
+  }
+
+  uint8_t head = remote->head;
+  if ((uint8_t)(head - remote->tail) >= REMOTE_COMMAND_BUFFER_SIZE) {
+    remote->droppedCommands += 1;
+    return;
+  }
+  uint8_t slot = head & (REMOTE_COMMAND_BUFFER_SIZE - 1);
+  remote->commands[slot].type = bytes[0];
+  remote->commands[slot].channel = bytes[1];
+  remote->commands[slot].value = (bytes[2] << 8) | bytes[3];
+  // Publish the command only once it is complete.
+  remote->head = head + 1;
+}
+
+void Remote::request(State *state) {
+  // A 16-bit value is written whole by either core, so it is never read half written.
+  uint16_t value = state->output.values[state->remote.readChannel];
+  uint8_t bytes[2] = { static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF) };
+  Wire1.write(bytes, 2);
+}
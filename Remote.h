@@ -0,0 +1,112 @@
+/**
+ * Recollections: Remote
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include <Arduino.h>
+
+#include "constants.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_REMOTE_H_
+#define RECOLLECTIONS_REMOTE_H_
+
+struct State;
+
+/**
+ * One command from a controller. On the bus, a command is REMOTE_COMMAND_BYTES long: the type,
+ * the channel, and the value, high byte first, as Teletype and similar controllers send it.
+ */
+typedef struct RemoteCommand {
+  /** See REMOTE_COMMAND in constants.h. */
+  RemoteCommandType_t type;
+
+  /** 0-7, for the commands that act on a channel. */
+  uint8_t channel;
+
+  uint16_t value;
+} RemoteCommand;
+
+/**
+ * Remote control of the module by a controller on the follower bus, such as Teletype, and later
+ * by MIDI through an expansion module that sends the same commands. See REMOTE_COMMAND.
+ *
+ * The interrupt handler of the bus only checks the size of each command and pushes it to a ring
+ * buffer, like that of GateEvents, and Input::handleInput() carries out the commands on the next
+ * loop. The handler never waits on the loop, so a controller can send commands as fast as the bus
+ * carries them, and the outputs, which are written by OutputTimer, are never held up by the
+ * commands. If the loop falls behind by more than REMOTE_COMMAND_BUFFER_SIZE commands, as while
+ * switching modules, the newest are dropped and counted.
+ *
+ * A read is answered in the interrupt handler itself, from the values last written to the DACs,
+ * as the controller waits on the bus for the answer. READ_OUTPUT chooses the output to read, and
+ * is not queued.
+ *
+ * An unlinked module answers at REMOTE_ADDRESS. A linked follower answers at its own address,
+ * where commands are told apart from the leader's messages by their size. The leader of linked
+ * modules drives the bus, so it takes no commands. See Link.h.
+ */
+typedef struct Remote {
+  /** Commands received. Indices run freely, as in GateEvents. */
+  volatile RemoteCommand commands[REMOTE_COMMAND_BUFFER_SIZE];
+
+  /** The count of commands pushed, written only by the interrupt handler. */
+  volatile uint8_t head;
+
+  /** The count of commands popped, written only by the loop. */
+  volatile uint8_t tail;
+
+  /** The output to answer a read with, set by READ_OUTPUT. */
+  volatile uint8_t readChannel;
+
+  /** Commands received, and commands dropped because the buffer was full or they were malformed. */
+  volatile uint32_t commandCount;
+  volatile uint32_t droppedCommands;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief Whether this module answers controllers on the follower bus.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool isListening(State *state);
+
+  /**
+   * @brief Take the oldest command from the buffer.
+   *
+   * @param state
+   * @param command Receives the command.
+   * @return true
+   * @return false if the buffer is empty.
+   */
+  static bool pop(State *state, RemoteCommand *command);
+
+  /**
+   * @brief Read a command from the follower bus and push it for the loop. Called by the interrupt
+   * handler of the follower bus in Recollections.ino. A command of any other size is dropped.
+   *
+   * @param state
+   * @param byteCount The bytes received.
+   */
+  static void receive(State *state, int byteCount);
+
+  /**
+   * @brief Answer a read from a controller with the output chosen by READ_OUTPUT. Called by the
+   * interrupt handler of the follower bus in Recollections.ino.
+   *
+   * @param state
+   */
+  static void request(State *state);
+} Remote;
+
+static_assert(
+  (REMOTE_COMMAND_BUFFER_SIZE & (REMOTE_COMMAND_BUFFER_SIZE - 1)) == 0 &&
+    REMOTE_COMMAND_BUFFER_SIZE <= 128,
+  "REMOTE_COMMAND_BUFFER_SIZE must be a power of two, no larger than 128"
+);
+
+#endif
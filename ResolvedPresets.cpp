@@ -0,0 +1,54 @@
+/**
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "ResolvedPresets.h"
+
+#include "Bits.h"
+#include "State.h"
+
+uint8_t ResolvedPresets::get(State *state, uint8_t bank, uint8_t preset, uint8_t channel) {
+  ResolvedPresets *resolved = &state->resolvedPresets;
+  if (resolved->isStale || resolved->tableBank != bank) {
+    ResolvedPresets::rebuild(state, bank);
+  }
+  return resolved->presets[preset][channel];
+}
+
+void ResolvedPresets::markStale(State *state, uint8_t bank) {
+  if (state->resolvedPresets.tableBank == bank) {
+    state->resolvedPresets.isStale = true;
+  }
+}
+
+void ResolvedPresets::markAllStale(State *state) {
+  state->resolvedPresets.isStale = true;
+}
+
+//--------------------------------------- PRIVATE --------------------------------------------------
+
+void ResolvedPresets::rebuild(State *state, uint8_t bank) {
+  ResolvedPresets *resolved = &state->resolvedPresets;
+  for (uint8_t preset = 0; preset < 16; preset++) {
+    ChannelFlags_t active = state->activeVoltages[bank][preset];
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      resolved->presets[preset][channel] = preset;
+    }
+    // Resolve the inactive channels of this preset all at once, walking backwards until each has
+    // found an active preset. As before this table existed, the search stops after 14 presets, and
+    // a voltage with no active preset among them outputs its own value.
+    ChannelFlags_t unresolved = (ChannelFlags_t)~active;
+    for (uint8_t i = 1; i < 15 && unresolved; i++) {
+      uint8_t candidatePreset = (preset + 16 - i) % 16;
+      ChannelFlags_t found = unresolved & state->activeVoltages[bank][candidatePreset];
+      for (uint8_t channel = 0; channel < 8; channel++) {
+        if (Bits::get(found, channel)) {
+          resolved->presets[preset][channel] = candidatePreset;
+        }
+      }
+      unresolved &= (ChannelFlags_t)~found;
+    }
+  }
+  resolved->tableBank = bank;
+  resolved->isStale = false;
+}
@@ -0,0 +1,68 @@
+/**
+ * Recollections: ResolvedPresets
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_RESOLVED_PRESETS_H_
+#define RECOLLECTIONS_RESOLVED_PRESETS_H_
+
+struct State;
+
+/**
+ * For every voltage, the preset whose voltage is actually output. An inactive voltage outputs the
+ * voltage of the closest earlier active preset, wrapping around the sequence, so finding it is a
+ * scan of up to 14 presets. The table keeps the result of that scan, so that the outputs can be
+ * resolved on every loop without scanning.
+ *
+ * Only the outputs of the current bank are resolved on every loop, so the table holds one bank, in
+ * 128 bytes rather than the 2 KB of all 16. It is rebuilt the next time it is read after the bank
+ * changes, or after the activeVoltages of its bank change. Every change to activeVoltages is
+ * recorded in the journal, which marks the bank as stale here.
+ */
+typedef struct ResolvedPresets {
+  /** Indices are [preset][channel], for tableBank. */
+  uint8_t presets[16][8];
+
+  /** The bank the table was built for. */
+  uint8_t tableBank;
+
+  /** Whether the table is out of date. */
+  bool isStale;
+
+  // ------------------------------- static methods ------------------------------------------------
+
+  /**
+   * @brief The preset whose voltage is output for a voltage: the preset itself when the voltage is
+   * active, otherwise the closest earlier preset where it is active.
+   *
+   * @param state
+   * @param bank
+   * @param preset
+   * @param channel
+   * @return uint8_t
+   */
+  static uint8_t get(State *state, uint8_t bank, uint8_t preset, uint8_t channel);
+
+  /**
+   * @brief Flag the table as out of date if it is for a bank whose activeVoltages have changed.
+   *
+   * @param state
+   * @param bank
+   */
+  static void markStale(State *state, uint8_t bank);
+
+  /**
+   * @brief Flag the table as out of date, whatever its bank, after reading a module.
+   *
+   * @param state
+   */
+  static void markAllStale(State *state);
+
+  private:
+  static void rebuild(State *state, uint8_t bank);
+} ResolvedPresets;
+
+#endif
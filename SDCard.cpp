@@ -7,10 +7,17 @@
 #include <ArduinoJson.h>
 
 #include <SPI.h>
+#include <string.h>
 #include <StackString.hpp> // I have not yet understood how to use cstrings. Why are these hard?
 using namespace Stack;
 
+#include "Advance.h"
+#include "BankRecord.h"
 #include "Config.h"
+#include "Log.h"
+#include "ModuleImage.h"
+#include "Playheads.h"
+#include "ResolvedPresets.h"
 #include "Utils.h"
 
 /**
@@ -20,10 +27,15 @@ typedef struct RecollectionsFileSystem {
   static File open(const char *filepath, uint8_t mode);
   static bool exists(const char *filepath);
   static bool mkdir(const char *filepath);
+  static bool remove(const char *filepath);
+  static bool rename(const char *fromFilepath, const char *toFilepath);
 } RecollectionsFileSystem;
 
 File RecollectionsFileSystem::open(const char *filepath, uint8_t mode = FILE_READ) {
   #ifdef CORE_TEENSY
+    if (mode == SD_APPEND) {
+      return SD.open(filepath, FILE_WRITE);
+    }
     File file = SD.open(filepath, mode);
     if (mode == FILE_WRITE_BEGIN) {
       file.truncate();
@@ -38,6 +50,10 @@ File RecollectionsFileSystem::open(const char *filepath, uint8_t mode = FILE_REA
         return SDFS.exists(filepath) ? SDFS.open(filepath, "r") : SDFS.open(filepath, "w");
         break;
       }
+      case SD_APPEND: {
+        return SDFS.open(filepath, "a");
+        break;
+      }
       case FILE_WRITE_BEGIN: {
         return SDFS.open(filepath, "w");
         break;
@@ -50,6 +66,63 @@ File RecollectionsFileSystem::open(const char *filepath, uint8_t mode = FILE_REA
   #endif
 }
 
+/**
+ * @brief Conversion between the bit-packed ChannelFlags_t in State and the arrays of 8 booleans,
+ * one per channel, used in the bank files. The files keep the unpacked form so they remain easy to
+ * read and edit by hand.
+ */
+typedef struct ChannelFlagsJson {
+  static void read(JsonVariantConst source, ChannelFlags_t *flags);
+  static void write(ChannelFlags_t flags, JsonArray destination);
+} ChannelFlagsJson;
+
+/**
+ * @brief Copy a JSON array of booleans into flags. As with copyArray(), a missing or short array
+ * leaves the remaining flags unchanged.
+ *
+ * @param source
+ * @param flags
+ */
+void ChannelFlagsJson::read(JsonVariantConst source, ChannelFlags_t *flags) {
+  bool values[8];
+  for (uint8_t i = 0; i < 8; i++) {
+    values[i] = Bits::get(*flags, i);
+  }
+  copyArray(source, values);
+  for (uint8_t i = 0; i < 8; i++) {
+    Bits::set(flags, i, values[i]);
+  }
+}
+
+void ChannelFlagsJson::write(ChannelFlags_t flags, JsonArray destination) {
+  for (uint8_t i = 0; i < 8; i++) {
+    destination.add(Bits::get(flags, i));
+  }
+}
+
+/**
+ * @brief Paths of the files within a module directory, such as Recollections/Module_15/Bank_0.bin.
+ */
+typedef struct ModulePath {
+  static StackString<100> build(uint8_t module, const char *filename);
+  static StackString<100> bank(uint8_t module, uint8_t bank, const char *extension);
+} ModulePath;
+
+StackString<100> ModulePath::build(uint8_t module, const char *filename) {
+  char moduleString[4];
+  sprintf(moduleString, "%u", module);
+  StackString<100> path = StackString<100>(MODULE_SD_PATH_PREFIX);
+  path.append(moduleString);
+  path.append(filename);
+  return path;
+}
+
+StackString<100> ModulePath::bank(uint8_t module, uint8_t bank, const char *extension) {
+  char bankFilename[16];
+  sprintf(bankFilename, "/Bank_%u%s", bank, extension);
+  return ModulePath::build(module, bankFilename);
+}
+
 bool RecollectionsFileSystem::exists(const char *filepath) {
   #ifdef CORE_TEENSY
     return SD.exists(filepath);
@@ -66,12 +139,24 @@ bool RecollectionsFileSystem::mkdir(const char *filepath) {
   #endif
 }
 
-void SDCard::confirmOrCreatePath(State state) {
-  int currentModuleLength = snprintf(NULL, 0, "%d", state.config.currentModule) + 1;
-  char currentModuleString[currentModuleLength];
-  sprintf(currentModuleString, "%d", state.config.currentModule);
-  StackString<100> modulePath = StackString<100>(MODULE_SD_PATH_PREFIX);
-  modulePath.append(currentModuleString);
+bool RecollectionsFileSystem::remove(const char *filepath) {
+  #ifdef CORE_TEENSY
+    return SD.remove(filepath);
+  #else // PICO
+    return SDFS.remove(filepath);
+  #endif
+}
+
+bool RecollectionsFileSystem::rename(const char *fromFilepath, const char *toFilepath) {
+  #ifdef CORE_TEENSY
+    return SD.rename(fromFilepath, toFilepath);
+  #else // PICO
+    return SDFS.rename(fromFilepath, toFilepath);
+  #endif
+}
+
+void SDCard::confirmOrCreatePath(State *state) {
+  StackString<100> modulePath = ModulePath::build(state->config.currentModule, "");
 
   if (!RecollectionsFileSystem::exists(modulePath.c_str())) {
     if (!RecollectionsFileSystem::exists("Recollections")) {
@@ -81,196 +166,777 @@ void SDCard::confirmOrCreatePath(State state) {
   }
 }
 
-Config SDCard::readConfigFile(Config config) {
+void SDCard::readConfigFile(Config *config) {
   File configFile = RecollectionsFileSystem::open(CONFIG_SD_PATH, SD_READ_CREATE);
 
   if (!configFile) {
-    Serial.println("Could not open Config.txt");
-    return config;
+    LOG_ERROR("Could not open Config.txt");
+    return;
   } else {
-    Serial.println("Successfully opened Config.txt");
+    LOG_INFO("Successfully opened Config.txt");
   }
 
   JsonDocument doc;
   DeserializationError error = deserializeJson(doc, configFile);
 
   if (error == DeserializationError::EmptyInput) {
-    Serial.println("Config.txt is an empty file");
-    return config;
+    LOG_ERROR("Config.txt is an empty file");
+    return;
   }
   else if (error) {
-    Serial.printf("%s %s \n", "deserializeJson() failed during read operation: ", error.c_str());
-    return config;
+    LOG_ERROR("deserializeJson() failed during read operation: %s", error.c_str());
+    return;
   }
   else {
-    Serial.println("Copying Config.txt to config struct");
+    LOG_INFO("Copying Config.txt to config struct");
+    if (doc["autosaveInterval"] != nullptr) {
+      config->autosaveInterval = doc["autosaveInterval"];
+    }
     if (doc["brightness"] != nullptr) {
-      config.brightness = doc["brightness"];
+      config->brightness = doc["brightness"];
     }
     if (doc["colors"] != nullptr) {
-      copyArray(doc["colors"]["white"], config.colors.white);
-      copyArray(doc["colors"]["red"], config.colors.red);
-      copyArray(doc["colors"]["blue"], config.colors.blue);
-      copyArray(doc["colors"]["yellow"], config.colors.yellow);
-      copyArray(doc["colors"]["green"], config.colors.green);
-      copyArray(doc["colors"]["purple"], config.colors.purple);
-      copyArray(doc["colors"]["orange"], config.colors.orange);
-      copyArray(doc["colors"]["magenta"], config.colors.magenta);
-      copyArray(doc["colors"]["black"], config.colors.black);
+      copyArray(doc["colors"]["white"], config->colors.white);
+      copyArray(doc["colors"]["red"], config->colors.red);
+      copyArray(doc["colors"]["blue"], config->colors.blue);
+      copyArray(doc["colors"]["yellow"], config->colors.yellow);
+      copyArray(doc["colors"]["green"], config->colors.green);
+      copyArray(doc["colors"]["purple"], config->colors.purple);
+      copyArray(doc["colors"]["orange"], config->colors.orange);
+      copyArray(doc["colors"]["magenta"], config->colors.magenta);
+      copyArray(doc["colors"]["black"], config->colors.black);
     }
     if (doc["controllerOrientation"] != nullptr) {
-      config.controllerOrientation = doc["controllerOrientation"];
+      config->controllerOrientation = doc["controllerOrientation"];
     }
     if (doc["currentModule"] != nullptr) {
-      config.currentModule = doc["currentModule"];
+      config->currentModule = doc["currentModule"];
     }
     if (doc["isAdvancingMaxInterval"] != nullptr) {
-      config.isAdvancingMaxInterval = doc["isAdvancingMaxInterval"];
+      config->isAdvancingMaxInterval = doc["isAdvancingMaxInterval"];
     }
     if (doc["isClockedTolerance"] != nullptr) {
-      config.isClockedTolerance = doc["isClockedTolerance"];
+      config->isClockedTolerance = doc["isClockedTolerance"];
+    }
+    if (doc["cvSmoothing"] != nullptr) {
+      uint8_t cvSmoothing = doc["cvSmoothing"];
+      config->cvSmoothing = cvSmoothing > CV_SMOOTHING_MAX ? CV_SMOOTHING_MAX : cvSmoothing;
     }
     if (doc["randomOutputOverwrites"] != nullptr) {
-      config.randomOutputOverwrites = doc["randomOutputOverwrites"];
+      config->randomOutputOverwrites = doc["randomOutputOverwrites"];
+    }
+    if (doc["exportBankJson"] != nullptr) {
+      config->exportBankJson = doc["exportBankJson"];
+    }
+    if (doc["linkModuleCount"] != nullptr) {
+      uint8_t linkModuleCount = doc["linkModuleCount"];
+      config->linkModuleCount = linkModuleCount < 1
+        ? 1
+        : linkModuleCount > LINK_MAX_MODULES ? LINK_MAX_MODULES : linkModuleCount;
+    }
+    if (doc["linkPosition"] != nullptr) {
+      config->linkPosition = doc["linkPosition"];
+    }
+    if (config->linkPosition >= config->linkModuleCount) {
+      LOG_WARN("linkPosition is outside the chain of linked modules, so this module is unlinked");
+      config->linkModuleCount = 1;
+      config->linkPosition = 0;
     }
   }
   configFile.close();
+}
 
-  return config;
+bool SDCard::switchModule(State *state, uint8_t module) {
+  if (!SDCard::finishSave(state)) {
+    return false;
+  }
+  SDCard::closeJournal(state);
+  state->config.currentModule = module;
+  SDCard::readModuleDirectory(state);
+  return true;
 }
 
-State SDCard::readModuleDirectory(State state) {
-  state = SDCard::readModuleFile(state);
-  for (uint8_t bank = 0; bank < 16; bank++) {
-    state = SDCard::readBankFile(state, bank);
+void SDCard::readModuleDirectory(State *state) {
+  state->dirtyBanks = 0;
+  state->isModuleDirty = false;
+  ResolvedPresets::markAllStale(state);
+  Advance::markStale(state);
+  Playheads::markStale(state);
+  if (!SDCard::readModuleImage(state)) {
+    SDCard::readModuleFile(state);
+    for (uint8_t bank = 0; bank < 16; bank++) {
+      SDCard::readBankFile(state, bank);
+    }
+    // Let autosave convert the legacy files into a Module.bin.
+    State::markModuleDirty(state);
   }
-  return state;
+
+  bool const hasJournal = SDCard::replayJournal(state);
+  // Imported after the journal, whose replay empties the pending entries the import records.
+  bool const hasImport = SDCard::importSequencesFile(state);
+  if (hasJournal || hasImport) {
+    // Fold the journal into Module.bin right away. This is the one time we can afford to block,
+    // and it means new entries are never appended after a torn one.
+    if (SDCard::saveDirtyBanks(state)) {
+      SDCard::compactJournal(state);
+    }
+  }
+  Playheads::moveTo(state, state->currentPreset);
 }
 
-State SDCard::readModuleFile(State state) {
-  int currentModuleLength = snprintf(NULL, 0, "%d", state.config.currentModule) + 1;
-  char currentModuleString[currentModuleLength];
-  sprintf(currentModuleString, "%d", state.config.currentModule);
+bool SDCard::readModuleImage(State *state) {
+  // Recollections/Module_15/Module.bin
+  StackString<100> imagePath = ModulePath::build(state->config.currentModule, "/Module.bin");
+  StackString<100> tempPath = ModulePath::build(state->config.currentModule, "/Module.tmp");
+
+  // A save removes Module.bin only once Module.tmp has been read back, so Module.tmp is complete.
+  // Were it left in place, the next save would truncate the only copy.
+  if (
+    !RecollectionsFileSystem::exists(imagePath.c_str()) &&
+    RecollectionsFileSystem::exists(tempPath.c_str())
+  ) {
+    LOG_WARN("Module.bin is missing, restoring it from Module.tmp");
+    RecollectionsFileSystem::rename(tempPath.c_str(), imagePath.c_str());
+  }
+
+  File imageFile = RecollectionsFileSystem::open(imagePath.c_str(), FILE_READ);
+  if (!imageFile) {
+    return false;
+  }
 
+  ModuleImage image;
+  size_t bytesRead = imageFile.read(reinterpret_cast<uint8_t *>(&image), sizeof(ModuleImage));
+  if (bytesRead != sizeof(ModuleImage) || !ModuleImage::toState(&image, state)) {
+    LOG_WARN("Module.bin is not a valid module image, reading the bank files");
+    imageFile.close();
+    return false;
+  }
+
+  // The records are written contiguously after the header, so in practice this is one sequential
+  // read through the file, one record at a time to keep the buffer small.
+  BankRecord record;
+  for (uint8_t bank = 0; bank < 16; bank++) {
+    if (imageFile.position() != image.bankOffsets[bank]) {
+      imageFile.seek(image.bankOffsets[bank]);
+    }
+    bytesRead = imageFile.read(reinterpret_cast<uint8_t *>(&record), sizeof(BankRecord));
+    if (
+      bytesRead < BANK_RECORD_V1_SIZE ||
+      bytesRead < record.size ||
+      !BankRecord::toState(&record, state, bank)
+    ) {
+      // A damaged record only costs us that one bank.
+      LOG_WARN("Bank %u in Module.bin is not valid, reading the bank file", bank);
+      SDCard::readBankFile(state, bank);
+    }
+  }
+  imageFile.close();
+  LOG_INFO("Copied Module.bin to state");
+  return true;
+}
+
+void SDCard::readModuleFile(State *state) {
   // Recollections/Module_15/Module.txt
-  StackString<100> modulePath = StackString<100>(MODULE_SD_PATH_PREFIX);
-  modulePath.append(currentModuleString);
-  modulePath.append("/Module.txt");
+  StackString<100> modulePath = ModulePath::build(state->config.currentModule, "/Module.txt");
 
   File moduleFile = RecollectionsFileSystem::open(modulePath.c_str(), SD_READ_CREATE);
   if (!moduleFile) {
-    Serial.println("Could not open Module.txt");
-    return state;
+    LOG_ERROR("Could not open Module.txt");
+    return;
   } else {
-    Serial.println("Successfully opened Module.txt");
+    LOG_INFO("Successfully opened Module.txt");
   }
 
   JsonDocument doc;
   DeserializationError error = deserializeJson(doc, moduleFile);
   if (error == DeserializationError::EmptyInput) {
-    Serial.println("Module.txt is an empty file");
+    LOG_ERROR("Module.txt is an empty file");
   }
   else if (error) {
-    Serial.printf("%s %s \n", "deserializeJson() failed during read operation: ", error.c_str());
+    LOG_ERROR("deserializeJson() failed during read operation: %s", error.c_str());
   }
   else {
-    Serial.println("Copying Module.txt to state");
-    state.currentPreset = doc["currentPreset"];
-    state.currentBank = doc["currentBank"];
-    state.currentChannel = doc["currentChannel"];
-    copyArray(doc["removedPresets"], state.removedPresets);
+    LOG_INFO("Copying Module.txt to state");
+    state->currentPreset = doc["currentPreset"];
+    state->currentBank = doc["currentBank"];
+    state->currentChannel = doc["currentChannel"];
+    copyArray(doc["removedPresets"], state->removedPresets);
   }
   moduleFile.close();
+}
 
-  return state;
+void SDCard::readBankFile(State *state, uint8_t bank) {
+  if (SDCard::readBinaryBankFile(state, bank)) {
+    return;
+  }
+  SDCard::readJsonBankFile(state, bank);
 }
 
-State SDCard::readBankFile(State state, uint8_t bank) {
-  int currentModuleLength = snprintf(NULL, 0, "%d", state.config.currentModule) + 1;
-  char currentModuleString[currentModuleLength];
-  sprintf(currentModuleString, "%d", state.config.currentModule);
+bool SDCard::readBinaryBankFile(State *state, uint8_t bank) {
+  // Recollections/Module_15/Bank_0.bin
+  StackString<100> bankPath = ModulePath::bank(state->config.currentModule, bank, ".bin");
 
+  // Opening for reading fails when the file does not exist, which spares us a separate exists()
+  // lookup on the card.
+  File bankFile = RecollectionsFileSystem::open(bankPath.c_str(), FILE_READ);
+  if (!bankFile) {
+    return false;
+  }
+
+  BankRecord record;
+  size_t bytesRead = bankFile.read(reinterpret_cast<uint8_t *>(&record), sizeof(BankRecord));
+  bankFile.close();
+
+  if (
+    bytesRead < BANK_RECORD_V1_SIZE ||
+    bytesRead < record.size ||
+    !BankRecord::toState(&record, state, bank)
+  ) {
+    LOG_WARN("Bank_%u.bin is not a valid bank record, reading Bank_%u.txt", bank, bank);
+    return false;
+  }
+  LOG_INFO("Copied Bank_%u.bin to state", bank);
+  return true;
+}
+
+void SDCard::readJsonBankFile(State *state, uint8_t bank) {
   int bankLength = snprintf(NULL, 0, "%d", bank) + 1;
   char bankString[bankLength];
   sprintf(bankString, "%d", bank);
 
   // Recollections/Module_15/Bank_0.txt
-  StackString<100> bankPath = StackString<100>(MODULE_SD_PATH_PREFIX);
-  bankPath.append(currentModuleString);
-  bankPath.append("/Bank_");
-  bankPath.append(bankString);
-  bankPath.append(".txt");
+  StackString<100> bankPath = ModulePath::bank(state->config.currentModule, bank, ".txt");
 
   File bankFile = RecollectionsFileSystem::open(bankPath.c_str(), SD_READ_CREATE);
 
   if (!bankFile) {
-    Serial.printf("%s%s%s\n", "Could not open Bank_", bankString, ".txt");
-    return state;
+    LOG_ERROR("Could not open Bank_%s.txt", bankString);
+    return;
   } else {
-    Serial.printf("%s%s%s\n", "Successfully opened Bank_", bankString, ".txt");
+    LOG_INFO("Successfully opened Bank_%s.txt", bankString);
   }
 
   JsonDocument doc;
   DeserializationError error = deserializeJson(doc, bankFile);
   if (error == DeserializationError::EmptyInput) {
-    Serial.printf("Bank_%s.txt is an empty file\n", bankString);
+    LOG_ERROR("Bank_%s.txt is an empty file", bankString);
   }
   else if (error) {
-    Serial.printf("%s %s \n", "deserializeJson() failed during read operation: ", error.c_str());
+    LOG_ERROR("deserializeJson() failed during read operation: %s", error.c_str());
   }
   else {
-    Serial.printf("Copying Bank_%s.txt to state\n", bankString);
-    copyArray(doc["activeVoltages"], state.activeVoltages[bank]);
-    copyArray(doc["autoRecordChannels"], state.autoRecordChannels[bank]);
-    copyArray(doc["gateChannels"], state.gateChannels[bank]);
-    copyArray(doc["gateVoltages"], state.gateVoltages[bank]);
-    copyArray(doc["lockedVoltages"], state.lockedVoltages[bank]);
-    copyArray(doc["randomInputChannels"], state.randomInputChannels[bank]);
-    copyArray(doc["randomOutputChannels"], state.randomOutputChannels[bank]);
-    copyArray(doc["randomVoltages"], state.randomVoltages[bank]);
-    copyArray(doc["voltages"], state.voltages[bank]);
+    LOG_INFO("Copying Bank_%s.txt to state", bankString);
+    ChannelFlagsJson::read(doc["autoRecordChannels"], &state->autoRecordChannels[bank]);
+    ChannelFlagsJson::read(doc["gateChannels"], &state->gateChannels[bank]);
+    ChannelFlagsJson::read(doc["randomInputChannels"], &state->randomInputChannels[bank]);
+    ChannelFlagsJson::read(doc["randomOutputChannels"], &state->randomOutputChannels[bank]);
+    for (uint8_t i = 0; i < 16; i++) {
+      ChannelFlagsJson::read(doc["activeVoltages"][i], &state->activeVoltages[bank][i]);
+      ChannelFlagsJson::read(doc["gateVoltages"][i], &state->gateVoltages[bank][i]);
+      ChannelFlagsJson::read(doc["lockedVoltages"][i], &state->lockedVoltages[bank][i]);
+      ChannelFlagsJson::read(doc["randomVoltages"][i], &state->randomVoltages[bank][i]);
+    }
+    // Added after the other fields, so older files go without.
+    memset(state->randomSeeds[bank], 0, sizeof(state->randomSeeds[bank]));
+    if (doc["randomSeeds"] != nullptr) {
+      copyArray(doc["randomSeeds"], state->randomSeeds[bank]);
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+      state->channelLengths[bank][i] = 0;
+      state->channelAddends[bank][i] = 1;
+      state->removedSteps[bank][i] = 0;
+    }
+    if (doc["channelLengths"] != nullptr) {
+      copyArray(doc["channelLengths"], state->channelLengths[bank]);
+    }
+    if (doc["channelAddends"] != nullptr) {
+      copyArray(doc["channelAddends"], state->channelAddends[bank]);
+    }
+    if (doc["removedSteps"] != nullptr) {
+      copyArray(doc["removedSteps"], state->removedSteps[bank]);
+    }
+    copyArray(doc["voltages"], state->voltages[bank]);
   }
   bankFile.close();
+}
+
+bool SDCard::importSequencesFile(State *state) {
+  // Recollections/Module_15/Sequences.txt
+  StackString<100> sequencesPath = ModulePath::build(state->config.currentModule, "/Sequences.txt");
+  if (!RecollectionsFileSystem::exists(sequencesPath.c_str())) {
+    return false;
+  }
 
-  return state;
+  File sequencesFile = RecollectionsFileSystem::open(sequencesPath.c_str(), FILE_READ);
+  if (!sequencesFile) {
+    LOG_ERROR("Could not open Sequences.txt");
+    return false;
+  }
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, sequencesFile);
+  sequencesFile.close();
+  if (error) {
+    // The file is left as it is, so it can be corrected and imported on the next start up.
+    LOG_ERROR("deserializeJson() failed during read of Sequences.txt: %s", error.c_str());
+    return false;
+  }
+
+  for (uint8_t bank = 0; bank < 16; bank++) {
+    char bankString[3];
+    sprintf(bankString, "%u", bank);
+    // Banks missing from the file are left as they are.
+    bool isImported = false;
+    // As in Bank_n.txt, a missing or short array leaves the remaining channels unchanged.
+    if (doc[bankString]["channelLengths"] != nullptr) {
+      copyArray(doc[bankString]["channelLengths"], state->channelLengths[bank]);
+      isImported = true;
+    }
+    if (doc[bankString]["channelAddends"] != nullptr) {
+      copyArray(doc[bankString]["channelAddends"], state->channelAddends[bank]);
+      isImported = true;
+    }
+    if (doc[bankString]["removedSteps"] != nullptr) {
+      copyArray(doc[bankString]["removedSteps"], state->removedSteps[bank]);
+      isImported = true;
+    }
+    if (!isImported) {
+      continue;
+    }
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      if (state->channelLengths[bank][channel] > 16) {
+        state->channelLengths[bank][channel] = 0;
+      }
+      Journal::sequence(state, bank, channel);
+    }
+  }
+  Playheads::markStale(state);
+
+  // Renamed rather than removed, so the user keeps the file, but it is only imported once and
+  // later edits to the module are not overwritten at every start up.
+  StackString<100> importedPath = ModulePath::build(
+    state->config.currentModule,
+    "/Sequences_imported.txt"
+  );
+  if (RecollectionsFileSystem::exists(importedPath.c_str())) {
+    RecollectionsFileSystem::remove(importedPath.c_str());
+  }
+  if (!RecollectionsFileSystem::rename(sequencesPath.c_str(), importedPath.c_str())) {
+    LOG_ERROR("Could not rename Sequences.txt");
+  }
+  LOG_INFO("Imported Sequences.txt");
+  return true;
 }
 
-bool SDCard::writeCurrentModuleAndBank(State state) {
-  Serial.println("writing to SD card");
+void SDCard::autosave(unsigned long loopStartTime, State *state) {
+  if (state->saveJob.step != SAVE_STEP.IDLE || (state->dirtyBanks == 0 && !state->isModuleDirty)) {
+    return;
+  }
+  // A large journal is compacted even when autosave is off, as it is replayed on every start up.
+  if (
+    state->journal.fileSize < JOURNAL_COMPACT_SIZE &&
+    (
+      state->config.autosaveInterval == 0 ||
+      loopStartTime - state->lastAutosaveTime < state->config.autosaveInterval
+    )
+  ) {
+    return;
+  }
 
-  SDCard::confirmOrCreatePath(state);
+  if (!SDCard::beginSave(state, SDCard::nextDirtyBank(state), true)) {
+    // The banks are still dirty, and are tried again after the next interval.
+    return;
+  }
+
+  // One save covers every dirty bank, so the interval starts now.
+  state->lastAutosaveTime = loopStartTime;
+}
+
+bool SDCard::beginSave(State *state, uint8_t bank, bool isAutosave) {
+  SaveJob *job = &state->saveJob;
+  if (job->step != SAVE_STEP.IDLE) {
+    // Only one save at a time. Finish the earlier one so its snapshot is not lost.
+    SDCard::finishSave(state);
+    if (job->hasFailed) {
+      // The earlier bank is dirty again. Nothing new is snapshotted, so nothing is marked clean.
+      return false;
+    }
+  }
+  job->hasFailed = false;
+
+  LOG_DEBUG("writing to SD card");
+  job->module = state->config.currentModule;
+  job->bank = bank;
+  job->isAutosave = isAutosave;
+  ModuleImage::fromState(state, &job->image);
+  BankRecord::fromState(state, bank, &job->record);
+  job->step = SAVE_STEP.OPEN;
+
+  // Changes made from here on may not be in the image, and will mark their bank dirty again.
+  job->cleanedBanks = state->dirtyBanks | (uint16_t)(1 << bank);
+  state->dirtyBanks = 0;
+  state->isModuleDirty = false;
+  return true;
+}
+
+bool SDCard::continueSave(State *state) {
+  SaveJob *job = &state->saveJob;
+  switch (job->step) {
+    case SAVE_STEP.IDLE: {
+      return true;
+    }
+    case SAVE_STEP.OPEN: {
+      SDCard::confirmOrCreatePath(state);
 
-  // TODO: I would like to abstract a lot of this into a function, since a lot of lines are repeated
-  // twice here and in the other SD card functions, but I am having trouble figuring out how to do
-  // this with cstrings in a way that makes sense and actually saves lines of code. Something to
-  // improve upon later.
+      // Recollections/Module_15/Module.tmp
+      StackString<100> tempPath = ModulePath::build(job->module, "/Module.tmp");
+      job->file = RecollectionsFileSystem::open(tempPath.c_str(), FILE_WRITE_BEGIN);
+      if (!job->file) {
+        LOG_ERROR("Could not open Module.tmp");
+        return SDCard::abandonSave(state);
+      }
+      job->segment = 0;
+      job->segmentBytesWritten = 0;
+      job->step = SAVE_STEP.WRITE;
+      return true;
+    }
+    case SAVE_STEP.WRITE: {
+      if (!SDCard::writeSaveChunk(state)) {
+        LOG_ERROR("Failed to write Module.tmp, segment: %u", job->segment);
+        job->file.close();
+        return SDCard::abandonSave(state);
+      }
+      return true;
+    }
+    case SAVE_STEP.CLOSE: {
+      job->file.close();
+      StackString<100> tempPath = ModulePath::build(job->module, "/Module.tmp");
+      job->file = RecollectionsFileSystem::open(tempPath.c_str(), FILE_READ);
+      if (!job->file) {
+        LOG_ERROR("Could not reopen Module.tmp");
+        return SDCard::abandonSave(state);
+      }
+      job->segment = 0;
+      job->step = SAVE_STEP.VERIFY;
+      return true;
+    }
+    case SAVE_STEP.VERIFY: {
+      if (!SDCard::verifySaveChunk(state)) {
+        LOG_ERROR("Module.tmp does not read back as written, segment: %u", job->segment);
+        job->file.close();
+        return SDCard::abandonSave(state);
+      }
+      return true;
+    }
+    case SAVE_STEP.COMMIT: {
+      StackString<100> imagePath = ModulePath::build(job->module, "/Module.bin");
+      StackString<100> tempPath = ModulePath::build(job->module, "/Module.tmp");
+      // Should the power be cut between these two, readModuleImage() finishes the rename.
+      if (
+        (
+          RecollectionsFileSystem::exists(imagePath.c_str()) &&
+          !RecollectionsFileSystem::remove(imagePath.c_str())
+        ) ||
+        !RecollectionsFileSystem::rename(tempPath.c_str(), imagePath.c_str())
+      ) {
+        LOG_ERROR("Could not replace Module.bin with Module.tmp");
+        return SDCard::abandonSave(state);
+      }
+      if (state->config.exportBankJson) {
+        job->step = SAVE_STEP.EXPORT;
+        return true;
+      }
+      break;
+    }
+    case SAVE_STEP.EXPORT: {
+      // The JSON export is opt-in and is written in one go, so it will stall the loop.
+      if (!SDCard::exportModuleFile(state) || !SDCard::exportBankFile(state, job->bank)) {
+        return SDCard::abandonSave(state);
+      }
+      break;
+    }
+  }
 
-  // --------------------------- Module file ---------------------------------
+  // Only now is the data on the card, so only now do we confirm the save.
+  LOG_INFO("Module.bin written");
+  job->step = SAVE_STEP.IDLE;
+  if (!job->isAutosave) {
+    state->confirmingSave = true;
+    state->flashesSinceSave = 0;
+  }
+  return true;
+}
 
-  int currentModuleLength = snprintf(NULL, 0, "%d", state.config.currentModule) + 1;
-  char currentModuleString[currentModuleLength];
-  sprintf(currentModuleString, "%d", state.config.currentModule);
+uint8_t SDCard::nextDirtyBank(State *state) {
+  for (uint8_t i = 0; i < 16; i++) {
+    if (state->dirtyBanks & (1 << i)) {
+      return i;
+    }
+  }
+  // The module header is written along with any bank, so when only the header has changed, we
+  // rewrite the current bank.
+  return state->currentBank;
+}
 
+bool SDCard::saveDirtyBanks(State *state) {
+  while (state->dirtyBanks != 0 || state->isModuleDirty) {
+    uint8_t const bank = SDCard::nextDirtyBank(state);
+    if (!SDCard::beginSave(state, bank, true)) {
+      return false;
+    }
+    SDCard::finishSave(state);
+    // A failed autosave marks its banks dirty again rather than reporting an error.
+    if (state->saveJob.hasFailed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SDCard::maintainJournal(unsigned long loopStartTime, State *state) {
+  Journal *journal = &state->journal;
+
+  // Once nothing is dirty and no save is in progress, every journaled edit is in Module.bin. A save
+  // only ends once its image has been read back and has replaced Module.bin, and a failed save
+  // marks its bank dirty again, so the journal outlives any save that did not make it.
+  if (
+    state->dirtyBanks == 0 &&
+    !state->isModuleDirty &&
+    state->saveJob.step == SAVE_STEP.IDLE
+  ) {
+    SDCard::compactJournal(state);
+    return;
+  }
+
+  if (
+    journal->pendingCount > 0 &&
+    loopStartTime - journal->lastFlushTime >= JOURNAL_FLUSH_INTERVAL
+  ) {
+    SDCard::flushJournal(state);
+    journal->lastFlushTime = loopStartTime;
+  }
+}
+
+bool SDCard::flushJournal(State *state) {
+  Journal *journal = &state->journal;
+  if (journal->pendingCount == 0) {
+    return true;
+  }
+
+  if (!journal->file) {
+    // On a new card, the module directory does not exist until the first save.
+    SDCard::confirmOrCreatePath(state);
+
+    // Recollections/Module_15/Journal.bin
+    StackString<100> journalPath = ModulePath::build(state->config.currentModule, "/Journal.bin");
+    journal->file = RecollectionsFileSystem::open(journalPath.c_str(), SD_APPEND);
+    if (!journal->file) {
+      LOG_ERROR("Could not open Journal.bin");
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < journal->pendingCount; i++) {
+    Journal::seal(&journal->pending[i]);
+  }
+  size_t const length = journal->pendingCount * sizeof(JournalEntry);
+  size_t bytesWritten = journal->file.write(reinterpret_cast<uint8_t *>(journal->pending), length);
+  journal->file.flush();
+  journal->fileSize += bytesWritten;
+
+  // The banks are still dirty, so even if the journal write failed, autosave will save the edits.
+  journal->pendingCount = 0;
+  if (bytesWritten != length) {
+    LOG_ERROR(
+      "Failed to write Journal.bin, bytes written: %u", static_cast<unsigned>(bytesWritten)
+    );
+    return false;
+  }
+  return true;
+}
+
+void SDCard::closeJournal(State *state) {
+  SDCard::flushJournal(state);
+  if (state->journal.file) {
+    state->journal.file.close();
+  }
+}
+
+bool SDCard::replayJournal(State *state) {
+  Journal *journal = &state->journal;
+  journal->pendingCount = 0;
+  journal->fileSize = 0;
+
+  // Recollections/Module_15/Journal.bin
+  StackString<100> journalPath = ModulePath::build(state->config.currentModule, "/Journal.bin");
+  File journalFile = RecollectionsFileSystem::open(journalPath.c_str(), FILE_READ);
+  if (!journalFile) {
+    return false;
+  }
+
+  JournalEntry entry;
+  uint32_t entriesApplied = 0;
+  while (journalFile.read(reinterpret_cast<uint8_t *>(&entry), sizeof(JournalEntry)) > 0) {
+    // Anything after a torn or invalid entry cannot be trusted.
+    if (!Journal::apply(&entry, state)) {
+      LOG_WARN("Journal.bin has an invalid entry, ignoring the rest");
+      break;
+    }
+    entriesApplied += 1;
+  }
+  // The whole file counts, torn tail included, so that compaction removes all of it.
+  journal->fileSize = journalFile.size();
+  journalFile.close();
+
+  LOG_INFO("Replayed %u entries from Journal.bin", entriesApplied);
+  return journal->fileSize > 0;
+}
+
+void SDCard::compactJournal(State *state) {
+  Journal *journal = &state->journal;
+  journal->pendingCount = 0;
+  if (journal->fileSize == 0) {
+    return;
+  }
+  if (journal->file) {
+    journal->file.close();
+  }
+
+  // Recollections/Module_15/Journal.bin
+  StackString<100> journalPath = ModulePath::build(state->config.currentModule, "/Journal.bin");
+  File journalFile = RecollectionsFileSystem::open(journalPath.c_str(), FILE_WRITE_BEGIN);
+  if (journalFile) {
+    journalFile.close();
+    journal->fileSize = 0;
+  }
+}
+
+bool SDCard::abandonSave(State *state) {
+  SaveJob *job = &state->saveJob;
+  job->step = SAVE_STEP.IDLE;
+  job->hasFailed = true;
+  // The banks never made it to the card, so they still need saving.
+  state->dirtyBanks |= job->cleanedBanks;
+  State::markModuleDirty(state);
+  // Autosave tries again after the next interval, so only a failed explicit save is an error.
+  if (job->isAutosave) {
+    state->lastAutosaveTime = millis();
+  }
+  return job->isAutosave;
+}
+
+bool SDCard::finishSave(State *state) {
+  while (state->saveJob.step != SAVE_STEP.IDLE) {
+    if (!SDCard::continueSave(state)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SDCard::writeSaveChunk(State *state) {
+  SaveJob *job = &state->saveJob;
+
+  // All 16 banks are written to Module.tmp, then the header, so that a Module.tmp left by a save
+  // cut short has no valid header.
+  bool const isHeader = job->segment == 16;
+
+  uint8_t *data;
+  uint16_t length;
+  uint32_t offset;
+  if (isHeader) {
+    data = reinterpret_cast<uint8_t *>(&job->image);
+    length = sizeof(ModuleImage);
+    offset = 0;
+  } else {
+    uint8_t const bank = job->segment;
+    if (bank == job->bank) {
+      data = reinterpret_cast<uint8_t *>(&job->record);
+    } else {
+      if (job->segmentBytesWritten == 0) {
+        BankRecord::fromState(state, bank, &job->scratch);
+      }
+      data = reinterpret_cast<uint8_t *>(&job->scratch);
+    }
+    length = sizeof(BankRecord);
+    offset = job->image.bankOffsets[bank];
+  }
+
+  if (job->segmentBytesWritten == 0 && !job->file.seek(offset)) {
+    return false;
+  }
+
+  uint16_t const remaining = length - job->segmentBytesWritten;
+  uint16_t const chunkLength = remaining < SD_SAVE_CHUNK_SIZE ? remaining : SD_SAVE_CHUNK_SIZE;
+  size_t bytesWritten = job->file.write(data + job->segmentBytesWritten, chunkLength);
+  if (bytesWritten != chunkLength) {
+    return false;
+  }
+
+  job->segmentBytesWritten += chunkLength;
+  if (job->segmentBytesWritten == length) {
+    job->segment += 1;
+    job->segmentBytesWritten = 0;
+    if (job->segment == 17) {
+      job->step = SAVE_STEP.CLOSE;
+    }
+  }
+  return true;
+}
+
+bool SDCard::verifySaveChunk(State *state) {
+  SaveJob *job = &state->saveJob;
+  bool isVerified;
+  if (job->segment == 16) {
+    ModuleImage image;
+    isVerified =
+      job->file.seek(0) &&
+      job->file.read(reinterpret_cast<uint8_t *>(&image), sizeof(ModuleImage)) ==
+        sizeof(ModuleImage) &&
+      memcmp(&image, &job->image, sizeof(ModuleImage)) == 0;
+  } else {
+    uint8_t const bank = job->segment;
+    // The other banks were copied from state as they were written, so only their CRCs are known.
+    isVerified =
+      job->file.seek(job->image.bankOffsets[bank]) &&
+      job->file.read(reinterpret_cast<uint8_t *>(&job->scratch), sizeof(BankRecord)) ==
+        sizeof(BankRecord) &&
+      (
+        bank == job->bank
+          ? memcmp(&job->scratch, &job->record, sizeof(BankRecord)) == 0
+          : BankRecord::isValid(&job->scratch)
+      );
+  }
+  if (!isVerified) {
+    return false;
+  }
+
+  job->segment += 1;
+  if (job->segment == 17) {
+    job->file.close();
+    job->step = SAVE_STEP.COMMIT;
+  }
+  return true;
+}
+
+bool SDCard::exportModuleFile(State *state) {
   // Recollections/Module_15/Module.txt
-  StackString<100> modulePath = StackString<100>(MODULE_SD_PATH_PREFIX);
-  modulePath.append(currentModuleString);
-  modulePath.append("/Module.txt");
+  StackString<100> modulePath = ModulePath::build(state->config.currentModule, "/Module.txt");
 
   File moduleFile = RecollectionsFileSystem::open(modulePath.c_str(), FILE_WRITE_BEGIN);
 
   if (!moduleFile) {
-    Serial.println("Could not open Module.txt");
+    LOG_ERROR("Could not open Module.txt");
     return false;
   } else {
-    Serial.println("Successfully opened Module.txt");
+    LOG_INFO("Successfully opened Module.txt");
   }
 
   JsonDocument moduleDoc;
-  moduleDoc["currentBank"] = state.currentBank;
-  moduleDoc["currentChannel"] = state.currentChannel;
-  moduleDoc["currentPreset"] = state.currentPreset;
+  moduleDoc["currentBank"] = state->currentBank;
+  moduleDoc["currentChannel"] = state->currentChannel;
+  moduleDoc["currentPreset"] = state->currentPreset;
   for (uint8_t i = 0; i < 16; i++) {
-    moduleDoc["removedPresets"][i] = state.removedPresets[i];
+    moduleDoc["removedPresets"][i] = state->removedPresets[i];
   }
 
   WriteBufferingStream writeBufferingStream(moduleFile, 64);
@@ -278,64 +944,68 @@ bool SDCard::writeCurrentModuleAndBank(State state) {
   writeBufferingStream.flush();
   moduleFile.close();
   if (charsWritten == 0) {
-    Serial.println("Failed to write any chars to SD card");
+    LOG_ERROR("Failed to write any chars to SD card");
     return false;
   } else {
-    Serial.printf("%s %u \n", "chars written: ", charsWritten);
+    LOG_DEBUG("chars written: %u", static_cast<unsigned>(charsWritten));
   }
+  return true;
+}
 
-  // --------------------------- Bank file -------------------------------------
-
-  uint8_t bank = state.currentBank;
-
-  int bankLength = snprintf(NULL, 0, "%d", bank) + 1;
-  char bankString[bankLength];
-  sprintf(bankString, "%d", bank);
+bool SDCard::exportBankFile(State *state, uint8_t bank) {
+  SDCard::confirmOrCreatePath(state);
 
   // Recollections/Module_15/Bank_0.txt
-  StackString<100> bankPath = StackString<100>(MODULE_SD_PATH_PREFIX);
-  bankPath.append(currentModuleString);
-  bankPath.append("/Bank_");
-  bankPath.append(bankString);
-  bankPath.append(".txt");
+  StackString<100> bankPath = ModulePath::bank(state->config.currentModule, bank, ".txt");
 
   File bankFile = RecollectionsFileSystem::open(bankPath.c_str(), FILE_WRITE_BEGIN);
   if (!bankFile) {
-    Serial.printf("%s%s%s\n", "Could not open Bank_", bankString, ".txt");
+    LOG_ERROR("Could not open Bank_%u.txt", bank);
     return false;
   } else {
-    Serial.printf("%s%s%s\n", "Successfully opened Bank_", bankString, ".txt");
+    LOG_INFO("Successfully opened Bank_%u.txt", bank);
   }
 
   JsonDocument bankDoc;
   JsonObject bankRoot = bankDoc.to<JsonObject>();
-  JsonArray autoRecordChannels = bankRoot["autoRecordChannels"].to<JsonArray>();
-  JsonArray gateChannels = bankRoot["gateChannels"].to<JsonArray>();
-  JsonArray randomInputChannels = bankRoot["randomInputChannels"].to<JsonArray>();
-  JsonArray randomOutputChannels = bankRoot["randomOutputChannels"].to<JsonArray>();
-  for (uint8_t i = 0; i < 8; i++) {
-    autoRecordChannels.add(state.autoRecordChannels[bank][i]);
-    gateChannels.add(state.gateChannels[bank][i]);
-    randomInputChannels.add(state.randomInputChannels[bank][i]);
-    randomOutputChannels.add(state.randomOutputChannels[bank][i]);
-  }
+  ChannelFlagsJson::write(
+    state->autoRecordChannels[bank],
+    bankRoot["autoRecordChannels"].to<JsonArray>()
+  );
+  ChannelFlagsJson::write(state->gateChannels[bank], bankRoot["gateChannels"].to<JsonArray>());
+  ChannelFlagsJson::write(
+    state->randomInputChannels[bank],
+    bankRoot["randomInputChannels"].to<JsonArray>()
+  );
+  ChannelFlagsJson::write(
+    state->randomOutputChannels[bank],
+    bankRoot["randomOutputChannels"].to<JsonArray>()
+  );
   JsonArray activeVoltages = bankRoot["activeVoltages"].to<JsonArray>();
   JsonArray gateVoltages = bankRoot["gateVoltages"].to<JsonArray>();
   JsonArray lockedVoltages = bankRoot["lockedVoltages"].to<JsonArray>();
   JsonArray randomVoltages = bankRoot["randomVoltages"].to<JsonArray>();
   JsonArray voltages = bankRoot["voltages"].to<JsonArray>();
+  JsonArray randomSeeds = bankRoot["randomSeeds"].to<JsonArray>();
+  for (uint8_t i = 0; i < 8; i++) {
+    randomSeeds.add(state->randomSeeds[bank][i]);
+  }
+  JsonArray channelLengths = bankRoot["channelLengths"].to<JsonArray>();
+  JsonArray channelAddends = bankRoot["channelAddends"].to<JsonArray>();
+  JsonArray removedSteps = bankRoot["removedSteps"].to<JsonArray>();
+  for (uint8_t i = 0; i < 8; i++) {
+    channelLengths.add(state->channelLengths[bank][i]);
+    channelAddends.add(state->channelAddends[bank][i]);
+    removedSteps.add(state->removedSteps[bank][i]);
+  }
   for (uint8_t i = 0; i < 16; i++) {
-    JsonArray activeVoltagesChannelArray = activeVoltages.add<JsonArray>();
-    JsonArray gateVoltagesChannelArray = gateVoltages.add<JsonArray>();
-    JsonArray lockedVoltagesChannelArray = lockedVoltages.add<JsonArray>();
-    JsonArray randomVoltagesChannelArray = randomVoltages.add<JsonArray>();
+    ChannelFlagsJson::write(state->activeVoltages[bank][i], activeVoltages.add<JsonArray>());
+    ChannelFlagsJson::write(state->gateVoltages[bank][i], gateVoltages.add<JsonArray>());
+    ChannelFlagsJson::write(state->lockedVoltages[bank][i], lockedVoltages.add<JsonArray>());
+    ChannelFlagsJson::write(state->randomVoltages[bank][i], randomVoltages.add<JsonArray>());
     JsonArray voltagesChannelArray = voltages.add<JsonArray>();
     for (uint8_t j = 0; j < 8; j++) {
-      activeVoltagesChannelArray.add(state.activeVoltages[bank][i][j]);
-      gateVoltagesChannelArray.add(state.gateVoltages[bank][i][j]);
-      lockedVoltagesChannelArray.add(state.lockedVoltages[bank][i][j]);
-      randomVoltagesChannelArray.add(state.randomVoltages[bank][i][j]);
-      voltagesChannelArray.add(state.voltages[bank][i][j]);
+      voltagesChannelArray.add(state->voltages[bank][i][j]);
     }
   }
 
@@ -344,10 +1014,10 @@ bool SDCard::writeCurrentModuleAndBank(State state) {
   writeBankBufferingStream.flush();
   bankFile.close();
   if (bankCharsWritten == 0) {
-    Serial.println("Failed to write any chars to SD card");
+    LOG_ERROR("Failed to write any chars to SD card");
     return false;
   } else {
-    Serial.printf("%s %u \n", "chars written: ", bankCharsWritten);
+    LOG_DEBUG("chars written: %u", static_cast<unsigned>(bankCharsWritten));
   }
 
   return true;
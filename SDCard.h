@@ -39,48 +39,147 @@ typedef struct SDCard {
    * @brief Get the config data from the config file, or create the file if it does not exist.
    *
    * @param config
-   * @return Config
    */
-  static Config readConfigFile(Config config);
+  static void readConfigFile(Config *config);
 
   /**
-   * @brief Read an entirely new module from the SD card, reading from both Module.txt and all the
-   * Bank_n.txt files within a new Module_n directory, so an entirely new set of 16 banks becomes
-   * available. Creat the directory structure and files if they do not yet exist.
+   * @brief Read an entirely new module from the SD card, so an entirely new set of 16 banks becomes
+   * available. The single Module.bin file is preferred. If it is missing or fails validation, this
+   * reads Module.txt and all the bank files within the Module_n directory instead, creating the
+   * directory structure and files if they do not yet exist. Any edits in Journal.bin are then
+   * replayed, any Sequences.txt is imported, and both are saved.
    *
    * @param state
-   * @return State
    */
-  static State readModuleDirectory(State state);
+  static void readModuleDirectory(State *state);
+
+  /**
+   * @brief Change to another module: finish any save in progress and close the journal, both of
+   * which belong to the current module, then read the new module. Returns false if the save
+   * failed, in which case the current module is kept.
+   *
+   * @param state
+   * @param module
+   * @return true
+   * @return false
+   */
+  static bool switchModule(State *state, uint8_t module);
 
   /**
    * @brief Read the persisted state values from the Module.txt file on the SD card. Create the
    * file if it does not yet exist.
    *
    * @param state
-   * @return State
    */
-  static State readModuleFile(State state);
+  static void readModuleFile(State *state);
 
   /**
-   * @brief Read the persisted state values from one of the Bank_n.txt fils the SD card. Create the
-   * file if it does not yet exist.
+   * @brief Read the persisted state values for one bank from the SD card. The binary Bank_n.bin
+   * file is preferred. If it is missing or fails validation, the legacy Bank_n.txt JSON file is
+   * read instead.
+   *
+   * @param state
+   * @param bank
+   */
+  static void readBankFile(State *state, uint8_t bank);
+
+  /**
+   * @brief Start an automatic save of the dirty banks, if autosave is on, no save is in progress,
+   * and the autosave interval has elapsed. Called once per loop iteration.
+   *
+   * @param loopStartTime
+   * @param state
+   */
+  static void autosave(unsigned long loopStartTime, State *state);
+
+  /**
+   * @brief Start saving the module image to Module.bin. The header and the given bank are
+   * snapshotted now, and the other banks are copied as they are reached. Every bank is marked
+   * clean, and the data is then written a chunk at a time by continueSave(). If a save is already
+   * in progress, it is finished first. Returns false if that earlier save failed, in which case no
+   * save is started and the banks are left dirty.
    *
    * @param state
    * @param bank
-   * @return State
+   * @param isAutosave
+   * @return true
+   * @return false
    */
-  static State readBankFile(State state, uint8_t bank);
+  static bool beginSave(State *state, uint8_t bank, bool isAutosave);
 
   /**
-   * @brief Get the persisted state values from the state struct and write them to the SD card.
-   * Returns a bool value denoting whether the write was successful.
+   * @brief Advance the save in progress by one step: opening the file, writing one chunk of at
+   * most SD_SAVE_CHUNK_SIZE bytes, reading back one record, or replacing the file. Called once per
+   * loop iteration.
+   *
+   * Module.bin is never written in place. The whole image is written to Module.tmp and read back,
+   * and only once every record checks out does Module.tmp replace Module.bin. A save cut short by
+   * the power leaves Module.bin as it was, and the journal, which is only truncated once nothing is
+   * dirty, still holds the edits. Starts the visual save confirmation when the save completes.
+   * Returns false if the save failed and was abandoned.
    *
    * @param state
    * @return true
    * @return false
    */
-  static bool writeCurrentModuleAndBank(State state);
+  static bool continueSave(State *state);
+
+  /**
+   * @brief Run the save in progress, if any, to completion, blocking until it is done. Returns
+   * false if the save failed.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool finishSave(State *state);
+
+  /**
+   * @brief Append the pending journal entries to Journal.bin every JOURNAL_FLUSH_INTERVAL ms, and
+   * truncate the journal once every dirty bank has been saved. Called once per loop iteration.
+   *
+   * @param loopStartTime
+   * @param state
+   */
+  static void maintainJournal(unsigned long loopStartTime, State *state);
+
+  /**
+   * @brief Append the pending journal entries to Journal.bin now.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool flushJournal(State *state);
+
+  /**
+   * @brief Flush and close Journal.bin. This must be called before changing modules, as the
+   * journal belongs to the current module.
+   *
+   * @param state
+   */
+  static void closeJournal(State *state);
+
+  /**
+   * @brief Write the human-readable Module.txt JSON file. This file is only read when there is no
+   * valid Module.bin.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool exportModuleFile(State *state);
+
+  /**
+   * @brief Write one bank to the human-readable Bank_n.txt JSON file. This file is only read when
+   * there is no valid Module.bin or Bank_n.bin, so to load hand edits, delete those files.
+   *
+   * @param state
+   * @param bank
+   * @return true
+   * @return false
+   */
+  static bool exportBankFile(State *state, uint8_t bank);
 
   private:
   /**
@@ -89,7 +188,117 @@ typedef struct SDCard {
    *
    * @param state
    */
-  static void confirmOrCreatePath(State state);
+  static void confirmOrCreatePath(State *state);
+
+  /**
+   * @brief Read one bank from Bank_n.bin with a single block read. Returns false if the file is
+   * missing or is not a valid bank record, in which case state is unchanged.
+   *
+   * @param state
+   * @param bank
+   * @return true
+   * @return false
+   */
+  static bool readBinaryBankFile(State *state, uint8_t bank);
+
+  /**
+   * @brief Read one bank from the legacy Bank_n.txt JSON file. Create the file if it does not yet
+   * exist.
+   *
+   * @param state
+   * @param bank
+   */
+  static void readJsonBankFile(State *state, uint8_t bank);
+
+  /**
+   * @brief Import the channel sequences in Sequences.txt, if the module directory has one, on top
+   * of the banks already read. The imported values are journaled, so they are saved to Module.bin
+   * like any edit, and the file is then renamed to Sequences_imported.txt so that it is imported
+   * only once. Returns true if anything was imported.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool importSequencesFile(State *state);
+
+  /**
+   * @brief Read the module header and all 16 bank records from Module.bin with one open and one
+   * sequential pass through the file. If Module.bin is missing but Module.tmp is present, the power
+   * was cut just after a verified save removed Module.bin, so Module.tmp is renamed first. Returns
+   * false if the file is missing or its header is not valid, in which case state is unchanged. A
+   * single invalid bank record is read from that bank's own files instead.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool readModuleImage(State *state);
+
+  /**
+   * @brief Write the next chunk of the save in progress, moving on to the CLOSE step after the last
+   * one.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool writeSaveChunk(State *state);
+
+  /**
+   * @brief Read back the next record of the save in progress and compare it with what was
+   * written, moving on to the COMMIT step after the header.
+   *
+   * @param state
+   * @return true
+   * @return false if the record could not be read or does not match.
+   */
+  static bool verifySaveChunk(State *state);
+
+  /**
+   * @brief Give up on the save in progress and mark its data dirty again. Returns false if this is
+   * an error the user should see, which is the case for explicit saves but not for autosaves.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool abandonSave(State *state);
+
+  /**
+   * @brief The lowest dirty bank, or the current bank if only the module header is dirty.
+   *
+   * @param state
+   * @return uint8_t
+   */
+  static uint8_t nextDirtyBank(State *state);
+
+  /**
+   * @brief Save every dirty bank, blocking until done. Returns false if the save failed.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool saveDirtyBanks(State *state);
+
+  /**
+   * @brief Apply every valid entry in Journal.bin to state, stopping at the first torn or invalid
+   * entry. Returns true if the journal was not empty.
+   *
+   * @param state
+   * @return true
+   * @return false
+   */
+  static bool replayJournal(State *state);
+
+  /**
+   * @brief Discard the pending journal entries and truncate Journal.bin. Only call this when every
+   * journaled edit has been saved to Module.bin.
+   *
+   * @param state
+   */
+  static void compactJournal(State *state);
 } SDCard;
 
 #endif
\ No newline at end of file
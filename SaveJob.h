@@ -0,0 +1,77 @@
+/**
+ * Recollections: Save Job
+ *
+ * Copyright 2022 William Edward Fisher.
+ */
+
+// Included for File
+#ifdef CORE_TEENSY
+  // This needs to be the Teensy-specific version of this. Rename others to disambiguate.
+  #include <SD.h>
+#else
+  #include <SDFS.h>
+#endif
+
+#include "BankRecord.h"
+#include "ModuleImage.h"
+#include "typedefs.h"
+
+#ifndef RECOLLECTIONS_SAVE_JOB_H_
+#define RECOLLECTIONS_SAVE_JOB_H_
+
+/**
+ * A save to the SD card in progress. Saving is spread across many loop iterations, one step at a
+ * time, so the outputs and the ADV clock keep running while the card is written. See
+ * SDCard::beginSave() and SDCard::continueSave().
+ *
+ * The bank being saved and the module header are copied into the job when the save begins, so
+ * edits made while the save is in progress do not tear the record that is written.
+ */
+typedef struct SaveJob {
+  /** The current step. See constants.h. */
+  SaveStep_t step;
+
+  /** The module and bank being saved. */
+  uint8_t module;
+  uint8_t bank;
+
+  /**
+   * Banks marked clean when the save began, one bit per bank. Every bank is written to the image,
+   * and each is copied from state no earlier than the start of the save, so one save covers all of
+   * the banks that were dirty. A failed save marks them dirty again.
+   */
+  uint16_t cleanedBanks;
+
+  /**
+   * Whether this save was started by autosave rather than by the user. Autosaves are silent: there
+   * is no visual confirmation, and a failure is retried later rather than shown as an error.
+   */
+  bool isAutosave;
+
+  /** Whether the last save was abandoned. Cleared when a save begins. */
+  bool hasFailed;
+
+  /** Index of the record being written or verified: banks 0-15, then the header. */
+  uint8_t segment;
+
+  /** Bytes of the current segment written so far. */
+  uint16_t segmentBytesWritten;
+
+  /** Snapshot of the module header taken when the save began. */
+  ModuleImage image;
+
+  /** Snapshot of the bank taken when the save began. */
+  BankRecord record;
+
+  /**
+   * The other banks of the module image. These are copied from state as each one is reached, as
+   * snapshotting all 16 banks up front would cost several kilobytes of RAM. Also receives each
+   * record as it is read back.
+   */
+  BankRecord scratch;
+
+  /** Module.tmp, open for writing from OPEN to CLOSE, and for reading from CLOSE to VERIFY. */
+  File file;
+} SaveJob;
+
+#endif
@@ -4,32 +4,30 @@
 
 #include "State.h"
 
+#include "CVInput.h"
+#include "Log.h"
+#include "Playheads.h"
+#include "Random.h"
 #include "Utils.h"
 
 /**
  * @brief Capture voltage while automatically recording.
  *
  * @param state
- * @return State
  */
-State State::autoRecord(State state) {
-  uint8_t currentBank = state.currentBank;
-  uint8_t currentPreset = state.currentPreset;
+void State::autoRecord(State *state) {
+  uint8_t currentBank = state->currentBank;
   for (uint8_t i = 0; i < 7; i++) {
+    uint8_t currentPreset = Playheads::step(state, i);
     if (
-      state.autoRecordChannels[currentBank][i] &&
-      !state.lockedVoltages[currentBank][currentPreset][i] &&
-      !state.randomInputChannels[currentBank][i]
+      Bits::get(state->autoRecordChannels[currentBank], i) &&
+      !Bits::get(state->lockedVoltages[currentBank][currentPreset], i) &&
+      !Bits::get(state->randomInputChannels[currentBank], i)
     ) {
-      #ifdef CORE_TEENSY
-        state.voltages[currentBank][currentPreset][i] =
-          Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-      #else
-        state.voltages[currentBank][currentPreset][i] = analogRead(CV_INPUT);
-      #endif
+      state->voltages[currentBank][currentPreset][i] = CVInput::read(state);
+      Journal::voltage(state, currentBank, currentPreset, i);
     }
   }
-  return state;
 }
 
 /**
@@ -38,19 +36,18 @@ State State::autoRecord(State state) {
  * continuous recording or a sample -- this function is agnostic to whether it is continuous.
  *
  * @param state
- * @return State
  */
-State State::editVoltageOnSelectedPreset(State state) {
-  if (state.screen == SCREEN.EDIT_CHANNEL_VOLTAGES || state.screen == SCREEN.PRESET_SELECT) {
-    #ifdef CORE_TEENSY
-      state.voltages[state.currentBank][state.selectedKeyForRecording][state.currentChannel] =
-        Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-    #else
-      state.voltages[state.currentBank][state.selectedKeyForRecording][state.currentChannel] =
-        analogRead(CV_INPUT);
-    #endif
+void State::editVoltageOnSelectedPreset(State *state) {
+  if (state->screen == SCREEN.EDIT_CHANNEL_VOLTAGES || state->screen == SCREEN.PRESET_SELECT) {
+    state->voltages[state->currentBank][state->selectedKeyForRecording][state->currentChannel] =
+      CVInput::read(state);
+    Journal::voltage(
+      state,
+      state->currentBank,
+      state->selectedKeyForRecording,
+      state->currentChannel
+    );
   }
-  return state;
 }
 
 /**
@@ -58,25 +55,23 @@ State State::editVoltageOnSelectedPreset(State state) {
  * the main loop() function.
  *
  * @param state
- * @return State
  */
-State State::recordContinuously(State state) {
-  if (state.selectedKeyForRecording >= 0) {
+void State::recordContinuously(State *state) {
+  if (state->selectedKeyForRecording >= 0) {
     if (
-      (state.screen == SCREEN.EDIT_CHANNEL_VOLTAGES || state.screen == SCREEN.PRESET_SELECT) &&
-      !state.randomInputChannels[state.currentBank][state.currentChannel]
+      (state->screen == SCREEN.EDIT_CHANNEL_VOLTAGES || state->screen == SCREEN.PRESET_SELECT) &&
+      !Bits::get(state->randomInputChannels[state->currentBank], state->currentChannel)
     ) {
-      state = State::editVoltageOnSelectedPreset(state);
+      State::editVoltageOnSelectedPreset(state);
     }
-    else if (state.screen == SCREEN.RECORD_CHANNEL_SELECT && !state.isAdvancingPresets) {
-      state = State::recordVoltageOnSelectedChannel(state);
+    else if (state->screen == SCREEN.RECORD_CHANNEL_SELECT && !state->isAdvancingPresets) {
+      State::recordVoltageOnSelectedChannel(state);
     }
   }
-  else if (!state.readyForRecInput && !state.isAdvancingPresets) {
-    Serial.println("should auto record");
-    state = State::autoRecord(state);
+  else if (!state->readyForRecInput && !state->isAdvancingPresets) {
+    LOG_DEBUG("should auto record");
+    State::autoRecord(state);
   }
-  return state;
 }
 
 /**
@@ -85,105 +80,126 @@ State State::recordContinuously(State state) {
  * recording or a sample -- this function is agnostic to whether it is continuous.
  *
  * @param state
- * @return State
  */
-State State::recordVoltageOnSelectedChannel(State state) {
-  uint8_t currentBank = state.currentBank;
-  uint8_t currentPreset = state.currentPreset;
-  uint8_t channel = state.selectedKeyForRecording;
+void State::recordVoltageOnSelectedChannel(State *state) {
+  uint8_t currentBank = state->currentBank;
+  uint8_t channel = state->selectedKeyForRecording;
+  uint8_t currentPreset = Playheads::step(state, channel);
   if (
-    state.screen == SCREEN.RECORD_CHANNEL_SELECT &&
-    !state.lockedVoltages[currentBank][currentPreset][channel]
+    state->screen == SCREEN.RECORD_CHANNEL_SELECT &&
+    !Bits::get(state->lockedVoltages[currentBank][currentPreset], channel)
   ) {
-    #ifdef CORE_TEENSY
-      state.voltages[currentBank][currentPreset][channel] =
-        Utils::tenBitToTwelveBit(analogRead(CV_INPUT));
-    #else
-      state.voltages[currentBank][currentPreset][channel] = analogRead(CV_INPUT);
-    #endif
+    state->voltages[currentBank][currentPreset][channel] = CVInput::read(state);
+    Journal::voltage(state, currentBank, currentPreset, channel);
   }
-  return state;
 }
 
-State State::paste(State state) {
-  if (state.selectedKeyForCopying < 0) {
-    Serial.printf("%s %u \n", "selectedKeyForCopying is unexpectedly", state.selectedKeyForCopying);
-    return state;
+void State::copyBank(State *state, uint8_t sourceBank, uint8_t targetBank) {
+  // [banks][presets][channels]
+  // The boolean planes are bit-packed, so all 8 channels of a preset are copied at once.
+  state->autoRecordChannels[targetBank] = state->autoRecordChannels[sourceBank];
+  state->gateChannels[targetBank] = state->gateChannels[sourceBank];
+  state->randomInputChannels[targetBank] = state->randomInputChannels[sourceBank];
+  state->randomOutputChannels[targetBank] = state->randomOutputChannels[sourceBank];
+  for (uint8_t j = 0; j < 16; j++) {
+    state->activeVoltages[targetBank][j] = state->activeVoltages[sourceBank][j];
+    state->gateVoltages[targetBank][j] = state->gateVoltages[sourceBank][j];
+    state->lockedVoltages[targetBank][j] = state->lockedVoltages[sourceBank][j];
+    state->randomVoltages[targetBank][j] = state->randomVoltages[sourceBank][j];
+    for (uint8_t k = 0; k < 8; k++) {
+      state->voltages[targetBank][j][k] = state->voltages[sourceBank][j][k];
+    }
+  }
+  for (uint8_t k = 0; k < 8; k++) {
+    state->randomSeeds[targetBank][k] = state->randomSeeds[sourceBank][k];
+    state->channelLengths[targetBank][k] = state->channelLengths[sourceBank][k];
+    state->channelAddends[targetBank][k] = state->channelAddends[sourceBank][k];
+    state->removedSteps[targetBank][k] = state->removedSteps[sourceBank][k];
+  }
+  Playheads::markStale(state);
+}
+
+void State::markBankDirty(State *state, uint8_t bank) {
+  state->dirtyBanks |= (uint16_t)(1 << bank);
+}
+
+void State::markModuleDirty(State *state) {
+  state->isModuleDirty = true;
+}
+
+void State::paste(State *state) {
+  if (state->selectedKeyForCopying < 0) {
+    LOG_ERROR("selectedKeyForCopying is unexpectedly %d", state->selectedKeyForCopying);
+    return;
   }
-  switch (state.screen) {
+  switch (state->screen) {
     case SCREEN.BANK_SELECT:
-      state = State::pasteBanks(state);
+      State::pasteBanks(state);
       break;
     case SCREEN.EDIT_CHANNEL_SELECT:
-      state = State::pasteChannels(state);
+      State::pasteChannels(state);
       break;
     case SCREEN.EDIT_CHANNEL_VOLTAGES:
-      state = State::pasteVoltages(state);
+      State::pasteVoltages(state);
       break;
     case SCREEN.GLOBAL_EDIT:
-      state = State::pastePresets(state);
+      State::pastePresets(state);
       break;
   }
-  state.selectedKeyForCopying = -1;
-  return state;
+  state->selectedKeyForCopying = -1;
 }
 
-State State::pasteBanks(State state) {
-  uint8_t selectedKeyForCopying = state.selectedKeyForCopying;
-  // [banks][presets][channels]
+void State::pasteBanks(State *state) {
+  uint8_t selectedKeyForCopying = state->selectedKeyForCopying;
   for (uint8_t i = 0; i < 16; i++) {
-    if (state.pasteTargetKeys[i]) {
-      for (uint8_t j = 0; j < 16; j++) {
-        for (uint8_t k = 0; k < 8; k++) {
-          state.activeVoltages[i][j][k] = state.activeVoltages[selectedKeyForCopying][j][k];
-          state.autoRecordChannels[i][k] = state.autoRecordChannels[selectedKeyForCopying][k];
-          state.gateChannels[i][k] = state.gateChannels[selectedKeyForCopying][k];
-          state.gateVoltages[i][j][k] = state.gateVoltages[selectedKeyForCopying][j][k];
-          state.lockedVoltages[i][j][k] = state.lockedVoltages[selectedKeyForCopying][j][k];
-          state.randomInputChannels[i][k] = state.randomInputChannels[selectedKeyForCopying][k];
-          state.randomOutputChannels[i][k] = state.randomOutputChannels[selectedKeyForCopying][k];
-          state.randomVoltages[i][j][k] = state.randomVoltages[selectedKeyForCopying][j][k];
-          state.voltages[i][j][k] = state.voltages[selectedKeyForCopying][j][k];
-        }
-      }
-      state.pasteTargetKeys[i] = false;
+    if (state->pasteTargetKeys[i]) {
+      State::copyBank(state, selectedKeyForCopying, i);
+      Journal::bank(state, i);
+      state->pasteTargetKeys[i] = false;
     }
   }
-  state.selectedKeyForCopying = -1;
-  return state;
+  state->selectedKeyForCopying = -1;
 }
 
 /**
  * @brief Paste all 16 preset voltage values from one channel to the set of target channels.
  *
  * @param state
- * @return State
  */
-State State::pasteChannels(State state) {
-  uint8_t currentBank = state.currentBank;
-  uint8_t selectedKeyForCopying = state.selectedKeyForCopying;
+void State::pasteChannels(State *state) {
+  uint8_t currentBank = state->currentBank;
+  uint8_t selectedKeyForCopying = state->selectedKeyForCopying;
   for (uint8_t i = 0; i < 8; i++) { // channels
-    if (state.pasteTargetKeys[i]) {
-      if (state.gateChannels[currentBank][selectedKeyForCopying]) {
-        state.gateChannels[state.currentBank][i] = true;
+    if (state->pasteTargetKeys[i]) {
+      if (Bits::get(state->gateChannels[currentBank], selectedKeyForCopying)) {
+        Bits::set(&state->gateChannels[state->currentBank], i, true);
+        Journal::channelFlags(state, currentBank);
         for (uint8_t j = 0; j < 16; j++) {
-          state.gateVoltages[currentBank][j][i] =
-            state.gateVoltages[currentBank][j][selectedKeyForCopying];
+          Bits::set(
+            &state->gateVoltages[currentBank][j],
+            i,
+            Bits::get(state->gateVoltages[currentBank][j], selectedKeyForCopying)
+          );
+          Journal::presetFlags(state, currentBank, j);
         }
       }
       else {
         for (uint8_t j = 0; j < 16; j++) { // presets
-          state.activeVoltages[currentBank][j][i] =
-            state.activeVoltages[currentBank][j][state.selectedKeyForCopying];
-          state.voltages[currentBank][j][i] =
-            state.voltages[currentBank][j][state.selectedKeyForCopying];
+          Bits::set(
+            &state->activeVoltages[currentBank][j],
+            i,
+            Bits::get(state->activeVoltages[currentBank][j], selectedKeyForCopying)
+          );
+          state->voltages[currentBank][j][i] =
+            state->voltages[currentBank][j][state->selectedKeyForCopying];
+          Journal::presetFlags(state, currentBank, j);
+          Journal::voltage(state, currentBank, j, i);
         }
       }
     }
-    state.pasteTargetKeys[i] = false;
+    state->pasteTargetKeys[i] = false;
   }
-  state.selectedKeyForCopying = -1;
-  return state;
+  state->selectedKeyForCopying = -1;
 }
 
 /**
@@ -191,67 +207,84 @@ State State::pasteChannels(State state) {
  * presets.
  *
  * @param state
- * @return State
  */
-State State::pasteVoltages(State state) {
+void State::pasteVoltages(State *state) {
   for (uint8_t i = 0; i < 16; i++) { // presets
-    if (state.pasteTargetKeys[i]) {
-      state.voltages[state.currentBank][i][state.currentChannel] =
-        state.voltages[state.currentBank][state.selectedKeyForCopying][state.currentChannel];
+    if (state->pasteTargetKeys[i]) {
+      state->voltages[state->currentBank][i][state->currentChannel] =
+        state->voltages[state->currentBank][state->selectedKeyForCopying][state->currentChannel];
+      Journal::voltage(state, state->currentBank, i, state->currentChannel);
     }
-    state.pasteTargetKeys[i] = false;
+    state->pasteTargetKeys[i] = false;
   }
-  state.selectedKeyForCopying = -1;
-  return state;
+  state->selectedKeyForCopying = -1;
 }
 
 /**
  * @brief Paste all 8 channel voltage values from one preset to the set of target presets.
  *
  * @param state
- * @return State
  */
-State State::pastePresets(State state) {
+void State::pastePresets(State *state) {
   for (uint8_t i = 0; i < 16; i++) { // presets
-    if (state.pasteTargetKeys[i]) {
+    if (state->pasteTargetKeys[i]) {
       for (uint8_t j = 0; j < 8; j++) { // channels
-        state.voltages[state.currentBank][i][j] =
-          state.voltages[state.currentBank][state.selectedKeyForCopying][j];
+        state->voltages[state->currentBank][i][j] =
+          state->voltages[state->currentBank][state->selectedKeyForCopying][j];
+        Journal::voltage(state, state->currentBank, i, j);
       }
     }
-    state.pasteTargetKeys[i] = false;
+    state->pasteTargetKeys[i] = false;
   }
-  state.selectedKeyForCopying = -1;
-  return state;
+  state->selectedKeyForCopying = -1;
 }
 
-State State::quitCopyPasteFlowPriorToPaste(State state) {
-  state.selectedKeyForCopying = -1;
+void State::quitCopyPasteFlowPriorToPaste(State *state) {
+  state->selectedKeyForCopying = -1;
   for (uint8_t i = 0; i < 16; i++) {
-    state.pasteTargetKeys[i] = false;
+    state->pasteTargetKeys[i] = false;
+  }
+}
+
+void State::selectBank(State *state, uint8_t bank) {
+  if (bank > 15 || bank == state->currentBank) {
+    return;
   }
-  return state;
+  LOG_DEBUG("Selected bank %u", bank);
+  state->currentBank = bank;
 }
 
-State State::setRandomVoltagesForPreset(uint8_t preset, State state) {
+void State::setRandomVoltagesForPreset(uint8_t preset, uint32_t step, State *state) {
+  uint8_t currentBank = state->currentBank;
+  ChannelFlags_t randomChannels = state->randomOutputChannels[currentBank];
+  // The step each channel will play, which is the preset unless it has a sequence of its own.
+  uint8_t steps[8];
+  ChannelFlags_t randomPresets = CHANNEL_FLAGS_NONE;
+  for (uint8_t i = 0; i < 8; i++) {
+    steps[i] = Playheads::nextStep(state, i, preset);
+    Bits::set(&randomPresets, i, Bits::get(state->randomVoltages[currentBank][steps[i]], i));
+  }
+  if ((randomChannels | randomPresets) == CHANNEL_FLAGS_NONE) {
+    return;
+  }
+  // Every random value this step can need, computed at once.
+  uint32_t randomBits[8];
+  Random::allAtStep(state, currentBank, step, randomBits);
+
   for (uint8_t i = 0; i < 8; i++) {
-    // random channels, random 32-bit converted to 12-bit
-    if (state.randomOutputChannels[state.currentBank][i]) {
-      state.voltages[state.currentBank][preset][i] = Utils::random(MAX_UNSIGNED_12_BIT);
+    // random channels, the top 12 bits
+    if (Bits::get(randomChannels, i)) {
+      state->voltages[currentBank][steps[i]][i] = randomBits[i] >> 20;
     }
 
-    if (state.randomVoltages[state.currentBank][preset][i]) {
-      // random gate presets
-      if (state.gateChannels[state.currentBank][i]) {
-        uint32_t coinToss = Utils::random(2);
-        state.gateVoltages[state.currentBank][preset][i] = coinToss
-          ? VOLTAGE_VALUE_MAX
-          : 0;
+    if (Bits::get(randomPresets, i)) {
+      // random gate presets, the top bit
+      if (Bits::get(state->gateChannels[currentBank], i)) {
+        Bits::set(&state->gateVoltages[currentBank][steps[i]], i, randomBits[i] >> 31);
       } else {
-        // random CV presets, random 32-bit converted to 12-bit
-        state.voltages[state.currentBank][preset][i] = Utils::random(MAX_UNSIGNED_12_BIT);
+        // random CV presets
+        state->voltages[currentBank][steps[i]][i] = randomBits[i] >> 20;
       }
     }
   }
-  return state;
 }
@@ -4,7 +4,23 @@
  * Copyright 2022 William Edward Fisher.
  */
 
+#include "Advance.h"
+#include "Bits.h"
+#include "CVInput.h"
+#include "ClockTracker.h"
 #include "Config.h"
+#include "Framebuffer.h"
+#include "GateEvents.h"
+#include "Journal.h"
+#include "Link.h"
+#include "LoopProfiler.h"
+#include "Output.h"
+#include "OutputTimer.h"
+#include "Playheads.h"
+#include "Random.h"
+#include "Remote.h"
+#include "ResolvedPresets.h"
+#include "SaveJob.h"
 #include "constants.h"
 #include "typedefs.h"
 
@@ -21,6 +37,14 @@
  *
  * Some channel configurations affect every voltage on that channel. In these cases, the preset axis
  * is dropped and a 2D array of [bank][channel] is used instead.
+ *
+ * Boolean data is bit-packed: the channel axis of a boolean plane is a single ChannelFlags_t byte
+ * holding one bit per channel, so a plane indexed [bank][preset][channel] is stored as
+ * [bank][preset] and read or written with the accessors in Bits.h.
+ *
+ * The state object is many kilobytes in size, so it must never be copied. All functions that read
+ * or modify state take a pointer to the single instance in Recollections.ino and mutate it in
+ * place.
  */
 typedef struct State {
   /** Global config. Values here should very rarely change. Initial values provided in setup(). */
@@ -58,10 +82,22 @@ typedef struct State {
    */
   int8_t advanceBankAddend;
 
-  /** Flag to track whether we have recently received a gate or trigger on the ADV input. */
+  /**
+   * The number of steps taken since the last RESET, which chooses the values of the random
+   * channels and presets. See Random::atStep().
+   */
+  uint32_t randomStep;
+
+  /**
+   * Flag to track whether we have recently received a gate or trigger on the ADV input. Set by
+   * ClockTracker.
+   */
   bool isAdvancingPresets;
 
-  /** Flag to track whether we are receiving regular gates or triggers on the ADV input. */
+  /**
+   * Flag to track whether we are receiving regular gates or triggers on the ADV input. Set by
+   * ClockTracker.
+   */
   bool isClocked;
 
   /** Flag to track whether to respond to a clock/gate/trigger on the ADV input. */
@@ -104,6 +140,49 @@ typedef struct State {
   /** Count the number of flashes since saving to help manage the visual save confirmation. */
   uint8_t flashesSinceSave;
 
+  /** The save to the SD card in progress, if any. The visual save confirmation follows its end. */
+  SaveJob saveJob;
+
+  /**
+   * Banks changed since they were last saved, one bit per bank. Bit n is bank n. Every mutation of
+   * bank data must be recorded in the journal, which also marks the bank here, so that autosave
+   * knows what to write.
+   */
+  uint16_t dirtyBanks;
+
+  /** Whether removedPresets has changed since the module was last saved. */
+  bool isModuleDirty;
+
+  /** The time in ms at which the last round of automatic saving completed. */
+  unsigned long lastAutosaveTime;
+
+  /** Edits not yet saved to Module.bin, recorded so they survive a power cut. See Journal.h. */
+  Journal journal;
+
+  /** The values last written to the DACs, and instrumentation of the writes. See Output.h. */
+  Output output;
+
+  /** Output values scheduled for a later time, and the claim on the I2C bus. See OutputTimer.h. */
+  OutputTimer outputTimer;
+
+  /** The time taken by each phase of the loop. See LoopProfiler.h. */
+  LoopProfiler profiler;
+
+  /** The colors last sent to the keys. See Framebuffer.h. */
+  Framebuffer framebuffer;
+
+  /** Edges at the gate inputs, captured by interrupts and not yet handled. See GateEvents.h. */
+  GateEvents gateEvents;
+
+  /** The clock at the ADV input. See ClockTracker.h. */
+  ClockTracker clock;
+
+  /** The voltage at the CV input. See CVInput.h. */
+  CVInput cvInput;
+
+  /** The generator of random voltages, gates and colors. See Random.h. */
+  Random random;
+
   /**
    * Count the number of flashes to determine if enough time has elapsed to where a new random
    * color should be rendered. This number will update regardless of whether any preset
@@ -129,13 +208,6 @@ typedef struct State {
    */
   unsigned long lastFlashToggle;
 
-  /**
-   * Time in ms since the last time a clock/gate/trigger was received at the ADV input. We keep the
-   * last three values to determine whether the module is advancing or being clocked, as well as how
-   * long gates should be.
-   */
-  unsigned long lastAdvReceivedTime[3];
-
   /** Time in ms since last MOD button press. */
   unsigned long lastModPressTime;
 
@@ -153,8 +225,8 @@ typedef struct State {
   uint8_t keyPressesSinceModHold;
 
   /**
-   * The average between the last two times a clock/gate/trigger was received at the ADV input.
-   * This is used to calculate the gate length when a channel is configured to send gates.
+   * The length of the gates sent by channels configured to send gates: half the clock period at the
+   * ADV input when clocked, and DEFAULT_TRIGGER_LENGTH otherwise. Set by ClockTracker.
    */
   unsigned long gateMillis;
 
@@ -171,6 +243,13 @@ typedef struct State {
   /** Keys representing banks, channels, presets or sets of presets to be  pasted. */
   bool pasteTargetKeys[16];
 
+  /**
+   * The module selected on the module select screen, 0-15. Keys are handled while the I2C bus is
+   * claimed, so the switch is left to Input::handleInput(). A value below zero denotes that no
+   * module is waiting to be switched to.
+   */
+  int8_t requestedModule;
+
   /**
    * The presets that will be skipped entirely during sequencing.
    * This is set in GLOBAL_EDIT screen.
@@ -180,58 +259,102 @@ typedef struct State {
   /**
    * The channels where the voltage will be either 5v or 0v and the duration of 5v will be based on
    * the measured time between clock signals received at the ADV input.
-   * Indices are [bank][channel].
+   * Indices are [bank], with one bit per channel.
    */
-  bool gateChannels[16][8];
+  ChannelFlags_t gateChannels[16];
 
   /**
    * The channels that will sample the incoming voltage when a gate or trigger is received on the
    * REC input. The incoming voltage could be from the CV input, the internal voltage source, or if
    * the channel is in the list of randomInputChannels, a randomly generated voltage value.
-   * Indices are [bank][channel].
+   * Indices are [bank], with one bit per channel.
    */
-  bool autoRecordChannels[16][8];
+  ChannelFlags_t autoRecordChannels[16];
 
   /**
    * The channels where the output voltage will be random.
-   * Indices are [bank][channel].
+   * Indices are [bank], with one bit per channel.
    */
-  bool randomOutputChannels[16][8];
+  ChannelFlags_t randomOutputChannels[16];
 
   /**
    * The channels where the input voltage will be random. This only applies to automatic recording.
-   * Indices are [bank][channel].
+   * Indices are [bank], with one bit per channel.
    */
-  bool randomInputChannels[16][8];
+  ChannelFlags_t randomInputChannels[16];
 
   /**
    * If a voltage is not active, its value will be ignored in favor of the last previous
    * active voltage. There must always be at least one active voltage.
    * This is set in EDIT_CHANNEL_VOLTAGES screen.
-   * Indices are [bank][preset][channel].
+   * Indices are [bank][preset], with one bit per channel.
    */
-  bool activeVoltages[16][16][8];
+  ChannelFlags_t activeVoltages[16][16];
+
+  /** The preset each voltage resolves to, given activeVoltages. See ResolvedPresets.h. */
+  ResolvedPresets resolvedPresets;
+
+  /** Linked modules. See Link.h. */
+  Link link;
+
+  /** Commands from a controller on the follower bus. See Remote.h. */
+  Remote remote;
+
+  /** The preset after each preset, skipping the removed presets. See Advance.h. */
+  Advance advance;
+
+  /** The step of each channel with a sequence of its own. See Playheads.h. */
+  Playheads playheads;
 
   /**
    * The voltages (aka "steps") that will produce gates on a specified channel.
    * This is set in EDIT_CHANNEL_VOLTAGES screen.
-   * Indices are [bank][preset][channel].
+   * Indices are [bank][preset], with one bit per channel.
    */
-  bool gateVoltages[16][16][8];
+  ChannelFlags_t gateVoltages[16][16];
 
   /**
    * The voltages (aka "steps") that will produce a random value, either CV or gate, on a specified
    * channel.
    * This is set in EDIT_CHANNEL_VOLTAGES screen.
-   * Indices are [bank][preset][channel].
+   * Indices are [bank][preset], with one bit per channel.
+   */
+  ChannelFlags_t randomVoltages[16][16];
+
+  /**
+   * The seed of the random values of each channel, so that a random sequence can be recalled: it
+   * repeats from every RESET, and is saved with the bank. A new seed is drawn when a channel is
+   * made random. Indices are [bank][channel].
+   */
+  uint16_t randomSeeds[16][8];
+
+  /**
+   * The number of steps in the sequence of each channel, so that channels can run sequences of
+   * different lengths from the same clock. 0, the default, means the channel has no sequence of its
+   * own and plays the current preset. See Playheads.h.
+   * Indices are [bank][channel].
+   */
+  uint8_t channelLengths[16][8];
+
+  /**
+   * The number of steps each channel moves on each advance, in the direction of
+   * advancePresetAddend. Only used by channels with a length.
+   * Indices are [bank][channel].
+   */
+  int8_t channelAddends[16][8];
+
+  /**
+   * Steps that are skipped in the sequence of each channel, one bit per step. Bit n is step n. Only
+   * used by channels with a length.
+   * Indices are [bank][channel].
    */
-  bool randomVoltages[16][16][8];
+  uint16_t removedSteps[16][8];
 
   /**
    * Voltages that cannot be changed in RECORD_CHANNEL_SELECT screen or through automatic recording.
-   * Indices are [bank][preset][channel].
+   * Indices are [bank][preset], with one bit per channel.
    */
-  bool lockedVoltages[16][16][8];
+  ChannelFlags_t lockedVoltages[16][16];
 
   /**
    * 12-bit stored voltage values for channels per preset per bank (max value is 1023).
@@ -259,90 +382,121 @@ typedef struct State {
    * @brief Record voltage on the channels set up for automatic recording.
    *
    * @param state
-   * @return State
    */
-  static State autoRecord(State state);
+  static void autoRecord(State *state);
 
   /**
    * @brief Edit voltage for preset selected by hand.
    *
    * @param state
-   * @return State
    */
-  static State editVoltageOnSelectedPreset(State state);
+  static void editVoltageOnSelectedPreset(State *state);
 
   /**
    * @brief Record new voltage
    *
    * @param state
-   * @return State
    */
-  static State recordContinuously(State state);
+  static void recordContinuously(State *state);
 
   /**
    * @brief Record voltage for a channel selected by hand.
    *
    * @param state
-   * @return State
    */
-  static State recordVoltageOnSelectedChannel(State state);
+  static void recordVoltageOnSelectedChannel(State *state);
+
+  /**
+   * @brief Copy every field of one bank to another. Keep this in sync with the bank data set up
+   * in setupState() in Recollections.ino.
+   *
+   * @param state
+   * @param sourceBank
+   * @param targetBank
+   */
+  static void copyBank(State *state, uint8_t sourceBank, uint8_t targetBank);
+
+  /**
+   * @brief Flag a bank as changed since it was last saved.
+   *
+   * @param state
+   * @param bank
+   */
+  static void markBankDirty(State *state, uint8_t bank);
+
+  /**
+   * @brief Flag the module-level data, such as removedPresets, as changed since it was last saved.
+   *
+   * @param state
+   */
+  static void markModuleDirty(State *state);
 
   /**
    * @brief Universal entry point for all pastes.
    *
    * @param state
-   * @return State
    */
-  static State paste(State state);
+  static void paste(State *state);
 
   /**
    * @brief Paste the voltages from one bank to a number of other banks, across all 16 presets and
    * all 8 channels.
    *
    * @param state
-   * @return State
    */
-  static State pasteBanks(State state);
+  static void pasteBanks(State *state);
 
   /**
    * @brief Paste the voltages from one channel to a number of other channels, across all 16 presets.
    *
    * @param state
-   * @return State
    */
-  static State pasteChannels(State state);
+  static void pasteChannels(State *state);
 
   /**
    * @brief Paste the voltage from one preset to a number of other presets on the same channel.
    *
    * @param state
-   * @return State
    */
-  static State pasteVoltages(State state);
+  static void pasteVoltages(State *state);
 
   /**
    * @brief Paste the voltage from one preset to a number of other presets, across all 8 channels.
    *
    * @param state
-   * @return State
    */
-  static State pastePresets(State state);
+  static void pastePresets(State *state);
 
   /**
    * @brief Clean up state related to copy-paste.
    *
    * @param state
-   * @return State
    */
-  static State quitCopyPasteFlowPriorToPaste(State state);
+  static void quitCopyPasteFlowPriorToPaste(State *state);
 
   /**
-   * @brief Set all random voltages across channels for a specified preset
+   * @brief Change the current bank. The bank select keys, the BANK ADV input, remote commands and
+   * the leader of linked modules all change banks here. The step tables of Playheads and the
+   * table of ResolvedPresets are rebuilt for the new bank the next time they are read.
+   *
+   * @param state
+   * @param bank 0-15.
+   */
+  static void selectBank(State *state, uint8_t bank);
+
+  /**
+   * @brief Set all random voltages across channels for a specified preset, to their values at the
+   * given step. See Random::atStep(). A channel with a sequence of its own sets the voltage of its
+   * next step instead. See Playheads.h.
+   *
+   * The values are generated, not edits, so they are not journaled and do not mark the bank dirty.
+   * They reach the SD card with the next save of the bank.
    *
+   * @param preset The preset that will be current after the next advance.
+   * @param step
    * @param state
-   * @return State
    */
-  static State setRandomVoltagesForPreset(uint8_t preset, State state);
+  static void setRandomVoltagesForPreset(uint8_t preset, uint32_t step, State *state);
  } State;
 
  #endif
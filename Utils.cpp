@@ -4,17 +4,34 @@
 
 #include "Utils.h"
 
-#ifdef CORE_TEENSY
-  #include <Entropy.h>
-#else
-  #include <stdlib.h> // for rand()
-#endif
-
+#include "ClockTracker.h"
+#include "Log.h"
+#include "Random.h"
+#include "ResolvedPresets.h"
 #include "constants.h"
 
+/**
+ * @brief Standard CRC-32 (the one used by zip and PNG), computed bitwise to avoid the RAM cost of a
+ * lookup table. This is only used when reading and writing files, never within the loop.
+ *
+ * @param data
+ * @param length
+ * @return uint32_t
+ */
+uint32_t Utils::crc32(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc = crc ^ data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
 Quadrant_t Utils::keyQuadrant(uint8_t key) {
   if (key > 15) {
-    Serial.println("Key is outside of range");
+    LOG_ERROR("Key is outside of range");
     return QUADRANT.INVALID;
   }
   if (key < 2 || (key > 3 && key < 6)) {
@@ -28,17 +45,9 @@ Quadrant_t Utils::keyQuadrant(uint8_t key) {
   }
 }
 
-uint32_t Utils::random(uint32_t max) {
-  #ifdef CORE_TEENSY
-    return Entropy.random(max); // True random number generation
-  #else
-    return rand() % max;
-  #endif
-}
-
 uint16_t Utils::tenBitToTwelveBit(uint16_t n) {
   if (n > MAX_UNSIGNED_10_BIT) {
-    Serial.println("invalid 10-bit integer");
+    LOG_ERROR("invalid 10-bit integer");
     return 0;
   }
   else if (n == 0) {
@@ -50,59 +59,68 @@ uint16_t Utils::tenBitToTwelveBit(uint16_t n) {
   return n << 2;
 }
 
-// TODO: create unit tests for this
-uint16_t Utils::voltageValue(State state, uint8_t preset, uint8_t channel) {
-  uint8_t currentBank = state.currentBank;
+uint16_t Utils::voltageValue(State *state, uint8_t preset, uint8_t channel) {
+  return Utils::voltageValueAtStep(
+    state,
+    preset,
+    channel,
+    state->randomStep,
+    ClockTracker::isWithinGate(state, micros())
+  );
+}
 
-  // Gate channels
-  if (state.gateChannels[currentBank][channel]) {
-    // When randomOutputOverwrites is true, random gate voltages are set in
-    // State::setRandomVoltagesForPreset() before we advance to the next preset.
-    if (!state.config.randomOutputOverwrites && state.randomVoltages[currentBank][preset][channel]) {
-      return
-        Utils::random(2) &&
-        millis() - state.lastAdvReceivedTime[0] < state.gateMillis
-        ? VOLTAGE_VALUE_MAX
-        : 0;
-    }
-    return
-      state.gateVoltages[currentBank][preset][channel] &&
-      millis() - state.lastAdvReceivedTime[0] < state.gateMillis
-        ? VOLTAGE_VALUE_MAX
-        : 0;
-  }
+/**
+ * @brief The voltage value of a channel at a step other than the current one, such as the step the
+ * next ADV gate will advance to, so that it can be produced the moment the gate arrives.
+ *
+ * @param state
+ * @param preset
+ * @param channel
+ * @param step The value of State::randomStep at that step.
+ * @param isWithinGate Whether gate channels are high.
+ * @return uint16_t
+ */
+uint16_t Utils::voltageValueAtStep(
+  State *state,
+  uint8_t preset,
+  uint8_t channel,
+  uint32_t step,
+  bool isWithinGate
+) {
+  uint8_t currentBank = state->currentBank;
+  // Random values always come from the seed, so a run repeats from each reset. When
+  // randomOutputOverwrites is true, State::setRandomVoltagesForPreset() also writes them into the
+  // voltages as they play, but they are never read back from there.
 
-  // Inactive presets within CV channels
-  if (!state.activeVoltages[currentBank][preset][channel]) {
-    // To get the voltage for an inactive preset, we need to find the last active preset, even if that
-    // means wrapping around the sequence.
-    for (uint8_t i = 1; i < 15; i++) {
-      int8_t priorPreset = preset - i;
-      uint8_t candidatePreset = priorPreset >= 0 ? priorPreset : 16 + priorPreset;
-      if (candidatePreset == preset) {
-        continue;
-      }
-      else if (state.activeVoltages[currentBank][candidatePreset][channel])
-      {
-        return Utils::outputControlVoltageValue(state, candidatePreset, channel);
-      }
-    }
+  // Gate channels
+  if (Bits::get(state->gateChannels[currentBank], channel)) {
+    bool isHigh =
+      Bits::get(state->randomVoltages[currentBank][preset], channel)
+        ? Random::atStep(state, currentBank, channel, step) >> 31
+        : Bits::get(state->gateVoltages[currentBank][preset], channel);
+    return isHigh && isWithinGate ? VOLTAGE_VALUE_MAX : 0;
   }
 
-  // Default CV channel behavior
-  return Utils::outputControlVoltageValue(state, preset, channel);
+  // CV channels. An inactive preset outputs the voltage of the last active preset, even if that
+  // means wrapping around the sequence.
+  uint8_t resolvedPreset = ResolvedPresets::get(state, currentBank, preset, channel);
+  return Utils::outputControlVoltageValue(state, resolvedPreset, channel, step);
 }
 
 //--------------------------------------- PRIVATE --------------------------------------------------
 
-uint16_t Utils::outputControlVoltageValue(State state, uint8_t preset, uint8_t channel) {
-  uint8_t currentBank = state.currentBank;
+uint16_t Utils::outputControlVoltageValue(
+  State *state,
+  uint8_t preset,
+  uint8_t channel,
+  uint32_t step
+) {
+  uint8_t currentBank = state->currentBank;
   if (
-    !state.config.randomOutputOverwrites &&
-    (state.randomOutputChannels[currentBank][channel] ||
-      state.randomVoltages[currentBank][preset][channel])
+    Bits::get(state->randomOutputChannels[currentBank], channel) ||
+    Bits::get(state->randomVoltages[currentBank][preset], channel)
   ) {
-    return Utils::random(MAX_UNSIGNED_12_BIT);
+    return Random::atStep(state, currentBank, channel, step) >> 20;
   }
-  return state.voltages[currentBank][preset][channel];
+  return state->voltages[currentBank][preset][channel];
 }
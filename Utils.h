@@ -11,13 +11,25 @@
 #define RECOLLECTIONS_UTILS_H_
 
 typedef struct Utils {
+  static uint32_t crc32(const uint8_t *data, size_t length);
   static Quadrant_t keyQuadrant(uint8_t key);
-  static uint32_t random(uint32_t max);
   static uint16_t tenBitToTwelveBit(uint16_t n);
-  static uint16_t voltageValue(State state, uint8_t preset, uint8_t channel);
+  static uint16_t voltageValue(State *state, uint8_t preset, uint8_t channel);
+  static uint16_t voltageValueAtStep(
+    State *state,
+    uint8_t preset,
+    uint8_t channel,
+    uint32_t step,
+    bool isWithinGate
+  );
 
   private:
-  static uint16_t outputControlVoltageValue(State state, uint8_t preset, uint8_t channel);
+  static uint16_t outputControlVoltageValue(
+    State *state,
+    uint8_t preset,
+    uint8_t channel,
+    uint32_t step
+  );
 } Utils;
 
 #endif
\ No newline at end of file
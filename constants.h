@@ -43,6 +43,7 @@
 #define DEFAULT_BRIGHTNESS 100
 #define COLOR_VALUE_MAX 255 // max brightness, relative to brightness setting
 #define DIMMED_COLOR_MULTIPLIER 0.15
+#define MIN_FRAME_INTERVAL 16 // ms between showing changed pixels, about 60 frames per second
 
 // ------------------------------ Timing and Flashing ----------------------------------------------
 
@@ -51,8 +52,54 @@
 #define LONG_PRESS_TIME 1500
 #define DEFAULT_TRIGGER_LENGTH 20
 
+// The fractions of a gate's timing error that correct the beat and the period. See ClockTracker.h.
+#define CLOCK_BEAT_CORRECTION_DIVISOR 2
+#define CLOCK_PERIOD_CORRECTION_DIVISOR 8
+
 #define SAVE_CONFIRMATION_MAX_FLASHES 4
 
+#define OUTPUT_STATS_INTERVAL 1000
+
+// Gate edges captured by interrupts between two loops. A power of two. See GateEvents.h.
+#define GATE_EVENT_BUFFER_SIZE 32
+
+// How often the output timer checks for a scheduled write, and so how late a gate may end. On the
+// RP2040, also how often the second core samples the CV input. See OutputTimer.h.
+#define OUTPUT_TIMER_PERIOD_MICROS 250
+
+// Sent over the RP2040's inter-core FIFO to start the second core once setup() has completed.
+#define CORE1_START 1
+
+// Sampling of the CV input. See CVInput.h. The ring holds 2^CV_SAMPLE_RING_BITS bytes, and the DMA
+// transfer count is a multiple of the samples it holds.
+#define CV_SAMPLE_RATE 48000
+#define CV_SAMPLE_RING_BITS 7
+#define CV_SAMPLE_RING_SIZE 64
+#define CV_OVERSAMPLING 16
+#define CV_DMA_TRANSFER_COUNT 0xFFFFFFC0
+#define CV_SMOOTHING_MAX 8
+
+// How often more entropy is mixed into the random number generator, in ms. See Random.h.
+#define RANDOM_RESEED_INTERVAL 10000
+
+// Linked modules. See Link.h. Follower n of a chain answers at LINK_FOLLOWER_ADDRESS + n - 1 on the
+// follower bus. A message is the address byte and 8 bytes, 9 bits each on the bus, so it takes
+// LINK_MESSAGE_TRANSFER_MICROS at LINK_BUS_FREQUENCY. Received messages wait in a buffer of
+// LINK_MESSAGE_BUFFER_SIZE, a power of two, for the loop.
+#define LINK_MAX_MODULES 4
+#define LINK_FOLLOWER_ADDRESS 0x58
+#define LINK_BUS_FREQUENCY 400000
+#define LINK_MESSAGE_BUS_BYTES 9
+#define LINK_MESSAGE_TRANSFER_MICROS 203
+#define LINK_MESSAGE_BUFFER_SIZE 16
+
+// Remote control. See Remote.h. An unlinked module answers controllers at REMOTE_ADDRESS on the
+// follower bus, and a linked follower at its own address. A command is REMOTE_COMMAND_BYTES long.
+// Received commands wait in a buffer of REMOTE_COMMAND_BUFFER_SIZE, a power of two, for the loop.
+#define REMOTE_ADDRESS 0x5C
+#define REMOTE_COMMAND_BYTES 4
+#define REMOTE_COMMAND_BUFFER_SIZE 64
+
 // ------------------------------ Hardware Environment ---------------------------------------------
 
 // The version of the hardware expressed as a semver. See https://semver.org/
@@ -64,6 +111,41 @@ bool const USB_POWERED = false;
 // Whether the SD card is required to boot up the module. Used for development and debugging.
 bool const REQUIRE_SD_CARD = true;
 
+// Whether to print I2C traffic and time spent on the outputs over Serial. See Output.h.
+bool const REPORT_OUTPUT_STATS = false;
+
+// Whether to time each phase of the loop. See LoopProfiler.h. The host build turns this on.
+#ifndef PROFILE_LOOP
+  #define PROFILE_LOOP false
+#endif
+
+// The character that asks, over Serial, for a report of the loop profile. See LoopProfiler.h.
+#define PROFILE_REPORT_COMMAND 'p'
+
+// Histogram buckets per loop phase: four per power of two, up to 2^31 cycles. See LoopProfiler.h.
+#define PROFILE_BUCKETS 124
+
+// ------------------------------------------- Log -------------------------------------------------
+
+// The levels of the messages in the log, in order of severity. See Log.h.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// The most verbose level that is compiled into the firmware. Messages above it cost nothing.
+#define LOG_LEVEL LOG_LEVEL_INFO
+
+// Whether to hold log messages until the next loop rather than printing them where they occur.
+bool const LOG_BUFFERED = true;
+
+// The number of messages held until the next loop. Messages beyond these are counted and dropped.
+#define LOG_BUFFER_LINES 16
+
+// The length of a message, including the terminating null. Longer messages are truncated.
+#define LOG_LINE_LENGTH 96
+
 // ------------------------------------- SD Card ---------------------------------------------------
 
 // Calculated with https://arduinojson.org/v6/assistant
@@ -74,9 +156,30 @@ bool const REQUIRE_SD_CARD = true;
 #define MODULE_JSON_DOC_DESERIALIZATION_SIZE 512 // 410 required
 #define MODULE_JSON_DOC_SERIALIZATION_SIZE 384 // 336 required
 
+// Bytes written to the SD card per loop iteration while saving. See SaveJob.h.
+#define SD_SAVE_CHUNK_SIZE 128
+
+// Journal of edits, Journal.bin. See Journal.h.
+#define JOURNAL_BUFFER_ENTRIES 64 // 512 bytes, one SD card sector
+#define JOURNAL_FLUSH_INTERVAL 100 // ms of edits at risk if the power is cut
+#define JOURNAL_COMPACT_SIZE 16384 // bytes, at which the journal is compacted even without autosave
+
 #define CONFIG_SD_PATH "Recollections/Config.txt"
 #define MODULE_SD_PATH_PREFIX "Recollections/Module_"
 
+// Binary bank files, Bank_n.bin. See BankRecord.h.
+#define BANK_RECORD_MAGIC 0x4B424352 // "RCBK" when read as little-endian bytes
+#define BANK_RECORD_VERSION 3
+
+// The sizes of the older bank records, still read but never written: version 1 had no random
+// seeds, and version 2 had no channel sequences.
+#define BANK_RECORD_V1_SIZE 336
+#define BANK_RECORD_V2_SIZE 352
+
+// Binary module files, Module.bin. See ModuleImage.h.
+#define MODULE_IMAGE_MAGIC 0x444D4352 // "RCMD" when read as little-endian bytes
+#define MODULE_IMAGE_VERSION 1
+
 #ifdef ARDUINO_TEENSY41
   const uint8_t SD_CS_PIN = BUILTIN_SDCARD;
 #elif defined(ARDUINO_TEENSY36)
@@ -95,6 +198,8 @@ bool const REQUIRE_SD_CARD = true;
 
 // Different ways to open files on the SD card
 uint8_t const SD_READ_CREATE = (uint8_t)(O_READ | O_CREAT);
+// Write to the end of the file, creating it if needed.
+uint8_t const SD_APPEND = (uint8_t)(O_WRONLY | O_CREAT | O_APPEND);
 
 // --------------------------- Microcontroller Board Pins ------------------------------------------
 
@@ -155,7 +260,6 @@ uint8_t const SD_READ_CREATE = (uint8_t)(O_READ | O_CREAT);
   // Analog inputs
   /** Control voltage input to be recorded. */
   uint8_t const CV_INPUT = 26;
-  uint8_t const UNCONNECTED_ANALOG_PIN = 28; // noise for srand()
 
   // Digital inputs
   /** Gate to start/stop automatic recording. Recording occurs when the gate is high. */
@@ -200,6 +304,12 @@ uint8_t const SD_READ_CREATE = (uint8_t)(O_READ | O_CREAT);
 
 #endif
 
+// ---------------------------------- Channel Flags ------------------------------------------------
+
+// Values for a ChannelFlags_t with every channel's flag cleared or set. See Bits.h.
+#define CHANNEL_FLAGS_NONE 0x00
+#define CHANNEL_FLAGS_ALL 0xFF
+
 // ------------------------------------- Screens ---------------------------------------------------
 
 /**
@@ -256,6 +366,150 @@ typedef struct Screen {
 } Screen;
 Screen constexpr SCREEN;
 
+// ----------------------------------- Save Steps --------------------------------------------------
+
+/**
+ * The steps of a save in progress, advanced once per loop iteration. See SDCard::continueSave().
+ */
+typedef struct SaveStep {
+  // No save in progress.
+  SaveStep_t IDLE = 0;
+
+  // Create Module.tmp, which receives a whole new module image.
+  SaveStep_t OPEN = 1;
+
+  // Write the next chunk of the image.
+  SaveStep_t WRITE = 2;
+
+  // Close the file, which flushes the last of the data to the card, and open it again for reading.
+  SaveStep_t CLOSE = 3;
+
+  // Read back the next record and check it against what was written.
+  SaveStep_t VERIFY = 4;
+
+  // Replace Module.bin with Module.tmp.
+  SaveStep_t COMMIT = 5;
+
+  // Write the optional JSON files. See Config::exportBankJson.
+  SaveStep_t EXPORT = 6;
+} SaveStep;
+SaveStep constexpr SAVE_STEP;
+
+// --------------------------------- Journal Fields ------------------------------------------------
+
+/**
+ * The fields of State that a journal entry can record, and how each uses the entry's coordinates.
+ * See Journal.h.
+ */
+typedef struct JournalField {
+  // voltages[bank][preset][channel] = value
+  JournalField_t VOLTAGE = 0;
+
+  // The ChannelFlags_t of one preset, [bank][preset] = value
+  JournalField_t ACTIVE_VOLTAGES = 1;
+  JournalField_t GATE_VOLTAGES = 2;
+  JournalField_t LOCKED_VOLTAGES = 3;
+  JournalField_t RANDOM_VOLTAGES = 4;
+
+  // The ChannelFlags_t of one bank, [bank] = value
+  JournalField_t AUTO_RECORD_CHANNELS = 5;
+  JournalField_t GATE_CHANNELS = 6;
+  JournalField_t RANDOM_INPUT_CHANNELS = 7;
+  JournalField_t RANDOM_OUTPUT_CHANNELS = 8;
+
+  // removedPresets[preset] = value
+  JournalField_t REMOVED_PRESET = 9;
+
+  // 10 is unused. It copied a whole bank, which could not be replayed safely once the source bank
+  // had been saved with later edits, so pasted banks are now recorded value by value.
+
+  // randomSeeds[bank][channel] = value
+  JournalField_t RANDOM_SEED = 11;
+
+  // The sequence of one channel, [bank][channel] = value. See Playheads.h.
+  JournalField_t CHANNEL_LENGTH = 12;
+  JournalField_t CHANNEL_ADDEND = 13; // the int8_t addend, as its unsigned byte
+  JournalField_t REMOVED_STEPS = 14;
+} JournalField;
+JournalField constexpr JOURNAL_FIELD;
+
+// ----------------------------------- Gate Inputs -------------------------------------------------
+
+/**
+ * The gate inputs, in the order their edges are handled within a loop. See Input::handleInput().
+ * The MOD button is not among them, as it is polled and debounced.
+ */
+typedef struct GateInput {
+  GateInput_t RESET = 0;
+  GateInput_t BANK_REV = 1;
+  GateInput_t BANK_ADV = 2;
+  GateInput_t REV = 3;
+  GateInput_t ADV = 4;
+  GateInput_t REC = 5;
+} GateInput;
+GateInput constexpr GATE_INPUT;
+#define GATE_INPUT_COUNT 6
+
+// --------------------------------- Link Messages -------------------------------------------------
+
+/**
+ * The messages the leader of linked modules sends to its followers. See Link.h.
+ */
+typedef struct LinkMessageType {
+  // The leader advanced to linked step `value`, and will advance to `nextValue` after it.
+  LinkMessageType_t STEP = 0;
+
+  // The leader was reset to linked step `value`, and will advance to `nextValue` after it.
+  LinkMessageType_t RESET = 1;
+
+  // The leader changed to bank `value`.
+  LinkMessageType_t BANK = 2;
+} LinkMessageType;
+LinkMessageType constexpr LINK_MESSAGE;
+
+// -------------------------------- Remote Commands ------------------------------------------------
+
+/**
+ * The commands a controller can send on the follower bus. See Remote.h.
+ */
+typedef struct RemoteCommandType {
+  // Set the voltage of channel `channel` at its current step to the 12-bit `value`.
+  RemoteCommandType_t SET_VOLTAGE = 0;
+
+  // Select preset `value`, as its key does on the PRESET_SELECT screen.
+  RemoteCommandType_t SELECT_PRESET = 1;
+
+  // Select bank `value`.
+  RemoteCommandType_t SELECT_BANK = 2;
+
+  // Select module `value`, which reads it from the SD card.
+  RemoteCommandType_t SELECT_MODULE = 3;
+
+  // Record, as a rising edge at the REC input does.
+  RemoteCommandType_t RECORD = 4;
+
+  // Answer the next read with the value of output `channel`, as 2 bytes, high byte first.
+  RemoteCommandType_t READ_OUTPUT = 5;
+} RemoteCommandType;
+RemoteCommandType constexpr REMOTE_COMMAND;
+
+// ----------------------------------- Loop Phases -------------------------------------------------
+
+/**
+ * The phases of loop() timed by LoopProfiler, in the order they run. LOOP is the whole iteration.
+ */
+typedef struct LoopPhase {
+  LoopPhase_t FLASH_TIMING = 0;
+  LoopPhase_t TRELLIS_READ = 1;
+  LoopPhase_t HANDLE_INPUT = 2;
+  LoopPhase_t RECORD = 3;
+  LoopPhase_t REFLECT_STATE = 4;
+  LoopPhase_t SAVE = 5;
+  LoopPhase_t LOOP = 6;
+} LoopPhase;
+LoopPhase constexpr LOOP_PHASE;
+#define LOOP_PHASE_COUNT 7
+
 // ----------------------------------- Quadrants ---------------------------------------------------
 
 /**
@@ -278,6 +532,39 @@ Quadrant constexpr QUADRANT;
 uint8_t const DAC_1_I2C_ADDRESS = 0x60;
 uint8_t const DAC_2_I2C_ADDRESS = 0x61;
 
+/**
+ * Bytes on the I2C bus for one fast write of all four channels of a DAC: the address byte, then two
+ * bytes per channel.
+ */
+#define DAC_FAST_WRITE_BYTES 9
+
+/**
+ * Bytes on the I2C bus for one multi-write of a single channel of a DAC: the address byte, then
+ * three bytes for the channel.
+ */
+#define DAC_MULTI_WRITE_BYTES 4
+
+/**
+ * Bytes on the I2C bus for one general call software update: the general call address, then the
+ * command.
+ */
+#define DAC_GENERAL_CALL_BYTES 2
+
+/**
+ * The I2C general call address, and the general call command with which every MCP4728 on the bus
+ * moves the values in its input registers to its outputs at once.
+ */
+uint8_t const I2C_GENERAL_CALL_ADDRESS = 0x00;
+uint8_t const DAC_SOFTWARE_UPDATE_COMMAND = 0x08;
+
+/**
+ * Whether to load the voltages of the next preset into the DACs ahead of the ADV input, and move
+ * them to all eight outputs at once on its rising edge. See Output.h. This requires the LDAC pins
+ * of both DACs to be held high: where LDAC is low, each output follows its input register, and the
+ * next preset would be heard before the edge.
+ */
+bool const PRELOAD_DAC_OUTPUTS = true;
+
 /**
  * The four channels of an MCP4728 DAC arranged as an array for the sake of syntactic sugar.
  * Do not use this array directly. Use setChannel() instead.
@@ -25,4 +25,40 @@ typedef uint8_t Quadrant_t;
  */
 typedef uint8_t RGBColorArray_t[3];
 
+/**
+ * Eight boolean flags packed into one byte, one flag per output channel. Bit n is channel n.
+ * See Bits.h for the accessors.
+ */
+typedef uint8_t ChannelFlags_t;
+
+/**
+ * The steps of an incremental save to the SD card. See constants.h.
+ */
+typedef uint8_t SaveStep_t;
+
+/**
+ * The fields of State that a journal entry can record. See constants.h.
+ */
+typedef uint8_t JournalField_t;
+
+/**
+ * The gate inputs, whose edges are captured by interrupts. See constants.h.
+ */
+typedef uint8_t GateInput_t;
+
+/**
+ * The phases of the loop, as timed by LoopProfiler. See constants.h.
+ */
+typedef uint8_t LoopPhase_t;
+
+/**
+ * The messages the leader of linked modules sends to its followers. See constants.h.
+ */
+typedef uint8_t LinkMessageType_t;
+
+/**
+ * The commands a controller can send on the follower bus. See constants.h.
+ */
+typedef uint8_t RemoteCommandType_t;
+
 #endif